@@ -0,0 +1,83 @@
+#ifndef BENCHSTATS_H
+#define BENCHSTATS_H
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+/******************************************************************
+    Sample statistics shared by the benches.  Samples are taken by
+    value and sorted here, so callers can pass what they recorded.
+*******************************************************************/
+
+namespace KMDM
+{
+    namespace bench
+    {
+        /**
+         * @brief The samples in ascending order.
+         *
+         * @param samples
+         * @return std::vector<double>
+         */
+        inline std::vector<double> sorted(std::vector<double> samples)
+        {
+            std::sort(samples.begin(), samples.end());
+            return samples;
+        }
+
+        /**
+         * @brief Nearest rank percentile, p in (0, 1].
+         *
+         * @param samples
+         * @param p
+         * @return double
+         */
+        inline double percentile(std::vector<double> samples, double p)
+        {
+            samples = sorted(samples);
+            size_t index = static_cast<size_t>(std::ceil(p * samples.size()));
+            return samples[std::min(index > 0 ? index - 1 : 0, samples.size() - 1)];
+        }
+
+        /**
+         * @brief The middle sample, the upper of the two middle ones for an even count.
+         *
+         * @param samples
+         * @return double
+         */
+        inline double median(std::vector<double> samples)
+        {
+            samples = sorted(samples);
+            return samples[samples.size() / 2];
+        }
+
+        inline double mean(const std::vector<double>& samples)
+        {
+            double total = 0.0;
+            for (double sample : samples)
+            {
+                total += sample;
+            }
+            return samples.empty() ? 0.0 : total / samples.size();
+        }
+
+        /**
+         * @brief Population standard deviation.
+         *
+         * @param samples
+         * @return double
+         */
+        inline double standardDeviation(const std::vector<double>& samples)
+        {
+            double average = mean(samples);
+            double variance = 0.0;
+            for (double sample : samples)
+            {
+                variance += (sample - average) * (sample - average);
+            }
+            return samples.empty() ? 0.0 : std::sqrt(variance / samples.size());
+        }
+    }
+}
+#endif // BENCHSTATS_H
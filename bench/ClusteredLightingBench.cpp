@@ -0,0 +1,208 @@
+#include "../include/Window.h"
+#include "../include/Instance.h"
+#include "../include/Surface.h"
+#include "../include/PhysicalDevice.h"
+#include "../include/LogicalDevice.h"
+#include "../include/SwapChain.h"
+#include "../include/CommandPool.h"
+#include "../include/Renderpass.h"
+#include "../include/DescriptorSet.h"
+#include "../include/ClusteredLighting.h"
+#include "../include/PipelineCache.h"
+#include "../include/SamplerCache.h"
+#include "../include/Util.h"
+#include "BenchStats.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+/******************************************************************
+    ClusteredLightingBench: sweep the number of dynamic lights and
+    time the light culling pass on the GPU with timestamp queries.
+    The light grid is read back to show how many lights a fragment
+    loops over in its cluster, against every light without culling.
+
+    Lights of a fixed range are scattered through the view frustum
+    of a 1920x1080 camera looking down -z.
+
+    ClusteredLightingBench [runs]
+*******************************************************************/
+
+namespace
+{
+    const VkExtent2D BENCH_EXTENT = {1920, 1080};
+    const float BENCH_NEAR = 0.1f;
+    const float BENCH_FAR = 100.0f;
+    const float BENCH_LIGHT_RANGE = 2.0f;
+    const uint32_t BENCH_LIGHT_COUNTS[] = {10, 100, 1000, 10000};
+
+    struct CullResult
+    {
+        double gpuMs;
+        double averageLights;
+        uint32_t maxLights;
+        uint32_t fullClusters;
+    };
+
+    std::vector<KMDM::Light> scatterLights(uint32_t count, std::mt19937& random)
+    {
+        std::uniform_real_distribution<float> depth(BENCH_NEAR, BENCH_FAR);
+        std::uniform_real_distribution<float> side(-1.0f, 1.0f);
+        float halfHeight = std::tan(glm::radians(30.0f));
+        float halfWidth = halfHeight * BENCH_EXTENT.width / BENCH_EXTENT.height;
+
+        std::vector<KMDM::Light> lights(count);
+        for (auto & light : lights)
+        {
+            float z = depth(random);
+            light.position = glm::vec3(side(random) * halfWidth * z, side(random) * halfHeight * z, -z);
+            light.range = BENCH_LIGHT_RANGE;
+        }
+        return lights;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int runs = argc > 1 ? std::max(1, std::atoi(argv[1])) : 20;
+
+    try
+    {
+        KMDM::Window* window = KMDM::Window::getInstance();
+        KMDM::Instance* instance = KMDM::Instance::getInstance();
+        KMDM::Surface* surface = KMDM::Surface::getInstance();
+        KMDM::PhysicalDevice* physical_device = KMDM::PhysicalDevice::getInstance();
+        KMDM::LogicalDevice* device = KMDM::LogicalDevice::getInstance();
+        KMDM::SwapChain* swap_chain = KMDM::SwapChain::getInstance();
+        KMDM::CommandPool* command_pool = KMDM::CommandPool::getInstance();
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physical_device->getPhysicalDevice(), &properties);
+        if (!properties.limits.timestampComputeAndGraphics)
+        {
+            throw std::runtime_error("The device has no timestamp queries on the graphics queue.");
+        }
+
+        KMDM::Renderpass* renderpass = new KMDM::Renderpass();
+        KMDM::DescriptorSet* descriptor_set = new KMDM::DescriptorSet(renderpass);
+        KMDM::ClusteredLighting* lighting = new KMDM::ClusteredLighting(descriptor_set, 1);
+        uint32_t clusters = KMDM::ClusteredLighting::getClusterCount();
+
+        VkQueryPoolCreateInfo queryInfo = {};
+        queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryInfo.queryCount = 2;
+        VkQueryPool queries;
+        if (vkCreateQueryPool(device->getLogicalDevice(), &queryInfo, nullptr, &queries) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create timestamp query pool.");
+        }
+
+        VkBuffer readback;
+        VkDeviceMemory readbackMemory;
+        KMDM::createBuffer(clusters * sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, readback, readbackMemory);
+
+        glm::mat4 view = glm::mat4(1.0f);
+        glm::mat4 projection = glm::perspective(glm::radians(60.0f),
+            BENCH_EXTENT.width / static_cast<float>(BENCH_EXTENT.height), BENCH_NEAR, BENCH_FAR);
+        projection[1][1] *= -1;
+
+        std::mt19937 random(1234);
+        std::vector<std::pair<uint32_t, CullResult>> results;
+        for (uint32_t count : BENCH_LIGHT_COUNTS)
+        {
+            lighting->update(0, scatterLights(count, random), glm::vec3(0.0f), view, projection, BENCH_EXTENT,
+                BENCH_NEAR, BENCH_FAR);
+
+            std::vector<double> samples;
+            for (int run = 0; run < runs; run++)
+            {
+                VkCommandBuffer commandBuffer = command_pool->beginSingleTimeCommands();
+                vkCmdResetQueryPool(commandBuffer, queries, 0, 2);
+                vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queries, 0);
+                lighting->recordCulling(commandBuffer, 0);
+                vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, queries, 1);
+
+                VkBufferMemoryBarrier barrier = {};
+                barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+                barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+                barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.buffer = lighting->getLightGridBuffer();
+                barrier.offset = 0;
+                barrier.size = VK_WHOLE_SIZE;
+                vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+                VkBufferCopy copy = {0, 0, clusters * sizeof(uint32_t)};
+                vkCmdCopyBuffer(commandBuffer, lighting->getLightGridBuffer(), readback, 1, &copy);
+                command_pool->endSingleTimeCommands(commandBuffer);
+
+                uint64_t timestamps[2];
+                vkGetQueryPoolResults(device->getLogicalDevice(), queries, 0, 2, sizeof(timestamps), timestamps,
+                    sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+                samples.push_back((timestamps[1] - timestamps[0]) * properties.limits.timestampPeriod / 1.0e6);
+            }
+
+            // The grid is the same on every run.
+            std::vector<uint32_t> grid(clusters);
+            void* data;
+            vkMapMemory(device->getLogicalDevice(), readbackMemory, 0, clusters * sizeof(uint32_t), 0, &data);
+            memcpy(grid.data(), data, clusters * sizeof(uint32_t));
+            vkUnmapMemory(device->getLogicalDevice(), readbackMemory);
+
+            CullResult result = {};
+            result.gpuMs = KMDM::bench::median(samples);
+            uint64_t total = 0;
+            for (uint32_t lights : grid)
+            {
+                total += lights;
+                result.maxLights = std::max(result.maxLights, lights);
+                result.fullClusters += lights >= MAX_LIGHTS_PER_CLUSTER ? 1 : 0;
+            }
+            result.averageLights = total / static_cast<double>(clusters);
+            results.emplace_back(count, result);
+        }
+
+        vkDestroyBuffer(device->getLogicalDevice(), readback, nullptr);
+        vkFreeMemory(device->getLogicalDevice(), readbackMemory, nullptr);
+        vkDestroyQueryPool(device->getLogicalDevice(), queries, nullptr);
+        delete(lighting);
+        delete(descriptor_set);
+        delete(renderpass);
+        KMDM::PipelineCache::getInstance()->destroyPipelineCache();
+        KMDM::SamplerCache::getInstance()->destroySamplerCache();
+        command_pool->destroyCommandPool();
+        swap_chain->destroySwapChain();
+        device->destroyLogicalDevice();
+        surface->destroySurface();
+        instance->destoryInstance();
+        window->destoryWindow();
+
+        std::cout << "Light culling over " << clusters << " clusters, median of " << runs << " runs:" << std::endl;
+        for (const auto & entry : results)
+        {
+            const CullResult& result = entry.second;
+            std::printf("  %5u lights: %.3f ms, %.1f lights per cluster (max %u, %u full), %.0fx fewer than unculled\n",
+                entry.first, result.gpuMs, result.averageLights, result.maxLights, result.fullClusters,
+                result.averageLights > 0.0 ? entry.first / result.averageLights : 0.0);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
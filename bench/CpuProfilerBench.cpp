@@ -0,0 +1,114 @@
+#include "../include/CpuProfiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+/******************************************************************
+    CpuProfilerBench: time the cost of a CPU profiler zone, empty
+    and with a payload, on one thread and with every core recording
+    at once.  Each run records CPU_PROFILER_RING_SIZE zones per
+    thread, and the average over the runs is reported.  The zones are written
+    to cpu_trace.json at the end.
+
+    CpuProfilerBench [runs]
+*******************************************************************/
+
+namespace
+{
+    const uint64_t BENCH_ZONES = CPU_PROFILER_RING_SIZE;
+
+    // Keep the zones from being optimised away.
+    volatile uint64_t g_sink = 0;
+
+    void recordZones()
+    {
+        for (uint64_t i = 0; i < BENCH_ZONES; i++)
+        {
+            KMDM_PROFILE_ZONE("zone");
+            g_sink = i;
+        }
+    }
+
+    void recordValueZones()
+    {
+        for (uint64_t i = 0; i < BENCH_ZONES; i++)
+        {
+            KMDM_PROFILE_ZONE_VALUE("valueZone", i);
+            g_sink = i;
+        }
+    }
+
+    /**
+     * @brief Nanoseconds per zone with the zones recorded on threads at once.  Each thread gets
+     * its own ring, so the threads are started once and record every run.
+     *
+     * @param record
+     * @param threads
+     * @param runs
+     * @return double
+     */
+    double timeZones(void (*record)(), uint32_t threads, int runs)
+    {
+        auto recordRuns = [record, runs]
+        {
+            for (int run = 0; run < runs; run++)
+            {
+                record();
+            }
+        };
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for (uint32_t i = 1; i < threads; i++)
+        {
+            workers.emplace_back(recordRuns);
+        }
+        recordRuns();
+        for (auto & worker : workers)
+        {
+            worker.join();
+        }
+        return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count()
+            / (BENCH_ZONES * runs);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int runs = argc > 1 ? std::max(1, std::atoi(argv[1])) : 10;
+
+    try
+    {
+#ifndef KMDM_ENABLE_PROFILER
+        std::cout << "Built without KMDM_ENABLE_PROFILER, the zones are compiled out." << std::endl;
+#endif // KMDM_ENABLE_PROFILER
+        KMDM::CpuProfiler* profiler = KMDM::CpuProfiler::getInstance();
+        KMDM_PROFILE_THREAD("Main");
+
+        // Register the thread and fault the ring in before timing.
+        recordZones();
+
+        uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+        std::printf("%-24s %10s %10s\n", "zone", "1 thread", "all cores");
+        std::printf("%-24s %8.1fns %8.1fns\n", "empty",
+            timeZones(recordZones, 1, runs), timeZones(recordZones, cores, runs));
+        std::printf("%-24s %8.1fns %8.1fns\n", "with payload",
+            timeZones(recordValueZones, 1, runs), timeZones(recordValueZones, cores, runs));
+        std::printf("All cores is wall time per zone of one thread, with %u threads recording.\n", cores);
+
+        profiler->writeChromeTrace(CPU_TRACE_PATH);
+        profiler->destroyCpuProfiler();
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,232 @@
+#include "../include/Renderer.h"
+#include "../include/Window.h"
+#include "../include/Scene.h"
+#include "../include/Model.h"
+#include "../include/UploadManager.h"
+#include "../include/PhysicalDevice.h"
+#include "../include/GpuProfiler.h"
+#include "../include/MemoryTelemetry.h"
+#include "BenchStats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/******************************************************************
+    HeadlessBench: draw a scene offscreen, without a window, for a
+    number of frames along a scripted camera path, and write the
+    frame times, GPU pass times and memory use as JSON.  It runs on
+    any Vulkan device, so CI can run it on lavapipe by pointing
+    VK_ICD_FILENAMES at the lvp_icd json.
+
+    The camera path is a text file of keyframes, one per line:
+
+        time  eye_x eye_y eye_z  target_x target_y target_z
+
+    with z up.  The path is stretched over the measured frames, and
+    lines starting with # are skipped.  Without one the camera
+    circles the origin from the default view.
+
+    Pipeline statistics and occlusion counters are collected per
+    pass or per draw when counters is passes or draws, and written
+    to GPU_COUNTERS_PATH with the renderer's shutdown.
+
+    HeadlessBench model texture [frames] [width] [height] [camera path|-] [output] [off|passes|draws]
+*******************************************************************/
+
+namespace
+{
+    const uint32_t BENCH_WARMUP_FRAMES = 5;
+    const char* BENCH_OUTPUT = "headless_bench.json";
+
+    struct CameraKey
+    {
+        float time;
+        glm::vec3 eye;
+        glm::vec3 target;
+    };
+
+    std::vector<CameraKey> loadCameraPath(const std::string& path)
+    {
+        std::vector<CameraKey> keys;
+        if (path.empty() || path == "-")
+        {
+            for (int i = 0; i <= 8; i++)
+            {
+                float angle = glm::radians(45.0f * i + 45.0f);
+                keys.push_back({ static_cast<float>(i),
+                    glm::vec3(2.83f * std::cos(angle), 2.83f * std::sin(angle), 2.0f), glm::vec3(0.0f) });
+            }
+            return keys;
+        }
+
+        std::ifstream file(path);
+        if (!file)
+        {
+            throw std::runtime_error("Failed to open camera path " + path + ".");
+        }
+        std::string line;
+        while (std::getline(file, line))
+        {
+            if (line.empty() || line[0] == '#')
+            {
+                continue;
+            }
+            std::istringstream stream(line);
+            CameraKey key;
+            if (stream >> key.time >> key.eye.x >> key.eye.y >> key.eye.z >> key.target.x >> key.target.y
+                >> key.target.z)
+            {
+                keys.push_back(key);
+            }
+        }
+        if (keys.empty())
+        {
+            throw std::runtime_error("Camera path " + path + " has no keyframes.");
+        }
+        std::sort(keys.begin(), keys.end(), [](const CameraKey& a, const CameraKey& b)
+        {
+            return a.time < b.time;
+        });
+        return keys;
+    }
+
+    /**
+     * @brief The view at a fraction of the way along the path, between its two nearest keys.
+     *
+     */
+    glm::mat4 sampleCameraPath(const std::vector<CameraKey>& keys, float fraction)
+    {
+        float time = keys.front().time + fraction * (keys.back().time - keys.front().time);
+        size_t next = 1;
+        while (next < keys.size() && keys[next].time < time)
+        {
+            next++;
+        }
+        if (next >= keys.size())
+        {
+            return glm::lookAt(keys.back().eye, keys.back().target, glm::vec3(0.0f, 0.0f, 1.0f));
+        }
+        const CameraKey& a = keys[next - 1];
+        const CameraKey& b = keys[next];
+        float t = b.time > a.time ? (time - a.time) / (b.time - a.time) : 1.0f;
+        return glm::lookAt(glm::mix(a.eye, b.eye, t), glm::mix(a.target, b.target, t), glm::vec3(0.0f, 0.0f, 1.0f));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: HeadlessBench model texture [frames] [width] [height] [camera path|-] [output] "
+                  << "[off|passes|draws]" << std::endl;
+        return 1;
+    }
+    std::string model_path = argv[1];
+    std::string texture_path = argv[2];
+    int frames = argc > 3 ? std::max(1, std::atoi(argv[3])) : 300;
+    int width = argc > 4 ? std::max(1, std::atoi(argv[4])) : WIDTH;
+    int height = argc > 5 ? std::max(1, std::atoi(argv[5])) : HEIGHT;
+    std::string camera_path = argc > 6 ? argv[6] : "-";
+    std::string output = argc > 7 ? argv[7] : BENCH_OUTPUT;
+    std::string counters = argc > 8 ? argv[8] : "off";
+
+    try
+    {
+        std::vector<CameraKey> keys = loadCameraPath(camera_path);
+
+        KMDM::Window::setHeadless(true, width, height);
+        KMDM::Renderer* renderer = KMDM::Renderer::getInstance();
+        KMDM::Scene* scene = KMDM::Scene::getInstance();
+        if (counters == "passes" || counters == "draws")
+        {
+            KMDM::GpuProfiler::getInstance()->setCounterLevel(counters == "passes" ?
+                KMDM::GpuCounterLevel::Passes : KMDM::GpuCounterLevel::Draws);
+        }
+
+        KMDM::Model model(model_path, texture_path);
+        KMDM::UploadManager::getInstance()->wait(model.getUploadTicket());
+        scene->addMesh(model);
+
+        // The latch is read just before each frame is submitted.
+        float fraction = 0.0f;
+        renderer->setCameraLatch([&keys, &fraction]()
+        {
+            return sampleCameraPath(keys, fraction);
+        });
+
+        // Pipelines are built, and textures stream in, over the first frames.
+        for (uint32_t i = 0; i < BENCH_WARMUP_FRAMES; i++)
+        {
+            renderer->renderFrame();
+        }
+
+        std::vector<double> samples;
+        samples.reserve(frames);
+        for (int frame = 0; frame < frames; frame++)
+        {
+            fraction = frames > 1 ? frame / static_cast<float>(frames - 1) : 0.0f;
+            auto start = std::chrono::high_resolution_clock::now();
+            renderer->renderFrame();
+            auto end = std::chrono::high_resolution_clock::now();
+            samples.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+        }
+        vkDeviceWaitIdle(KMDM::LogicalDevice::getInstance()->getLogicalDevice());
+
+        std::vector<double> sorted = KMDM::bench::sorted(samples);
+
+        std::ofstream file(output);
+        if (!file)
+        {
+            throw std::runtime_error("Failed to open " + output + " for the benchmark results.");
+        }
+        VkPhysicalDeviceProperties props = KMDM::PhysicalDevice::getInstance()->getPhysicalDeviceProperties();
+        file << std::fixed << std::setprecision(3);
+        file << "{\n  \"device\": \"" << props.deviceName << "\",\n";
+        file << "  \"width\": " << width << ",\n  \"height\": " << height << ",\n";
+        file << "  \"frames\": " << frames << ",\n";
+        file << "  \"frameTimeMs\": {\"min\": " << sorted.front()
+             << ", \"mean\": " << KMDM::bench::mean(samples)
+             << ", \"p50\": " << KMDM::bench::percentile(sorted, 0.50)
+             << ", \"p90\": " << KMDM::bench::percentile(sorted, 0.90)
+             << ", \"p95\": " << KMDM::bench::percentile(sorted, 0.95)
+             << ", \"p99\": " << KMDM::bench::percentile(sorted, 0.99)
+             << ", \"max\": " << sorted.back() << "},\n";
+
+        // GPU scopes keep their last GPU_PROFILER_WINDOW samples.
+        std::vector<KMDM::GpuScopeStats> scopes = KMDM::GpuProfiler::getInstance()->getStats();
+        file << "  \"gpuPasses\": [";
+        for (size_t i = 0; i < scopes.size(); i++)
+        {
+            file << (i ? ",\n" : "\n") << "    {\"name\": \"" << scopes[i].name
+                 << "\", \"samples\": " << scopes[i].samples
+                 << ", \"minMs\": " << scopes[i].minMs
+                 << ", \"avgMs\": " << scopes[i].avgMs
+                 << ", \"p99Ms\": " << scopes[i].p99Ms << "}";
+        }
+        file << "\n  ],\n  \"memory\": ";
+        KMDM::MemoryTelemetry::getInstance()->writeJson(file);
+        file << "\n}" << std::endl;
+
+        scene->destoryScene();
+        renderer->destroyRenderer();
+
+        std::cout << frames << " frames at " << width << "x" << height << " on " << props.deviceName
+                  << ", p50 " << KMDM::bench::percentile(sorted, 0.50) << " ms, p99 "
+                  << KMDM::bench::percentile(sorted, 0.99) << " ms, written to " << output << "." << std::endl;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,406 @@
+#include "../include/Renderer.h"
+#include "../include/Window.h"
+#include "../include/Model.h"
+#include "../include/MipGenerator.h"
+#include "../include/Ktx2.h"
+#include "../include/UploadManager.h"
+#include "BenchStats.h"
+
+#include <stb_image.h>
+#include <stb_image_write.h>
+#include <tiny_obj_loader.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/******************************************************************
+    ImportBench: time each stage of importing a model, over small,
+    medium and huge synthetic assets and any real ones given.
+
+        obj_parse           tinyobj alone.
+        obj_parse_dedupe    Model's parse, tinyobj plus the vertex
+                            deduplication, so the difference to
+                            obj_parse is the deduplication.
+        texture_decode      PNG or KTX2 decode.
+        mip_generation      Mip chain of the decoded texture.
+        decode_model        Model::decodeModelData, all of the above.
+        upload              Model's constructor and the wait for its
+                            uploads, on a headless device.
+
+    Every stage reports the median, mean, spread and coefficient of
+    variation of its repetitions, its throughput and the operator new
+    allocations of one repetition (stb allocates with malloc, which is
+    not counted).  Results are also written as JSON, to compare runs
+    when the loader changes.
+
+    ImportBench [repetitions] [output] [model texture]...
+*******************************************************************/
+
+namespace
+{
+    std::atomic<uint64_t> g_allocations{0};
+    std::atomic<uint64_t> g_allocatedBytes{0};
+}
+
+void* operator new(std::size_t size)
+{
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    g_allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* pointer = std::malloc(size ? size : 1))
+    {
+        return pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+    std::free(pointer);
+}
+
+namespace
+{
+    const char* BENCH_OUTPUT = "import_bench.json";
+
+    // Synthetic assets: quads along each side of the mesh, and the texture size.
+    struct SyntheticSize
+    {
+        const char* name;
+        uint32_t grid;
+        uint32_t textureSize;
+    };
+    const SyntheticSize SYNTHETIC_SIZES[] =
+    {
+        { "small", 32, 256 },
+        { "medium", 256, 1024 },
+        { "huge", 1024, 4096 }
+    };
+    // Huge assets take seconds a stage, so they are repeated at most this often.
+    const int HUGE_REPETITIONS = 3;
+
+    struct BenchAsset
+    {
+        std::string name;
+        std::vector<char> obj;
+        std::vector<char> texture;
+        int repetitions;
+    };
+
+    struct StageResult
+    {
+        std::string stage;
+        std::string asset;
+        size_t bytes;
+        size_t vertices;
+        std::vector<double> samples;
+        uint64_t allocations;
+        uint64_t allocatedBytes;
+    };
+
+    // Exposes Model's decode stages.
+    struct ModelStages : public KMDM::Model
+    {
+        using KMDM::Model::parseModel;
+        using KMDM::Model::decodeTexture;
+    };
+
+    /**
+     * @brief A grid of quads on a gentle wave, with positions, normals and texture coordinates
+     * indexed separately the way exporters write them.  Inner vertices are shared by six triangles.
+     *
+     */
+    std::vector<char> createObj(uint32_t grid)
+    {
+        std::string obj;
+        obj.reserve(static_cast<size_t>(grid + 1) * (grid + 1) * 96 + static_cast<size_t>(grid) * grid * 80);
+        char line[128];
+        for (uint32_t y = 0; y <= grid; y++)
+        {
+            for (uint32_t x = 0; x <= grid; x++)
+            {
+                float u = x / static_cast<float>(grid);
+                float v = y / static_cast<float>(grid);
+                float height = 0.05f * std::sin(u * 12.0f) * std::cos(v * 12.0f);
+                obj.append(line, std::snprintf(line, sizeof(line), "v %.6f %.6f %.6f\nvt %.6f %.6f\nvn 0 0 1\n",
+                    u - 0.5f, v - 0.5f, height, u, v));
+            }
+        }
+        for (uint32_t y = 0; y < grid; y++)
+        {
+            for (uint32_t x = 0; x < grid; x++)
+            {
+                uint32_t a = y * (grid + 1) + x + 1;
+                uint32_t b = a + 1;
+                uint32_t c = a + grid + 2;
+                uint32_t d = a + grid + 1;
+                obj.append(line, std::snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u\n",
+                    a, a, a, b, b, b, c, c, c));
+                obj.append(line, std::snprintf(line, sizeof(line), "f %u/%u/%u %u/%u/%u %u/%u/%u\n",
+                    c, c, c, d, d, d, a, a, a));
+            }
+        }
+        return std::vector<char>(obj.begin(), obj.end());
+    }
+
+    /**
+     * @brief A PNG of smooth gradients with some noise, so it compresses about as well as a
+     * photographed texture.
+     *
+     */
+    std::vector<char> createPng(uint32_t size)
+    {
+        std::vector<unsigned char> pixels(static_cast<size_t>(size) * size * 4);
+        uint32_t random = 1234;
+        for (uint32_t y = 0; y < size; y++)
+        {
+            for (uint32_t x = 0; x < size; x++)
+            {
+                random = random * 1664525u + 1013904223u;
+                unsigned char noise = static_cast<unsigned char>(random >> 28);
+                unsigned char* pixel = &pixels[(static_cast<size_t>(y) * size + x) * 4];
+                pixel[0] = static_cast<unsigned char>(x * 255 / size) ^ noise;
+                pixel[1] = static_cast<unsigned char>(y * 255 / size) ^ noise;
+                pixel[2] = static_cast<unsigned char>((x + y) * 127 / size) ^ noise;
+                pixel[3] = 255;
+            }
+        }
+        std::vector<char> png;
+        stbi_write_png_to_func([](void* context, void* data, int size)
+        {
+            std::vector<char>* out = static_cast<std::vector<char>*>(context);
+            out->insert(out->end(), static_cast<char*>(data), static_cast<char*>(data) + size);
+        }, &png, static_cast<int>(size), static_cast<int>(size), 4, pixels.data(), static_cast<int>(size * 4));
+        return png;
+    }
+
+    /**
+     * @brief Run a stage for some repetitions.  Setup runs before each one and is not timed.
+     *
+     */
+    StageResult runStage(const std::string& stage, const BenchAsset& asset, size_t bytes, size_t vertices,
+        const std::function<void()>& setup, const std::function<void()>& run)
+    {
+        StageResult result = { stage, asset.name, bytes, vertices, {}, 0, 0 };
+        for (int i = 0; i < asset.repetitions; i++)
+        {
+            if (setup)
+            {
+                setup();
+            }
+            uint64_t allocations = g_allocations.load();
+            uint64_t allocated_bytes = g_allocatedBytes.load();
+            auto start = std::chrono::high_resolution_clock::now();
+            run();
+            auto end = std::chrono::high_resolution_clock::now();
+            result.samples.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+            result.allocations += g_allocations.load() - allocations;
+            result.allocatedBytes += g_allocatedBytes.load() - allocated_bytes;
+        }
+        result.allocations /= asset.repetitions;
+        result.allocatedBytes /= asset.repetitions;
+
+        double median = KMDM::bench::median(result.samples);
+        std::printf("  %-18s %-12s %10.3f ms  %9.1f MB/s  %8llu allocs\n", stage.c_str(), asset.name.c_str(), median,
+            bytes / (median * 1000.0), static_cast<unsigned long long>(result.allocations));
+        return result;
+    }
+
+    void benchAsset(const BenchAsset& asset, bool upload, std::vector<StageResult>& results)
+    {
+        const unsigned char* texture_bytes = reinterpret_cast<const unsigned char*>(asset.texture.data());
+        std::string obj(asset.obj.begin(), asset.obj.end());
+
+        // Sizes of the decoded data, for the throughput of the later stages.
+        KMDM::ModelData data = KMDM::Model::decodeModelData(asset.obj, asset.texture);
+        size_t vertices = data.vertices.size();
+        size_t texture_size = data.texture.mips.empty() ? 0 : data.texture.mips[0].size;
+
+        results.push_back(runStage("obj_parse", asset, obj.size(), vertices, nullptr, [&obj]()
+        {
+            tinyobj::attrib_t attrib;
+            std::vector<tinyobj::shape_t> shapes;
+            std::vector<tinyobj::material_t> materials;
+            std::string warn, err;
+            std::istringstream stream(obj);
+            if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, &stream))
+            {
+                throw std::runtime_error(warn + err);
+            }
+        }));
+
+        results.push_back(runStage("obj_parse_dedupe", asset, obj.size(), vertices, nullptr, [&obj]()
+        {
+            KMDM::ModelData parsed;
+            std::istringstream stream(obj);
+            ModelStages::parseModel(stream, parsed);
+        }));
+
+        results.push_back(runStage("texture_decode", asset, asset.texture.size(), 0, nullptr,
+            [&asset, texture_bytes]()
+        {
+            if (KMDM::isKtx2(texture_bytes, asset.texture.size()))
+            {
+                KMDM::readKtx2(texture_bytes, asset.texture.size());
+                return;
+            }
+            int width, height, channels;
+            stbi_uc* pixels = stbi_load_from_memory(texture_bytes, static_cast<int>(asset.texture.size()), &width,
+                &height, &channels, STBI_rgb_alpha);
+            if (!pixels)
+            {
+                throw std::runtime_error("Failed to decode the texture of " + asset.name + ".");
+            }
+            stbi_image_free(pixels);
+        }));
+
+        // Cooked KTX2 textures already have their mips.
+        if (!KMDM::isKtx2(texture_bytes, asset.texture.size()))
+        {
+            KMDM::TextureData level;
+            level.format = data.texture.format;
+            level.width = data.texture.width;
+            level.height = data.texture.height;
+            level.data.assign(data.texture.data.begin(), data.texture.data.begin() + texture_size);
+            level.mips = { { 0, texture_size, level.width, level.height } };
+
+            KMDM::TextureData texture;
+            results.push_back(runStage("mip_generation", asset, texture_size, 0, [&texture, &level]()
+            {
+                texture = level;
+            }, [&texture]()
+            {
+                KMDM::generateMipChain(texture);
+            }));
+        }
+
+        results.push_back(runStage("decode_model", asset, asset.obj.size() + asset.texture.size(), vertices, nullptr,
+            [&asset]()
+        {
+            KMDM::Model::decodeModelData(asset.obj, asset.texture);
+        }));
+
+        if (upload)
+        {
+            size_t upload_bytes = data.vertices.size() * sizeof(KMDM::Vertex) +
+                data.indices.size() * sizeof(uint32_t) + data.texture.data.size();
+            results.push_back(runStage("upload", asset, upload_bytes, vertices, nullptr, [&data]()
+            {
+                KMDM::Model model(data);
+                KMDM::UploadManager::getInstance()->wait(model.getUploadTicket());
+                model.destroyModel();
+            }));
+        }
+    }
+
+    void writeJson(const std::string& path, const std::vector<StageResult>& results)
+    {
+        std::ofstream file(path);
+        if (!file)
+        {
+            throw std::runtime_error("Failed to open " + path + " for the benchmark results.");
+        }
+        file << std::fixed << std::setprecision(3);
+        file << "{\n  \"results\": [";
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            const StageResult& result = results[i];
+            std::vector<double> sorted = KMDM::bench::sorted(result.samples);
+            double mean = KMDM::bench::mean(sorted);
+            double stddev = KMDM::bench::standardDeviation(sorted);
+            double median = KMDM::bench::median(sorted);
+
+            file << (i ? ",\n" : "\n") << "    {\"stage\": \"" << result.stage
+                 << "\", \"asset\": \"" << result.asset
+                 << "\", \"repetitions\": " << sorted.size()
+                 << ", \"bytes\": " << result.bytes
+                 << ", \"vertices\": " << result.vertices
+                 << ", \"minMs\": " << sorted.front()
+                 << ", \"medianMs\": " << median
+                 << ", \"meanMs\": " << mean
+                 << ", \"maxMs\": " << sorted.back()
+                 << ", \"stddevMs\": " << stddev
+                 << ", \"cv\": " << (mean > 0.0 ? stddev / mean : 0.0)
+                 << ", \"mbPerSecond\": " << result.bytes / (median * 1000.0)
+                 << ", \"verticesPerSecond\": " << result.vertices / (median / 1000.0)
+                 << ", \"allocations\": " << result.allocations
+                 << ", \"allocatedBytes\": " << result.allocatedBytes << "}";
+        }
+        file << "\n  ]\n}" << std::endl;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int repetitions = argc > 1 ? std::max(1, std::atoi(argv[1])) : 10;
+    std::string output = argc > 2 ? argv[2] : BENCH_OUTPUT;
+
+    try
+    {
+        std::vector<BenchAsset> assets;
+        for (const auto & size : SYNTHETIC_SIZES)
+        {
+            int asset_repetitions = size.grid >= 1024 ? std::min(repetitions, HUGE_REPETITIONS) : repetitions;
+            assets.push_back({ size.name, createObj(size.grid), createPng(size.textureSize), asset_repetitions });
+        }
+        for (int i = 3; i + 1 < argc; i += 2)
+        {
+            std::string model_path = argv[i];
+            assets.push_back({ model_path.substr(model_path.find_last_of("/\\") + 1), KMDM::readFile(model_path),
+                KMDM::readFile(argv[i + 1]), repetitions });
+        }
+
+        // Uploads, and decoding KTX2, need a device.  Any will do, so draw headless.
+        bool upload = true;
+        KMDM::Renderer* renderer = nullptr;
+        try
+        {
+            KMDM::Window::setHeadless(true);
+            renderer = KMDM::Renderer::getInstance();
+        }
+        catch (const std::exception& e)
+        {
+            std::cerr << "No device, uploads are not timed: " << e.what() << std::endl;
+            upload = false;
+        }
+
+        std::vector<StageResult> results;
+        for (const auto & asset : assets)
+        {
+            std::printf("%s: %zu byte obj, %zu byte texture, %d repetitions\n", asset.name.c_str(), asset.obj.size(),
+                asset.texture.size(), asset.repetitions);
+            benchAsset(asset, upload, results);
+        }
+        writeJson(output, results);
+
+        if (renderer)
+        {
+            vkDeviceWaitIdle(KMDM::LogicalDevice::getInstance()->getLogicalDevice());
+            renderer->destroyRenderer();
+        }
+        std::cout << "Written to " << output << "." << std::endl;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,104 @@
+#include "../include/Window.h"
+#include "../include/Instance.h"
+#include "../include/Surface.h"
+#include "../include/PhysicalDevice.h"
+#include "../include/LogicalDevice.h"
+#include "../include/SwapChain.h"
+#include "../include/Renderpass.h"
+#include "../include/DescriptorSet.h"
+#include "../include/Pipeline.h"
+#include "../include/PipelineCache.h"
+#include "../include/PipelineManager.h"
+#include "../include/SamplerCache.h"
+#include "BenchStats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+/******************************************************************
+    PipelineCacheBench: time pipeline creation at startup with an
+    empty pipeline cache (cold) and with one loaded from disk (warm).
+    Each sample covers loading the cache and creating the pipeline.
+
+    PipelineCacheBench [runs]
+*******************************************************************/
+
+namespace
+{
+    const char* BENCH_CACHE_PATH = "pipeline_cache_bench.bin";
+
+    double timeStartup(KMDM::Renderpass* renderpass, KMDM::DescriptorSet* descriptor_set)
+    {
+        auto start = std::chrono::steady_clock::now();
+        KMDM::PipelineCache::getInstance();
+        KMDM::Pipeline* pipeline = new KMDM::Pipeline(renderpass, descriptor_set);
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+        // The manager would hand the same pipeline back, so it goes with the cache.
+        delete(pipeline);
+        KMDM::PipelineManager::getInstance()->destroyPipelineManager();
+        KMDM::PipelineCache::getInstance()->destroyPipelineCache();
+        return elapsed.count();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int runs = argc > 1 ? std::max(1, std::atoi(argv[1])) : 5;
+
+    // Driver shader caches would turn the cold runs warm.
+    setenv("MESA_SHADER_CACHE_DISABLE", "true", 0);
+    setenv("__GL_SHADER_DISK_CACHE", "0", 0);
+
+    try
+    {
+        KMDM::Window* window = KMDM::Window::getInstance();
+        KMDM::Instance* instance = KMDM::Instance::getInstance();
+        KMDM::Surface* surface = KMDM::Surface::getInstance();
+        KMDM::PhysicalDevice::getInstance();
+        KMDM::LogicalDevice* device = KMDM::LogicalDevice::getInstance();
+        KMDM::SwapChain* swap_chain = KMDM::SwapChain::getInstance();
+
+        KMDM::Renderpass* renderpass = new KMDM::Renderpass();
+        KMDM::DescriptorSet* descriptor_set = new KMDM::DescriptorSet(renderpass);
+        KMDM::PipelineCache::setCachePath(BENCH_CACHE_PATH);
+
+        std::vector<double> cold, warm;
+        for (int i = 0; i < runs; i++)
+        {
+            std::remove(BENCH_CACHE_PATH);
+            cold.push_back(timeStartup(renderpass, descriptor_set));
+        }
+        for (int i = 0; i < runs; i++)
+        {
+            warm.push_back(timeStartup(renderpass, descriptor_set));
+        }
+        std::remove(BENCH_CACHE_PATH);
+
+        delete(descriptor_set);
+        delete(renderpass);
+        KMDM::SamplerCache::getInstance()->destroySamplerCache();
+        swap_chain->destroySwapChain();
+        device->destroyLogicalDevice();
+        surface->destroySurface();
+        instance->destoryInstance();
+        window->destoryWindow();
+
+        std::cout << "Pipeline startup over " << runs << " runs:" << std::endl;
+        std::cout << "  cold: median " << KMDM::bench::median(cold) << " ms, min "
+                  << *std::min_element(cold.begin(), cold.end()) << " ms" << std::endl;
+        std::cout << "  warm: median " << KMDM::bench::median(warm) << " ms, min "
+                  << *std::min_element(warm.begin(), warm.end()) << " ms" << std::endl;
+        std::cout << "  speedup: " << KMDM::bench::median(cold) / KMDM::bench::median(warm) << "x" << std::endl;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,157 @@
+#include "../include/Renderer.h"
+#include "../include/Scene.h"
+#include "../include/Model.h"
+#include "../include/UploadManager.h"
+#include "BenchStats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+/******************************************************************
+    VisibilityBufferBench: time whole frames of a high overdraw
+    scene with forward shading, forward shading after a depth
+    pre-pass, and the visibility buffer.
+
+    The scene is a stack of layers of small triangles, drawn from
+    the bottom layer up so that from the default camera every layer
+    lands in front of the last and forward shading shades each
+    pixel once per layer.
+
+    VisibilityBufferBench [layers] [frames]
+*******************************************************************/
+
+namespace
+{
+    const uint32_t BENCH_GRID = 64;         // Quads along each side of a layer.
+    const uint32_t BENCH_LIGHTS = 256;
+    const uint32_t BENCH_WARMUP_FRAMES = 5;
+
+    struct BenchMode
+    {
+        const char* name;
+        KMDM::RenderPath path;
+        bool depthPrepass;
+    };
+
+    /**
+     * @brief Layers of BENCH_GRID x BENCH_GRID quads filling the unit square around the origin,
+     * stacked along z.  Indices go from the lowest layer to the highest.
+     *
+     */
+    KMDM::ModelData createOverdrawData(uint32_t layers)
+    {
+        KMDM::ModelData data = KMDM::Model::createPlaceholderData();
+        data.vertices.clear();
+        data.indices.clear();
+
+        for (uint32_t layer = 0; layer < layers; layer++)
+        {
+            float z = layers > 1 ? -0.5f + layer / static_cast<float>(layers - 1) : 0.0f;
+            uint32_t base = static_cast<uint32_t>(data.vertices.size());
+            for (uint32_t y = 0; y <= BENCH_GRID; y++)
+            {
+                for (uint32_t x = 0; x <= BENCH_GRID; x++)
+                {
+                    KMDM::Vertex vertex = {};
+                    vertex.texCoord = glm::vec2(x, y) / static_cast<float>(BENCH_GRID);
+                    vertex.position = glm::vec3(vertex.texCoord - 0.5f, z);
+                    vertex.normal = glm::vec3(0.0f, 0.0f, 1.0f);
+                    vertex.color = glm::vec3(1.0f);
+                    data.vertices.push_back(vertex);
+                }
+            }
+            for (uint32_t y = 0; y < BENCH_GRID; y++)
+            {
+                for (uint32_t x = 0; x < BENCH_GRID; x++)
+                {
+                    uint32_t corner = base + y * (BENCH_GRID + 1) + x;
+                    uint32_t quad[] = { corner, corner + 1, corner + BENCH_GRID + 2,
+                        corner + BENCH_GRID + 2, corner + BENCH_GRID + 1, corner };
+                    data.indices.insert(data.indices.end(), quad, quad + 6);
+                }
+            }
+        }
+        return data;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t layers = argc > 1 ? static_cast<uint32_t>(std::max(1, std::atoi(argv[1]))) : 32;
+    int frames = argc > 2 ? std::max(1, std::atoi(argv[2])) : 100;
+
+    try
+    {
+        KMDM::Renderer* renderer = KMDM::Renderer::getInstance();
+        KMDM::Scene* scene = KMDM::Scene::getInstance();
+
+        KMDM::Model model(createOverdrawData(layers));
+        KMDM::UploadManager::getInstance()->wait(model.getUploadTicket());
+        scene->addMesh(model);
+
+        std::mt19937 random(1234);
+        std::uniform_real_distribution<float> side(-0.5f, 0.5f);
+        for (uint32_t i = 0; i < BENCH_LIGHTS; i++)
+        {
+            KMDM::Light light;
+            light.position = glm::vec3(side(random), side(random), side(random) + 0.6f);
+            light.range = 0.5f;
+            light.intensity = 0.2f;
+            scene->addLight(light);
+        }
+        scene->setAmbientLight(glm::vec3(0.1f));
+
+        const BenchMode modes[] =
+        {
+            { "forward", KMDM::RenderPath::Forward, false },
+            { "forward + depth pre-pass", KMDM::RenderPath::Forward, true },
+            { "visibility buffer", KMDM::RenderPath::VisibilityBuffer, false }
+        };
+
+        std::vector<double> results;
+        for (const auto & mode : modes)
+        {
+            renderer->setRenderPath(mode.path);
+            renderer->setDepthPrepass(mode.depthPrepass);
+
+            // Pipelines and the visibility geometry are built in the first frames.
+            for (uint32_t i = 0; i < BENCH_WARMUP_FRAMES; i++)
+            {
+                renderer->renderFrame();
+            }
+
+            std::vector<double> samples;
+            for (int frame = 0; frame < frames; frame++)
+            {
+                auto start = std::chrono::high_resolution_clock::now();
+                renderer->renderFrame();
+                auto end = std::chrono::high_resolution_clock::now();
+                samples.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+            }
+            results.push_back(KMDM::bench::median(samples));
+        }
+
+        vkDeviceWaitIdle(KMDM::LogicalDevice::getInstance()->getLogicalDevice());
+        scene->destoryScene();
+        renderer->destroyRenderer();
+
+        std::printf("%u layers of %u triangles, median frame of %d:\n", layers, 2 * BENCH_GRID * BENCH_GRID,
+            frames);
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            std::printf("  %-26s %.3f ms (%.2fx forward)\n", modes[i].name, results[i], results[0] / results[i]);
+        }
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
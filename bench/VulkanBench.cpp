@@ -0,0 +1,412 @@
+#include "../include/Window.h"
+#include "../include/Instance.h"
+#include "../include/PhysicalDevice.h"
+#include "../include/LogicalDevice.h"
+#include "../include/CommandPool.h"
+#include "../include/MemoryTelemetry.h"
+#include "../include/Util.h"
+#include "BenchStats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/******************************************************************
+    VulkanBench: the cost of the API patterns the engine uses every
+    frame, each isolated on a headless device, in ns per operation
+    at a range of batch sizes.
+
+        descriptor_allocate   Allocate and write a set per operation,
+                              reset the pool after each batch, as
+                              DescriptorSet does every frame.
+        descriptor_batched    Allocate a batch of sets in one call,
+                              then write each.
+        descriptor_reuse      Only write sets allocated up front.
+        map_unmap             Map, copy a uniform block and unmap.
+        persistent_map        Copy into memory mapped once.
+        single_time_submit    A fill in its own command buffer through
+                              CommandPool::endSingleTimeCommands, a
+                              submit and vkQueueWaitIdle each.
+        batched_submit        The batch's fills in one command buffer,
+                              one submit and wait.
+        pipeline_bind_same    Record binds of one compute pipeline.
+        pipeline_bind_switch  Record binds alternating between two.
+
+    Every batch size runs until about BENCH_TARGET_OPS operations
+    are timed, and reports the median and fastest batch.
+
+    VulkanBench [output]
+*******************************************************************/
+
+namespace
+{
+    const char* BENCH_OUTPUT = "vulkan_bench.json";
+    const uint32_t BENCH_BATCH_SIZES[] = { 1, 16, 256, 4096 };
+    const uint32_t BENCH_TARGET_OPS = 65536;
+    const uint32_t BENCH_MIN_BATCHES = 8;
+
+    // Submits take microseconds to milliseconds each, so they are timed less.
+    const uint32_t BENCH_SUBMIT_TARGET_OPS = 2048;
+    const uint32_t BENCH_MAX_SUBMIT_BATCH = 256;
+
+    const VkDeviceSize BENCH_UNIFORM_SIZE = 256;
+
+    // A compute shader with an empty main and no resources: local_size 1, 1, 1.
+    const uint32_t EMPTY_COMPUTE_SPIRV[] =
+    {
+        0x07230203, 0x00010000, 0x00000000, 0x00000005, 0x00000000,
+        0x00020011, 0x00000001,                                     // OpCapability Shader
+        0x0003000E, 0x00000000, 0x00000001,                         // OpMemoryModel Logical GLSL450
+        0x0005000F, 0x00000005, 0x00000001, 0x6E69616D, 0x00000000, // OpEntryPoint GLCompute %1 "main"
+        0x00060010, 0x00000001, 0x00000011, 0x00000001, 0x00000001, 0x00000001, // OpExecutionMode %1 LocalSize 1 1 1
+        0x00020013, 0x00000002,                                     // %2 = OpTypeVoid
+        0x00030021, 0x00000003, 0x00000002,                         // %3 = OpTypeFunction %2
+        0x00050036, 0x00000002, 0x00000001, 0x00000000, 0x00000003, // %1 = OpFunction %2 None %3
+        0x000200F8, 0x00000004,                                     // %4 = OpLabel
+        0x000100FD,                                                 // OpReturn
+        0x00010038                                                  // OpFunctionEnd
+    };
+
+    struct BenchResult
+    {
+        std::string pattern;
+        uint32_t batch;
+        uint32_t batches;
+        double medianNs;
+        double minNs;
+    };
+
+    /**
+     * @brief Time batches of an operation.  Setup runs before each batch and is not timed.
+     *
+     */
+    BenchResult runPattern(const std::string& pattern, uint32_t batch, uint32_t target_ops,
+        const std::function<void()>& setup, const std::function<void(uint32_t)>& run)
+    {
+        uint32_t batches = std::max(BENCH_MIN_BATCHES, target_ops / batch);
+        std::vector<double> samples;
+        samples.reserve(batches);
+        for (uint32_t i = 0; i < batches; i++)
+        {
+            if (setup)
+            {
+                setup();
+            }
+            auto start = std::chrono::high_resolution_clock::now();
+            run(batch);
+            auto end = std::chrono::high_resolution_clock::now();
+            samples.push_back(std::chrono::duration<double, std::nano>(end - start).count() / batch);
+        }
+        std::vector<double> sorted = KMDM::bench::sorted(samples);
+
+        BenchResult result = { pattern, batch, batches, KMDM::bench::median(sorted), sorted.front() };
+        std::printf("  %-22s batch %5u  %12.1f ns/op  (min %.1f)\n", pattern.c_str(), batch, result.medianNs,
+            result.minNs);
+        return result;
+    }
+
+    void writeJson(const std::string& path, const std::string& device, const std::vector<BenchResult>& results)
+    {
+        std::ofstream file(path);
+        if (!file)
+        {
+            throw std::runtime_error("Failed to open " + path + " for the benchmark results.");
+        }
+        file << std::fixed << std::setprecision(1);
+        file << "{\n  \"device\": \"" << device << "\",\n  \"results\": [";
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            file << (i ? ",\n" : "\n") << "    {\"pattern\": \"" << results[i].pattern
+                 << "\", \"batch\": " << results[i].batch
+                 << ", \"batches\": " << results[i].batches
+                 << ", \"medianNs\": " << results[i].medianNs
+                 << ", \"minNs\": " << results[i].minNs << "}";
+        }
+        file << "\n  ]\n}" << std::endl;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::string output = argc > 1 ? argv[1] : BENCH_OUTPUT;
+
+    try
+    {
+        // Only the device is needed, so there is no window and any device will do.
+        KMDM::Window::setHeadless(true);
+        KMDM::LogicalDevice* logical_device = KMDM::LogicalDevice::getInstance();
+        KMDM::CommandPool* command_pool = KMDM::CommandPool::getInstance();
+        VkDevice device = logical_device->getLogicalDevice();
+        std::string device_name = KMDM::PhysicalDevice::getInstance()->getPhysicalDeviceProperties().deviceName;
+        uint32_t max_batch = BENCH_BATCH_SIZES[sizeof(BENCH_BATCH_SIZES) / sizeof(BENCH_BATCH_SIZES[0]) - 1];
+        std::cout << "Vulkan hot paths on " << device_name << ":" << std::endl;
+
+        // A uniform buffer the descriptor writes point at, a host visible one for each map pattern,
+        // and one the submits fill.
+        VkBuffer uniform_buffer, map_buffer, host_buffer, fill_buffer;
+        VkDeviceMemory uniform_memory, map_memory, host_memory, fill_memory;
+        KMDM::createBuffer(BENCH_UNIFORM_SIZE, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            uniform_buffer, uniform_memory, KMDM::MemoryCategory::Uniform);
+        KMDM::createBuffer(BENCH_UNIFORM_SIZE, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, map_buffer, map_memory, KMDM::MemoryCategory::Uniform);
+        KMDM::createBuffer(BENCH_UNIFORM_SIZE, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, host_buffer, host_memory, KMDM::MemoryCategory::Uniform);
+        KMDM::createBuffer(BENCH_UNIFORM_SIZE, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            fill_buffer, fill_memory);
+
+        // One uniform buffer binding, like the per-model sets.
+        VkDescriptorSetLayoutBinding binding = {};
+        binding.binding = 0;
+        binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        binding.descriptorCount = 1;
+        binding.stageFlags = VK_SHADER_STAGE_ALL;
+        VkDescriptorSetLayoutCreateInfo layout_info = {};
+        layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layout_info.bindingCount = 1;
+        layout_info.pBindings = &binding;
+        VkDescriptorSetLayout set_layout;
+        if (vkCreateDescriptorSetLayout(device, &layout_info, nullptr, &set_layout) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create the descriptor set layout.");
+        }
+
+        VkDescriptorPoolSize pool_size = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, max_batch };
+        VkDescriptorPoolCreateInfo pool_info = {};
+        pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        pool_info.maxSets = max_batch;
+        pool_info.poolSizeCount = 1;
+        pool_info.pPoolSizes = &pool_size;
+        VkDescriptorPool descriptor_pool, reuse_pool;
+        if (vkCreateDescriptorPool(device, &pool_info, nullptr, &descriptor_pool) != VK_SUCCESS ||
+            vkCreateDescriptorPool(device, &pool_info, nullptr, &reuse_pool) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create the descriptor pools.");
+        }
+
+        std::vector<VkDescriptorSetLayout> layouts(max_batch, set_layout);
+        VkDescriptorSetAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        alloc_info.descriptorPool = reuse_pool;
+        alloc_info.descriptorSetCount = max_batch;
+        alloc_info.pSetLayouts = layouts.data();
+        std::vector<VkDescriptorSet> reused_sets(max_batch);
+        std::vector<VkDescriptorSet> batch_sets(max_batch);
+        if (vkAllocateDescriptorSets(device, &alloc_info, reused_sets.data()) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to allocate the reused descriptor sets.");
+        }
+
+        VkDescriptorBufferInfo buffer_info = { uniform_buffer, 0, BENCH_UNIFORM_SIZE };
+        VkWriteDescriptorSet write = {};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstBinding = 0;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        write.descriptorCount = 1;
+        write.pBufferInfo = &buffer_info;
+
+        // Two pipelines of the empty shader, to switch between.
+        VkShaderModuleCreateInfo module_info = {};
+        module_info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        module_info.codeSize = sizeof(EMPTY_COMPUTE_SPIRV);
+        module_info.pCode = EMPTY_COMPUTE_SPIRV;
+        VkShaderModule module;
+        if (vkCreateShaderModule(device, &module_info, nullptr, &module) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create the shader module.");
+        }
+        VkPipelineLayoutCreateInfo pipeline_layout_info = {};
+        pipeline_layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        VkPipelineLayout pipeline_layout;
+        if (vkCreatePipelineLayout(device, &pipeline_layout_info, nullptr, &pipeline_layout) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create the pipeline layout.");
+        }
+        VkComputePipelineCreateInfo pipeline_info = {};
+        pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipeline_info.stage.module = module;
+        pipeline_info.stage.pName = "main";
+        pipeline_info.layout = pipeline_layout;
+        VkPipeline pipelines[2];
+        for (auto & pipeline : pipelines)
+        {
+            if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &pipeline) != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to create the compute pipelines.");
+            }
+        }
+
+        VkCommandBufferAllocateInfo command_info = {};
+        command_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        command_info.commandPool = command_pool->getCommandPool();
+        command_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        command_info.commandBufferCount = 1;
+        VkCommandBuffer record_buffer;
+        if (vkAllocateCommandBuffers(device, &command_info, &record_buffer) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to allocate the command buffer.");
+        }
+        VkCommandBufferBeginInfo begin_info = {};
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+        unsigned char block[BENCH_UNIFORM_SIZE];
+        std::memset(block, 1, sizeof(block));
+        void* persistent = nullptr;
+        vkMapMemory(device, host_memory, 0, BENCH_UNIFORM_SIZE, 0, &persistent);
+
+        std::vector<BenchResult> results;
+        for (uint32_t batch : BENCH_BATCH_SIZES)
+        {
+            results.push_back(runPattern("descriptor_allocate", batch, BENCH_TARGET_OPS, [&]()
+            {
+                vkResetDescriptorPool(device, descriptor_pool, 0);
+            }, [&](uint32_t count)
+            {
+                VkDescriptorSetAllocateInfo info = alloc_info;
+                info.descriptorPool = descriptor_pool;
+                info.descriptorSetCount = 1;
+                for (uint32_t i = 0; i < count; i++)
+                {
+                    VkDescriptorSet set;
+                    vkAllocateDescriptorSets(device, &info, &set);
+                    write.dstSet = set;
+                    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+                }
+            }));
+
+            results.push_back(runPattern("descriptor_batched", batch, BENCH_TARGET_OPS, [&]()
+            {
+                vkResetDescriptorPool(device, descriptor_pool, 0);
+            }, [&](uint32_t count)
+            {
+                VkDescriptorSetAllocateInfo info = alloc_info;
+                info.descriptorPool = descriptor_pool;
+                info.descriptorSetCount = count;
+                vkAllocateDescriptorSets(device, &info, batch_sets.data());
+                for (uint32_t i = 0; i < count; i++)
+                {
+                    write.dstSet = batch_sets[i];
+                    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+                }
+            }));
+
+            results.push_back(runPattern("descriptor_reuse", batch, BENCH_TARGET_OPS, nullptr, [&](uint32_t count)
+            {
+                for (uint32_t i = 0; i < count; i++)
+                {
+                    write.dstSet = reused_sets[i];
+                    vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+                }
+            }));
+
+            results.push_back(runPattern("map_unmap", batch, BENCH_TARGET_OPS, nullptr, [&](uint32_t count)
+            {
+                for (uint32_t i = 0; i < count; i++)
+                {
+                    void* data;
+                    vkMapMemory(device, map_memory, 0, BENCH_UNIFORM_SIZE, 0, &data);
+                    std::memcpy(data, block, sizeof(block));
+                    vkUnmapMemory(device, map_memory);
+                }
+            }));
+
+            results.push_back(runPattern("persistent_map", batch, BENCH_TARGET_OPS, nullptr, [&](uint32_t count)
+            {
+                for (uint32_t i = 0; i < count; i++)
+                {
+                    std::memcpy(persistent, block, sizeof(block));
+                }
+            }));
+
+            if (batch <= BENCH_MAX_SUBMIT_BATCH)
+            {
+                results.push_back(runPattern("single_time_submit", batch, BENCH_SUBMIT_TARGET_OPS, nullptr,
+                    [&](uint32_t count)
+                {
+                    for (uint32_t i = 0; i < count; i++)
+                    {
+                        VkCommandBuffer command_buffer = command_pool->beginSingleTimeCommands();
+                        vkCmdFillBuffer(command_buffer, fill_buffer, 0, 4, i);
+                        command_pool->endSingleTimeCommands(command_buffer);
+                    }
+                }));
+
+                results.push_back(runPattern("batched_submit", batch, BENCH_SUBMIT_TARGET_OPS, nullptr,
+                    [&](uint32_t count)
+                {
+                    VkCommandBuffer command_buffer = command_pool->beginSingleTimeCommands();
+                    for (uint32_t i = 0; i < count; i++)
+                    {
+                        vkCmdFillBuffer(command_buffer, fill_buffer, 0, 4, i);
+                    }
+                    command_pool->endSingleTimeCommands(command_buffer);
+                }));
+            }
+
+            // Recording only, the command buffers are never submitted.
+            results.push_back(runPattern("pipeline_bind_same", batch, BENCH_TARGET_OPS, nullptr, [&](uint32_t count)
+            {
+                vkBeginCommandBuffer(record_buffer, &begin_info);
+                for (uint32_t i = 0; i < count; i++)
+                {
+                    vkCmdBindPipeline(record_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines[0]);
+                }
+                vkEndCommandBuffer(record_buffer);
+            }));
+
+            results.push_back(runPattern("pipeline_bind_switch", batch, BENCH_TARGET_OPS, nullptr, [&](uint32_t count)
+            {
+                vkBeginCommandBuffer(record_buffer, &begin_info);
+                for (uint32_t i = 0; i < count; i++)
+                {
+                    vkCmdBindPipeline(record_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelines[i & 1]);
+                }
+                vkEndCommandBuffer(record_buffer);
+            }));
+        }
+        writeJson(output, device_name, results);
+
+        vkDeviceWaitIdle(device);
+        vkUnmapMemory(device, host_memory);
+        vkFreeCommandBuffers(device, command_pool->getCommandPool(), 1, &record_buffer);
+        for (auto & pipeline : pipelines)
+        {
+            vkDestroyPipeline(device, pipeline, nullptr);
+        }
+        vkDestroyPipelineLayout(device, pipeline_layout, nullptr);
+        vkDestroyShaderModule(device, module, nullptr);
+        vkDestroyDescriptorPool(device, descriptor_pool, nullptr);
+        vkDestroyDescriptorPool(device, reuse_pool, nullptr);
+        vkDestroyDescriptorSetLayout(device, set_layout, nullptr);
+        vkDestroyBuffer(device, uniform_buffer, nullptr);
+        vkDestroyBuffer(device, map_buffer, nullptr);
+        vkDestroyBuffer(device, host_buffer, nullptr);
+        vkDestroyBuffer(device, fill_buffer, nullptr);
+        KMDM::freeMemory(uniform_memory);
+        KMDM::freeMemory(map_memory);
+        KMDM::freeMemory(host_memory);
+        KMDM::freeMemory(fill_memory);
+
+        command_pool->destroyCommandPool();
+        KMDM::MemoryTelemetry::getInstance()->destroyMemoryTelemetry();
+        logical_device->destroyLogicalDevice();
+        KMDM::Instance::getInstance()->destoryInstance();
+        std::cout << "Written to " << output << "." << std::endl;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -6,7 +6,7 @@
 #define ALLOCATOR_H
 
 #include "types.h"
-// #define VMA_RECORDING_ENABLED 1
+#include "MemoryTelemetry.h"
 #include "vk_mem_alloc.h"
 
 namespace KMDM
@@ -23,10 +23,11 @@ namespace KMDM
              * @param size VkDeviceSize
              * @param buffer_usage VkBufferUsageFlags
              * @param vma_usage VmaMemoryUsage
+             * @param category MemoryCategory
              * @return AllocatedBuffer 
              */
             AllocatedBuffer getVMABuffer(VkDeviceSize size, VkBufferUsageFlags buffer_usage,
-                VmaMemoryUsage vma_usage);
+                VmaMemoryUsage vma_usage, MemoryCategory category = MemoryCategory::Other);
              
 
             /**
@@ -40,11 +41,12 @@ namespace KMDM
             * @param image_usage VkImageUsageFlags
             * @param memory_usage VmaMemoryUsage
             * @param memory_properties VkMemoryPropertyFlags
+            * @param category MemoryCategory
             * @return AllocatedImage 
             */
             AllocatedImage getVMAImage(uint32_t width, uint32_t height, uint32_t mip_level,
                 VkFormat format, VkImageTiling tiling, VkImageUsageFlags image_usage, VmaMemoryUsage memory_usage,
-                VkMemoryPropertyFlags memory_properties);
+                VkMemoryPropertyFlags memory_properties, MemoryCategory category = MemoryCategory::Other);
 
             /**
              * @brief Get the Allocator object.
@@ -61,13 +63,11 @@ namespace KMDM
             void cleanupAllcatedBuffer(AllocatedBuffer buffer);
 
             /**
-             * @brief 
+             * @brief Clean up an allocated image.
              * 
-             * @param src AllocatedBuffer
-             * @param dst AllocatedBuffer
-             * @param size size_t
+             * @param image AllocatedImage
              */
-            void copyVMABuffer(AllocatedBuffer src, AllocatedBuffer dst, size_t size);
+            void cleanupAllocatedImage(AllocatedImage image);
 
             /**
              * @brief Destory the Allocator.
@@ -84,6 +84,8 @@ namespace KMDM
             size_t padUniformBuffer(size_t initial_size);
 
         protected:
+            void trackAllocation(VmaAllocation allocation, MemoryCategory category);
+            void untrackAllocation(VmaAllocation allocation);
 
         private:
             Allocator();
@@ -0,0 +1,99 @@
+#ifndef ASSETSTREAMER_H
+#define ASSETSTREAMER_H
+
+#include "Model.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+namespace KMDM
+{
+    /**
+     * @brief A model that finished (or failed) loading on the worker threads.
+     * 
+     */
+    struct StreamedModel
+    {
+        uint32_t id;
+        ModelData data;
+        std::exception_ptr error;
+    };
+
+    /**
+     * @brief Loads models in the background.  One I/O thread reads the files from disk and hands
+     * the raw bytes to a pool of decode threads, which parse the geometry and decode the texture.
+     * Decoded models are collected on the render thread with takeCompleted(), where they can be
+     * uploaded at a frame boundary.
+     * 
+     */
+    class AssetStreamer
+    {
+        public:
+            /**
+             * @brief Construct a new Asset Streamer object
+             * 
+             * @param decode_threads Number of decode threads, 0 picks one per spare core.
+             */
+            AssetStreamer(uint32_t decode_threads = 0);
+            virtual ~AssetStreamer();
+
+            /**
+             * @brief Stop the worker threads.  Requests that have not been decoded are dropped.
+             * 
+             */
+            void destroyAssetStreamer();
+
+            /**
+             * @brief Queue a model for loading.
+             * 
+             * @param id Caller chosen id, returned with the result.
+             * @param model_path 
+             * @param texture_path 
+             */
+            void requestModel(uint32_t id, std::string model_path, std::string texture_path);
+
+            /**
+             * @brief Take every model that has finished decoding since the last call.
+             * 
+             * @return std::vector<StreamedModel> 
+             */
+            std::vector<StreamedModel> takeCompleted();
+
+        protected:
+            void ioWorker();
+            void decodeWorker();
+
+        private:
+            struct LoadRequest
+            {
+                uint32_t id;
+                std::string modelPath;
+                std::string texturePath;
+            };
+
+            struct DecodeRequest
+            {
+                uint32_t id;
+                std::vector<char> objBytes;
+                std::vector<char> textureBytes;
+            };
+
+            std::mutex m_mutex;
+            std::condition_variable m_ioCondition;
+            std::condition_variable m_decodeCondition;
+            bool m_stopping = false;
+
+            std::deque<LoadRequest> m_loadQueue;
+            std::deque<DecodeRequest> m_decodeQueue;
+            std::vector<StreamedModel> m_completed;
+
+            std::thread m_ioThread;
+            std::vector<std::thread> m_decodeThreads;
+    };
+}
+#endif // ASSETSTREAMER_H
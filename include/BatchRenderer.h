@@ -0,0 +1,104 @@
+#ifndef BATCHRENDERER_H
+#define BATCHRENDERER_H
+
+#include "Renderer.h"
+#include "ReadbackRing.h"
+#include "ImageWriter.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+namespace KMDM
+{
+    /**
+     * @brief One image to render: a scene file of models, the camera looking from eye at target with
+     * z up, and the PNG to write.
+     *
+     */
+    struct BatchJob
+    {
+        std::string scene;
+        glm::vec3 eye;
+        glm::vec3 target;
+        uint32_t width;
+        uint32_t height;
+        std::string output;
+    };
+
+    /**
+     * @brief Renders a list of jobs offscreen and writes them out as PNG files.  Jobs are sorted so
+     * each scene is loaded and each size is allocated once.  Frames are copied out through a
+     * readback ring and encoded on worker threads while the next jobs render, so copying and
+     * writing the images costs the render thread nothing.
+     *
+     * The GPU still renders one job at a time.  Renderer::renderFrame() records the command buffer of
+     * every image and resets the descriptor pools each frame, so it waits for the queue after each
+     * frame, and a job costs its recording plus its GPU time.  Keeping several frames in flight
+     * needs per frame descriptor pools and recording only the image being drawn, and until the
+     * renderer has those a batch is bound by that submit and wait.
+     *
+     * Several processes, on one device or several, can share one job list.  With claiming on, each
+     * job is claimed by creating its output path with a .claim suffix, which is removed once the
+     * image is written.  Jobs that another process claimed, or whose output exists, are skipped,
+     * unless the claim is older than BATCH_CLAIM_TIMEOUT and there is still no output.
+     *
+     */
+    class BatchRenderer
+    {
+        public:
+            /**
+             * @brief Construct a new Batch Renderer object.  Switches to headless mode, so it has to
+             * be created before the renderer.
+             *
+             * @param claim_jobs Claim jobs through claim files, to share the list with other processes.
+             */
+            BatchRenderer(bool claim_jobs = false);
+            virtual ~BatchRenderer();
+
+            /**
+             * @brief Finish writing the images and destroy the readback ring and writer.  The
+             * renderer and scene are left to their owners.
+             *
+             */
+            void destroyBatchRenderer();
+
+            /**
+             * @brief Read a job list, a JSON array of objects with "scene" and "output", and optionally
+             * "eye" and "target" as [x, y, z], and "width" and "height".
+             *
+             * @param path
+             * @return std::vector<BatchJob>
+             */
+            static std::vector<BatchJob> loadJobs(std::string path);
+
+            /**
+             * @brief Render the jobs and wait until their images are written.
+             *
+             * @param jobs
+             * @return uint64_t Images written.
+             */
+            uint64_t render(std::vector<BatchJob> jobs);
+
+        protected:
+            bool claimJob(const BatchJob& job);
+            void loadScene(const std::string& path);
+            void warmUp();
+            void writeCompleted();
+
+        private:
+            bool m_claimJobs;
+            Renderer* m_renderer;
+            ReadbackRing* m_readbackRing;
+            ImageWriter* m_imageWriter;
+
+            // The loaded scene, and the view the next frame is drawn with.
+            std::string m_scene;
+            glm::mat4 m_view;
+
+            // Output paths of the frames being read back, by capture tag.
+            std::unordered_map<uint64_t, std::string> m_outputs;
+            uint64_t m_nextTag = 0;
+    };
+}
+#endif // BATCHRENDERER_H
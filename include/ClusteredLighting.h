@@ -0,0 +1,126 @@
+#ifndef CLUSTEREDLIGHTING_H
+#define CLUSTEREDLIGHTING_H
+
+#include "Common.h"
+#include "types.h"
+#include "LogicalDevice.h"
+#include "DescriptorSet.h"
+#include "RenderGraph.h"
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <cstdint>
+
+namespace KMDM
+{
+    /**
+     * @brief Graph handles of the light lists written by the culling pass.  Passes that shade with
+     * the lighting set read both.
+     *
+     */
+    struct LightCullingResources
+    {
+        RenderResource lightGrid;
+        RenderResource lightIndices;
+    };
+
+    /**
+     * @brief Clustered forward lighting.  The view frustum is cut into a grid of clusters, screen
+     * tiles by exponential depth slices, and a compute pass lists the lights that touch each cluster
+     * every frame.  The forward pass then only loops over the lights of its fragment's cluster, so
+     * the cost of shading grows with the lights near a surface rather than all of them.
+     *
+     * The lights and cluster parameters are written per swap chain image, the light lists are
+     * shared and rebuilt at the start of every frame.
+     *
+     */
+    class ClusteredLighting
+    {
+        public:
+            ClusteredLighting(DescriptorSet* descriptor_set, uint32_t image_count);
+            virtual ~ClusteredLighting();
+            void destroyClusteredLighting();
+
+            /**
+             * @brief Upload the lights of a frame, in view space, and the cluster grid of its camera.
+             * Lights past MAX_LIGHTS are dropped.
+             *
+             * @param image Swap chain image the frame is drawn to.
+             * @param lights Lights in world space.
+             * @param ambient
+             * @param view
+             * @param projection
+             * @param extent Size of the viewport in pixels.
+             * @param near_plane
+             * @param far_plane
+             */
+            void update(uint32_t image, const std::vector<Light>& lights, glm::vec3 ambient,
+                const glm::mat4& view, const glm::mat4& projection, VkExtent2D extent,
+                float near_plane, float far_plane);
+
+            /**
+             * @brief Record the light culling dispatch.
+             *
+             * @param command_buffer
+             * @param image
+             */
+            void recordCulling(VkCommandBuffer command_buffer, uint32_t image);
+
+            /**
+             * @brief Add the light culling pass to a frame graph.
+             *
+             * @param graph
+             * @param image
+             * @return LightCullingResources
+             */
+            LightCullingResources addCullingPass(RenderGraph& graph, uint32_t image);
+
+            /**
+             * @brief Reallocate the per image buffers and sets after the swap chain came back with a
+             * different number of images.
+             *
+             * @param image_count
+             */
+            void setImageCount(uint32_t image_count);
+
+            VkDescriptorSet getDescriptorSet(uint32_t image);
+            VkBuffer getLightGridBuffer();
+            VkBuffer getLightIndexBuffer();
+            uint32_t getLightCount(uint32_t image);
+            static uint32_t getClusterCount();
+
+        protected:
+            void createBuffers();
+            void createImageBuffers();
+            void createDescriptorSets();
+            void createCullingPipeline();
+
+        private:
+            LogicalDevice* m_logicalDevice;
+            DescriptorSet* m_descriptorSet;
+            uint32_t m_imageCount;
+
+            // Per image, written by the host and left mapped.
+            std::vector<VkBuffer> m_clusterBuffers;
+            std::vector<VkDeviceMemory> m_clusterMemory;
+            std::vector<void*> m_clusterData;
+            std::vector<VkBuffer> m_lightBuffers;
+            std::vector<VkDeviceMemory> m_lightMemory;
+            std::vector<void*> m_lightData;
+            std::vector<uint32_t> m_lightCounts;
+
+            // Light count and light indices of each cluster, written by the culling pass.
+            VkBuffer m_lightGridBuffer;
+            VkDeviceMemory m_lightGridMemory;
+            VkBuffer m_lightIndexBuffer;
+            VkDeviceMemory m_lightIndexMemory;
+
+            VkDescriptorPool m_descriptorPool;
+            std::vector<VkDescriptorSet> m_descriptorSets;
+
+            VkPipelineLayout m_cullingLayout;
+            VkPipeline m_cullingPipeline;
+    };
+}
+#endif // CLUSTEREDLIGHTING_H
@@ -45,7 +45,96 @@ const size_t MAX_FRAMES_IN_FLIGHT = 2;
 
 const uint32_t MAX_DESCRIPTORS = 3072;
 
+// Size of the persistently mapped upload staging ring.
+const VkDeviceSize STAGING_RING_SIZE = 64 * 1024 * 1024;
+
+// Texture streaming: device memory texture images may use, the size at which mip levels
+// are always resident, and how many textures start streaming finer levels per frame.
+const VkDeviceSize TEXTURE_MEMORY_BUDGET = 512ull * 1024 * 1024;
+const uint32_t TEXTURE_TAIL_SIZE = 128;
+const uint32_t TEXTURE_STREAMS_PER_FRAME = 2;
+
+// Seconds between writes of the pipeline cache while running, when it has grown.
+const double PIPELINE_CACHE_SAVE_INTERVAL = 60.0;
+
+// Clustered lighting: the view frustum is cut into a CLUSTER_GRID_X * CLUSTER_GRID_Y tile grid with
+// CLUSTER_GRID_Z exponential depth slices, and each cluster lists up to MAX_LIGHTS_PER_CLUSTER lights.
+const uint32_t CLUSTER_GRID_X = 16;
+const uint32_t CLUSTER_GRID_Y = 9;
+const uint32_t CLUSTER_GRID_Z = 24;
+const uint32_t MAX_LIGHTS_PER_CLUSTER = 256;
+const uint32_t MAX_LIGHTS = 16384;
+
+// Visibility buffer: each pixel holds the draw in its top bits and the triangle of the draw in
+// the low VISIBILITY_TRIANGLE_BITS.  The all ones id marks empty pixels.  Shading indexes one
+// array of MAX_VISIBILITY_TEXTURES material textures.
+const VkFormat VISIBILITY_FORMAT = VK_FORMAT_R32_UINT;
+const uint32_t VISIBILITY_TRIANGLE_BITS = 22;
+const uint32_t MAX_VISIBILITY_DRAWS = (1u << (32 - VISIBILITY_TRIANGLE_BITS)) - 1;
+const uint32_t MAX_VISIBILITY_TEXTURES = 64;
+
+// Shade through the visibility buffer instead of forward shading.
+const bool VISIBILITY_BUFFER = false;
+
+// Render opaque geometry into depth first, so the main pass shades each pixel about once.
+const bool DEPTH_PREPASS = true;
+
+// Dynamic resolution: the scene is drawn at between MIN_RENDER_SCALE and 1 of the swap chain size,
+// scaled each frame to keep the GPU frame time under TARGET_FRAME_TIME_MS, and temporally upscaled.
+const bool DYNAMIC_RESOLUTION = false;
+const float TARGET_FRAME_TIME_MS = 16.6f;
+const float MIN_RENDER_SCALE = 0.5f;
+const uint32_t JITTER_PHASES = 8;
+const VkFormat SCENE_COLOR_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+const VkFormat MOTION_VECTOR_FORMAT = VK_FORMAT_R16G16_SFLOAT;
+
+// Render targets released on resize are kept for reuse until unused for RENDER_TARGET_IDLE_FRAMES,
+// and at most RENDER_TARGET_POOL_SIZE are kept.
+const uint64_t RENDER_TARGET_IDLE_FRAMES = 300;
+const size_t RENDER_TARGET_POOL_SIZE = 16;
+
+// Presentation: the preferred present mode, FIFO when the surface does not support it.  Frames are
+// paced to start as late as they can and still meet their deadline, which is the display refresh for
+// the FIFO modes or FRAME_RATE_LIMIT when it is above 0, with FRAME_PACING_MARGIN_MS to spare.
+const VkPresentModeKHR PRESENT_MODE = VK_PRESENT_MODE_MAILBOX_KHR;
+const float FRAME_RATE_LIMIT = 0.0f;
+const float FRAME_PACING_MARGIN_MS = 1.0f;
+
+// GPU profiler: time named scopes with timestamps, up to GPU_PROFILER_MAX_SCOPES per command buffer,
+// keeping the last GPU_PROFILER_WINDOW samples of each scope.  The statistics are written to
+// GPU_TIMES_PATH when the renderer is destroyed.
+const bool GPU_PROFILER = true;
+const uint32_t GPU_PROFILER_MAX_SCOPES = 64;
+const size_t GPU_PROFILER_WINDOW = 240;
+
+// Pipeline statistics and occlusion queries each swap chain image's command buffer may use.  F11
+// cycles the counter level, and what was counted is written to GPU_COUNTERS_PATH on shutdown.
+const uint32_t GPU_PROFILER_MAX_COUNTERS = 512;
+
+// CPU profiler: zones kept per thread, a power of two.  Zones are only recorded when built with
+// KMDM_ENABLE_PROFILER.
+const uint64_t CPU_PROFILER_RING_SIZE = 1 << 16;
+
+// Memory telemetry warns when a heap's usage passes this fraction of its budget.
+const float MEMORY_BUDGET_WARNING = 0.9f;
+
+// Frame readback: copies that may be in flight or waiting to be written out at once, and the most
+// frames a batch scene is drawn before its first image while its textures stream in.  A batch job
+// claimed this many seconds ago that still has no output was left by a process that died.
+const uint32_t READBACK_RING_SIZE = 4;
+const uint32_t BATCH_MAX_WARMUP_FRAMES = 64;
+const uint32_t BATCH_CLAIM_TIMEOUT = 600;
+
+// Frame capture: readback slots for recording, enough to cover the writer falling behind for a few
+// frames.  Frames that find every slot busy are dropped rather than waited for.
+const uint32_t CAPTURE_RING_SIZE = 8;
+
 #define SHADER_PATH "shaders/"
+#define PIPELINE_CACHE_PATH "pipeline_cache.bin"
+#define CPU_TRACE_PATH "cpu_trace.json"
+#define GPU_TIMES_PATH "gpu_times.csv"
+#define GPU_COUNTERS_PATH "gpu_counters.csv"
+#define CAPTURE_PATH "capture"
 #define WIDTH 1600
 #define HEIGHT 1200
 #define ENGINE "KMDMEngine"
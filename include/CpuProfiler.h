@@ -0,0 +1,178 @@
+#ifndef CPUPROFILER_H
+#define CPUPROFILER_H
+
+#include "Common.h"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/******************************************************************
+    CPU zones.  Build with -DKMDM_ENABLE_PROFILER (make PROFILE=1)
+    to record them, otherwise they compile to nothing.
+
+    KMDM_PROFILE_ZONE("name")             Time the enclosing scope.
+    KMDM_PROFILE_ZONE_VALUE("name", v)    Same, with an integer payload.
+    KMDM_PROFILE_THREAD("name")           Name the calling thread.
+
+    Names have to be string literals, only the pointer is kept.
+*******************************************************************/
+#ifdef KMDM_ENABLE_PROFILER
+#define KMDM_PROFILE_CONCAT_IMPL(a, b) a##b
+#define KMDM_PROFILE_CONCAT(a, b) KMDM_PROFILE_CONCAT_IMPL(a, b)
+#define KMDM_PROFILE_ZONE(name) KMDM::ProfileZone KMDM_PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define KMDM_PROFILE_ZONE_VALUE(name, value) \
+    KMDM::ProfileZone KMDM_PROFILE_CONCAT(profileZone, __LINE__)(name, static_cast<int64_t>(value))
+#define KMDM_PROFILE_THREAD(name) KMDM::CpuProfiler::setThreadName(name)
+#else
+#define KMDM_PROFILE_ZONE(name)
+#define KMDM_PROFILE_ZONE_VALUE(name, value)
+#define KMDM_PROFILE_THREAD(name)
+#endif // KMDM_ENABLE_PROFILER
+
+namespace KMDM
+{
+    /**
+     * @brief One finished zone, in profiler ticks.
+     *
+     */
+    struct ProfileEvent
+    {
+        const char* name;
+        uint64_t start;
+        uint64_t end;
+        int64_t value;
+        bool hasValue;
+    };
+
+    /**
+     * @brief Zones of one thread.  Only the owning thread writes, it never waits, and once the ring
+     * is full the oldest zones are overwritten.
+     *
+     */
+    struct ProfileThreadBuffer
+    {
+        std::atomic<uint64_t> head{0};
+        uint32_t threadId = 0;
+        std::string name;
+        std::vector<ProfileEvent> events;
+    };
+
+    /**
+     * @brief Collects the CPU zones of every thread and exports them as Chrome trace events, to be
+     * opened in chrome://tracing or Perfetto.  Ticks are the TSC where there is one, steady clock
+     * nanoseconds elsewhere, and are converted to time when exported.
+     *
+     */
+    class CpuProfiler
+    {
+        public:
+            /**
+             * @brief Get the Instance object
+             *
+             * @return CpuProfiler*
+             */
+            static CpuProfiler* getInstance();
+            virtual ~CpuProfiler();
+            void destroyCpuProfiler();
+
+            /**
+             * @brief Read the tick counter.
+             *
+             * @return uint64_t
+             */
+            static inline uint64_t now()
+            {
+#if defined(__x86_64__) || defined(__i386__)
+                return __rdtsc();
+#else
+                return static_cast<uint64_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif
+            }
+
+            /**
+             * @brief Record a zone into the calling thread's ring.
+             *
+             * @param name
+             * @param start
+             * @param end
+             * @param value
+             * @param has_value
+             */
+            static inline void record(const char* name, uint64_t start, uint64_t end, int64_t value, bool has_value)
+            {
+                ProfileThreadBuffer* buffer = t_buffer ? t_buffer : registerThread();
+                uint64_t head = buffer->head.load(std::memory_order_relaxed);
+                ProfileEvent& event = buffer->events[head & (CPU_PROFILER_RING_SIZE - 1)];
+                event.name = name;
+                event.start = start;
+                event.end = end;
+                event.value = value;
+                event.hasValue = has_value;
+                buffer->head.store(head + 1, std::memory_order_release);
+            }
+
+            /**
+             * @brief Name the calling thread in the trace.
+             *
+             * @param name
+             */
+            static void setThreadName(const std::string& name);
+
+            /**
+             * @brief Write the zones still in the rings as Chrome trace event JSON.  Threads keep
+             * recording while this runs, zones overwritten meanwhile are left out.
+             *
+             * @param path
+             * @return size_t Number of zones written.
+             */
+            size_t writeChromeTrace(const std::string& path);
+
+        protected:
+            static ProfileThreadBuffer* registerThread();
+
+        private:
+            CpuProfiler();
+            static CpuProfiler* m_cpuProfiler;
+            static thread_local ProfileThreadBuffer* t_buffer;
+
+            // Ticks and time at creation, to convert ticks to time on export.
+            uint64_t m_startTicks;
+            std::chrono::steady_clock::time_point m_startTime;
+
+            std::mutex m_mutex;
+            std::vector<std::unique_ptr<ProfileThreadBuffer>> m_threads;
+    };
+
+    /**
+     * @brief Records the lifetime of a scope, see KMDM_PROFILE_ZONE.
+     *
+     */
+    class ProfileZone
+    {
+        public:
+            explicit ProfileZone(const char* name) :
+                m_name(name), m_value(0), m_hasValue(false), m_start(CpuProfiler::now()) {}
+            ProfileZone(const char* name, int64_t value) :
+                m_name(name), m_value(value), m_hasValue(true), m_start(CpuProfiler::now()) {}
+            ~ProfileZone() { CpuProfiler::record(m_name, m_start, CpuProfiler::now(), m_value, m_hasValue); }
+
+            ProfileZone(const ProfileZone&) = delete;
+            ProfileZone& operator=(const ProfileZone&) = delete;
+
+        private:
+            const char* m_name;
+            int64_t m_value;
+            bool m_hasValue;
+            uint64_t m_start;
+    };
+}
+#endif // CPUPROFILER_H
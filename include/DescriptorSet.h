@@ -23,6 +23,14 @@ namespace KMDM
 
             VkDescriptorSetLayout getSceneLayout();
             VkDescriptorSetLayout getModelLayout();
+
+            /**
+             * @brief Layout of the clustered lighting set: cluster parameters, lights, the light count
+             * of each cluster and the light indices of each cluster.
+             * 
+             * @return VkDescriptorSetLayout 
+             */
+            VkDescriptorSetLayout getLightingLayout();
             VkDescriptorPool getSceneDescriptorPool();
             VkDescriptorPool getModelDescriptorPool();
 
@@ -55,6 +63,9 @@ namespace KMDM
             // Model Descriptor pool.
             VkDescriptorSetLayout m_modelLayout;
             VkDescriptorPool m_modelDescriptorPool;        
+
+            // Clustered lighting, allocated by ClusteredLighting.
+            VkDescriptorSetLayout m_lightingLayout;
     };
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,173 @@
+#ifndef DYNAMICRESOLUTION_H
+#define DYNAMICRESOLUTION_H
+
+#include "Common.h"
+#include "types.h"
+#include "LogicalDevice.h"
+#include "Renderpass.h"
+#include "RenderGraph.h"
+#include "RenderTargetPool.h"
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <cstdint>
+
+namespace KMDM
+{
+    /**
+     * @brief Graph handles of the scene targets the upscaled forward pass draws into.
+     *
+     */
+    struct UpscaleResources
+    {
+        RenderResource sceneColor;
+        RenderResource motionVectors;
+    };
+
+    /**
+     * @brief Dynamic resolution with temporal upscaling.  The scene is drawn into the top left of
+     * swap chain sized targets at a render scale that a controller adjusts every frame from the
+     * measured GPU frame time, with a sub-pixel jitter that changes every frame.  A compute pass
+     * then accumulates the jittered samples into a full size history along the motion vectors, and
+     * the result is blitted into the swap chain image.
+     *
+     * The GPU time of a frame is measured with timestamps around its command buffer.
+     *
+     */
+    class DynamicResolution
+    {
+        public:
+            /**
+             * @brief Construct a new Dynamic Resolution object
+             *
+             * @param depth_view Depth buffer the scene is drawn with.
+             * @param image_count Number of swap chain images.
+             */
+            DynamicResolution(VkImageView depth_view, uint32_t image_count);
+            virtual ~DynamicResolution();
+            void destroyDynamicResolution();
+
+            /**
+             * @brief Pick the render extent and jitter of the next frame.  Call once per frame before
+             * it is recorded.
+             *
+             */
+            void beginFrame();
+
+            /**
+             * @brief Read the GPU time of a submitted frame and adjust the render scale.  The frame
+             * has to have finished.
+             *
+             * @param image Swap chain image the frame was drawn to.
+             */
+            void endFrame(uint32_t image);
+
+            /**
+             * @brief Write the timestamps that measure a frame around everything it records.
+             *
+             * @param command_buffer
+             * @param image
+             */
+            void recordFrameStart(VkCommandBuffer command_buffer, uint32_t image);
+            void recordFrameEnd(VkCommandBuffer command_buffer, uint32_t image);
+
+            /**
+             * @brief Add the scene targets to a frame graph.  The scene pass writes both as color
+             * attachments, in the render pass and framebuffer from getRenderPass() and getFramebuffer().
+             *
+             * @param graph
+             * @return UpscaleResources
+             */
+            UpscaleResources importTargets(RenderGraph& graph);
+
+            /**
+             * @brief Add the upscale and present passes to a frame graph.
+             *
+             * @param graph
+             * @param targets
+             * @param color Swap chain image, written with a blit.
+             */
+            void addUpscalePasses(RenderGraph& graph, const UpscaleResources& targets, RenderResource color);
+
+            /**
+             * @brief Offset the projection by this frame's jitter.
+             *
+             * @param projection
+             * @return glm::mat4
+             */
+            glm::mat4 jitterProjection(const glm::mat4& projection);
+
+            /**
+             * @brief Recreate the size dependent targets after a swap chain resize, without waiting
+             * for the device.  The history is dropped.
+             *
+             * @param depth_view The new depth buffer.
+             */
+            void resize(VkImageView depth_view);
+
+            /**
+             * @brief Recreate the per image frame timestamps after the swap chain came back with a
+             * different number of images.
+             *
+             * @param image_count
+             */
+            void setImageCount(uint32_t image_count);
+
+            /**
+             * @brief Set the GPU frame time the controller holds.
+             *
+             * @param milliseconds
+             */
+            void setTargetFrameTime(float milliseconds);
+
+            VkExtent2D getRenderExtent();
+            float getRenderScale();
+            float getGpuFrameTime();
+            Renderpass* getRenderPass();
+            VkFramebuffer getFramebuffer();
+
+        protected:
+            void createQueryPool();
+            void createTargets(VkImageView depth_view);
+            void createPipeline();
+            void writeDescriptorSets();
+
+        private:
+            LogicalDevice* m_logicalDevice;
+            uint32_t m_imageCount;
+            VkExtent2D m_extent;
+
+            // Controller state.
+            float m_targetFrameTime;
+            float m_renderScale;
+            float m_gpuFrameTime;
+            VkExtent2D m_renderExtent;
+            uint64_t m_frame;
+            glm::vec2 m_jitter;
+
+            // Timestamps at the start and end of each swap chain image's frame.
+            VkQueryPool m_queryPool;
+            float m_timestampPeriod;
+
+            // Scene targets, and the two history images that take turns as output.
+            RenderTarget m_sceneColorTarget;
+            RenderTarget m_motionTarget;
+            RenderTarget m_historyTargets[2];
+            uint32_t m_historyIndex;
+            bool m_historyValid;
+
+            Renderpass* m_renderPass;
+            VkFramebuffer m_framebuffer;
+
+            // Upscale pass, with one set for each history direction.
+            VkSampler m_pointSampler;
+            VkSampler m_linearSampler;
+            VkDescriptorSetLayout m_setLayout;
+            VkDescriptorPool m_descriptorPool;
+            VkDescriptorSet m_descriptorSets[2];
+            VkPipelineLayout m_pipelineLayout;
+            VkPipeline m_pipeline;
+    };
+}
+#endif // DYNAMICRESOLUTION_H
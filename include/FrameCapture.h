@@ -0,0 +1,126 @@
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include "Common.h"
+#include "ReadbackRing.h"
+#include "ImageWriter.h"
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+
+namespace KMDM
+{
+    /**
+     * @brief What a recording is written as.  Frames go to numbered PNG or QOI files, or are appended
+     * to one raw RGBA8 stream per frame size, named with the size.
+     *
+     */
+    enum class CaptureFormat
+    {
+        Png,
+        Qoi,
+        RawVideo
+    };
+
+    /**
+     * @brief Records presented frames, and single render targets, to disk without stalling the
+     * queue.  Each frame is copied into a readback ring after it is submitted and handed to the
+     * image writer once its fence has signalled, frames later.  When the writer falls behind and
+     * the ring is full, frames are dropped and counted instead of waited for, so recording keeps
+     * the frame rate.
+     *
+     */
+    class FrameCapture
+    {
+        public:
+            /**
+             * @brief Construct a new Frame Capture object
+             *
+             * @param directory Directory the recordings are written to, created if needed.
+             * @param format
+             * @param slots Readback slots.
+             */
+            FrameCapture(std::string directory = CAPTURE_PATH, CaptureFormat format = CaptureFormat::Qoi,
+                uint32_t slots = CAPTURE_RING_SIZE);
+            virtual ~FrameCapture();
+
+            /**
+             * @brief Finish writing what was captured and destroy the ring and writer.  Has to be
+             * called before the command pool is destroyed.
+             *
+             */
+            void destroyFrameCapture();
+
+            /**
+             * @brief Start recording the presented frames as a new numbered session.
+             *
+             * @return true
+             * @return false The swapchain images cannot be read back.
+             */
+            bool start();
+
+            /**
+             * @brief Stop recording, and wait until the session is written.
+             *
+             */
+            void stop();
+            bool isRecording();
+
+            /**
+             * @brief Hand the finished copies to the writer and, while recording, ask for the next
+             * frame to be copied.  Called on the render thread before each frame is drawn.
+             *
+             */
+            void update();
+
+            /**
+             * @brief Copy an image once, after what has been submitted, and write it as name in the
+             * capture directory.  Raw recordings write single images as QOI.
+             *
+             * @param image
+             * @param format 8 bit RGBA or BGRA, or RGBA16F.
+             * @param extent
+             * @param layout Layout the image is in, and is left in.
+             * @param name File name without the extension.
+             * @throw std::runtime_error If the image writer can not write the format.
+             * @return true
+             * @return false Every slot was busy, nothing is captured.
+             */
+            bool captureImage(VkImage image, VkFormat format, VkExtent2D extent, VkImageLayout layout,
+                std::string name);
+
+            uint64_t getCapturedCount();
+            uint64_t getDroppedCount();
+            uint64_t getWrittenCount();
+
+        protected:
+            void writeCompleted();
+            void flush();
+
+        private:
+            struct PendingOutput
+            {
+                std::string path;
+                ImageEncoding encoding;
+            };
+
+            std::string m_directory;
+            CaptureFormat m_format;
+            ReadbackRing* m_readbackRing;
+            ImageWriter* m_imageWriter;
+
+            bool m_recording = false;
+            uint32_t m_session = 0;
+            uint64_t m_frame = 0;
+            uint64_t m_captured = 0;
+            uint64_t m_dropped = 0;
+
+            // Where each copy in flight is written, by capture tag.
+            std::unordered_map<uint64_t, PendingOutput> m_outputs;
+            uint64_t m_nextTag = 0;
+    };
+}
+#endif // FRAMECAPTURE_H
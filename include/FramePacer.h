@@ -0,0 +1,106 @@
+#ifndef FRAMEPACER_H
+#define FRAMEPACER_H
+
+#include "Common.h"
+
+#include <vulkan/vulkan.h>
+
+#include <chrono>
+#include <cstdint>
+
+namespace KMDM
+{
+    /**
+     * @brief Frame pacing and latency counters.  Latency is measured from the moment the camera is
+     * latched to the moment the presentation queue is idle after the frame's present.
+     *
+     */
+    struct FramePacingStats
+    {
+        uint64_t frames = 0;
+        float latencyMs = 0.0f;
+        float averageLatencyMs = 0.0f;
+        float maxLatencyMs = 0.0f;
+        float sleepMs = 0.0f;
+        float predictedFrameMs = 0.0f;
+    };
+
+    /**
+     * @brief Low latency frame pacing.  Instead of letting the CPU run ahead and block in
+     * vkAcquireNextImageKHR with stale input, the frame sleeps until the latest moment it can start
+     * and still be presented by its deadline, predicted from how long recent frames took.  Deadlines
+     * follow the display refresh for the FIFO modes, and the frame rate limit when one is set.
+     *
+     */
+    class FramePacer
+    {
+        public:
+            /**
+             * @brief Construct a new Frame Pacer object
+             *
+             * @param refresh_rate Display refresh in Hz, 0 when unknown.
+             */
+            FramePacer(float refresh_rate);
+            virtual ~FramePacer();
+            void destroyFramePacer();
+
+            /**
+             * @brief Sleep until the predicted start of the next frame.  Call before anything of the
+             * frame is done.
+             *
+             */
+            void waitForFrame();
+
+            /**
+             * @brief Mark the moment the frame's camera and input are read.
+             *
+             */
+            void latch();
+
+            /**
+             * @brief Measure the latency of a frame once its present has been queued and the
+             * presentation queue is idle, and move the deadline on.
+             *
+             */
+            void framePresented();
+
+            /**
+             * @brief Set the present mode in use, the FIFO modes are paced to the refresh rate.
+             *
+             * @param mode
+             */
+            void setPresentMode(VkPresentModeKHR mode);
+
+            /**
+             * @brief Limit the frame rate, 0 for no limit beyond the refresh of the FIFO modes.
+             *
+             * @param frames_per_second
+             */
+            void setFrameRateLimit(float frames_per_second);
+
+            FramePacingStats getStats();
+
+        protected:
+            typedef std::chrono::steady_clock Clock;
+
+            void updateInterval();
+
+        private:
+            float m_refreshRate;
+            float m_frameRateLimit;
+            VkPresentModeKHR m_presentMode;
+
+            // Time between deadlines, 0 when frames are not paced.
+            Clock::duration m_interval;
+            Clock::time_point m_deadline;
+            Clock::time_point m_frameStart;
+            Clock::time_point m_latchTime;
+            bool m_latched;
+
+            // How long a frame takes from its start to its present, kept pessimistic.
+            float m_predictedFrameMs;
+            double m_totalLatencyMs;
+            FramePacingStats m_stats;
+    };
+}
+#endif // FRAMEPACER_H
@@ -0,0 +1,304 @@
+#ifndef GPUPROFILER_H
+#define GPUPROFILER_H
+
+#include "Common.h"
+
+#include <vulkan/vulkan.h>
+
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+
+namespace KMDM
+{
+    /**
+     * @brief GPU time of a named scope over the last GPU_PROFILER_WINDOW frames it ran in.
+     *
+     */
+    struct GpuScopeStats
+    {
+        std::string name;
+        uint32_t samples = 0;
+        float lastMs = 0.0f;
+        float minMs = 0.0f;
+        float avgMs = 0.0f;
+        float p99Ms = 0.0f;
+    };
+
+    /**
+     * @brief What pipeline statistics and occlusion queries are wrapped around.  Queries of a type
+     * can not nest, so it is either whole passes or single draws.
+     *
+     */
+    enum class GpuCounterLevel
+    {
+        Off,
+        Passes,
+        // Draws are summed per pass, work a pass does outside its draws is not counted.
+        Draws
+    };
+
+    /**
+     * @brief Pipeline statistics and occlusion counts of some GPU work.
+     *
+     */
+    struct GpuCounters
+    {
+        uint64_t inputVertices = 0;
+        uint64_t inputPrimitives = 0;
+        uint64_t vertexInvocations = 0;
+        uint64_t clippingInvocations = 0;
+        uint64_t clippingPrimitives = 0;
+        uint64_t fragmentInvocations = 0;
+        uint64_t computeInvocations = 0;
+        uint64_t samplesPassed = 0;
+    };
+
+    /**
+     * @brief Counters of a pass or model in the last frame, and averaged over the last
+     * GPU_PROFILER_WINDOW frames it ran in.
+     *
+     */
+    struct GpuCounterStats
+    {
+        std::string name;
+        uint32_t samples = 0;
+        GpuCounters last;
+        GpuCounters average;
+    };
+
+    /**
+     * @brief Times named scopes of GPU work with timestamps.  There is one query pool per frame in
+     * flight, and a frame's results are read when its slot comes around again, only if its fence has
+     * signalled, so reading never waits for the GPU.
+     *
+     * Each pool is split into a region per swap chain image, since every image's command buffer is
+     * recorded each frame and only the acquired one runs, and a region for upload batches.  A scope
+     * resets its own two queries, so it has to begin outside a render pass.
+     *
+     * Pipeline statistics and occlusion queries can also be collected for passes or draws, see
+     * setCounterLevel().  They are off by default, since they cost GPU time of their own and
+     * draw level queries break up the work of a pass.
+     *
+     */
+    class GpuProfiler
+    {
+        public:
+            /**
+             * @brief Get the Instance object
+             *
+             * @return GpuProfiler*
+             */
+            static GpuProfiler* getInstance();
+
+            /**
+             * @brief Get the instance if one has been created, for code that should not create it.
+             *
+             * @return GpuProfiler* nullptr before getInstance().
+             */
+            static GpuProfiler* findInstance();
+            virtual ~GpuProfiler();
+
+            /**
+             * @brief Destroy the query pools.
+             *
+             */
+            void destroyGpuProfiler();
+
+            /**
+             * @brief Read the results of the frame that last used a slot, then start a new frame in
+             * it.  Call once per frame before anything of the frame is recorded.
+             *
+             * @param frame Frame in flight slot.
+             * @param fence Fence signalled when the slot's last frame finished, it is only polled.
+             */
+            void beginFrame(uint32_t frame, VkFence fence);
+
+            /**
+             * @brief Resize the per image regions after the swap chain came back with a different
+             * number of images.  Results still in the old pools are dropped.
+             *
+             * @param image_count
+             */
+            void setImageCount(uint32_t image_count);
+
+            /**
+             * @brief Start timing the command buffer of a swap chain image.  Its earlier scopes in
+             * this slot are dropped.
+             *
+             * @param command_buffer
+             * @param image
+             */
+            void beginCommandBuffer(VkCommandBuffer command_buffer, uint32_t image);
+
+            /**
+             * @brief Time scopes of an upload batch command buffer with the frame.  It has to be
+             * submitted to the graphics queue before the frame.
+             *
+             * @param command_buffer
+             */
+            void beginUploadCommandBuffer(VkCommandBuffer command_buffer);
+
+            /**
+             * @brief Mark which image's command buffer the current frame submitted.
+             *
+             * @param image
+             */
+            void frameSubmitted(uint32_t image);
+
+            /**
+             * @brief Open and close a named scope.  Scopes nest, and are ignored in command buffers
+             * that were not begun with the profiler or once a region is full.
+             *
+             * @param command_buffer
+             * @param name
+             */
+            void beginScope(VkCommandBuffer command_buffer, const std::string& name);
+            void endScope(VkCommandBuffer command_buffer);
+
+            /**
+             * @brief Count a pass with pipeline statistics and occlusion queries at the Passes level,
+             * and name the pass the draws in it are counted for at the Draws level.  Has to begin
+             * and end outside a render pass.
+             *
+             * @param command_buffer
+             * @param name
+             */
+            void beginPassCounters(VkCommandBuffer command_buffer, const std::string& name);
+            void endPassCounters(VkCommandBuffer command_buffer);
+
+            /**
+             * @brief Count a draw of a scene model at the Draws level.  Has to begin and end in the
+             * same subpass.
+             *
+             * @param command_buffer
+             * @param model Index of the model in the scene.
+             */
+            void beginDrawCounters(VkCommandBuffer command_buffer, uint32_t model);
+            void endDrawCounters(VkCommandBuffer command_buffer);
+
+            /**
+             * @brief Set what counters are collected, from the next recorded command buffer on.
+             * Ignored without the pipelineStatisticsQuery feature.
+             *
+             * @param level
+             */
+            void setCounterLevel(GpuCounterLevel level);
+            GpuCounterLevel getCounterLevel();
+
+            /**
+             * @brief Counters per pass, and per model at the Draws level, in the order first seen.
+             *
+             * @return std::vector<GpuCounterStats>
+             */
+            std::vector<GpuCounterStats> getPassCounters();
+            std::vector<GpuCounterStats> getModelCounters();
+
+            /**
+             * @brief Rolling statistics of every scope, in the order they were first seen.
+             *
+             * @return std::vector<GpuScopeStats>
+             */
+            std::vector<GpuScopeStats> getStats();
+
+            /**
+             * @brief Write getStats() as CSV.
+             *
+             * @param path
+             */
+            void writeCsv(const std::string& path);
+
+            /**
+             * @brief Write getPassCounters() and getModelCounters() averages as CSV.
+             *
+             * @param path
+             */
+            void writeCountersCsv(const std::string& path);
+
+            bool isEnabled();
+
+        protected:
+            struct ScopeRecord
+            {
+                std::string name;
+                uint32_t query;
+            };
+
+            // Counters of a pass, or of a model's draw in a pass when model is not -1.
+            struct CounterRecord
+            {
+                std::string pass;
+                int32_t model;
+                uint32_t query;
+            };
+
+            // A range of queries, and the scopes recorded into it.  Image regions also have a range
+            // of the counter pools.
+            struct Region
+            {
+                uint32_t firstQuery = 0;
+                uint32_t used = 0;
+                std::vector<ScopeRecord> records;
+                std::vector<int32_t> open;
+
+                GpuCounterLevel level = GpuCounterLevel::Off;
+                uint32_t firstCounter = 0;
+                uint32_t countersUsed = 0;
+                std::vector<CounterRecord> counterRecords;
+                int32_t openCounter = -1;
+                std::string pass;
+            };
+
+            struct Slot
+            {
+                VkQueryPool pool = VK_NULL_HANDLE;
+                VkQueryPool statisticsPool = VK_NULL_HANDLE;
+                VkQueryPool occlusionPool = VK_NULL_HANDLE;
+                std::vector<Region> regions;
+                int32_t submittedImage = -1;
+            };
+
+            void createQueryPools();
+            void collect(Slot& slot);
+            void collectCounters(Slot& slot, Region& region);
+            void clearRegion(Region& region);
+            void addSample(const std::string& name, float milliseconds);
+            void beginCounters(VkCommandBuffer command_buffer, const std::string& pass, int32_t model);
+            void endCounters(VkCommandBuffer command_buffer);
+            void addCounters(std::unordered_map<std::string, std::deque<GpuCounters>>& samples,
+                std::vector<std::string>& names, const std::string& name, const GpuCounters& counters);
+            std::vector<GpuCounterStats> counterStats(std::unordered_map<std::string, std::deque<GpuCounters>>& samples,
+                const std::vector<std::string>& names);
+
+        private:
+            GpuProfiler();
+            static GpuProfiler* m_gpuProfiler;
+
+            bool m_enabled;
+            float m_timestampPeriod;
+            uint64_t m_timestampMask;
+            uint32_t m_imageCount;
+
+            std::vector<Slot> m_slots;
+            uint32_t m_frame;
+
+            // Region of each command buffer begun in the current frame.
+            std::unordered_map<VkCommandBuffer, uint32_t> m_commandRegions;
+
+            // Last samples of each scope, names in first seen order.
+            std::unordered_map<std::string, std::deque<float>> m_samples;
+            std::vector<std::string> m_names;
+
+            // Counters, at the level set when a command buffer is begun.
+            bool m_countersSupported;
+            bool m_preciseOcclusion;
+            GpuCounterLevel m_counterLevel;
+            std::unordered_map<std::string, std::deque<GpuCounters>> m_passCounters;
+            std::vector<std::string> m_passNames;
+            std::unordered_map<std::string, std::deque<GpuCounters>> m_modelCounters;
+            std::vector<std::string> m_modelNames;
+    };
+}
+#endif // GPUPROFILER_H
@@ -0,0 +1,138 @@
+#ifndef IMAGEWRITER_H
+#define IMAGEWRITER_H
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <deque>
+#include <fstream>
+#include <unordered_map>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <cstdint>
+
+namespace KMDM
+{
+    /**
+     * @brief How an image is written.  PNG is the smallest, QOI encodes many times faster, and Raw
+     * appends tightly packed RGBA8 frames to a stream file, in the order they were queued, which
+     * ffmpeg reads as -f rawvideo -pix_fmt rgba.
+     *
+     */
+    enum class ImageEncoding
+    {
+        Png,
+        Qoi,
+        Raw
+    };
+
+    /**
+     * @brief Pixels to write out.  The pixels are only read until release is called, which the
+     * writer does as soon as it has its own copy.
+     *
+     */
+    struct ImageWriteJob
+    {
+        std::string path;
+        const unsigned char* pixels;
+        size_t rowPitch;
+        uint32_t width;
+        uint32_t height;
+        VkFormat format;
+        std::function<void()> release;
+        ImageEncoding encoding = ImageEncoding::Png;
+
+        // Called on the writer thread once the file has been written, if set.
+        std::function<void()> written;
+    };
+
+    /**
+     * @brief Encodes images on a pool of worker threads, so the render thread only hands the pixels
+     * over.  8 bit RGBA and BGRA are written as they are, and RGBA16F, which holds linear color, is
+     * sRGB encoded to 8 bits on the way.
+     *
+     */
+    class ImageWriter
+    {
+        public:
+            /**
+             * @brief Construct a new Image Writer object
+             *
+             * @param threads Number of worker threads, 0 picks one per spare core.
+             */
+            ImageWriter(uint32_t threads = 0);
+            virtual ~ImageWriter();
+
+            /**
+             * @brief Write out the queued images and stop the worker threads.
+             *
+             */
+            void destroyImageWriter();
+
+            /**
+             * @brief Whether images of a format can be written.
+             *
+             * @param format
+             * @return true
+             * @return false
+             */
+            static bool isSupported(VkFormat format);
+
+            /**
+             * @brief Queue an image to be written.
+             *
+             * @param job
+             */
+            void write(ImageWriteJob job);
+
+            /**
+             * @brief Block until every queued image has been written.
+             *
+             */
+            void wait();
+
+            /**
+             * @brief Close the Raw stream files.  Call after wait(), the next Raw image to a path
+             * starts the file over.
+             *
+             */
+            void closeStreams();
+
+            uint64_t getWrittenCount();
+            uint64_t getFailedCount();
+
+        protected:
+            void worker();
+            bool appendToStream(const ImageWriteJob& job, const std::vector<unsigned char>& rgba,
+                uint64_t sequence);
+
+        private:
+            struct QueuedJob
+            {
+                ImageWriteJob job;
+                uint64_t sequence;
+            };
+
+            std::mutex m_mutex;
+            std::condition_variable m_queued;
+            std::condition_variable m_idle;
+            bool m_stopping = false;
+            uint32_t m_active = 0;
+            uint64_t m_written = 0;
+            uint64_t m_failed = 0;
+
+            std::deque<QueuedJob> m_queue;
+            std::vector<std::thread> m_threads;
+
+            // Raw frames are converted in parallel but appended in the order they were queued.
+            std::mutex m_streamMutex;
+            std::condition_variable m_streamTurn;
+            uint64_t m_nextStreamSequence = 0;
+            uint64_t m_streamSequence = 0;
+            std::unordered_map<std::string, std::ofstream> m_streams;
+    };
+}
+#endif // IMAGEWRITER_H
@@ -0,0 +1,48 @@
+#ifndef KTX2_H
+#define KTX2_H
+
+#include "types.h"
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <cstdint>
+
+namespace KMDM
+{
+    /**
+     * @brief Check for the KTX2 file identifier.
+     *
+     * @param bytes
+     * @param size
+     * @return true
+     * @return false
+     */
+    bool isKtx2(const unsigned char* bytes, size_t size);
+
+    /**
+     * @brief Read the format of a KTX2 file from its header without parsing the rest.
+     *
+     * @param bytes
+     * @param size
+     * @return VkFormat VK_FORMAT_UNDEFINED if the header is not valid.
+     */
+    VkFormat peekKtx2Format(const unsigned char* bytes, size_t size);
+
+    /**
+     * @brief Parse a single layer, single face 2D KTX2 texture.  Supercompressed files are rejected.
+     *
+     * @param bytes
+     * @param size
+     * @return TextureData Mip levels in the order largest first.
+     */
+    TextureData readKtx2(const unsigned char* bytes, size_t size);
+
+    /**
+     * @brief Serialise a texture as KTX2, with a basic data format descriptor.
+     *
+     * @param texture
+     * @return std::vector<unsigned char>
+     */
+    std::vector<unsigned char> writeKtx2(const TextureData& texture);
+}
+#endif // KTX2_H
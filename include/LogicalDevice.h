@@ -14,6 +14,14 @@ namespace KMDM
             VkDevice getLogicalDevice();
             VkQueue getGraphicsQueue();
             VkQueue getPresentationQueue();
+
+            /**
+             * @brief Get the queue of the dedicated transfer family.  Only valid if
+             * getQueueFamilyInfo().hasTransfer().
+             * 
+             * @return VkQueue 
+             */
+            VkQueue getTransferQueue();
             QueueFamilyInfo getQueueFamilyInfo();
             virtual ~LogicalDevice();
             void destroyLogicalDevice();
@@ -21,9 +29,17 @@ namespace KMDM
             VkShaderModule createShaderModule(const std::vector<char>& code);
             VkPhysicalDeviceProperties getPhysicalDeviceProperties();
 
+            /**
+             * @brief Whether VK_EXT_memory_budget is enabled.
+             * 
+             * @return bool 
+             */
+            bool hasMemoryBudget();
+
         protected:
             void getQueueHandle();
             void findSuitableQueueFamily(VkQueueFlags QUEUE_FLAGS);
+            void findTransferQueueFamily();
 
 
         private:
@@ -33,8 +49,10 @@ namespace KMDM
             static VkDevice m_VKDevice;
             VkQueue m_graphicsQueue;
             VkQueue m_presentationQueue;
+            VkQueue m_transferQueue;
             QueueFamilyInfo m_queueFamilyInfo;
             VkPhysicalDeviceProperties m_physicalDeviceProperties;
+            bool m_memoryBudget;
     };
 }
 #endif // LOGICALDEVICE_H
@@ -0,0 +1,187 @@
+#ifndef MEMORYTELEMETRY_H
+#define MEMORYTELEMETRY_H
+
+#include "Common.h"
+
+#include <vulkan/vulkan.h>
+
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+
+namespace KMDM
+{
+    /**
+     * @brief What an allocation of device memory is used for.
+     *
+     */
+    enum class MemoryCategory
+    {
+        Geometry,
+        Texture,
+        Staging,
+        Uniform,
+        RenderTarget,
+        Other
+    };
+
+    const uint32_t MEMORY_CATEGORY_COUNT = 6;
+
+    /**
+     * @brief Live bytes of a category, and the most it has held at once.
+     *
+     */
+    struct MemoryCategoryStats
+    {
+        const char* name = "";
+        uint32_t allocations = 0;
+        VkDeviceSize bytes = 0;
+        VkDeviceSize peakBytes = 0;
+    };
+
+    /**
+     * @brief A memory heap.  Budget and usage are the driver's, for the whole process, from
+     * VK_EXT_memory_budget; without it the budget is the heap size and usage is what is tracked.
+     *
+     */
+    struct MemoryHeapStats
+    {
+        uint32_t heap = 0;
+        bool deviceLocal = false;
+        VkDeviceSize size = 0;
+        VkDeviceSize budget = 0;
+        VkDeviceSize usage = 0;
+        VkDeviceSize peakUsage = 0;
+        VkDeviceSize tracked = 0;
+        VkDeviceSize peakTracked = 0;
+    };
+
+    /**
+     * @brief Allocations made and freed during a frame.
+     *
+     */
+    struct MemoryFrameStats
+    {
+        uint64_t frame = 0;
+        uint32_t allocations = 0;
+        uint32_t frees = 0;
+        VkDeviceSize allocatedBytes = 0;
+        VkDeviceSize freedBytes = 0;
+    };
+
+    struct MemoryStats
+    {
+        bool budgetSupported = false;
+        std::vector<MemoryCategoryStats> categories;
+        std::vector<MemoryHeapStats> heaps;
+        MemoryFrameStats lastFrame;
+    };
+
+    /**
+     * @brief Tracks device memory by category and heap, for allocations made with vkAllocateMemory
+     * through createBuffer() and createImage() and for the ones made by VMA through Allocator.  Heaps
+     * are checked against the driver's budget once per frame, with a warning when usage passes
+     * MEMORY_BUDGET_WARNING of it.  Tracking may happen on any thread.
+     *
+     */
+    class MemoryTelemetry
+    {
+        public:
+            /**
+             * @brief Get the Instance object
+             *
+             * @return MemoryTelemetry*
+             */
+            static MemoryTelemetry* getInstance();
+
+            /**
+             * @brief Get the instance if one has been created, for code that should not create it.
+             *
+             * @return MemoryTelemetry* nullptr before getInstance().
+             */
+            static MemoryTelemetry* findInstance();
+            virtual ~MemoryTelemetry();
+            void destroyMemoryTelemetry();
+
+            /**
+             * @brief Track memory from vkAllocateMemory, until trackFree().
+             *
+             * @param memory
+             * @param size
+             * @param memory_type
+             * @param category
+             */
+            void trackAllocation(VkDeviceMemory memory, VkDeviceSize size, uint32_t memory_type,
+                MemoryCategory category);
+            void trackFree(VkDeviceMemory memory);
+
+            /**
+             * @brief Track a VMA allocation, until trackVmaFree().
+             *
+             * @param allocation The VmaAllocation.
+             * @param size
+             * @param memory_type
+             * @param category
+             */
+            void trackVmaAllocation(const void* allocation, VkDeviceSize size, uint32_t memory_type,
+                MemoryCategory category);
+            void trackVmaFree(const void* allocation);
+
+            /**
+             * @brief Close the frame's counters and read the heap budgets.  Call once per frame.
+             *
+             */
+            void update();
+
+            MemoryStats getStats();
+
+            /**
+             * @brief Write getStats() as JSON.
+             *
+             * @param path
+             */
+            void writeJson(const std::string& path);
+
+            /**
+             * @brief Write getStats() as a JSON object, for reports that include it.
+             *
+             * @param stream
+             */
+            void writeJson(std::ostream& stream);
+
+            static const char* getCategoryName(MemoryCategory category);
+
+        protected:
+            struct Allocation
+            {
+                VkDeviceSize size;
+                uint32_t heap;
+                MemoryCategory category;
+            };
+
+            void addAllocation(const Allocation& allocation);
+            void removeAllocation(const Allocation& allocation);
+            void readBudget();
+
+        private:
+            MemoryTelemetry();
+            static MemoryTelemetry* m_memoryTelemetry;
+
+            std::mutex m_mutex;
+            VkPhysicalDeviceMemoryProperties m_memoryProperties;
+            bool m_budgetSupported;
+
+            std::unordered_map<VkDeviceMemory, Allocation> m_allocations;
+            std::unordered_map<const void*, Allocation> m_vmaAllocations;
+
+            MemoryCategoryStats m_categories[MEMORY_CATEGORY_COUNT];
+            std::vector<MemoryHeapStats> m_heaps;
+            std::vector<bool> m_overBudget;
+            MemoryFrameStats m_frame;
+            MemoryFrameStats m_lastFrame;
+    };
+}
+#endif // MEMORYTELEMETRY_H
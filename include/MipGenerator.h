@@ -0,0 +1,39 @@
+#ifndef MIPGENERATOR_H
+#define MIPGENERATOR_H
+
+#include "types.h"
+
+#include <vulkan/vulkan.h>
+
+namespace KMDM
+{
+    /**
+     * @brief Downsampling filter used to build mip chains.
+     *
+     */
+    enum class MipFilter
+    {
+        Box,        // Average of the texels each output texel covers.
+        Kaiser      // Kaiser windowed sinc, sharper with less aliasing.
+    };
+
+    /**
+     * @brief Append mip levels down to 1x1 to a single level RGBA8 texture.  sRGB textures are
+     * filtered in linear space, alpha is always linear.  Rows are spread over the shared
+     * WorkerPool, which decode threads building mips at once share, and the filter taps use SSE2.
+     *
+     * @param texture Texture in VK_FORMAT_R8G8B8A8_UNORM or VK_FORMAT_R8G8B8A8_SRGB with one mip.
+     * @param filter
+     */
+    void generateMipChain(TextureData& texture, MipFilter filter = MipFilter::Kaiser);
+
+    /**
+     * @brief Number of levels in a full mip chain.
+     *
+     * @param width
+     * @param height
+     * @return uint32_t
+     */
+    uint32_t getMipLevelCount(uint32_t width, uint32_t height);
+}
+#endif // MIPGENERATOR_H
@@ -6,42 +6,143 @@
 
 #include <vulkan/vulkan.h>
 #include <string>
+#include <vector>
+#include <istream>
 
 namespace KMDM
 {
+    /**
+     * @brief CPU side model data.  Everything needed to build a Model without touching
+     * the GPU, so it can be produced on a worker thread and uploaded later.
+     * 
+     */
+    struct ModelData
+    {
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+
+        // Uncompressed RGBA8 or a pre-compressed mip chain loaded from KTX2.
+        TextureData texture;
+    };
+
     class Model
     {
         public:
             Model(std::string model_path, std::string texture_path);
+            Model(const ModelData& data);
             virtual ~Model();
 
             VkBuffer* getVertexBuffer();
+
+            /**
+             * @brief Get the buffer holding only the vertex positions, for depth only passes.
+             * 
+             * @return VkBuffer* 
+             */
+            VkBuffer* getPositionBuffer();
             VkBuffer* getIndexBuffer();
             void destroyModel();
 
+            /**
+             * @brief Get the view of the texture's resident mip levels.  It changes as levels stream
+             * in and out, so fetch it every frame.
+             * 
+             * @return VkImageView 
+             */
             VkImageView getTextureImageView();
             VkSampler getTextureSampler();
 
+            /**
+             * @brief Get the TextureResidency id of the model's texture.
+             * 
+             * @return uint32_t 
+             */
+            uint32_t getTexture();
+
+            /**
+             * @brief Get the centre of the model's bounding sphere, in model space.
+             * 
+             * @return glm::vec3 
+             */
+            glm::vec3 getBoundsCenter();
+            float getBoundsRadius();
+
             uint32_t getIndexCount();
 
+            /**
+             * @brief Get the host copy of the geometry, for building shared buffers.
+             * 
+             * @return const std::vector<Vertex>& 
+             */
+            const std::vector<Vertex>& getVertices();
+            const std::vector<uint32_t>& getIndices();
+
             VkBuffer getTranslationMatrix();
 
+            /**
+             * @brief Get the UploadManager ticket of the model's uploads.  The model can be drawn
+             * once UploadManager::isComplete() returns true for it.
+             * 
+             * @return uint64_t 
+             */
+            uint64_t getUploadTicket();
+
+            /**
+             * @brief Read and decode a model and its texture from disk.  Does not use the GPU.
+             * 
+             * @param model_path 
+             * @param texture_path 
+             * @return ModelData 
+             */
+            static ModelData loadModelData(std::string model_path, std::string texture_path);
+
+            /**
+             * @brief Decode a model and its texture from in-memory file contents.  Does not use the GPU.
+             * 
+             * @param obj_bytes Contents of the .obj file.
+             * @param texture_bytes Contents of the image or KTX2 file.
+             * @return ModelData 
+             */
+            static ModelData decodeModelData(const std::vector<char>& obj_bytes,
+                const std::vector<char>& texture_bytes);
+
+            /**
+             * @brief A unit cube with a flat grey texture, drawn while the real model streams in.
+             * 
+             * @return ModelData 
+             */
+            static ModelData createPlaceholderData();
+
+            /**
+             * @brief Read a texture file, preferring a .ktx2 file next to it when the device can use
+             * its format.  A .ktx2 path whose format is unusable falls back to the .png next to it.
+             * 
+             * @param texture_path 
+             * @return std::vector<char> 
+             */
+            static std::vector<char> readTextureFile(std::string texture_path);
+
+            /**
+             * @brief Create info of the sampler shared by all model textures.  It is also baked into
+             * the model descriptor set layout as an immutable sampler.
+             * 
+             * @return VkSamplerCreateInfo 
+             */
+            static VkSamplerCreateInfo getTextureSamplerInfo();
+
         protected:
-            void loadModel(std::string path);
-            void loadTexture(std::string path);
+            static void parseModel(std::istream& stream, ModelData& data);
+            static void decodeTexture(const unsigned char* bytes, size_t size, ModelData& data);
+            static bool isTextureFormatUsable(VkFormat format);
+            static bool isTextureFormatSampleable(VkFormat format);
+
             void createVertexBuffer();
             void createIndexBuffer();
-            void createTextureImage(std::string path);
+            void createTextureImage(const TextureData& texture);
             void creatteTransBuffer();
 
-            void generateMipmaps(VkImage image, int32_t tex_width, int32_t tex_height, 
-                VkFormat format, uint32_t mip_levels);
-
-            void transitionImageLayout(VkImage image, VkFormat format,
-                VkImageLayout old_layout, VkImageLayout new_layout, uint32_t mip_levels);
-
-            void createTextureImageView();
             void createTextureSampler();
+            void computeBounds();
 
         private:
             // Vertex buffer
@@ -49,17 +150,22 @@ namespace KMDM
             std::vector<Vertex> m_vertices;
             VkDeviceMemory m_vertexBufferMemory;
 
+            // Positions only, tightly packed, so depth only passes fetch a third of the data.
+            VkBuffer m_positionBuffer;
+            VkDeviceMemory m_positionBufferMemory;
+
             // Indices
             std::vector<uint32_t> m_indices;
             VkBuffer m_indexBuffer;
             VkDeviceMemory m_indexBufferMemory;
 
-            // Texture
-            VkImage m_textureImage;
-            VkDeviceMemory m_textureImageMemory;
-            VkImageView m_textureImageView;
+            // Texture, its images are owned by TextureResidency and the sampler by SamplerCache.
+            uint32_t m_texture;
             VkSampler m_textureImageSampler;
-            uint32_t m_mipLevels;
+
+            // Bounding sphere.
+            glm::vec3 m_boundsCenter;
+            float m_boundsRadius;
 
             // Translation buffer.
             VkBuffer m_translationBufffer;
@@ -68,6 +174,9 @@ namespace KMDM
 
             // Descriptor
             VkDescriptorSet m_descriptorSet;
+
+            // Upload batch holding the buffer and texture contents.
+            uint64_t m_uploadTicket;
     };
 }
 
@@ -12,13 +12,27 @@ namespace KMDM
     {
         public:
             static PhysicalDevice* getInstance();
+
+            /**
+             * @brief Use the index-th suitable device rather than the preferred one, to spread
+             * processes over several GPUs.  Has to be called before getInstance().
+             *
+             * @param index Index among the suitable devices, -1 for the preferred one.
+             */
+            static void setDeviceIndex(int index);
+
             VkPhysicalDevice getPhysicalDevice();
             SwapChainSupportDetails getSwapChainSupportDetails();
 
             VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates,
                 VkImageTiling tiling, VkFormatFeatureFlags features);
+
+            bool isFormatSupported(VkFormat format, VkImageTiling tiling, VkFormatFeatureFlags features);
             
             VkPhysicalDeviceMemoryProperties getMemoryProperties();
+            VkPhysicalDeviceProperties getPhysicalDeviceProperties();
+            VkPhysicalDeviceFeatures getPhysicalDeviceFeatures();
+            bool isExtensionSupported(const char* extension);
 
         protected:
             SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
@@ -31,8 +45,11 @@ namespace KMDM
 
             static PhysicalDevice* m_physicalDevice;
             static VkPhysicalDevice m_VKphysicalDevice;
+            static int m_deviceIndex;
             SwapChainSupportDetails m_SwapChainDetails;
             VkPhysicalDeviceMemoryProperties m_physicalDeviceMemoryProperties;
+            VkPhysicalDeviceProperties m_physicalDeviceProperties;
+            VkPhysicalDeviceFeatures m_physicalDeviceFeatures;
     };
 }
 #endif // PHYSICALDEVICE_H
@@ -6,6 +6,7 @@
 #include "Renderpass.h"
 #include "Pipeline.h"
 #include "DescriptorSet.h"
+#include "PipelineManager.h"
 
 #include <vulkan/vulkan.h>
 
@@ -21,6 +22,13 @@ namespace KMDM
             VkPipeline* getPipeline();
             VkPipelineLayout* getPipelineLayout();
 
+            /**
+             * @brief Get the description of the default pipeline, the fallback for its variants.
+             * 
+             * @return PipelineDesc 
+             */
+            PipelineDesc getDescription();
+
 
         protected:
             void createGraphicsPipeline();
@@ -29,6 +37,7 @@ namespace KMDM
         
             VkPipeline m_graphicsPipeline;
             VkPipelineLayout m_graphicsPipelineLayout;
+            PipelineDesc m_description;
             LogicalDevice* m_logicalDevice;
             Renderpass* m_renderPass;
 
@@ -0,0 +1,91 @@
+#ifndef PIPELINECACHE_H
+#define PIPELINECACHE_H
+
+#include "Common.h"
+
+#include <vulkan/vulkan.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace KMDM
+{
+    /**
+     * @brief The VkPipelineCache shared by every pipeline creation.  It is seeded from disk at
+     * startup when the file was written by the same driver and device, and written back on
+     * shutdown and every PIPELINE_CACHE_SAVE_INTERVAL seconds while it grows.  Writes go to a
+     * temporary file that is renamed over the old one, so a crash never leaves a torn cache.
+     *
+     */
+    class PipelineCache
+    {
+        public:
+            /**
+             * @brief Get the Instance object
+             *
+             * @return PipelineCache*
+             */
+            static PipelineCache* getInstance();
+            virtual ~PipelineCache();
+
+            /**
+             * @brief Save the cache and destroy it.
+             *
+             */
+            void destroyPipelineCache();
+
+            /**
+             * @brief Set the file the cache is loaded from and saved to.  Only has an effect before
+             * the instance is created.
+             *
+             * @param path
+             */
+            static void setCachePath(const std::string& path);
+
+            VkPipelineCache getPipelineCache();
+
+            /**
+             * @brief Write the cache to disk if it changed since it was last written.
+             *
+             */
+            void save();
+
+            /**
+             * @brief Save periodically.  Call once per frame.
+             *
+             */
+            void update();
+
+            /**
+             * @brief Check if the cache was seeded from disk.
+             *
+             * @return true
+             * @return false
+             */
+            bool isWarm();
+
+        protected:
+            /**
+             * @brief Read the cache file and check that its header matches this device.
+             *
+             * @return std::vector<char> The file contents, or nothing when it is missing or stale.
+             */
+            std::vector<char> loadCacheData();
+            bool isCacheDataValid(const std::vector<char>& data);
+
+        private:
+            PipelineCache();
+            static PipelineCache* m_pipelineCache;
+            static std::string m_path;
+
+            VkPipelineCache m_cache = VK_NULL_HANDLE;
+            bool m_warm = false;
+
+            // Size of the cache data when it was last loaded or written.
+            size_t m_savedSize = 0;
+            std::chrono::steady_clock::time_point m_lastSave;
+    };
+}
+#endif // PIPELINECACHE_H
@@ -0,0 +1,191 @@
+#ifndef PIPELINEMANAGER_H
+#define PIPELINEMANAGER_H
+
+#include "Common.h"
+
+#include <vulkan/vulkan.h>
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+
+namespace KMDM
+{
+    /**
+     * @brief A 32 bit specialization constant, set on every shader stage that declares its id.
+     *
+     */
+    struct SpecializationConstant
+    {
+        uint32_t id;
+        uint32_t value;
+    };
+
+    /**
+     * @brief Everything that distinguishes one graphics pipeline from another.  Descriptions that
+     * compare equal share a VkPipeline.  The layout and render pass are owned by the caller.
+     *
+     */
+    struct PipelineDesc
+    {
+        // SPIR-V files.  Without a fragment shader only depth is written.
+        std::string vertexShader;
+        std::string fragmentShader;
+        std::vector<SpecializationConstant> specialization;
+
+        // Vertex layout.
+        std::vector<VkVertexInputBindingDescription> vertexBindings;
+        std::vector<VkVertexInputAttributeDescription> vertexAttributes;
+        VkPrimitiveTopology topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+        // Rasterization.
+        VkPolygonMode polygonMode = VK_POLYGON_MODE_FILL;
+        VkCullModeFlags cullMode = VK_CULL_MODE_BACK_BIT;
+        VkFrontFace frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+        VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+
+        // Depth and blending.  Blending is standard alpha blending.
+        VkBool32 depthTest = VK_TRUE;
+        VkBool32 depthWrite = VK_TRUE;
+        VkCompareOp depthCompareOp = VK_COMPARE_OP_LESS;
+        VkBool32 blendEnable = VK_FALSE;
+        uint32_t colorAttachmentCount = 1;
+
+        VkPipelineLayout layout = VK_NULL_HANDLE;
+        VkRenderPass renderPass = VK_NULL_HANDLE;
+        uint32_t subpass = 0;
+
+        bool operator==(const PipelineDesc& other) const;
+    };
+
+    /**
+     * @brief Hash of every field of a pipeline description.
+     *
+     * @param desc
+     * @return size_t
+     */
+    size_t hashPipelineDesc(const PipelineDesc& desc);
+
+    /**
+     * @brief Pipeline manager counters.
+     *
+     */
+    struct PipelineManagerStats
+    {
+        uint32_t pipelines = 0;
+        uint32_t pending = 0;
+        uint64_t backgroundCompiles = 0;
+        uint64_t fallbacks = 0;
+    };
+
+    /**
+     * @brief Owns every graphics pipeline, keyed by its full description.  Variants that are not
+     * needed straight away are compiled on background threads, and requestPipeline() hands out a
+     * generic fallback until they are ready, so draws never wait on the compiler.  Compiles go
+     * through the shared PipelineCache.
+     *
+     */
+    class PipelineManager
+    {
+        public:
+            /**
+             * @brief Get the Instance object
+             *
+             * @return PipelineManager*
+             */
+            static PipelineManager* getInstance();
+            virtual ~PipelineManager();
+
+            /**
+             * @brief Stop the compile threads and destroy every pipeline.
+             *
+             */
+            void destroyPipelineManager();
+
+            /**
+             * @brief Get a pipeline, compiling it on the calling thread if needed.
+             *
+             * @param desc
+             * @return VkPipeline
+             */
+            VkPipeline getPipeline(const PipelineDesc& desc);
+
+            /**
+             * @brief Get a pipeline without waiting for the compiler.  A missing variant is queued for
+             * a background compile and the fallback is returned until it is ready, or for good if
+             * it failed to compile.
+             *
+             * @param desc Specialized variant.
+             * @param fallback Generic variant, compiled on the calling thread if needed.
+             * @return VkPipeline
+             */
+            VkPipeline requestPipeline(const PipelineDesc& desc, const PipelineDesc& fallback);
+
+            /**
+             * @brief Check if a variant has been compiled.
+             *
+             * @param desc
+             * @return true
+             * @return false
+             */
+            bool isReady(const PipelineDesc& desc);
+
+            PipelineManagerStats getStats();
+
+        protected:
+            enum class VariantState
+            {
+                Queued,
+                Compiling,
+                Ready,
+                Failed
+            };
+
+            struct Variant
+            {
+                PipelineDesc desc;
+                VkPipeline pipeline = VK_NULL_HANDLE;
+                VariantState state = VariantState::Queued;
+            };
+
+            /**
+             * @brief Find or add the variant of a description.  m_mutex must be held.
+             *
+             * @param desc
+             * @param added Set when the variant is new.
+             * @return Variant*
+             */
+            Variant* findVariant(const PipelineDesc& desc, bool& added);
+
+            VkPipeline compile(const PipelineDesc& desc);
+            void finishCompile(Variant* variant, VkPipeline pipeline, bool failed);
+            VkShaderModule getShaderModule(const std::string& path);
+            void compileWorker();
+
+        private:
+            PipelineManager(uint32_t compile_threads = 0);
+            static PipelineManager* m_pipelineManager;
+
+            std::mutex m_mutex;
+            std::condition_variable m_queueCondition;
+            std::condition_variable m_readyCondition;
+            bool m_stopping = false;
+
+            // Variants by description hash.  They are never moved, so pointers stay valid.
+            std::unordered_map<size_t, std::vector<std::unique_ptr<Variant>>> m_variants;
+            std::deque<Variant*> m_queue;
+            std::vector<std::thread> m_threads;
+            PipelineManagerStats m_stats;
+
+            // Shader modules by file, shared by every variant that uses them.
+            std::mutex m_shaderMutex;
+            std::unordered_map<std::string, VkShaderModule> m_shaderModules;
+    };
+}
+#endif // PIPELINEMANAGER_H
@@ -0,0 +1,162 @@
+#ifndef READBACKRING_H
+#define READBACKRING_H
+
+#include "Common.h"
+
+#include <vulkan/vulkan.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+
+namespace KMDM
+{
+    /**
+     * @brief An image copied back to the host.  The pixels stay valid until the slot is released.
+     *
+     */
+    struct ReadbackImage
+    {
+        uint32_t slot;
+        uint64_t tag;
+        VkFormat format;
+        VkExtent2D extent;
+        const unsigned char* pixels;
+        size_t rowPitch;
+    };
+
+    /**
+     * @brief Reads images back to the host without stalling.  Each slot owns a persistently mapped
+     * host buffer, a command buffer and a fence.  A capture records a copy of the image into a free
+     * slot and submits it after the frame, and the slot is handed back with takeCompleted() once its
+     * fence has signalled, usually frames later.  Whoever consumes the pixels releases the slot,
+     * from any thread, so they can be written out on worker threads while the next frames render.
+     *
+     * Images have to be in one of the formats getTexelSize() knows.
+     *
+     */
+    class ReadbackRing
+    {
+        public:
+            /**
+             * @brief Construct a new Readback Ring object
+             *
+             * @param slots Copies that may be in flight or held by consumers at once.
+             */
+            ReadbackRing(uint32_t slots = READBACK_RING_SIZE);
+            virtual ~ReadbackRing();
+
+            /**
+             * @brief Wait for the copies in flight and destroy the slots.  Every slot has to have
+             * been released.
+             *
+             */
+            void destroyReadbackRing();
+
+            /**
+             * @brief Bytes per texel of the color formats the ring can copy.
+             *
+             * @param format
+             * @return uint32_t 0 for any other format.
+             */
+            static uint32_t getTexelSize(VkFormat format);
+
+            /**
+             * @brief Whether capture() would find a free slot.
+             *
+             * @return true
+             * @return false
+             */
+            bool hasFreeSlot();
+
+            /**
+             * @brief Copy an image into a free slot, on the graphics queue after everything already
+             * submitted to it.  The image is put back in its layout afterwards.
+             *
+             * @param image
+             * @param format
+             * @param extent
+             * @param layout Layout the image is in when the copy runs, and is left in.
+             * @param signal_semaphore Signalled when the copy is done, or VK_NULL_HANDLE.  A frame
+             * that is presented after the copy waits on it instead of the frame's own semaphore.
+             * @param tag Returned with the image.
+             * @throw std::runtime_error If getTexelSize() does not know the format.
+             * @return true The copy was submitted.
+             * @return false Every slot is busy, nothing was submitted.
+             */
+            bool capture(VkImage image, VkFormat format, VkExtent2D extent, VkImageLayout layout,
+                VkSemaphore signal_semaphore, uint64_t tag);
+
+            /**
+             * @brief Take the images whose copies have finished, without waiting.  Their slots stay
+             * busy until released.
+             *
+             * @return std::vector<ReadbackImage>
+             */
+            std::vector<ReadbackImage> takeCompleted();
+
+            /**
+             * @brief Hand a slot from takeCompleted() back.  May be called from any thread.
+             *
+             * @param slot
+             */
+            void release(uint32_t slot);
+
+            /**
+             * @brief Block until a slot is free, or a copy has finished and can be taken.
+             *
+             */
+            void waitForSlot();
+
+            /**
+             * @brief Block until every copy in flight has finished.
+             *
+             */
+            void waitForCopies();
+
+            /**
+             * @brief Whether any copy is in flight or any image is still held.
+             *
+             * @return true
+             * @return false
+             */
+            bool isBusy();
+
+        protected:
+            void ensureCapacity(uint32_t slot, VkDeviceSize size);
+
+        private:
+            enum class SlotState
+            {
+                Free,
+                InFlight,
+                Completed,
+                Held
+            };
+
+            struct Slot
+            {
+                SlotState state = SlotState::Free;
+                VkBuffer buffer = VK_NULL_HANDLE;
+                VkDeviceMemory memory = VK_NULL_HANDLE;
+                VkDeviceSize size = 0;
+                void* mapped = nullptr;
+                VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+                VkFence fence = VK_NULL_HANDLE;
+                uint64_t tag = 0;
+                VkFormat format = VK_FORMAT_UNDEFINED;
+                VkExtent2D extent = {};
+            };
+
+            VkDevice m_device;
+            VkQueue m_queue;
+            VkMemoryPropertyFlags m_memoryProperties;
+            std::vector<Slot> m_slots;
+
+            // Slot states change on the render thread and on the threads releasing them.
+            std::mutex m_mutex;
+            std::condition_variable m_released;
+    };
+}
+#endif // READBACKRING_H
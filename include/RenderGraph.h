@@ -0,0 +1,306 @@
+#ifndef RENDERGRAPH_H
+#define RENDERGRAPH_H
+
+#include "Common.h"
+
+#include <vulkan/vulkan.h>
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace KMDM
+{
+    /**
+     * @brief How a pass uses an image or buffer.  Each access implies the pipeline stages, access
+     * mask and image layout of the barriers around it.
+     *
+     */
+    enum class RenderAccess
+    {
+        ColorAttachment,
+        DepthAttachment,
+        DepthRead,
+        Sampled,
+        StorageRead,
+        StorageWrite,
+        TransferSrc,
+        TransferDst,
+        Present,
+        VertexBuffer,
+        IndexBuffer,
+        UniformBuffer,
+        IndirectBuffer
+    };
+
+    /**
+     * @brief A single mip, single layer 2D image.
+     *
+     */
+    struct RenderImageDesc
+    {
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        VkExtent2D extent = {};
+        VkImageUsageFlags usage = 0;
+        VkImageAspectFlags aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+    };
+
+    struct RenderBufferDesc
+    {
+        VkDeviceSize size = 0;
+        VkBufferUsageFlags usage = 0;
+    };
+
+    /**
+     * @brief Handle of a graph resource, valid until the next reset().
+     *
+     */
+    typedef uint32_t RenderResource;
+
+    /**
+     * @brief Render graph counters of the last compile.
+     *
+     */
+    struct RenderGraphStats
+    {
+        uint32_t passes = 0;
+        uint32_t culledPasses = 0;
+        uint32_t barriers = 0;
+        uint32_t imageBarriers = 0;
+        uint32_t bufferBarriers = 0;
+        uint32_t transientImages = 0;
+        uint32_t memoryBlocks = 0;
+        VkDeviceSize transientBytes = 0;
+        VkDeviceSize unaliasedBytes = 0;
+    };
+
+    /**
+     * @brief A frame described as passes that read and write named images and buffers.  compile()
+     * drops passes whose results are never used, works out the barriers and layout transitions
+     * between the passes that are left, batched into one vkCmdPipelineBarrier per pass, and places
+     * transient images whose lifetimes do not overlap in the same device memory.
+     *
+     * The graph is rebuilt every frame: reset(), declare resources and passes, compile(), execute().
+     * Transient images are kept between frames for as long as the graph keeps the same shape.
+     *
+     * A pass that keeps what is already in a resource, like an attachment loaded rather than
+     * cleared, has to read it as well as write it, or the passes that wrote it before may be culled.
+     *
+     */
+    class RenderGraph
+    {
+        public:
+            typedef std::function<void(VkCommandBuffer, RenderGraph&)> PassCallback;
+
+            /**
+             * @brief Declares the resources of a pass.
+             *
+             */
+            class PassBuilder
+            {
+                public:
+                    PassBuilder(RenderGraph* graph, uint32_t pass);
+
+                    PassBuilder& read(RenderResource resource, RenderAccess access);
+                    PassBuilder& write(RenderResource resource, RenderAccess access);
+
+                    /**
+                     * @brief Never cull the pass, for passes whose work is seen outside the graph.
+                     *
+                     */
+                    PassBuilder& sideEffect();
+
+                private:
+                    RenderGraph* m_graph;
+                    uint32_t m_pass;
+            };
+
+            RenderGraph();
+            virtual ~RenderGraph();
+
+            /**
+             * @brief Wait for the device and destroy the transient resources.
+             *
+             */
+            void destroyRenderGraph();
+
+            /**
+             * @brief Forget the passes and resources of the last frame.  Transient memory is kept.
+             *
+             */
+            void reset();
+
+            /**
+             * @brief Declare an image that only lives for the frame and is owned by the graph.
+             *
+             * @param name
+             * @param desc
+             * @return RenderResource
+             */
+            RenderResource createImage(const std::string& name, const RenderImageDesc& desc);
+            RenderResource createBuffer(const std::string& name, const RenderBufferDesc& desc);
+
+            /**
+             * @brief Use an image owned by someone else.  Passes that write it are never culled.
+             *
+             * @param name
+             * @param image
+             * @param view
+             * @param desc
+             * @param initial_layout Layout the image is in when the graph starts.
+             * @param final_layout Layout the graph leaves the image in.
+             * @param initial_stages Stages the first use has to wait for, like the stage the swap chain
+             * acquire semaphore is waited at.
+             * @return RenderResource
+             */
+            RenderResource importImage(const std::string& name, VkImage image, VkImageView view,
+                const RenderImageDesc& desc, VkImageLayout initial_layout, VkImageLayout final_layout,
+                VkPipelineStageFlags initial_stages = 0);
+            RenderResource importBuffer(const std::string& name, VkBuffer buffer, VkDeviceSize size,
+                VkPipelineStageFlags initial_stages = 0);
+
+            /**
+             * @brief Add a pass.  The callback records it when the graph is executed.
+             *
+             * @param name
+             * @param callback
+             * @return PassBuilder
+             */
+            PassBuilder addPass(const std::string& name, PassCallback callback);
+
+            /**
+             * @brief Cull passes, allocate transient resources and work out the barriers.
+             *
+             */
+            void compile();
+
+            /**
+             * @brief Record the compiled passes and their barriers.
+             *
+             * @param command_buffer
+             */
+            void execute(VkCommandBuffer command_buffer);
+
+            VkImage getImage(RenderResource resource);
+            VkImageView getImageView(RenderResource resource);
+            VkBuffer getBuffer(RenderResource resource);
+            RenderImageDesc getImageDesc(RenderResource resource);
+            bool isPassCulled(const std::string& name);
+            RenderGraphStats getStats();
+
+        protected:
+            struct ResourceUse
+            {
+                RenderResource resource;
+                RenderAccess access;
+                bool read;
+                bool write;
+            };
+
+            struct Pass
+            {
+                std::string name;
+                PassCallback callback;
+                std::vector<ResourceUse> uses;
+                bool sideEffect = false;
+                bool culled = false;
+
+                // Barriers recorded before the pass.
+                VkPipelineStageFlags srcStages = 0;
+                VkPipelineStageFlags dstStages = 0;
+                std::vector<VkImageMemoryBarrier> imageBarriers;
+                std::vector<VkBufferMemoryBarrier> bufferBarriers;
+            };
+
+            struct Resource
+            {
+                std::string name;
+                bool isImage = true;
+                bool imported = false;
+                RenderImageDesc imageDesc;
+                RenderBufferDesc bufferDesc;
+                VkImageLayout initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+                VkPipelineStageFlags initialStages = 0;
+
+                VkImage image = VK_NULL_HANDLE;
+                VkImageView view = VK_NULL_HANDLE;
+                VkBuffer buffer = VK_NULL_HANDLE;
+
+                // Filled in by compile().
+                int32_t firstPass = -1;
+                int32_t lastPass = -1;
+                VkPipelineStageFlags useStages = 0;
+                VkAccessFlags writeAccess = 0;
+                int32_t aliasOf = -1;
+            };
+
+            // Synchronization state of a resource while the barriers are worked out.
+            struct ResourceState
+            {
+                VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+                VkPipelineStageFlags writeStages = 0;
+                VkAccessFlags writeAccess = 0;
+                VkPipelineStageFlags readStages = 0;
+                VkAccessFlags readAccess = 0;
+            };
+
+            // A transient image or buffer and the memory it is bound to.
+            struct PhysicalImage
+            {
+                VkImage image = VK_NULL_HANDLE;
+                VkImageView view = VK_NULL_HANDLE;
+                VkMemoryRequirements requirements = {};
+                uint32_t block = 0;
+            };
+
+            struct PhysicalBuffer
+            {
+                VkBuffer buffer = VK_NULL_HANDLE;
+                VkDeviceMemory memory = VK_NULL_HANDLE;
+            };
+
+            struct MemoryBlock
+            {
+                VkDeviceMemory memory = VK_NULL_HANDLE;
+                VkDeviceSize size = 0;
+                uint32_t memoryType = 0;
+                std::vector<uint32_t> images;
+            };
+
+            RenderResource addResource(const Resource& resource);
+            void addUse(uint32_t pass, RenderResource resource, RenderAccess access, bool write);
+            void cullPasses();
+            void computeLifetimes();
+            void allocateTransients();
+            void retireTransients();
+            void destroyTransients();
+            static void destroyPhysical(const std::vector<PhysicalImage>& images,
+                const std::vector<MemoryBlock>& blocks, const std::vector<PhysicalBuffer>& buffers);
+            void computeBarriers();
+            void addBarrier(Pass& pass, RenderResource resource, ResourceState& state, VkPipelineStageFlags stages,
+                VkAccessFlags read_access, VkAccessFlags write_access, VkImageLayout layout);
+            size_t getTransientSignature();
+
+        private:
+            std::vector<Resource> m_resources;
+            std::vector<Pass> m_passes;
+            bool m_compiled = false;
+
+            // Barriers recorded after the last pass, for imported images with a final layout.
+            VkPipelineStageFlags m_finalSrcStages = 0;
+            VkPipelineStageFlags m_finalDstStages = 0;
+            std::vector<VkImageMemoryBarrier> m_finalBarriers;
+
+            // Transient resources, in the order they are declared, and the memory of the images.
+            bool m_allocated = false;
+            size_t m_signature = 0;
+            std::vector<PhysicalImage> m_images;
+            std::vector<PhysicalBuffer> m_buffers;
+            std::vector<MemoryBlock> m_blocks;
+
+            RenderGraphStats m_stats;
+    };
+}
+#endif // RENDERGRAPH_H
@@ -0,0 +1,122 @@
+#ifndef RENDERTARGETPOOL_H
+#define RENDERTARGETPOOL_H
+
+#include "Common.h"
+#include "RenderGraph.h"
+
+#include <vulkan/vulkan.h>
+
+#include <deque>
+#include <functional>
+#include <vector>
+#include <cstdint>
+
+namespace KMDM
+{
+    /**
+     * @brief A device local image with its memory and a view of every mip level.
+     *
+     */
+    struct RenderTarget
+    {
+        VkImage image = VK_NULL_HANDLE;
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkImageView view = VK_NULL_HANDLE;
+        RenderImageDesc desc;
+    };
+
+    /**
+     * @brief Render target pool counters.
+     *
+     */
+    struct RenderTargetPoolStats
+    {
+        uint32_t liveTargets = 0;
+        uint32_t freeTargets = 0;
+        uint64_t requests = 0;
+        uint64_t hits = 0;
+        uint32_t pendingRetirements = 0;
+    };
+
+    /**
+     * @brief Size dependent attachments, and deferred destruction of objects the frames in flight may
+     * still use.  Released targets are handed out again for the same description once no frame in
+     * flight can still use them, so resizing back and forth does not allocate, and the ones left
+     * unused for RENDER_TARGET_IDLE_FRAMES are destroyed.  Nothing here waits for the device.
+     *
+     */
+    class RenderTargetPool
+    {
+        public:
+            /**
+             * @brief Get the Instance object
+             *
+             * @return RenderTargetPool*
+             */
+            static RenderTargetPool* getInstance();
+            virtual ~RenderTargetPool();
+
+            /**
+             * @brief Destroy every target and run every retirement.  The device has to be idle.
+             *
+             */
+            void destroyRenderTargetPool();
+
+            /**
+             * @brief Get a target for a description, reusing a released one when it can.
+             *
+             * @param desc
+             * @return RenderTarget
+             */
+            RenderTarget acquire(const RenderImageDesc& desc);
+
+            /**
+             * @brief Return a target to the pool.  It is not handed out again while a frame in flight
+             * may still use it.
+             *
+             * @param target
+             */
+            void release(const RenderTarget& target);
+
+            /**
+             * @brief Run a destruction once the frames in flight at the time of the call are done.
+             *
+             * @param destroy
+             */
+            void retire(std::function<void()> destroy);
+
+            /**
+             * @brief Run the retirements and trim the free targets.  Call once per frame.
+             *
+             */
+            void update();
+
+            RenderTargetPoolStats getStats();
+
+        protected:
+            static bool isSameDesc(const RenderImageDesc& a, const RenderImageDesc& b);
+            void destroyTarget(const RenderTarget& target);
+
+            struct FreeTarget
+            {
+                RenderTarget target;
+                uint64_t frame;
+            };
+
+            struct Retirement
+            {
+                std::function<void()> destroy;
+                uint64_t frame;
+            };
+
+        private:
+            RenderTargetPool();
+            static RenderTargetPool* m_renderTargetPool;
+
+            std::vector<FreeTarget> m_free;
+            std::deque<Retirement> m_retired;
+            uint64_t m_frame;
+            RenderTargetPoolStats m_stats;
+    };
+}
+#endif // RENDERTARGETPOOL_H
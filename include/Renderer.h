@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <array>
+#include <functional>
 
 #include "Window.h"
 #include "Surface.h"
@@ -16,9 +17,29 @@
 #include "Pipeline.h"
 #include "Allocator.h"
 #include "DescriptorSet.h"
+#include "RenderGraph.h"
+#include "RenderTargetPool.h"
+#include "ClusteredLighting.h"
+#include "VisibilityBuffer.h"
+#include "DynamicResolution.h"
+#include "FramePacer.h"
+#include "ReadbackRing.h"
 
 namespace KMDM
 {
+    class FrameCapture;
+
+    /**
+     * @brief How the scene is shaded.  Forward shades every fragment that passes the depth test,
+     * VisibilityBuffer shades every pixel once from the triangle ids of a visibility pass.
+     *
+     */
+    enum class RenderPath
+    {
+        Forward,
+        VisibilityBuffer
+    };
+
     class Renderer
     {
         public:
@@ -28,23 +49,109 @@ namespace KMDM
 
             void drawFrame();
             void run();
+
+            /**
+             * @brief Stream in models, record and submit one frame.  run() calls it until the window
+             * is closed.
+             *
+             */
+            void renderFrame();
+
+            /**
+             * @brief Turn the depth pre-pass on or off from the next frame.
+             * 
+             * @param enabled 
+             */
+            void setDepthPrepass(bool enabled);
+
+            /**
+             * @brief Switch between forward and visibility buffer shading from the next frame.
+             *
+             * @param path
+             */
+            void setRenderPath(RenderPath path);
+
+            /**
+             * @brief Turn dynamic resolution on or off from the next frame.  It applies to forward
+             * shading, and replaces the depth pre-pass while on.
+             *
+             * @param enabled
+             */
+            void setDynamicResolution(bool enabled);
+            DynamicResolution* getDynamicResolution();
+
+            /**
+             * @brief Switch the present mode, the swapchain is recreated after the next frame.  IMMEDIATE
+             * and MAILBOX give the lowest latency, FIFO_RELAXED tears only when a frame is late.  The
+             * swapchain may come back with a different number of images, the per image resources are
+             * reallocated to match.
+             *
+             * @param mode
+             */
+            void setPresentMode(VkPresentModeKHR mode);
+
+            /**
+             * @brief Limit the frame rate, 0 to only pace the FIFO modes to the display.
+             *
+             * @param frames_per_second
+             */
+            void setFrameRateLimit(float frames_per_second);
+
+            /**
+             * @brief Set the function that reads the view matrix from input.  It is called just before
+             * the frame is submitted, after pumping window events, so the frame shows the latest input.
+             *
+             * @param latch
+             */
+            void setCameraLatch(std::function<glm::mat4()> latch);
+            FramePacer* getFramePacer();
+
+            /**
+             * @brief Copy the next frame into a readback ring once it is drawn.  Frames are skipped,
+             * and the request kept, until the ring has a free slot.  The swapchain has to be
+             * readable, see SwapChain::isReadable().
+             *
+             * @param ring The ring, or nullptr to cancel the request.
+             * @param tag Returned with the image by ReadbackRing::takeCompleted().
+             */
+            void captureNextFrame(ReadbackRing* ring, uint64_t tag);
+
+            /**
+             * @brief Draw headless frames at another size from the next frame.
+             *
+             * @param width
+             * @param height
+             */
+            void resizeHeadless(uint32_t width, uint32_t height);
+
+            /**
+             * @brief The frame recorder, created on first use.  F12 starts and stops recording in run().
+             *
+             * @return FrameCapture*
+             */
+            FrameCapture* getFrameCapture();
             
         protected:
             void createFrameBuffers();
             void createSyncObjects();
             void createCommandBuffers();
             void recreateSwapChain();
+            void resizeImageResources();
             void createDepthResources();
             void createCameraBuffers();
             void createUniformBuffers();
             void createGPUSceneBuffers();
+            void createDepthPrepass();
+            void createDepthFramebuffer();
 
             void updateUniformBuffer(uint32_t currentImage);
+            void cycleCounterLevel();
 
             void cleanupDepthResources();
             void cleanupSyncObjects();
             void cleanupCameraBuffers();
             void cleanupGPUSceneBuffers();
+            void cleanupDepthPrepass();
 
 
         private:
@@ -67,6 +174,12 @@ namespace KMDM
             // Renderpass
             Renderpass* m_renderPass;
 
+            // Frame graph, rebuilt for every command buffer.
+            RenderGraph* m_renderGraph;
+
+            // Dynamic lights, culled into clusters every frame.
+            ClusteredLighting* m_lighting;
+
             // Framebuffers
             std::vector<VkFramebuffer> m_framebuffers;
             size_t m_numFramebuffers;
@@ -83,10 +196,44 @@ namespace KMDM
             // Graphics pipeline.
             Pipeline* m_graphicsPipeline;
 
-            // Depth resources.
-            VkImageView m_depthImageView;
-            VkImage m_depthImage;
-            VkDeviceMemory m_depthMemory;
+            // Depth resources, from the render target pool.
+            RenderTarget m_depthTarget;
+
+            // Depth pre-pass, and the main pass that tests against its depth.
+            bool m_depthPrepass;
+            Renderpass* m_depthPrepassRenderPass;
+            Renderpass* m_depthTestedRenderPass;
+            VkFramebuffer m_depthFramebuffer;
+            PipelineDesc m_depthPrepassDesc;
+            PipelineDesc m_depthTestedDesc;
+            VkPipeline m_depthPrepassPipeline;
+            VkPipeline m_depthTestedPipeline;
+
+            // Visibility buffer path, kept even when it is off like the pre-pass.
+            RenderPath m_renderPath;
+            VisibilityBuffer* m_visibilityBuffer;
+
+            // Dynamic resolution, and whether the frame being drawn uses it.
+            bool m_dynamicResolutionEnabled;
+            bool m_upscaledFrame;
+            DynamicResolution* m_dynamicResolution;
+            PipelineDesc m_upscaledDesc;
+            VkPipeline m_upscaledPipeline;
+
+            // Frame pacing, and the camera read just before submit.
+            FramePacer* m_framePacer;
+            std::function<glm::mat4()> m_cameraLatch;
+
+            // Readback ring the next frame is copied into, if a capture was asked for.
+            ReadbackRing* m_captureRing;
+            uint64_t m_captureTag;
+
+            // Records the presented frames to disk, fed every frame while it exists.
+            FrameCapture* m_frameCapture;
+
+            // Last frame's transform, for motion vectors.
+            glm::mat4 m_previousModelViewProj;
+            bool m_hasPreviousFrame;
 
             // Camera buffer.
             // CameraData m_cameraData;
@@ -96,8 +243,9 @@ namespace KMDM
             // Descriptor set vector.
             std::vector<VkDescriptorSet> m_descriptorSets;
 
-            // The current frame.
+            // The current frame, and the offscreen image the next headless frame draws to.
             size_t m_currentFrame;
+            uint32_t m_headlessImage;
 
             // Uniform Buffers.
             std::vector<VkBuffer> m_uniformBuffers;
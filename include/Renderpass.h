@@ -6,10 +6,28 @@
 
 namespace KMDM
 {
+    /**
+     * @brief Attachments and load operations of a render pass.
+     *
+     */
+    enum class RenderpassType
+    {
+        // Color and depth, both cleared.
+        Forward,
+        // Depth only, cleared and stored for the passes after it.
+        DepthPrepass,
+        // Color cleared, depth loaded from a pre-pass and only tested.
+        ForwardDepthTested,
+        // 32 bit triangle ids and depth, both cleared.  Color is VISIBILITY_FORMAT.
+        Visibility,
+        // Scene color and motion vectors for the temporal upscaler, then depth, all cleared.
+        Upscaled
+    };
+
     class Renderpass
     {
         public:
-            Renderpass();
+            Renderpass(RenderpassType type = RenderpassType::Forward);
             virtual ~Renderpass();
             VkRenderPass getRenderPass();
             VkFormat findDepthFormat();
@@ -0,0 +1,76 @@
+#ifndef SAMPLERCACHE_H
+#define SAMPLERCACHE_H
+
+#include <vulkan/vulkan.h>
+
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+
+namespace KMDM
+{
+    /**
+     * @brief Sampler cache counters.
+     *
+     */
+    struct SamplerCacheStats
+    {
+        uint32_t uniqueSamplers = 0;
+        uint64_t requests = 0;
+        uint64_t hits = 0;
+    };
+
+    /**
+     * @brief Hands out one shared VkSampler per distinct VkSamplerCreateInfo, so the number of
+     * sampler objects stays far below maxSamplerAllocationCount however many textures there are.
+     * Samplers live until the cache is destroyed and must not be destroyed by their users.
+     *
+     */
+    class SamplerCache
+    {
+        public:
+            /**
+             * @brief Get the Instance object
+             *
+             * @return SamplerCache*
+             */
+            static SamplerCache* getInstance();
+            virtual ~SamplerCache();
+
+            /**
+             * @brief Destroy every cached sampler.
+             *
+             */
+            void destroySamplerCache();
+
+            /**
+             * @brief Get the sampler for a create info, creating it on first use.  Extension
+             * structures in pNext are not supported.
+             *
+             * @param info
+             * @return VkSampler
+             */
+            VkSampler getSampler(const VkSamplerCreateInfo& info);
+
+            SamplerCacheStats getStats();
+
+        protected:
+            static size_t hashSamplerInfo(const VkSamplerCreateInfo& info);
+            static bool isSameSampler(const VkSamplerCreateInfo& a, const VkSamplerCreateInfo& b);
+
+            struct CachedSampler
+            {
+                VkSamplerCreateInfo info;
+                VkSampler sampler;
+            };
+
+        private:
+            SamplerCache();
+            static SamplerCache* m_samplerCache;
+
+            // Samplers by create info hash, colliding infos share a bucket.
+            std::unordered_map<size_t, std::vector<CachedSampler>> m_samplers;
+            SamplerCacheStats m_stats;
+    };
+}
+#endif // SAMPLERCACHE_H
@@ -1,15 +1,30 @@
 #ifndef SCENE_H
 #define SCENE_H
 #include "Model.h"
+#include "AssetStreamer.h"
 
 #include <unordered_map>
 #include <vector>
 #include <string>
+#include <optional>
+#include <future>
+#include <utility>
 #include <vulkan/vulkan.h>
 
 
 namespace KMDM
 {
+    /**
+     * @brief Handle to a model that is loading in the background.  The future becomes ready
+     * once the model has been uploaded and swapped in for its placeholder.
+     * 
+     */
+    struct ModelHandle
+    {
+        uint32_t id;
+        std::shared_future<void> ready;
+    };
+
     class Scene
     {
         public:
@@ -19,8 +34,58 @@ namespace KMDM
             void destoryScene();
             void addMesh(Model model);
 
+            /**
+             * @brief Destroy every mesh added with addMesh(), to load another scene.  The device
+             * has to be idle.
+             * 
+             */
+            void clearMeshes();
+
+            /**
+             * @brief Load a model on the streaming threads.  Until it is ready the placeholder
+             * model is drawn in its place.
+             * 
+             * @param model_path 
+             * @param texture_path 
+             * @return ModelHandle 
+             */
+            ModelHandle addModelAsync(std::string model_path, std::string texture_path);
+
+            /**
+             * @brief Upload the models that finished decoding and swap in the ones whose uploads
+             * have completed.  Call this at a frame boundary, before the command buffers are recorded.
+             * 
+             */
+            void processStreamedModels();
+
             std::vector<Model> getMeshes();
 
+            /**
+             * @brief Request the texture mip level each model needs from its projected size on screen.
+             * 
+             * @param model_view Model to view space transform.
+             * @param projection_scale Vertical scale of the projection, proj[1][1].
+             * @param viewport_height Height of the viewport in pixels.
+             */
+            void requestTextureMips(const glm::mat4& model_view, float projection_scale, float viewport_height);
+
+            /**
+             * @brief Add a dynamic light.  Lights are culled into the cluster grid every frame.
+             * 
+             * @param light 
+             */
+            void addLight(const Light& light);
+            void clearLights();
+            const std::vector<Light>& getLights();
+
+            /**
+             * @brief Set the light every surface gets regardless of the dynamic lights.
+             * 
+             * @param color 
+             */
+            void setAmbientLight(glm::vec3 color);
+            glm::vec3 getAmbientLight();
+
         protected:
 
 
@@ -30,6 +95,14 @@ namespace KMDM
             std::vector<Model> m_meshes;
             // std::unordered_map<std::string, Mesh> m_meshes;
             GPUSceneData m_sceneData;
+            std::vector<Light> m_lights;
+
+            // Background loading.
+            AssetStreamer* m_streamer;
+            std::optional<Model> m_placeholder;
+            std::unordered_map<uint32_t, std::promise<void>> m_pendingModels;
+            std::vector<std::pair<uint32_t, Model>> m_uploadingModels;
+            uint32_t m_nextModelId = 0;
     };
 }
 #endif // SCENE_H
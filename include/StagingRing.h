@@ -0,0 +1,82 @@
+#ifndef STAGINGRING_H
+#define STAGINGRING_H
+
+#include "Common.h"
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+
+namespace KMDM
+{
+    /**
+     * @brief A persistently mapped, host visible staging buffer that uploads sub-allocate from
+     * in FIFO order.  Space is handed back with release() once the submission that read it has
+     * retired, so uploads never allocate or map memory of their own.
+     *
+     */
+    class StagingRing
+    {
+        public:
+            /**
+             * @brief Construct a new Staging Ring object
+             *
+             * @param size Capacity in bytes.
+             */
+            StagingRing(VkDeviceSize size = STAGING_RING_SIZE);
+            virtual ~StagingRing();
+
+            /**
+             * @brief Unmap and free the ring memory.
+             *
+             */
+            void destroyStagingRing();
+
+            /**
+             * @brief Sub-allocate a contiguous range.
+             *
+             * @param size
+             * @param alignment Must be a power of two.
+             * @param offset Offset of the range in the ring buffer.
+             * @return true
+             * @return false The ring does not currently have enough contiguous free space.
+             */
+            bool allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+
+            /**
+             * @brief Position of the next allocation.  Passing it to release() later frees everything
+             * that was allocated before this call.
+             *
+             * @return uint64_t
+             */
+            uint64_t getHead();
+
+            /**
+             * @brief Free every allocation made before the ring was at position.
+             *
+             * @param position A value returned by getHead().
+             */
+            void release(uint64_t position);
+
+            /**
+             * @brief Host pointer to an offset returned by allocate().
+             *
+             * @param offset
+             * @return void*
+             */
+            void* getMappedPointer(VkDeviceSize offset);
+
+            VkBuffer getBuffer();
+            VkDeviceSize getSize();
+
+        private:
+            VkBuffer m_buffer = VK_NULL_HANDLE;
+            VkDeviceMemory m_memory = VK_NULL_HANDLE;
+            unsigned char* m_mapped = nullptr;
+            VkDeviceSize m_size;
+
+            // Running totals of allocated and released bytes, the ring offset is total % m_size.
+            uint64_t m_head = 0;
+            uint64_t m_tail = 0;
+    };
+}
+#endif // STAGINGRING_H
@@ -24,7 +24,51 @@ namespace KMDM
 
             VkExtent2D getSwapChainExtent();
 
+            /**
+             * @brief Recreate the swapchain for the current surface size, passing the old one as
+             * oldSwapchain.  Pipelines do not depend on it, they use dynamic viewport and scissor.
+             *
+             * @return true The swapchain was recreated.
+             * @return false The surface has no size, the window is minimized.  Headless, the size
+             * has not changed.
+             */
+            bool recreateSwapChain();
+
+            /**
+             * @brief Set the present mode to use from the next recreateSwapChain(), FIFO when the
+             * surface does not support it.
+             *
+             * @param mode
+             */
+            void setPresentMode(VkPresentModeKHR mode);
+
+            /**
+             * @brief Get the present mode of the current swapchain.
+             *
+             * @return VkPresentModeKHR
+             */
+            VkPresentModeKHR getPresentMode();
+
+            /**
+             * @brief Get the layout frames leave the swapchain images in.  Headless images have no
+             * presentation engine, they are left ready to be copied from.
+             *
+             * @return VkImageLayout
+             */
+            VkImageLayout getPresentLayout();
+
+            /**
+             * @brief Whether the images can be copied from, to read frames back.
+             *
+             * @return true
+             * @return false
+             */
+            bool isReadable();
+
         protected:
+            void createSwapChain(VkSwapchainKHR old_swapchain);
+            void createOffscreenImages();
+            bool recreateOffscreenImages();
             SwapChainSupportDetails querySwapChainSupport();
             VkSurfaceFormatKHR chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& available_formats);
             VkPresentModeKHR chooseSwapPresentationMode(const std::vector<VkPresentModeKHR>& available_modes);
@@ -42,9 +86,13 @@ namespace KMDM
             VkFormat m_swapChainImageFormat;
             std::vector<VkImageView> m_swapChainImageViews;
             std::vector<VkImage> m_swapChainImages;
+            std::vector<VkDeviceMemory> m_offscreenMemory;
             std::vector<VkFramebuffer> m_swapChainFramebuffers;
             VkExtent2D m_swapChainExtent;
             SwapChainSupportDetails m_swapChainDetails;
+            VkPresentModeKHR m_preferredPresentMode;
+            VkPresentModeKHR m_presentMode;
+            bool m_readable = false;
 
             PhysicalDevice* m_physicalDevice;
             LogicalDevice* m_logicalDevice;
@@ -0,0 +1,99 @@
+#ifndef TEXTURECOMPRESSION_H
+#define TEXTURECOMPRESSION_H
+
+#include "types.h"
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+
+namespace KMDM
+{
+    /**
+     * @brief Check if a format is one of the BCn block compressed formats.
+     *
+     * @param format
+     * @return true
+     * @return false
+     */
+    bool isBlockCompressed(VkFormat format);
+
+    /**
+     * @brief Check if the texture pipeline can load and upload a format, uncompressed RGBA8 or
+     * one of BC1, BC3, BC5 and BC7.
+     *
+     * @param format
+     * @return true
+     * @return false
+     */
+    bool isTextureFormatHandled(VkFormat format);
+
+    /**
+     * @brief Get the texel block size of a texture format.  Uncompressed formats have 1x1 blocks.
+     * Throws for formats the texture pipeline does not handle.
+     *
+     * @param format
+     * @param block_width
+     * @param block_height
+     * @param block_bytes
+     */
+    void getFormatBlockInfo(VkFormat format, uint32_t& block_width, uint32_t& block_height, uint32_t& block_bytes);
+
+    /**
+     * @brief Size in bytes of one mip level.
+     *
+     * @param format
+     * @param width
+     * @param height
+     * @return size_t
+     */
+    size_t getMipSize(VkFormat format, uint32_t width, uint32_t height);
+
+    /**
+     * @brief Compress every mip level of an RGBA8 texture.
+     *
+     * @param texture Texture in VK_FORMAT_R8G8B8A8_UNORM or VK_FORMAT_R8G8B8A8_SRGB.
+     * @param format BC1, BC3, BC5 or BC7 format to encode to.  BC5 keeps the red and green channels.
+     * @return TextureData
+     */
+    TextureData compressTexture(const TextureData& texture, VkFormat format);
+
+    /**
+     * @brief Check if decompressTexture() can decode a format.
+     *
+     * @param format
+     * @return true
+     * @return false
+     */
+    bool canDecompressTexture(VkFormat format);
+
+    /**
+     * @brief Decode a BC1, BC3 or BC5 texture to RGBA8, for devices that cannot sample the
+     * compressed format.
+     *
+     * @param texture
+     * @return TextureData
+     */
+    TextureData decompressTexture(const TextureData& texture);
+
+    /**
+     * @brief Encode a 4x4 block of RGBA8 texels.  BC1 writes 8 bytes, the others 16.
+     *
+     * @param rgba 16 texels, row major.
+     * @param block
+     */
+    void encodeBC1Block(const unsigned char* rgba, unsigned char* block);
+    void encodeBC3Block(const unsigned char* rgba, unsigned char* block);
+    void encodeBC5Block(const unsigned char* rgba, unsigned char* block);
+    void encodeBC7Block(const unsigned char* rgba, unsigned char* block);
+
+    /**
+     * @brief Decode a block to 16 RGBA8 texels.
+     *
+     * @param block
+     * @param rgba
+     */
+    void decodeBC1Block(const unsigned char* block, unsigned char* rgba);
+    void decodeBC3Block(const unsigned char* block, unsigned char* rgba);
+    void decodeBC5Block(const unsigned char* block, unsigned char* rgba);
+}
+#endif // TEXTURECOMPRESSION_H
@@ -0,0 +1,173 @@
+#ifndef TEXTURERESIDENCY_H
+#define TEXTURERESIDENCY_H
+
+#include "Common.h"
+#include "types.h"
+
+#include <vulkan/vulkan.h>
+
+#include <deque>
+#include <memory>
+#include <unordered_map>
+#include <cstdint>
+
+namespace KMDM
+{
+    /**
+     * @brief Keeps only the mip levels that are needed on screen in device memory.  Every texture
+     * starts with its mip tail resident, finer levels are streamed in through the UploadManager as
+     * they are requested, and least recently used textures are dropped back towards their tail when
+     * the device memory budget is exceeded.  The full mip chains stay in system memory.
+     *
+     * Changing the resident levels swaps the texture's image and view, so descriptors have to be
+     * written from getImageView() every frame.
+     *
+     */
+    class TextureResidency
+    {
+        public:
+            /**
+             * @brief Get the Instance object
+             *
+             * @return TextureResidency*
+             */
+            static TextureResidency* getInstance();
+            virtual ~TextureResidency();
+
+            /**
+             * @brief Wait for the device and destroy every texture image.
+             *
+             */
+            void destroyTextureResidency();
+
+            /**
+             * @brief Take a texture over and queue the upload of its mip tail.  The upload is part of
+             * the next UploadManager::flush().
+             *
+             * @param texture
+             * @return uint32_t Texture id.
+             */
+            uint32_t registerTexture(const TextureData& texture);
+
+            /**
+             * @brief Destroy a texture once the GPU is done with it.
+             *
+             * @param id
+             */
+            void releaseTexture(uint32_t id);
+
+            /**
+             * @brief Ask for a mip level to be resident.  Call every frame the texture is drawn.
+             *
+             * @param id
+             * @param mip Finest level needed, 0 being the full resolution.
+             */
+            void requestMip(uint32_t id, uint32_t mip);
+
+            /**
+             * @brief Finest mip level worth having for a texture that covers a number of pixels on screen.
+             *
+             * @param id
+             * @param projected_pixels Size of the textured surface on screen, in pixels.
+             * @return uint32_t
+             */
+            uint32_t computeRequiredMip(uint32_t id, float projected_pixels);
+
+            /**
+             * @brief Swap in finished streams, start new ones and evict under budget pressure.  Call
+             * once per frame, before descriptors are written.
+             *
+             */
+            void update();
+
+            VkImageView getImageView(uint32_t id);
+            uint32_t getMipLevels(uint32_t id);
+
+            /**
+             * @brief Finest level currently resident.
+             *
+             * @param id
+             * @return uint32_t
+             */
+            uint32_t getResidentMip(uint32_t id);
+
+            void setBudget(VkDeviceSize budget);
+            VkDeviceSize getBudget();
+
+            /**
+             * @brief Device memory held by texture images, including streams in flight.
+             *
+             * @return VkDeviceSize
+             */
+            VkDeviceSize getResidentBytes();
+
+        protected:
+            /**
+             * @brief An image holding the levels [mip, mip count) of a texture.
+             *
+             */
+            struct ResidentImage
+            {
+                VkImage image = VK_NULL_HANDLE;
+                VkDeviceMemory memory = VK_NULL_HANDLE;
+                VkImageView view = VK_NULL_HANDLE;
+                VkDeviceSize bytes = 0;
+                uint32_t mip = 0;
+                uint64_t ticket = 0;
+            };
+
+            struct Texture
+            {
+                std::shared_ptr<const TextureData> data;
+                ResidentImage resident;
+
+                // Replacement image while its upload is in flight.
+                ResidentImage incoming;
+                bool streaming = false;
+
+                // Coarsest level that is always resident.
+                uint32_t tailMip = 0;
+
+                // Finest level asked for since the last update().
+                uint32_t requestedMip = 0;
+                uint64_t lastUsedFrame = 0;
+
+                // Allocation size of an image starting at each level, 0 until asked for.
+                std::vector<VkDeviceSize> imageBytes;
+            };
+
+            struct RetiredImage
+            {
+                ResidentImage image;
+                uint64_t frame;
+            };
+
+            ResidentImage createResidentImage(const TextureData& data, uint32_t mip);
+            VkDeviceSize getImageBytes(Texture& texture, uint32_t mip);
+            void startStream(Texture& texture, uint32_t mip);
+            void retireImage(const ResidentImage& image);
+            void destroyImage(const ResidentImage& image);
+            bool evictLeastRecentlyUsed(uint32_t keep_id);
+
+        private:
+            TextureResidency();
+            static TextureResidency* m_textureResidency;
+
+            std::unordered_map<uint32_t, Texture> m_textures;
+            uint32_t m_nextId = 0;
+
+            // Images that may still be read by frames in flight.
+            std::deque<RetiredImage> m_retired;
+
+            VkDeviceSize m_budget = TEXTURE_MEMORY_BUDGET;
+
+            // Bytes held by every texture once the streams in flight complete.
+            VkDeviceSize m_committedBytes = 0;
+
+            // Bytes actually allocated right now.
+            VkDeviceSize m_residentBytes = 0;
+
+            uint64_t m_frame = 1;
+    };
+}
+#endif // TEXTURERESIDENCY_H
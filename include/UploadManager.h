@@ -0,0 +1,220 @@
+#ifndef UPLOADMANAGER_H
+#define UPLOADMANAGER_H
+
+#include "StagingRing.h"
+#include "types.h"
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <deque>
+#include <cstdint>
+
+namespace KMDM
+{
+    /**
+     * @brief Batches buffer and image uploads.  Uploads are copied into a persistent staging ring
+     * as they are requested and recorded into one command buffer per flush, which is submitted on
+     * a dedicated transfer queue when the device has one.  Ownership of the uploaded resources is
+     * then handed to the graphics queue once the copies have finished, so the graphics queue never
+     * waits on the transfer queue.  Completion is tracked with timeline semaphores instead of
+     * idling a queue.
+     *
+     */
+    class UploadManager
+    {
+        public:
+            /**
+             * @brief Get the Instance object
+             *
+             * @return UploadManager*
+             */
+            static UploadManager* getInstance();
+            virtual ~UploadManager();
+
+            /**
+             * @brief Wait for the outstanding uploads and destroy the upload resources.
+             *
+             */
+            void destroyUploadManager();
+
+            /**
+             * @brief Queue a copy of host data into a device local buffer.
+             *
+             * @param dst Destination buffer, created with VK_BUFFER_USAGE_TRANSFER_DST_BIT.
+             * @param data
+             * @param size
+             * @param dst_access How the buffer is read once the upload completes.
+             * @param dst_stage Stage that first reads the buffer.
+             */
+            void uploadBuffer(VkBuffer dst, const void* data, VkDeviceSize size,
+                VkAccessFlags dst_access, VkPipelineStageFlags dst_stage);
+
+            /**
+             * @brief Queue a copy of every mip level of a texture into an image, all recorded as one
+             * multi-region copy.  The image ends up in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL.
+             *
+             * @param image Destination image in VK_IMAGE_LAYOUT_UNDEFINED, with one level per uploaded mip.
+             * @param texture
+             * @param base_mip First texture mip to upload, it goes to level 0 of the image.
+             */
+            void uploadImage(VkImage image, const TextureData& texture, uint32_t base_mip = 0);
+
+            /**
+             * @brief Submit everything queued since the last flush.
+             *
+             * @return uint64_t Ticket that can be passed to isComplete() and wait().
+             */
+            uint64_t flush();
+
+            /**
+             * @brief Hand finished transfers over to the graphics queue and release the staging memory
+             * of batches that have retired.  Call once per frame.
+             *
+             */
+            void update();
+
+            /**
+             * @brief Check if the uploads of a flush are usable on the graphics queue.
+             *
+             * @param ticket
+             * @return true
+             * @return false
+             */
+            bool isComplete(uint64_t ticket);
+
+            /**
+             * @brief Block until the uploads of a flush are usable on the graphics queue.
+             *
+             * @param ticket
+             */
+            void wait(uint64_t ticket);
+
+            /**
+             * @brief Submit the graphics queue part of every flush up to a ticket now, even if its
+             * copies are still running.  The graphics queue then waits for the copies instead of
+             * the CPU, so a frame can wait for the ticket on getGraphicsTimeline().
+             *
+             * @param ticket
+             */
+            void submitToGraphics(uint64_t ticket);
+
+            /**
+             * @brief Timeline semaphore that reaches a ticket once its uploads are usable on the
+             * graphics queue.
+             *
+             * @return VkSemaphore
+             */
+            VkSemaphore getGraphicsTimeline();
+
+            /**
+             * @brief True if uploads run on a queue family other than the graphics family.
+             *
+             * @return true
+             * @return false
+             */
+            bool hasDedicatedTransferQueue();
+
+        protected:
+            /**
+             * @brief A copy into a buffer.  Uploads that do not fit in the staging ring are split
+             * into several of these, only the last one hands the buffer to its consumers.
+             *
+             */
+            struct BufferUpload
+            {
+                VkBuffer dst;
+                VkDeviceSize dstOffset;
+                VkDeviceSize stagingOffset;
+                VkDeviceSize size;
+                VkAccessFlags dstAccess;
+                VkPipelineStageFlags dstStage;
+                bool last;
+            };
+
+            /**
+             * @brief Copies into an image.  Large images are split by rows, the first part moves
+             * the image into TRANSFER_DST and the last part finishes it.
+             *
+             */
+            struct ImageUpload
+            {
+                VkImage image;
+                uint32_t mipLevels;
+                std::vector<VkBufferImageCopy> regions;
+                bool first;
+                bool last;
+            };
+
+            /**
+             * @brief One flush worth of uploads.
+             *
+             */
+            struct Batch
+            {
+                VkCommandBuffer transferCommands = VK_NULL_HANDLE;
+                VkCommandBuffer graphicsCommands = VK_NULL_HANDLE;
+
+                // Transfer timeline value signalled when the copies are done.
+                uint64_t transferValue = 0;
+
+                // Graphics timeline value signalled when the resources are ready to use.
+                uint64_t graphicsValue = 0;
+                bool graphicsSubmitted = false;
+
+                // Staging ring position after the batch's allocations.
+                uint64_t stagingEnd = 0;
+            };
+
+            /**
+             * @brief Allocate staging space, flushing and waiting on older batches until the
+             * ring has room.
+             *
+             * @param size
+             * @return VkDeviceSize Offset in the staging ring.
+             */
+            VkDeviceSize allocateStaging(VkDeviceSize size);
+
+            VkCommandBuffer beginCommandBuffer(VkCommandPool pool);
+            VkSemaphore createTimelineSemaphore();
+            uint64_t getTimelineValue(VkSemaphore semaphore);
+            void waitTimelineValue(VkSemaphore semaphore, uint64_t value);
+
+            void recordTransfer(Batch& batch);
+            void recordAcquire(Batch& batch);
+            void submitGraphics(Batch& batch);
+            void advanceOldest();
+            void retireBatch(Batch& batch);
+
+        private:
+            UploadManager();
+            static UploadManager* m_uploadManager;
+
+            bool m_dedicatedTransfer;
+            uint32_t m_graphicsFamily;
+            uint32_t m_transferFamily;
+            VkQueue m_graphicsQueue;
+            VkQueue m_transferQueue;
+            VkCommandPool m_graphicsPool;
+            VkCommandPool m_transferPool;
+
+            StagingRing* m_stagingRing;
+
+            // Rows of an image copy must be a multiple of this on the transfer queue, 0 if
+            // only whole images can be copied.
+            uint32_t m_copyRowGranularity;
+
+            VkSemaphore m_transferTimeline;
+            VkSemaphore m_graphicsTimeline;
+            uint64_t m_transferValue = 0;
+            uint64_t m_graphicsValue = 0;
+
+            // Uploads queued since the last flush.
+            std::vector<BufferUpload> m_bufferUploads;
+            std::vector<ImageUpload> m_imageUploads;
+
+            // Flushed batches that have not retired, oldest first.
+            std::deque<Batch> m_inFlight;
+    };
+}
+#endif // UPLOADMANAGER_H
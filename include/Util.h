@@ -4,6 +4,7 @@
 #include "LogicalDevice.h"
 #include "CommandPool.h"
 #include "types.h"
+#include "MemoryTelemetry.h"
 
 
 #include <vulkan/vulkan.h>
@@ -18,20 +19,13 @@ namespace KMDM
      * @param properties 
      * @param buffer 
      * @param buffer_memory 
+     * @param category What the memory is for, in the memory telemetry.
      */
     void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
-        VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& buffer_memory);
+        VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& buffer_memory,
+        MemoryCategory category = MemoryCategory::Other);
 
 
-    /**
-     * @brief Copy the content of the source VkBuffer to the destination VkBuffer.
-     * 
-     * @param src 
-     * @param dst 
-     * @param size 
-     */
-    void copyBuffer(VkBuffer src, VkBuffer dst, VkDeviceSize size);
-
     /**
      * @brief Create a VkImage object
      * 
@@ -44,13 +38,23 @@ namespace KMDM
      * @param properties 
      * @param image 
      * @param memory 
+     * @param category What the memory is for, in the memory telemetry.
      */
     void createImage(uint32_t width, uint32_t height, uint32_t mip_level,
         VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties,
-        VkImage &image, VkDeviceMemory &memory);
+        VkImage &image, VkDeviceMemory &memory, MemoryCategory category = MemoryCategory::Other);
+
+    /**
+     * @brief Free memory from createBuffer() or createImage(), or that was passed to the memory
+     * telemetry.
+     * 
+     * @param memory 
+     */
+    void freeMemory(VkDeviceMemory memory);
     
     /**
-     * @brief 
+     * @brief Create a device local buffer and queue an upload of data into it.  The buffer
+     * can be used once the returned ticket completes.
      * 
      * @param data 
      * @param size 
@@ -58,9 +62,11 @@ namespace KMDM
      * @param buffer_usage 
      * @param dest_buffer 
      * @param dest_memory 
+     * @param category 
+     * @return uint64_t UploadManager ticket of the upload.
      */
-    void loadGpuBuffer(void *data, VkDeviceSize size, VkMemoryPropertyFlags memory_properties, VkBufferUsageFlags buffer_usage,
-        VkBuffer dest_buffer, VkDeviceMemory dest_memory);
+    uint64_t loadGpuBuffer(void *data, VkDeviceSize size, VkMemoryPropertyFlags memory_properties, VkBufferUsageFlags buffer_usage,
+        VkBuffer& dest_buffer, VkDeviceMemory& dest_memory, MemoryCategory category = MemoryCategory::Other);
 
     /**
      * @brief 
@@ -78,16 +84,6 @@ namespace KMDM
      */
     uint32_t findMemoryType(uint32_t type_filter, VkMemoryPropertyFlags properties);
 
-    /**
-     * @brief 
-     * 
-     * @param buffer 
-     * @param image 
-     * @param width 
-     * @param height 
-     */
-    void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
-
     /**
      * @brief Create a Image View object
      * 
@@ -98,5 +94,13 @@ namespace KMDM
      * @return VkImageView 
      */
     VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspect_flags, uint32_t mip_levels);
+
+    /**
+     * @brief Set the dynamic viewport and scissor to the top left extent of the attachments.
+     * 
+     * @param command_buffer 
+     * @param extent 
+     */
+    void setViewportAndScissor(VkCommandBuffer command_buffer, VkExtent2D extent);
 }
 #endif // UTIL_H
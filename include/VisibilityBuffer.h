@@ -0,0 +1,163 @@
+#ifndef VISIBILITYBUFFER_H
+#define VISIBILITYBUFFER_H
+
+#include "Common.h"
+#include "types.h"
+#include "LogicalDevice.h"
+#include "DescriptorSet.h"
+#include "Pipeline.h"
+#include "Renderpass.h"
+#include "RenderGraph.h"
+#include "RenderTargetPool.h"
+#include "ClusteredLighting.h"
+#include "Model.h"
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <cstdint>
+
+namespace KMDM
+{
+    /**
+     * @brief Deferred texturing through a visibility buffer.  A raster pass writes only which
+     * triangle of which draw covers each pixel, and a full screen compute pass fetches that
+     * triangle from shared geometry buffers, reconstructs its attributes and shades every pixel
+     * exactly once.  Overdraw then only costs depth tests and a 32 bit write, and small triangles
+     * are not shaded in partly covered quads.
+     *
+     * The shaded image is blitted into the swap chain image at the end of the frame.
+     *
+     */
+    class VisibilityBuffer
+    {
+        public:
+            /**
+             * @brief Construct a new Visibility Buffer object
+             *
+             * @param descriptor_set Owner of the scene and lighting set layouts.
+             * @param pipeline Default pipeline, the visibility pipeline is derived from it.
+             * @param depth_view Depth buffer the visibility pass tests against.
+             * @param image_count Number of swap chain images.
+             */
+            VisibilityBuffer(DescriptorSet* descriptor_set, Pipeline* pipeline, VkImageView depth_view,
+                uint32_t image_count);
+            virtual ~VisibilityBuffer();
+            void destroyVisibilityBuffer();
+
+            /**
+             * @brief Rebuild the shared vertex, index and draw buffers when the models drawn change.
+             * The old buffers are retired, and the new ones are still uploading when this returns,
+             * see getGeometryTicket().
+             *
+             * @param models
+             */
+            void updateGeometry(std::vector<Model>& models);
+
+            /**
+             * @brief Write the resolve set of an image: camera, geometry and material textures.
+             * Texture views change as mips stream, so this is done whenever the frame is recorded,
+             * while the device is idle like the other per frame sets.
+             *
+             * @param image
+             * @param uniform_buffer Camera buffer of the image.
+             * @param models The models passed to updateGeometry().
+             */
+            void updateDescriptorSet(uint32_t image, VkBuffer uniform_buffer, std::vector<Model>& models);
+
+            /**
+             * @brief Add the visibility, resolve and present passes to a frame graph.  The passes
+             * record from models, which has to outlive the graph's execute().
+             *
+             * @param graph
+             * @param image
+             * @param color Swap chain image, written with a blit.
+             * @param depth
+             * @param lights Light lists read when shading.
+             * @param scene_set Scene set of the image, for the camera.
+             * @param lighting_set
+             * @param models
+             */
+            void addPasses(RenderGraph& graph, uint32_t image, RenderResource color, RenderResource depth,
+                const LightCullingResources& lights, VkDescriptorSet scene_set, VkDescriptorSet lighting_set,
+                std::vector<Model>& models);
+
+            /**
+             * @brief Recreate the size dependent images and framebuffer after a swap chain resize,
+             * without waiting for the device.
+             *
+             * @param depth_view The new depth buffer.
+             */
+            void resize(VkImageView depth_view);
+
+            /**
+             * @brief Reallocate the per image resolve sets after the swap chain came back with a
+             * different number of images.
+             *
+             * @param image_count
+             */
+            void setImageCount(uint32_t image_count);
+
+            VkImage getVisibilityImage();
+            VkImage getShadedImage();
+
+            /**
+             * @brief Upload ticket of the geometry buffers.  A frame that resolves has to wait on
+             * the upload graphics timeline for it before the compute stage.
+             *
+             * @return uint64_t
+             */
+            uint64_t getGeometryTicket();
+
+        protected:
+            // One draw of the visibility pass, as the resolve shader reads it.
+            struct DrawInfo
+            {
+                uint32_t firstIndex;
+                int32_t vertexOffset;
+                uint32_t texture;
+                uint32_t padding;
+            };
+
+            void createImages(VkImageView depth_view);
+            void createDescriptorSets();
+            void createDescriptorPool();
+            void createPipelines(Pipeline* pipeline);
+            void destroyGeometry();
+
+        private:
+            LogicalDevice* m_logicalDevice;
+            DescriptorSet* m_descriptorSet;
+            uint32_t m_imageCount;
+            VkExtent2D m_extent;
+
+            // Triangle ids, and the image the resolve shades into.
+            RenderTarget m_visibilityTarget;
+            RenderTarget m_shadedTarget;
+
+            Renderpass* m_renderPass;
+            VkFramebuffer m_framebuffer;
+            VkPipelineLayout m_pipelineLayout;
+            VkPipeline m_visibilityPipeline;
+
+            VkDescriptorSetLayout m_resolveLayout;
+            VkDescriptorPool m_descriptorPool;
+            std::vector<VkDescriptorSet> m_descriptorSets;
+            VkPipelineLayout m_resolvePipelineLayout;
+            VkPipeline m_resolvePipeline;
+
+            // Geometry of every model in one buffer each, and the models it was built from.
+            std::vector<VkBuffer> m_geometryModels;
+            VkBuffer m_vertexBuffer = VK_NULL_HANDLE;
+            VkDeviceMemory m_vertexMemory = VK_NULL_HANDLE;
+            VkBuffer m_indexBuffer = VK_NULL_HANDLE;
+            VkDeviceMemory m_indexMemory = VK_NULL_HANDLE;
+            VkBuffer m_drawBuffer = VK_NULL_HANDLE;
+            VkDeviceMemory m_drawMemory = VK_NULL_HANDLE;
+            uint64_t m_geometryTicket = 0;
+
+            // Model whose texture fills each slot of the texture array.
+            std::vector<uint32_t> m_textureModels;
+    };
+}
+#endif // VISIBILITYBUFFER_H
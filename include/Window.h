@@ -4,6 +4,7 @@
 #include <SDL.h>
 #include <SDL_vulkan.h>
 
+#include "Common.h"
 #include "types.h"
 
 namespace KMDM
@@ -18,12 +19,27 @@ namespace KMDM
             void destoryWindow();
             ExtentSize getWindowSize();
 
+            /**
+             * @brief Run without a window, surface or swapchain.  Frames are drawn into offscreen
+             * images of the given size, and any Vulkan device with a graphics queue can be used,
+             * software ones included.  Call before any other singleton is created.  The size may be
+             * changed later with Renderer::resizeHeadless().
+             *
+             * @param headless
+             * @param width
+             * @param height
+             */
+            static void setHeadless(bool headless, int width = WIDTH, int height = HEIGHT);
+            static bool isHeadless();
+
         protected:
 
         private:
             Window();
             static SDL_Window* m_SDLwindow;
             static Window* m_window;
+            static bool m_headless;
+            static ExtentSize m_headlessSize;
     };
 }
 #endif // WINDOW_H
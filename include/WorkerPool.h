@@ -0,0 +1,83 @@
+#ifndef WORKERPOOL_H
+#define WORKERPOOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <cstdint>
+
+namespace KMDM
+{
+    /**
+     * @brief Persistent threads for the data parallel loops of the CPU side asset work, mip
+     * generation and block (de)compression.  Every caller shares the same threads, so decode
+     * threads building textures at once do not each start a thread per core.  The calling thread
+     * works on its own loop too, so a loop finishes even when every pool thread is busy.
+     *
+     */
+    class WorkerPool
+    {
+        public:
+            /**
+             * @brief Get the Instance object.  Safe to call from any thread.
+             *
+             * @return WorkerPool*
+             */
+            static WorkerPool* getInstance();
+
+            /**
+             * @brief Get the instance if one has been created, for shutdown code that should not
+             * start the threads.
+             *
+             * @return WorkerPool* nullptr before getInstance().
+             */
+            static WorkerPool* findInstance();
+            virtual ~WorkerPool();
+
+            /**
+             * @brief Join the threads.  Loops still running finish on their calling threads.
+             *
+             */
+            void destroyWorkerPool();
+
+            /**
+             * @brief Run body(i) for every i in [0, count) and return once all have run.  Ranges of
+             * fewer than two grains stay on the calling thread.
+             *
+             * @param count
+             * @param body
+             * @param grain Iterations that are not worth another thread on their own.
+             */
+            void parallelFor(uint32_t count, const std::function<void(uint32_t)>& body, uint32_t grain = 1);
+
+        protected:
+            struct Loop
+            {
+                uint32_t count;
+                const std::function<void(uint32_t)>* body;
+                std::atomic<uint32_t> next{0};
+                std::atomic<uint32_t> done{0};
+                std::mutex mutex;
+                std::condition_variable finished;
+            };
+
+            void worker();
+            void run(Loop& loop);
+
+        private:
+            WorkerPool();
+            static WorkerPool* m_workerPool;
+
+            std::vector<std::thread> m_threads;
+            std::deque<std::shared_ptr<Loop>> m_loops;
+            std::mutex m_mutex;
+            std::condition_variable m_wake;
+            bool m_stop;
+    };
+}
+#endif // WORKERPOOL_H
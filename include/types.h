@@ -63,12 +63,31 @@ namespace KMDM
         static std::array<VkVertexInputAttributeDescription, 4> getAttributeDescriptions()
         {
             std::array<VkVertexInputAttributeDescription, 4> descriptions;
-            descriptions[0] = { 0, 0, VK_FORMAT_R32G32B32A32_SFLOAT, 0 }; // Position.
+            descriptions[0] = { 0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0 }; // Position.
             descriptions[1] = { 1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, normal) }; // Normal.
             descriptions[2] = { 2, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, color) }; // Color.
             descriptions[3] = { 3, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, texCoord) }; // texCoord.
             return descriptions;
         }
+
+        /**
+         * @brief Binding of the position only stream, used by the depth pre-pass.
+         * 
+         * @return VkVertexInputBindingDescription 
+         */
+        static VkVertexInputBindingDescription getPositionBindingDescription()
+        {
+            VkVertexInputBindingDescription bindingDescription = {};
+            bindingDescription.binding = 0;
+            bindingDescription.stride = sizeof(glm::vec3);
+            bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+            return bindingDescription;
+        }
+
+        static VkVertexInputAttributeDescription getPositionAttributeDescription()
+        {
+            return { 0, 0, VK_FORMAT_R32G32B32_SFLOAT, 0 };
+        }
     };
 
 /******************************************************************************/
@@ -81,6 +100,10 @@ namespace KMDM
         glm::mat4 model;
         glm::mat4 view;
         glm::mat4 proj;
+
+        // Motion vectors: this frame without the sub-pixel jitter, and the last frame's transform.
+        glm::mat4 unjitteredProj;
+        glm::mat4 previousModelViewProj;
     };
 
     /**
@@ -106,6 +129,7 @@ namespace KMDM
         std::optional<uint32_t> graphicsFamilyIndex;
         std::optional<uint32_t> presentationFamilyIndex;
         std::optional<uint32_t> computeFamilyIndex;
+        std::optional<uint32_t> transferFamilyIndex;
 
         bool isComplete()
         {
@@ -117,6 +141,11 @@ namespace KMDM
         {
             return computeFamilyIndex.has_value();
         }
+
+        bool hasTransfer()
+        {
+            return transferFamilyIndex.has_value();
+        }
     };
 /******************************************************************************/
 
@@ -179,6 +208,34 @@ namespace KMDM
         VmaAllocation allocation;
     };
 
+/******************************************************************************/
+
+    /**
+     * @brief One mip level of a TextureData.
+     * 
+     */
+    struct TextureMip
+    {
+        size_t offset;
+        size_t size;
+        uint32_t width;
+        uint32_t height;
+    };
+
+    /**
+     * @brief CPU side texture.  Mip levels are stored back to back in data, largest first.
+     * Block compressed formats hold whole 4x4 blocks.
+     * 
+     */
+    struct TextureData
+    {
+        VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<TextureMip> mips;
+        std::vector<unsigned char> data;
+    };
+
 /******************************************************************************/
 
     // Frame data.  Maybe I can make this a class.
@@ -202,6 +259,56 @@ namespace KMDM
         glm::vec4 sunlightDirection;
         glm::vec4 sunlightColor;
     };
+
+    enum class LightType : uint32_t
+    {
+        Point,
+        Spot
+    };
+
+    /**
+     * @brief A point or spot light in world space.  Nothing is lit beyond its range.
+     * 
+     */
+    struct Light
+    {
+        LightType type = LightType::Point;
+        glm::vec3 position = glm::vec3(0.0f);
+        float range = 1.0f;
+        glm::vec3 color = glm::vec3(1.0f);
+        float intensity = 1.0f;
+
+        // Spot lights only.  The cone angles are stored as cosines.
+        glm::vec3 direction = glm::vec3(0.0f, 0.0f, -1.0f);
+        float innerConeCos = 1.0f;
+        float outerConeCos = 0.0f;
+    };
+
+    /**
+     * @brief A light as the shaders see it, in view space.
+     * 
+     */
+    struct GPULight
+    {
+        glm::vec4 positionRange;
+        glm::vec4 colorIntensity;
+        glm::vec4 directionType;    // w is the LightType.
+        glm::vec4 cone;             // Inner and outer cone cosines.
+    };
+
+    /**
+     * @brief Cluster grid parameters shared by light culling and shading.
+     * 
+     */
+    struct GPUClusterData
+    {
+        glm::mat4 inverseProjection;
+        glm::uvec4 gridSize;        // Clusters in x, y and z.
+        glm::uvec4 lightCounts;     // Lights, and the most lights a cluster keeps.
+        glm::vec4 screenSize;       // Width and height in pixels, then the tile size.
+        glm::vec4 depthSlicing;     // Slice = log(depth) * x + y, near and far planes in z and w.
+        glm::vec4 ambientColor;
+    };
 }
 
 // Define a hashing function for the Vertex struct.
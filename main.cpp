@@ -1,9 +1,74 @@
 #include "Renderer.h"
+#include "BatchRenderer.h"
+#include "Scene.h"
 #include <stdexcept>
 #include <iostream>
+#include <string>
+#include <cstdlib>
 
-int main()
+/******************************************************************
+    Without arguments the engine runs interactively in a window.
+
+    main --batch jobs.json [--claim] [--device N]
+
+    renders the job list offscreen instead, see BatchRenderer.
+    --claim shares the list with other processes through claim
+    files, --device N renders on the N-th suitable GPU.
+*******************************************************************/
+int runBatch(int argc, char** argv)
+{
+    std::string jobs_path;
+    bool claim = false;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--batch" && i + 1 < argc)
+        {
+            jobs_path = argv[++i];
+        }
+        else if (arg == "--claim")
+        {
+            claim = true;
+        }
+        else if (arg == "--device" && i + 1 < argc)
+        {
+            KMDM::PhysicalDevice::setDeviceIndex(std::atoi(argv[++i]));
+        }
+    }
+    if (jobs_path.empty())
+    {
+        std::cerr << "Usage: main --batch jobs.json [--claim] [--device N]" << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        std::vector<KMDM::BatchJob> jobs = KMDM::BatchRenderer::loadJobs(jobs_path);
+        KMDM::BatchRenderer batch(claim);
+        uint64_t written = batch.render(jobs);
+        batch.destroyBatchRenderer();
+
+        KMDM::Renderer* render = KMDM::Renderer::getInstance();
+        vkDeviceWaitIdle(KMDM::LogicalDevice::getInstance()->getLogicalDevice());
+        KMDM::Scene::getInstance()->destoryScene();
+        render->destroyRenderer();
+        std::cout << "Rendered " << written << " of " << jobs.size() << " jobs." << std::endl;
+    }
+    catch(const std::exception& e)
+    {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
+
+int main(int argc, char** argv)
 {
+    if (argc > 1)
+    {
+        return runBatch(argc, argv);
+    }
+
     KMDM::Renderer* render;
     try
     {
@@ -0,0 +1,21 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Depth pre-pass.  gl_Position has to come out bit for bit the same as in
+// shader.vert, or the EQUAL depth test of the main pass drops fragments.
+
+// Camera.
+layout (set = 0, binding = 1) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+layout(location = 0) in vec3 inPostion;
+
+invariant gl_Position;
+
+void main()
+{
+    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPostion, 1.0);
+}
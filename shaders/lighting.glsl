@@ -0,0 +1,70 @@
+// Clustered lights, filled in by cluster.comp.  Define LIGHTING_SET to the
+// set the lighting descriptor set is bound at before including this.
+
+struct Light {
+    vec4 positionRange;
+    vec4 colorIntensity;
+    vec4 directionType;
+    vec4 cone;
+};
+
+layout(set = LIGHTING_SET, binding = 0) uniform ClusterData {
+    mat4 inverseProjection;
+    uvec4 gridSize;
+    uvec4 lightCounts;
+    vec4 screenSize;
+    vec4 depthSlicing;
+    vec4 ambientColor;
+} clusterData;
+
+layout(std430, set = LIGHTING_SET, binding = 1) readonly buffer Lights {
+    Light lights[];
+};
+
+layout(std430, set = LIGHTING_SET, binding = 2) readonly buffer LightGrid {
+    uint lightGrid[];
+};
+
+layout(std430, set = LIGHTING_SET, binding = 3) readonly buffer LightIndices {
+    uint lightIndices[];
+};
+
+const uint LIGHT_SPOT = 1;
+
+// Inverse square falloff, windowed to reach zero at the light's range.
+float attenuation(float distance, float range)
+{
+    float ratio = distance / range;
+    float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+    return window * window / (distance * distance + 1.0);
+}
+
+// Ambient plus the lights of the pixel's cluster, for a view space surface.
+vec3 clusteredLighting(vec2 pixel, vec3 viewPosition, vec3 normal)
+{
+    // Find the cluster of the pixel.  Slices are exponential in depth.
+    uvec3 grid = clusterData.gridSize.xyz;
+    float depth = max(-viewPosition.z, clusterData.depthSlicing.z);
+    uint slice = uint(max(log(depth) * clusterData.depthSlicing.x + clusterData.depthSlicing.y, 0.0));
+    uvec3 id = min(uvec3(uvec2(pixel / clusterData.screenSize.zw), slice), grid - 1);
+    uint cluster = id.x + id.y * grid.x + id.z * grid.x * grid.y;
+
+    vec3 lighting = clusterData.ambientColor.rgb;
+    uint count = lightGrid[cluster];
+    uint first = cluster * clusterData.lightCounts.y;
+    for (uint i = 0; i < count; i++)
+    {
+        Light light = lights[lightIndices[first + i]];
+        vec3 toLight = light.positionRange.xyz - viewPosition;
+        float distance = length(toLight);
+        vec3 direction = toLight / max(distance, 0.0001);
+
+        float intensity = light.colorIntensity.w * attenuation(distance, light.positionRange.w);
+        if (uint(light.directionType.w) == LIGHT_SPOT)
+        {
+            intensity *= smoothstep(light.cone.y, light.cone.x, dot(-direction, light.directionType.xyz));
+        }
+        lighting += light.colorIntensity.rgb * intensity * max(dot(normal, direction), 0.0);
+    }
+    return lighting;
+}
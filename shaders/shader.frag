@@ -1,5 +1,6 @@
 #version 450
 #extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
 
 layout(location = 0) in vec3 fragColor;
 layout(location = 0) out vec4 outColor;
@@ -9,10 +10,18 @@ layout(location = 1) in vec2 fragTexCoord;
 // layout(binding = 1 ) uniform sampler2D texSampler;
 layout(set = 1, binding = 1) uniform sampler2D texSampler;
 
+// Surface in view space.
+layout(location = 2) in vec3 fragViewPosition;
+layout(location = 3) in vec3 fragViewNormal;
+
+#define LIGHTING_SET 2
+#include "lighting.glsl"
+
 void main()
 {
     //outColor = vec4(1.0, 0.0, 0.0, 1.0); // makes the entire triangle red.
     //outColor = vec4(fragTexCoord, 0.0, 1.0);
-    outColor = texture(texSampler, fragTexCoord);
+    vec4 albedo = texture(texSampler, fragTexCoord);
+    vec3 lighting = clusteredLighting(gl_FragCoord.xy, fragViewPosition, normalize(fragViewNormal));
+    outColor = vec4(albedo.rgb * lighting, albedo.a);
 }
-
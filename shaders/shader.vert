@@ -15,6 +15,8 @@ layout (set = 0, binding = 1) uniform UniformBufferObject {
     mat4 model;
     mat4 view;
     mat4 proj;
+    mat4 unjitteredProj;
+    mat4 previousModelViewProj;
 } ubo;
 
 // Vertex.
@@ -35,11 +37,28 @@ layout(location = 3) in vec2 inTexCoord;
 // Output locationsl
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) out vec3 fragViewPosition;
+layout(location = 3) out vec3 fragViewNormal;
+
+// Unjittered clip positions of this frame and the last, for motion vectors.
+layout(location = 4) out vec4 fragClipPosition;
+layout(location = 5) out vec4 fragPreviousClipPosition;
+
+// Matches depth.vert exactly, for the EQUAL depth test after the pre-pass.
+invariant gl_Position;
 
 void main()
 {
     gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPostion, 1.0);
     fragColor = inColor;
     fragTexCoord = inTexCoord;
+
+    // Lights are culled and shaded in view space.
+    mat4 modelView = ubo.view * ubo.model;
+    fragViewPosition = vec3(modelView * vec4(inPostion, 1.0));
+    fragViewNormal = mat3(modelView) * inNormal;
+
+    fragClipPosition = ubo.unjitteredProj * modelView * vec4(inPostion, 1.0);
+    fragPreviousClipPosition = ubo.previousModelViewProj * vec4(inPostion, 1.0);
 }
 
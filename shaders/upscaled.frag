@@ -0,0 +1,33 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+
+// Forward shading into the scene color target of dynamic resolution, with
+// the screen motion of every pixel for the temporal upscaler.
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 1) in vec2 fragTexCoord;
+layout(location = 2) in vec3 fragViewPosition;
+layout(location = 3) in vec3 fragViewNormal;
+layout(location = 4) in vec4 fragClipPosition;
+layout(location = 5) in vec4 fragPreviousClipPosition;
+
+layout(location = 0) out vec4 outColor;
+layout(location = 1) out vec2 outMotion;
+
+layout(set = 1, binding = 1) uniform sampler2D texSampler;
+
+#define LIGHTING_SET 2
+#include "lighting.glsl"
+
+void main()
+{
+    vec4 albedo = texture(texSampler, fragTexCoord);
+    vec3 lighting = clusteredLighting(gl_FragCoord.xy, fragViewPosition, normalize(fragViewNormal));
+    outColor = vec4(albedo.rgb * lighting, albedo.a);
+
+    // Texture coordinate offset from where the surface was last frame.
+    vec2 current = fragClipPosition.xy / fragClipPosition.w;
+    vec2 previous = fragPreviousClipPosition.xy / fragPreviousClipPosition.w;
+    outMotion = (current - previous) * 0.5;
+}
@@ -0,0 +1,14 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Write which triangle of which draw covers the pixel, nothing else.
+
+layout(constant_id = 0) const uint TRIANGLE_BITS = 22;
+
+layout(location = 0) flat in uint fragDraw;
+layout(location = 0) out uint outVisibility;
+
+void main()
+{
+    outVisibility = (fragDraw << TRIANGLE_BITS) | uint(gl_PrimitiveID);
+}
@@ -0,0 +1,22 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// Visibility pass.  Only positions are fetched, and the index of the draw
+// comes in as its first instance.
+
+// Camera.
+layout (set = 0, binding = 1) uniform UniformBufferObject {
+    mat4 model;
+    mat4 view;
+    mat4 proj;
+} ubo;
+
+layout(location = 0) in vec3 inPostion;
+
+layout(location = 0) flat out uint fragDraw;
+
+void main()
+{
+    gl_Position = ubo.proj * ubo.view * ubo.model * vec4(inPostion, 1.0);
+    fragDraw = gl_InstanceIndex;
+}
@@ -3,10 +3,10 @@
 #include "LogicalDevice.h"
 #include "Instance.h"
 #include "Util.h"
+#include "MemoryTelemetry.h"
 
 
 #define VMA_IMPLEMENTATION
-// #define VMA_RECORDING_ENABLED 1
 #include "vk_mem_alloc.h"
 
 #include <stdexcept>
@@ -21,14 +21,17 @@ namespace KMDM
     */
     Allocator::Allocator()
     {
-        VmaRecordSettings recordSettings = {};
-        recordSettings.pFilePath = "/data/home/kenneth/Desktop/Programming/vulkan/Engine/src/vma.csv";
-
         VmaAllocatorCreateInfo allocatorInfo = {};
         allocatorInfo.physicalDevice = PhysicalDevice::getInstance()->getPhysicalDevice();
         allocatorInfo.device = LogicalDevice::getInstance()->getLogicalDevice();
         allocatorInfo.instance = Instance::getInstance()->getVulkanInstance();
-        // allocatorInfo.pRecordSettings = &recordSettings;
+        allocatorInfo.vulkanApiVersion = VK_API_VERSION_1_1;
+
+        // Let VMA keep to the heap budgets too.
+        if (LogicalDevice::getInstance()->hasMemoryBudget())
+        {
+            allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+        }
 
         if (vmaCreateAllocator(&allocatorInfo, &m_vmaAlocator) != VK_SUCCESS)
         {
@@ -66,7 +69,7 @@ namespace KMDM
 
 
     AllocatedBuffer Allocator::getVMABuffer(VkDeviceSize size, VkBufferUsageFlags buffer_usage,
-        VmaMemoryUsage vma_usage)
+        VmaMemoryUsage vma_usage, MemoryCategory category)
     {
         VkBufferCreateInfo bufferInfo = {};
         bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -88,18 +91,14 @@ namespace KMDM
         {
             throw std::runtime_error("Failed to allocate VMA buffer.");
         }
+        trackAllocation(ret.allocation, category);
         return ret;
     }
 
 
-    void Allocator::copyVMABuffer(AllocatedBuffer src, AllocatedBuffer dst, size_t size)
-    {
-        copyBuffer(src.buffer, dst.buffer, size);
-    }
-
     AllocatedImage Allocator::getVMAImage(uint32_t width, uint32_t height, uint32_t mip_level,
         VkFormat format, VkImageTiling tiling, VkImageUsageFlags image_usage, VmaMemoryUsage memory_usage,
-        VkMemoryPropertyFlags memory_properties)
+        VkMemoryPropertyFlags memory_properties, MemoryCategory category)
     {
         // Create image info.
         VkImageCreateInfo imageInfo = {};
@@ -127,15 +126,41 @@ namespace KMDM
         {
             throw std::runtime_error("Failed to allocate image.");
         }
+        trackAllocation(retImage.allocation, category);
         return retImage;
     }
 
 
     void Allocator::cleanupAllcatedBuffer(AllocatedBuffer buffer)
     {
+        untrackAllocation(buffer.allocation);
         vmaDestroyBuffer(m_vmaAlocator, buffer.buffer, buffer.allocation);
     }
 
+    void Allocator::cleanupAllocatedImage(AllocatedImage image)
+    {
+        untrackAllocation(image.allocation);
+        vmaDestroyImage(m_vmaAlocator, image.image, image.allocation);
+    }
+
+    /*
+        trackAllocation()
+    */
+    void Allocator::trackAllocation(VmaAllocation allocation, MemoryCategory category)
+    {
+        VmaAllocationInfo info = {};
+        vmaGetAllocationInfo(m_vmaAlocator, allocation, &info);
+        MemoryTelemetry::getInstance()->trackVmaAllocation(allocation, info.size, info.memoryType, category);
+    }
+
+    void Allocator::untrackAllocation(VmaAllocation allocation)
+    {
+        if (MemoryTelemetry* telemetry = MemoryTelemetry::findInstance())
+        {
+            telemetry->trackVmaFree(allocation);
+        }
+    }
+
 
     void Allocator::destoryAllocator()
     {
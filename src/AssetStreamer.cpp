@@ -0,0 +1,181 @@
+#include "../include/AssetStreamer.h"
+#include "../include/Common.h"
+#include "../include/CpuProfiler.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace KMDM
+{
+    /**
+     * @brief Construct a new Asset Streamer:: Asset Streamer object
+     * 
+     * @param decode_threads 
+     */
+    AssetStreamer::AssetStreamer(uint32_t decode_threads)
+    {
+        if (decode_threads == 0)
+        {
+            // Leave a core for the render thread and one for I/O.
+            uint32_t cores = std::thread::hardware_concurrency();
+            decode_threads = std::max(1u, cores > 2 ? cores - 2 : 1u);
+        }
+
+        m_ioThread = std::thread(&AssetStreamer::ioWorker, this);
+        for (uint32_t i = 0; i < decode_threads; i++)
+        {
+            m_decodeThreads.emplace_back(&AssetStreamer::decodeWorker, this);
+        }
+        std::cout << "Created asset streamer with " << decode_threads << " decode threads." << std::endl;
+    }
+
+    /**
+     * @brief Destroy the Asset Streamer:: Asset Streamer object
+     * 
+     */
+    AssetStreamer::~AssetStreamer()
+    {
+        destroyAssetStreamer();
+    }
+
+    /**
+     * @brief Stop and join the worker threads.
+     * 
+     */
+    void AssetStreamer::destroyAssetStreamer()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_stopping)
+            {
+                return;
+            }
+            m_stopping = true;
+        }
+        m_ioCondition.notify_all();
+        m_decodeCondition.notify_all();
+
+        if (m_ioThread.joinable())
+        {
+            m_ioThread.join();
+        }
+        for (auto & thread : m_decodeThreads)
+        {
+            if (thread.joinable())
+            {
+                thread.join();
+            }
+        }
+        std::cout << "- Cleaning up AssetStreamer." << std::endl;
+    }
+
+    /**
+     * @brief Queue a model for loading.
+     * 
+     * @param id 
+     * @param model_path 
+     * @param texture_path 
+     */
+    void AssetStreamer::requestModel(uint32_t id, std::string model_path, std::string texture_path)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_loadQueue.push_back({ id, model_path, texture_path });
+        }
+        m_ioCondition.notify_one();
+    }
+
+    /**
+     * @brief Take the decoded models.
+     * 
+     * @return std::vector<StreamedModel> 
+     */
+    std::vector<StreamedModel> AssetStreamer::takeCompleted()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        std::vector<StreamedModel> completed;
+        completed.swap(m_completed);
+        return completed;
+    }
+
+    /**
+     * @brief Read the requested files and pass them on to the decode threads.
+     * 
+     */
+    void AssetStreamer::ioWorker()
+    {
+        KMDM_PROFILE_THREAD("Asset IO");
+        while (true)
+        {
+            LoadRequest request;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_ioCondition.wait(lock, [this] { return m_stopping || !m_loadQueue.empty(); });
+                if (m_stopping)
+                {
+                    return;
+                }
+                request = std::move(m_loadQueue.front());
+                m_loadQueue.pop_front();
+            }
+
+            KMDM_PROFILE_ZONE("readModelFiles");
+            DecodeRequest decode = {};
+            decode.id = request.id;
+            try
+            {
+                decode.objBytes = readFile(request.modelPath);
+                decode.textureBytes = Model::readTextureFile(request.texturePath);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_completed.push_back({ request.id, {}, std::current_exception() });
+                continue;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_decodeQueue.push_back(std::move(decode));
+            }
+            m_decodeCondition.notify_one();
+        }
+    }
+
+    /**
+     * @brief Parse the geometry and decode the texture.
+     * 
+     */
+    void AssetStreamer::decodeWorker()
+    {
+        KMDM_PROFILE_THREAD("Asset decode");
+        while (true)
+        {
+            DecodeRequest request;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_decodeCondition.wait(lock, [this] { return m_stopping || !m_decodeQueue.empty(); });
+                if (m_stopping)
+                {
+                    return;
+                }
+                request = std::move(m_decodeQueue.front());
+                m_decodeQueue.pop_front();
+            }
+
+            StreamedModel result = {};
+            result.id = request.id;
+            try
+            {
+                result.data = Model::decodeModelData(request.objBytes, request.textureBytes);
+            }
+            catch (...)
+            {
+                result.error = std::current_exception();
+            }
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_completed.push_back(std::move(result));
+        }
+    }
+}
@@ -0,0 +1,302 @@
+#include "../include/BatchRenderer.h"
+#include "../include/Window.h"
+#include "../include/Scene.h"
+#include "../include/Model.h"
+#include "../include/UploadManager.h"
+#include "../include/TextureResidency.h"
+#include "../include/CpuProfiler.h"
+
+#include "nlohmann/json.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace KMDM
+{
+    namespace
+    {
+        // Frames the resident texture memory has to hold still for the streaming to be done.
+        const uint32_t BATCH_SETTLE_FRAMES = 4;
+
+        glm::vec3 readVec3(const nlohmann::json& value, glm::vec3 fallback)
+        {
+            if (!value.is_array() || value.size() != 3)
+            {
+                return fallback;
+            }
+            return glm::vec3(value[0].get<float>(), value[1].get<float>(), value[2].get<float>());
+        }
+    }
+
+    /**
+     * @brief Construct a new Batch Renderer:: Batch Renderer object
+     *
+     * @param claim_jobs
+     */
+    BatchRenderer::BatchRenderer(bool claim_jobs) :
+        m_claimJobs(claim_jobs),
+        m_view(1.0f)
+    {
+        Window::setHeadless(true);
+        m_renderer = Renderer::getInstance();
+        m_readbackRing = new ReadbackRing();
+        m_imageWriter = new ImageWriter();
+        m_renderer->setCameraLatch([this]()
+        {
+            return m_view;
+        });
+        std::cout << "Created batch renderer." << std::endl;
+    }
+
+    /**
+     * @brief Destroy the Batch Renderer:: Batch Renderer object
+     *
+     */
+    BatchRenderer::~BatchRenderer()
+    {
+        destroyBatchRenderer();
+    }
+
+    /**
+     * @brief Write out what is still queued, which releases the readback slots, then destroy the ring.
+     *
+     */
+    void BatchRenderer::destroyBatchRenderer()
+    {
+        if (!m_readbackRing)
+        {
+            return;
+        }
+        std::cout << "- Cleaning up BatchRenderer." << std::endl;
+        m_renderer->setCameraLatch(nullptr);
+        delete(m_imageWriter);
+        m_imageWriter = nullptr;
+        delete(m_readbackRing);
+        m_readbackRing = nullptr;
+    }
+
+    /**
+     * @brief Read a job list.
+     *
+     * @param path
+     * @return std::vector<BatchJob>
+     */
+    std::vector<BatchJob> BatchRenderer::loadJobs(std::string path)
+    {
+        std::ifstream file(path);
+        if (!file)
+        {
+            throw std::runtime_error("Failed to open job list " + path + ".");
+        }
+        nlohmann::json list;
+        file >> list;
+        if (!list.is_array())
+        {
+            throw std::runtime_error("Job list " + path + " is not an array.");
+        }
+
+        std::vector<BatchJob> jobs;
+        for (auto & entry : list)
+        {
+            BatchJob job = {};
+            job.scene = entry.at("scene").get<std::string>();
+            job.output = entry.at("output").get<std::string>();
+            job.eye = readVec3(entry.value("eye", nlohmann::json()), glm::vec3(2.0f, 2.0f, 2.0f));
+            job.target = readVec3(entry.value("target", nlohmann::json()), glm::vec3(0.0f));
+            job.width = entry.value("width", static_cast<uint32_t>(WIDTH));
+            job.height = entry.value("height", static_cast<uint32_t>(HEIGHT));
+            if (job.width == 0 || job.height == 0)
+            {
+                throw std::runtime_error("Job for " + job.output + " has no size.");
+            }
+            jobs.push_back(job);
+        }
+        return jobs;
+    }
+
+    /******************************************************************
+        Render the jobs.  Each frame is copied into a free readback
+        slot and written out on the writer threads once its copy is
+        done, so only a full ring makes the render thread wait on
+        the writers.  Each frame still waits for the queue in
+        drawFrame(), see the class comment.
+    *******************************************************************/
+    uint64_t BatchRenderer::render(std::vector<BatchJob> jobs)
+    {
+        KMDM_PROFILE_ZONE("renderBatch");
+        uint64_t written = m_imageWriter->getWrittenCount();
+
+        std::stable_sort(jobs.begin(), jobs.end(), [](const BatchJob& a, const BatchJob& b)
+        {
+            if (a.scene != b.scene)
+            {
+                return a.scene < b.scene;
+            }
+            return a.width != b.width ? a.width < b.width : a.height < b.height;
+        });
+
+        for (auto & job : jobs)
+        {
+            if (m_claimJobs && !claimJob(job))
+            {
+                continue;
+            }
+
+            m_view = glm::lookAt(job.eye, job.target, glm::vec3(0.0f, 0.0f, 1.0f));
+            VkExtent2D extent = SwapChain::getInstance()->getSwapChainExtent();
+            bool resized = extent.width != job.width || extent.height != job.height;
+            bool reloaded = job.scene != m_scene;
+            if (reloaded)
+            {
+                loadScene(job.scene);
+            }
+            if (resized)
+            {
+                m_renderer->resizeHeadless(job.width, job.height);
+            }
+            if (reloaded || resized)
+            {
+                warmUp();
+            }
+
+            while (!m_readbackRing->hasFreeSlot())
+            {
+                writeCompleted();
+                if (!m_readbackRing->hasFreeSlot())
+                {
+                    m_readbackRing->waitForSlot();
+                }
+            }
+            m_outputs[m_nextTag] = job.output;
+            m_renderer->captureNextFrame(m_readbackRing, m_nextTag++);
+            m_renderer->renderFrame();
+            writeCompleted();
+        }
+
+        m_readbackRing->waitForCopies();
+        writeCompleted();
+        m_imageWriter->wait();
+        return m_imageWriter->getWrittenCount() - written;
+    } /// render
+
+    /**
+     * @brief Claim a job by creating its claim file, which fails if another process has.  The
+     * claim is removed once the image is written.
+     *
+     * @param job
+     * @return true The job is this process's to render.
+     * @return false The job is claimed or already rendered.
+     */
+    bool BatchRenderer::claimJob(const BatchJob& job)
+    {
+        if (std::ifstream(job.output).good())
+        {
+            return false;
+        }
+
+        // A claim that is old and still has no output was left by a process that died.  Two
+        // processes may both take it over, which only renders the job twice.
+        std::string claim_path = job.output + ".claim";
+        std::error_code error;
+        std::filesystem::file_time_type claimed = std::filesystem::last_write_time(claim_path, error);
+        if (!error && std::filesystem::file_time_type::clock::now() - claimed >
+            std::chrono::seconds(BATCH_CLAIM_TIMEOUT))
+        {
+            std::cout << "Taking over the stale claim on " << job.output << "." << std::endl;
+            std::filesystem::remove(claim_path, error);
+        }
+
+        std::FILE* claim = std::fopen(claim_path.c_str(), "wx");
+        if (!claim)
+        {
+            return false;
+        }
+        std::fclose(claim);
+        return true;
+    }
+
+    /**
+     * @brief Replace the scene's meshes with the models of a scene file, an object of entries with
+     * "model_path" and "texture_path".
+     *
+     * @param path
+     */
+    void BatchRenderer::loadScene(const std::string& path)
+    {
+        KMDM_PROFILE_ZONE("loadScene");
+        std::ifstream file(path);
+        if (!file)
+        {
+            throw std::runtime_error("Failed to open scene " + path + ".");
+        }
+        nlohmann::json scene_file;
+        file >> scene_file;
+
+        vkDeviceWaitIdle(LogicalDevice::getInstance()->getLogicalDevice());
+        Scene* scene = Scene::getInstance();
+        scene->clearMeshes();
+        for (auto & [key, value] : scene_file.items())
+        {
+            Model model(value.at("model_path").get<std::string>(), value.at("texture_path").get<std::string>());
+            UploadManager::getInstance()->wait(model.getUploadTicket());
+            scene->addMesh(model);
+        }
+        m_scene = path;
+        std::cout << "Loaded scene " << path << "." << std::endl;
+    }
+
+    /**
+     * @brief Draw frames until the textures have streamed in for the current view and size, at
+     * most BATCH_MAX_WARMUP_FRAMES.
+     *
+     */
+    void BatchRenderer::warmUp()
+    {
+        KMDM_PROFILE_ZONE("warmUp");
+        TextureResidency* residency = TextureResidency::getInstance();
+        VkDeviceSize resident = residency->getResidentBytes();
+        uint32_t stable = 0;
+        for (uint32_t i = 0; i < BATCH_MAX_WARMUP_FRAMES && stable < BATCH_SETTLE_FRAMES; i++)
+        {
+            m_renderer->renderFrame();
+            VkDeviceSize bytes = residency->getResidentBytes();
+            stable = bytes == resident ? stable + 1 : 0;
+            resident = bytes;
+        }
+    }
+
+    /**
+     * @brief Hand the finished readbacks to the writer, which releases their slots and removes the
+     * claims of the images it has written.
+     *
+     */
+    void BatchRenderer::writeCompleted()
+    {
+        for (auto & image : m_readbackRing->takeCompleted())
+        {
+            ReadbackRing* ring = m_readbackRing;
+            uint32_t slot = image.slot;
+            std::string output = m_outputs[image.tag];
+            ImageWriteJob job = { output, image.pixels, image.rowPitch, image.extent.width, image.extent.height,
+                image.format, [ring, slot]()
+                {
+                    ring->release(slot);
+                } };
+            if (m_claimJobs)
+            {
+                std::string claim_path = output + ".claim";
+                job.written = [claim_path]()
+                {
+                    std::remove(claim_path.c_str());
+                };
+            }
+            m_imageWriter->write(job);
+            m_outputs.erase(image.tag);
+        }
+    }
+}
@@ -0,0 +1,348 @@
+#include "../include/ClusteredLighting.h"
+#include "../include/PipelineCache.h"
+#include "../include/RenderTargetPool.h"
+#include "../include/Util.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace KMDM
+{
+    namespace
+    {
+        // Must match local_size_x of cluster.comp.
+        const uint32_t CULLING_GROUP_SIZE = 64;
+    }
+
+    /**
+     * @brief Construct a new ClusteredLighting object
+     *
+     * @param descriptor_set Owner of the lighting set layout.
+     * @param image_count Number of swap chain images.
+     */
+    ClusteredLighting::ClusteredLighting(DescriptorSet* descriptor_set, uint32_t image_count)
+    {
+        m_logicalDevice = LogicalDevice::getInstance();
+        m_descriptorSet = descriptor_set;
+        m_imageCount = image_count;
+
+        createBuffers();
+        createDescriptorSets();
+        createCullingPipeline();
+        std::cout << "Created clustered lighting." << std::endl;
+    }
+
+    /**
+     * @brief Destroy the ClusteredLighting object
+     *
+     */
+    ClusteredLighting::~ClusteredLighting()
+    {
+        destroyClusteredLighting();
+    }
+
+    /**
+     * @brief Destroy the pipeline, the descriptor sets and the buffers.
+     *
+     */
+    void ClusteredLighting::destroyClusteredLighting()
+    {
+        std::cout << "- Destroying clustered lighting." << std::endl;
+        VkDevice device = m_logicalDevice->getLogicalDevice();
+        vkDestroyPipeline(device, m_cullingPipeline, nullptr);
+        vkDestroyPipelineLayout(device, m_cullingLayout, nullptr);
+        vkDestroyDescriptorPool(device, m_descriptorPool, nullptr);
+
+        for (uint32_t i = 0; i < m_imageCount; i++)
+        {
+            vkUnmapMemory(device, m_clusterMemory[i]);
+            vkDestroyBuffer(device, m_clusterBuffers[i], nullptr);
+            freeMemory(m_clusterMemory[i]);
+            vkUnmapMemory(device, m_lightMemory[i]);
+            vkDestroyBuffer(device, m_lightBuffers[i], nullptr);
+            freeMemory(m_lightMemory[i]);
+        }
+        vkDestroyBuffer(device, m_lightGridBuffer, nullptr);
+        freeMemory(m_lightGridMemory);
+        vkDestroyBuffer(device, m_lightIndexBuffer, nullptr);
+        freeMemory(m_lightIndexMemory);
+
+        m_clusterBuffers.clear();
+        m_lightBuffers.clear();
+        m_descriptorSets.clear();
+        m_imageCount = 0;
+    }
+
+    /******************************************************************
+        The cluster parameters and lights change every frame, so they
+        live in host visible memory, one copy per swap chain image.
+        The light lists never leave the GPU.  The grid can be copied
+        out for inspection.
+    *******************************************************************/
+    void ClusteredLighting::createBuffers()
+    {
+        createImageBuffers();
+
+        VkDeviceSize clusters = getClusterCount();
+        createBuffer(clusters * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_lightGridBuffer, m_lightGridMemory, MemoryCategory::RenderTarget);
+        createBuffer(clusters * MAX_LIGHTS_PER_CLUSTER * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_lightIndexBuffer, m_lightIndexMemory, MemoryCategory::RenderTarget);
+    } /// createBuffers
+
+    /**
+     * @brief Create and map the cluster parameters and lights of every swap chain image.
+     *
+     */
+    void ClusteredLighting::createImageBuffers()
+    {
+        VkDevice device = m_logicalDevice->getLogicalDevice();
+        VkMemoryPropertyFlags hostVisible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+        m_lightCounts.assign(m_imageCount, 0);
+        m_clusterBuffers.resize(m_imageCount);
+        m_clusterMemory.resize(m_imageCount);
+        m_clusterData.resize(m_imageCount);
+        m_lightBuffers.resize(m_imageCount);
+        m_lightMemory.resize(m_imageCount);
+        m_lightData.resize(m_imageCount);
+        for (uint32_t i = 0; i < m_imageCount; i++)
+        {
+            createBuffer(sizeof(GPUClusterData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, hostVisible,
+                m_clusterBuffers[i], m_clusterMemory[i], MemoryCategory::Uniform);
+            vkMapMemory(device, m_clusterMemory[i], 0, sizeof(GPUClusterData), 0, &m_clusterData[i]);
+
+            createBuffer(sizeof(GPULight) * MAX_LIGHTS, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, hostVisible,
+                m_lightBuffers[i], m_lightMemory[i], MemoryCategory::Uniform);
+            vkMapMemory(device, m_lightMemory[i], 0, sizeof(GPULight) * MAX_LIGHTS, 0, &m_lightData[i]);
+
+            // Nothing is lit until the first update.
+            GPUClusterData empty = {};
+            memcpy(m_clusterData[i], &empty, sizeof(empty));
+        }
+    }
+
+    /**
+     * @brief Follow a change of the swap chain image count.  The per image buffers and sets of the
+     * old count are destroyed once the frames in flight are done with them, the light lists are kept.
+     *
+     * @param image_count
+     */
+    void ClusteredLighting::setImageCount(uint32_t image_count)
+    {
+        if (image_count == m_imageCount)
+        {
+            return;
+        }
+        VkDevice device = m_logicalDevice->getLogicalDevice();
+        VkDescriptorPool descriptorPool = m_descriptorPool;
+        std::vector<VkBuffer> buffers = m_clusterBuffers;
+        buffers.insert(buffers.end(), m_lightBuffers.begin(), m_lightBuffers.end());
+        std::vector<VkDeviceMemory> memory = m_clusterMemory;
+        memory.insert(memory.end(), m_lightMemory.begin(), m_lightMemory.end());
+        RenderTargetPool::getInstance()->retire([device, descriptorPool, buffers, memory]()
+        {
+            vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+            for (size_t i = 0; i < buffers.size(); i++)
+            {
+                vkUnmapMemory(device, memory[i]);
+                vkDestroyBuffer(device, buffers[i], nullptr);
+                freeMemory(memory[i]);
+            }
+        });
+
+        m_imageCount = image_count;
+        createImageBuffers();
+        createDescriptorSets();
+    }
+
+    /**
+     * @brief Allocate and write a lighting set for every swap chain image.
+     *
+     */
+    void ClusteredLighting::createDescriptorSets()
+    {
+        VkDevice device = m_logicalDevice->getLogicalDevice();
+
+        std::array<VkDescriptorPoolSize, 2> sizes = {};
+        sizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        sizes[0].descriptorCount = m_imageCount;
+        sizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        sizes[1].descriptorCount = 3 * m_imageCount;
+
+        VkDescriptorPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.maxSets = m_imageCount;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(sizes.size());
+        poolInfo.pPoolSizes = sizes.data();
+
+        if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create lighting descriptor pool.");
+        }
+
+        m_descriptorSets.resize(m_imageCount);
+        std::vector<VkDescriptorSetLayout> layouts(m_imageCount, m_descriptorSet->getLightingLayout());
+        VkDescriptorSetAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = m_descriptorPool;
+        allocInfo.descriptorSetCount = m_imageCount;
+        allocInfo.pSetLayouts = layouts.data();
+
+        if (vkAllocateDescriptorSets(device, &allocInfo, m_descriptorSets.data()) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to allocate lighting descriptor sets.");
+        }
+
+        for (uint32_t i = 0; i < m_imageCount; i++)
+        {
+            std::array<VkDescriptorBufferInfo, 4> bufferInfos = {};
+            bufferInfos[0] = { m_clusterBuffers[i], 0, sizeof(GPUClusterData) };
+            bufferInfos[1] = { m_lightBuffers[i], 0, VK_WHOLE_SIZE };
+            bufferInfos[2] = { m_lightGridBuffer, 0, VK_WHOLE_SIZE };
+            bufferInfos[3] = { m_lightIndexBuffer, 0, VK_WHOLE_SIZE };
+
+            std::array<VkWriteDescriptorSet, 4> writes = {};
+            for (uint32_t j = 0; j < writes.size(); j++)
+            {
+                writes[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                writes[j].dstSet = m_descriptorSets[i];
+                writes[j].dstBinding = j;
+                writes[j].descriptorCount = 1;
+                writes[j].descriptorType = j == 0 ? VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER :
+                    VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                writes[j].pBufferInfo = &bufferInfos[j];
+            }
+            vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+        }
+    } /// createDescriptorSets
+
+    /**
+     * @brief Create the light culling compute pipeline.  Its only set is the lighting set.
+     *
+     */
+    void ClusteredLighting::createCullingPipeline()
+    {
+        VkDevice device = m_logicalDevice->getLogicalDevice();
+        VkDescriptorSetLayout layout = m_descriptorSet->getLightingLayout();
+
+        VkPipelineLayoutCreateInfo layoutInfo = {};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        layoutInfo.setLayoutCount = 1;
+        layoutInfo.pSetLayouts = &layout;
+
+        if (vkCreatePipelineLayout(device, &layoutInfo, nullptr, &m_cullingLayout) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create light culling pipeline layout.");
+        }
+
+        VkShaderModule module = m_logicalDevice->createShaderModule(readFile(SHADER_PATH "cluster_comp.spv"));
+
+        VkComputePipelineCreateInfo pipelineInfo = {};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = module;
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.layout = m_cullingLayout;
+
+        VkResult result = vkCreateComputePipelines(device, PipelineCache::getInstance()->getPipelineCache(), 1,
+            &pipelineInfo, nullptr, &m_cullingPipeline);
+        vkDestroyShaderModule(device, module, nullptr);
+        if (result != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create light culling pipeline.");
+        }
+    } /// createCullingPipeline
+
+    /******************************************************************
+        Move the lights into view space, where the clusters are
+        built, and work out the grid of this camera.  Depth slices are
+        spaced exponentially, so a cluster is about as deep as it is
+        wide at every distance:
+
+            slice = log(depth) * scale + bias
+    *******************************************************************/
+    void ClusteredLighting::update(uint32_t image, const std::vector<Light>& lights, glm::vec3 ambient,
+        const glm::mat4& view, const glm::mat4& projection, VkExtent2D extent, float near_plane, float far_plane)
+    {
+        uint32_t count = static_cast<uint32_t>(std::min<size_t>(lights.size(), MAX_LIGHTS));
+        GPULight* gpuLights = static_cast<GPULight*>(m_lightData[image]);
+        glm::mat3 rotation = glm::mat3(view);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const Light& light = lights[i];
+            glm::vec3 position = glm::vec3(view * glm::vec4(light.position, 1.0f));
+            glm::vec3 direction = glm::normalize(rotation * light.direction);
+
+            gpuLights[i].positionRange = glm::vec4(position, light.range);
+            gpuLights[i].colorIntensity = glm::vec4(light.color, light.intensity);
+            gpuLights[i].directionType = glm::vec4(direction, static_cast<float>(light.type));
+            gpuLights[i].cone = glm::vec4(light.innerConeCos, light.outerConeCos, 0.0f, 0.0f);
+        }
+        m_lightCounts[image] = count;
+
+        float logDepthRange = std::log(far_plane / near_plane);
+        GPUClusterData cluster = {};
+        cluster.inverseProjection = glm::inverse(projection);
+        cluster.gridSize = glm::uvec4(CLUSTER_GRID_X, CLUSTER_GRID_Y, CLUSTER_GRID_Z, 0);
+        cluster.lightCounts = glm::uvec4(count, MAX_LIGHTS_PER_CLUSTER, 0, 0);
+        cluster.screenSize = glm::vec4(extent.width, extent.height,
+            std::ceil(extent.width / static_cast<float>(CLUSTER_GRID_X)),
+            std::ceil(extent.height / static_cast<float>(CLUSTER_GRID_Y)));
+        cluster.depthSlicing = glm::vec4(CLUSTER_GRID_Z / logDepthRange,
+            -(CLUSTER_GRID_Z * std::log(near_plane)) / logDepthRange, near_plane, far_plane);
+        cluster.ambientColor = glm::vec4(ambient, 1.0f);
+        memcpy(m_clusterData[image], &cluster, sizeof(cluster));
+    } /// update
+
+    /**
+     * @brief Dispatch one invocation per cluster.
+     *
+     * @param command_buffer
+     * @param image
+     */
+    void ClusteredLighting::recordCulling(VkCommandBuffer command_buffer, uint32_t image)
+    {
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullingPipeline);
+        vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_cullingLayout, 0, 1,
+            &m_descriptorSets[image], 0, nullptr);
+        vkCmdDispatch(command_buffer, (getClusterCount() + CULLING_GROUP_SIZE - 1) / CULLING_GROUP_SIZE, 1, 1);
+    }
+
+    /**
+     * @brief Import the light lists and add the pass that fills them.  The lists are shared by the
+     * frames in flight, so the culling waits for the fragment shaders of the frame before.
+     *
+     * @param graph
+     * @param image
+     * @return LightCullingResources
+     */
+    LightCullingResources ClusteredLighting::addCullingPass(RenderGraph& graph, uint32_t image)
+    {
+        VkDeviceSize clusters = getClusterCount();
+        LightCullingResources resources = {};
+        resources.lightGrid = graph.importBuffer("light_grid", m_lightGridBuffer, clusters * sizeof(uint32_t),
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+        resources.lightIndices = graph.importBuffer("light_indices", m_lightIndexBuffer,
+            clusters * MAX_LIGHTS_PER_CLUSTER * sizeof(uint32_t), VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT);
+
+        graph.addPass("light_culling", [this, image](VkCommandBuffer command_buffer, RenderGraph&)
+        {
+            recordCulling(command_buffer, image);
+        })
+            .write(resources.lightGrid, RenderAccess::StorageWrite)
+            .write(resources.lightIndices, RenderAccess::StorageWrite);
+        return resources;
+    }
+
+    VkDescriptorSet ClusteredLighting::getDescriptorSet(uint32_t image) { return m_descriptorSets[image]; }
+    VkBuffer ClusteredLighting::getLightGridBuffer() { return m_lightGridBuffer; }
+    VkBuffer ClusteredLighting::getLightIndexBuffer() { return m_lightIndexBuffer; }
+    uint32_t ClusteredLighting::getLightCount(uint32_t image) { return m_lightCounts[image]; }
+    uint32_t ClusteredLighting::getClusterCount() { return CLUSTER_GRID_X * CLUSTER_GRID_Y * CLUSTER_GRID_Z; }
+}
@@ -0,0 +1,158 @@
+#include "../include/CpuProfiler.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+namespace KMDM
+{
+    CpuProfiler* CpuProfiler::m_cpuProfiler = nullptr;
+    thread_local ProfileThreadBuffer* CpuProfiler::t_buffer = nullptr;
+
+    static_assert((CPU_PROFILER_RING_SIZE & (CPU_PROFILER_RING_SIZE - 1)) == 0,
+        "CPU_PROFILER_RING_SIZE has to be a power of two.");
+
+    namespace
+    {
+        // Zone names are literals from the code, but are escaped anyway.
+        std::string escapeJson(const std::string& text)
+        {
+            std::string escaped;
+            for (char c : text)
+            {
+                if (c == '"' || c == '\\')
+                {
+                    escaped += '\\';
+                }
+                escaped += c;
+            }
+            return escaped;
+        }
+    }
+
+    /**
+     * @brief Get the Instance object
+     *
+     * @return CpuProfiler*
+     */
+    CpuProfiler* CpuProfiler::getInstance()
+    {
+        if (!m_cpuProfiler)
+        {
+            m_cpuProfiler = new CpuProfiler();
+        }
+        return m_cpuProfiler;
+    }
+
+    CpuProfiler::CpuProfiler()
+    {
+        m_startTicks = now();
+        m_startTime = std::chrono::steady_clock::now();
+        std::cout << "Created CPU profiler." << std::endl;
+    }
+
+    CpuProfiler::~CpuProfiler()
+    {
+        destroyCpuProfiler();
+    }
+
+    /**
+     * @brief Drop every thread's ring.  No thread may record after this.
+     *
+     */
+    void CpuProfiler::destroyCpuProfiler()
+    {
+        std::cout << "- Destroying CpuProfiler." << std::endl;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_threads.clear();
+        m_cpuProfiler = nullptr;
+    }
+
+    /******************************************************************
+        First zone of a thread: give it a ring.  This is the only time
+        a recording thread takes the lock.
+    *******************************************************************/
+    ProfileThreadBuffer* CpuProfiler::registerThread()
+    {
+        CpuProfiler* profiler = getInstance();
+        std::unique_ptr<ProfileThreadBuffer> buffer(new ProfileThreadBuffer());
+        buffer->events.resize(CPU_PROFILER_RING_SIZE);
+
+        std::lock_guard<std::mutex> lock(profiler->m_mutex);
+        buffer->threadId = static_cast<uint32_t>(profiler->m_threads.size()) + 1;
+        buffer->name = "Thread " + std::to_string(buffer->threadId);
+        t_buffer = buffer.get();
+        profiler->m_threads.push_back(std::move(buffer));
+        return t_buffer;
+    }
+
+    void CpuProfiler::setThreadName(const std::string& name)
+    {
+        ProfileThreadBuffer* buffer = t_buffer ? t_buffer : registerThread();
+        std::lock_guard<std::mutex> lock(getInstance()->m_mutex);
+        buffer->name = name;
+    }
+
+    /******************************************************************
+        Zones become complete ("X") events, thread names metadata
+        ("M") events.  Timestamps are microseconds since creation.
+    *******************************************************************/
+    size_t CpuProfiler::writeChromeTrace(const std::string& path)
+    {
+        std::ofstream file(path);
+        if (!file)
+        {
+            throw std::runtime_error("Failed to open " + path + " for the CPU trace.");
+        }
+
+        uint64_t ticks = now() - m_startTicks;
+        double elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - m_startTime).count();
+        double microsecondsPerTick = ticks > 0 ? elapsed / ticks : 0.0;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        size_t written = 0;
+        bool first = true;
+        file << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+        for (auto & thread : m_threads)
+        {
+            file << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":"
+                 << thread->threadId << ",\"args\":{\"name\":\"" << escapeJson(thread->name) << "\"}}";
+            first = false;
+
+            uint64_t head = thread->head.load(std::memory_order_acquire);
+            uint64_t begin = head > CPU_PROFILER_RING_SIZE ? head - CPU_PROFILER_RING_SIZE : 0;
+            std::vector<ProfileEvent> events;
+            events.reserve(head - begin);
+            for (uint64_t i = begin; i < head; i++)
+            {
+                events.push_back(thread->events[i & (CPU_PROFILER_RING_SIZE - 1)]);
+            }
+
+            // Zones the thread wrote over while they were copied.
+            uint64_t after = thread->head.load(std::memory_order_acquire);
+            uint64_t valid = after >= CPU_PROFILER_RING_SIZE ? after - CPU_PROFILER_RING_SIZE + 1 : 0;
+            for (uint64_t i = std::max(begin, valid); i < head; i++)
+            {
+                const ProfileEvent& event = events[i - begin];
+                if (event.end < m_startTicks || event.start < m_startTicks)
+                {
+                    continue;
+                }
+                file << ",\n{\"name\":\"" << escapeJson(event.name) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+                     << thread->threadId << ",\"ts\":" << (event.start - m_startTicks) * microsecondsPerTick
+                     << ",\"dur\":" << (event.end - event.start) * microsecondsPerTick;
+                if (event.hasValue)
+                {
+                    file << ",\"args\":{\"value\":" << event.value << "}";
+                }
+                file << "}";
+                written++;
+            }
+        }
+        file << "\n]}" << std::endl;
+        std::cout << "Wrote " << written << " CPU zones to " << path << "." << std::endl;
+        return written;
+    } /// writeChromeTrace
+}
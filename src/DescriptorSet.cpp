@@ -3,6 +3,7 @@
 #include "Common.h"
 #include "SwapChain.h"
 #include "Scene.h"
+#include "SamplerCache.h"
 #include "SwapChain.h"
 
 #include <vulkan/vulkan.h>
@@ -56,6 +57,9 @@ namespace KMDM
         }  
         std::cout << "Created scene descriptor set layout." << std::endl;   
 
+        // Every model texture uses the same sampler, so it is immutable in the layout.
+        VkSampler textureSampler = SamplerCache::getInstance()->getSampler(Model::getTextureSamplerInfo());
+
         VkDescriptorSetLayoutBinding modelLayoutBindings[] = {
             {
                 0,
@@ -69,7 +73,7 @@ namespace KMDM
                 VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
                 1,
                 VK_SHADER_STAGE_FRAGMENT_BIT,
-                nullptr
+                &textureSampler
             }
         };
         VkDescriptorSetLayoutCreateInfo modelLayoutCreateInfo{};
@@ -84,6 +88,50 @@ namespace KMDM
         }  
         std::cout << "Created model descriptor set layout." << std::endl;  
 
+        // Written by the light culling shader and read back when shading.
+        VkShaderStageFlags lightingStages = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+        VkDescriptorSetLayoutBinding lightingLayoutBindings[] = {
+            { // GPUClusterData.
+                0,
+                VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                1,
+                lightingStages,
+                nullptr
+            },
+            { // Lights.
+                1,
+                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                1,
+                lightingStages,
+                nullptr
+            },
+            { // Light count of each cluster.
+                2,
+                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                1,
+                lightingStages,
+                nullptr
+            },
+            { // Light indices of each cluster.
+                3,
+                VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                1,
+                lightingStages,
+                nullptr
+            }
+        };
+        VkDescriptorSetLayoutCreateInfo lightingLayoutCreateInfo{};
+        lightingLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        lightingLayoutCreateInfo.bindingCount = 4;
+        lightingLayoutCreateInfo.pBindings = lightingLayoutBindings;
+
+        if (vkCreateDescriptorSetLayout(m_logicalDevice->getLogicalDevice(), &lightingLayoutCreateInfo, 
+            nullptr, &m_lightingLayout) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create lighting descriptor set layout.");
+        }  
+        std::cout << "Created lighting descriptor set layout." << std::endl;  
+
         // Create the descriptor pools.
         createModelPool();
         createScenePool();
@@ -114,6 +162,8 @@ namespace KMDM
         vkDestroyDescriptorSetLayout(m_logicalDevice->getLogicalDevice(), m_sceneLayout, nullptr); 
         std::cout << "- Cleaning up model descriptor set layout." << std::endl;
         vkDestroyDescriptorSetLayout(m_logicalDevice->getLogicalDevice(), m_modelLayout, nullptr);         
+        std::cout << "- Cleaning up lighting descriptor set layout." << std::endl;
+        vkDestroyDescriptorSetLayout(m_logicalDevice->getLogicalDevice(), m_lightingLayout, nullptr);
     }
 
   
@@ -247,10 +297,10 @@ namespace KMDM
 
             writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
             writes[1].dstSet = sets[i];
-            writes[1].dstBinding = 0;
+            writes[1].dstBinding = 1;
             writes[1].descriptorCount = 1;
             writes[1].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-            writes[1].pBufferInfo = &sceneBufferInfo;
+            writes[1].pBufferInfo = &uniformBufferInfo;
 
             vkUpdateDescriptorSets(m_logicalDevice->getLogicalDevice(), 
                 static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);        
@@ -273,7 +323,7 @@ namespace KMDM
         std::vector<VkDescriptorSet> sets;
         sets.resize(models.size());
 
-        std::vector<VkDescriptorSetLayout> layouts(models.size(), m_sceneLayout);
+        std::vector<VkDescriptorSetLayout> layouts(models.size(), m_modelLayout);
         VkDescriptorSetAllocateInfo allocInfo{};
         allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
         allocInfo.descriptorPool = m_modelDescriptorPool;
@@ -299,6 +349,7 @@ namespace KMDM
             VkDescriptorImageInfo modelImageInfo{};
             modelImageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
             modelImageInfo.imageView = models[i].getTextureImageView();
+            // Ignored, the layout's immutable sampler is used.
             modelImageInfo.sampler = models[i].getTextureSampler();
 
             std::array<VkWriteDescriptorSet, 2> writes{};
@@ -342,6 +393,7 @@ namespace KMDM
 
     VkDescriptorSetLayout DescriptorSet::getSceneLayout() { return m_sceneLayout; }
     VkDescriptorSetLayout DescriptorSet::getModelLayout() { return m_modelLayout; }
+    VkDescriptorSetLayout DescriptorSet::getLightingLayout() { return m_lightingLayout; }
     VkDescriptorPool DescriptorSet::getSceneDescriptorPool() { return m_sceneDescriptorPool; }
     VkDescriptorPool DescriptorSet::getModelDescriptorPool() { return m_modelDescriptorPool; }
 }
\ No newline at end of file
@@ -0,0 +1,532 @@
+#include "../include/DynamicResolution.h"
+#include "../include/SwapChain.h"
+#include "../include/PhysicalDevice.h"
+#include "../include/PipelineCache.h"
+#include "../include/SamplerCache.h"
+#include "../include/Util.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+namespace KMDM
+{
+    namespace
+    {
+        // Must match local_size_x and local_size_y of upscale.comp.
+        const uint32_t UPSCALE_GROUP_SIZE = 8;
+
+        // Weight of a new frame time in the smoothed one.
+        const float FRAME_TIME_SMOOTHING = 0.2f;
+
+        // The scale is left alone within this distance of the ideal one, and moves at most
+        // MAX_SCALE_STEP per frame, so one slow frame does not drop the resolution at once.
+        const float SCALE_DEADBAND = 0.02f;
+        const float MAX_SCALE_STEP = 0.05f;
+
+        struct UpscaleConstants
+        {
+            glm::vec4 renderSize;
+            glm::vec4 outputSize;
+            glm::vec4 jitter;
+        };
+
+        // Low discrepancy sample positions in [0, 1).
+        float halton(uint32_t index, uint32_t base)
+        {
+            float result = 0.0f;
+            float fraction = 1.0f / base;
+            while (index > 0)
+            {
+                result += fraction * (index % base);
+                index /= base;
+                fraction /= base;
+            }
+            return result;
+        }
+    }
+
+    /**
+     * @brief Construct a new DynamicResolution object
+     *
+     * @param depth_view
+     * @param image_count
+     */
+    DynamicResolution::DynamicResolution(VkImageView depth_view, uint32_t image_count)
+    {
+        m_logicalDevice = LogicalDevice::getInstance();
+        m_imageCount = image_count;
+        m_extent = SwapChain::getInstance()->getSwapChainExtent();
+
+        m_targetFrameTime = TARGET_FRAME_TIME_MS;
+        m_renderScale = 1.0f;
+        m_gpuFrameTime = 0.0f;
+        m_renderExtent = m_extent;
+        m_frame = 0;
+        m_jitter = glm::vec2(0.0f);
+        m_historyIndex = 0;
+        m_historyValid = false;
+
+        // Without timestamps on the graphics queue the scale stays where it is set.
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(PhysicalDevice::getInstance()->getPhysicalDevice(), &properties);
+        m_timestampPeriod = properties.limits.timestampComputeAndGraphics ? properties.limits.timestampPeriod : 0.0f;
+
+        createQueryPool();
+
+        m_renderPass = new Renderpass(RenderpassType::Upscaled);
+        createTargets(depth_view);
+        createPipeline();
+        std::cout << "Created dynamic resolution." << std::endl;
+    }
+
+    /**
+     * @brief Destroy the DynamicResolution object
+     *
+     */
+    DynamicResolution::~DynamicResolution()
+    {
+        destroyDynamicResolution();
+    }
+
+    /**
+     * @brief Destroy the targets, upscale pipeline and query pool.  The samplers belong to the
+     * SamplerCache.
+     *
+     */
+    void DynamicResolution::destroyDynamicResolution()
+    {
+        std::cout << "- Destroying dynamic resolution." << std::endl;
+        VkDevice device = m_logicalDevice->getLogicalDevice();
+
+        vkDestroyPipeline(device, m_pipeline, nullptr);
+        vkDestroyPipelineLayout(device, m_pipelineLayout, nullptr);
+        vkDestroyDescriptorPool(device, m_descriptorPool, nullptr);
+        vkDestroyDescriptorSetLayout(device, m_setLayout, nullptr);
+
+        vkDestroyFramebuffer(device, m_framebuffer, nullptr);
+        delete(m_renderPass);
+
+        RenderTargetPool* pool = RenderTargetPool::getInstance();
+        pool->release(m_sceneColorTarget);
+        pool->release(m_motionTarget);
+        pool->release(m_historyTargets[0]);
+        pool->release(m_historyTargets[1]);
+
+        vkDestroyQueryPool(device, m_queryPool, nullptr);
+    }
+
+    /**
+     * @brief Follow a swap chain resize.  The old targets go back to the pool, the old framebuffer is
+     * destroyed once the frames in flight are done with it, and the history starts over.
+     *
+     * @param depth_view
+     */
+    void DynamicResolution::resize(VkImageView depth_view)
+    {
+        RenderTargetPool* pool = RenderTargetPool::getInstance();
+        pool->release(m_sceneColorTarget);
+        pool->release(m_motionTarget);
+        pool->release(m_historyTargets[0]);
+        pool->release(m_historyTargets[1]);
+        VkDevice device = m_logicalDevice->getLogicalDevice();
+        VkFramebuffer framebuffer = m_framebuffer;
+        pool->retire([device, framebuffer]()
+        {
+            vkDestroyFramebuffer(device, framebuffer, nullptr);
+        });
+
+        m_extent = SwapChain::getInstance()->getSwapChainExtent();
+        m_renderExtent = m_extent;
+        createTargets(depth_view);
+        writeDescriptorSets();
+    }
+
+    /**
+     * @brief Follow a change of the swap chain image count.  The old query pool is destroyed once
+     * the frames in flight are done with it.
+     *
+     * @param image_count
+     */
+    void DynamicResolution::setImageCount(uint32_t image_count)
+    {
+        if (image_count == m_imageCount)
+        {
+            return;
+        }
+        VkDevice device = m_logicalDevice->getLogicalDevice();
+        VkQueryPool queryPool = m_queryPool;
+        RenderTargetPool::getInstance()->retire([device, queryPool]()
+        {
+            vkDestroyQueryPool(device, queryPool, nullptr);
+        });
+
+        m_imageCount = image_count;
+        createQueryPool();
+    }
+
+    /**
+     * @brief Create the frame timestamps, a pair per swap chain image.
+     *
+     */
+    void DynamicResolution::createQueryPool()
+    {
+        VkQueryPoolCreateInfo queryInfo = {};
+        queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryInfo.queryCount = 2 * m_imageCount;
+        if (vkCreateQueryPool(m_logicalDevice->getLogicalDevice(), &queryInfo, nullptr, &m_queryPool) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create frame timestamp query pool.");
+        }
+    }
+
+    /******************************************************************
+        The scene targets are swap chain sized so the scale can change
+        every frame without reallocating; the scene only covers their
+        top left.  The history starts invalid, so the first frame
+        does not read it.
+    *******************************************************************/
+    void DynamicResolution::createTargets(VkImageView depth_view)
+    {
+        RenderTargetPool* pool = RenderTargetPool::getInstance();
+
+        RenderImageDesc colorDesc = {};
+        colorDesc.format = SCENE_COLOR_FORMAT;
+        colorDesc.extent = m_extent;
+        colorDesc.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        colorDesc.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+        m_sceneColorTarget = pool->acquire(colorDesc);
+
+        RenderImageDesc motionDesc = colorDesc;
+        motionDesc.format = MOTION_VECTOR_FORMAT;
+        m_motionTarget = pool->acquire(motionDesc);
+
+        RenderImageDesc historyDesc = colorDesc;
+        historyDesc.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        for (uint32_t i = 0; i < 2; i++)
+        {
+            m_historyTargets[i] = pool->acquire(historyDesc);
+        }
+        m_historyValid = false;
+
+        VkImageView attachments[] = { m_sceneColorTarget.view, m_motionTarget.view, depth_view };
+        VkFramebufferCreateInfo frameInfo = {};
+        frameInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        frameInfo.renderPass = m_renderPass->getRenderPass();
+        frameInfo.attachmentCount = 3;
+        frameInfo.pAttachments = attachments;
+        frameInfo.width = m_extent.width;
+        frameInfo.height = m_extent.height;
+        frameInfo.layers = 1;
+
+        if (vkCreateFramebuffer(m_logicalDevice->getLogicalDevice(), &frameInfo, nullptr, &m_framebuffer)
+            != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create upscale framebuffer.");
+        }
+    } /// createTargets
+
+    /******************************************************************
+        Set 0 of upscale.comp.  Set i reads history i and writes the
+        other one.
+    *******************************************************************/
+    void DynamicResolution::createPipeline()
+    {
+        VkDevice device = m_logicalDevice->getLogicalDevice();
+
+        VkSamplerCreateInfo samplerInfo = {};
+        samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+        samplerInfo.magFilter = VK_FILTER_NEAREST;
+        samplerInfo.minFilter = VK_FILTER_NEAREST;
+        samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+        samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+        samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_TRANSPARENT_BLACK;
+        m_pointSampler = SamplerCache::getInstance()->getSampler(samplerInfo);
+        samplerInfo.magFilter = VK_FILTER_LINEAR;
+        samplerInfo.minFilter = VK_FILTER_LINEAR;
+        m_linearSampler = SamplerCache::getInstance()->getSampler(samplerInfo);
+
+        VkDescriptorSetLayoutBinding bindings[] = {
+            { 0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },  // Scene color.
+            { 1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },  // Motion.
+            { 2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },  // History.
+            { 3, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr }            // Output.
+        };
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = 4;
+        layoutInfo.pBindings = bindings;
+
+        if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &m_setLayout) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create upscale descriptor set layout.");
+        }
+
+        std::array<VkDescriptorPoolSize, 2> sizes = {};
+        sizes[0] = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 6 };
+        sizes[1] = { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2 };
+
+        VkDescriptorPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.maxSets = 2;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(sizes.size());
+        poolInfo.pPoolSizes = sizes.data();
+
+        if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create upscale descriptor pool.");
+        }
+
+        VkDescriptorSetLayout layouts[] = { m_setLayout, m_setLayout };
+        VkDescriptorSetAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = m_descriptorPool;
+        allocInfo.descriptorSetCount = 2;
+        allocInfo.pSetLayouts = layouts;
+
+        if (vkAllocateDescriptorSets(device, &allocInfo, m_descriptorSets) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to allocate upscale descriptor sets.");
+        }
+
+        writeDescriptorSets();
+
+        VkPushConstantRange pushRange = {};
+        pushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        pushRange.offset = 0;
+        pushRange.size = sizeof(UpscaleConstants);
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = 1;
+        pipelineLayoutInfo.pSetLayouts = &m_setLayout;
+        pipelineLayoutInfo.pushConstantRangeCount = 1;
+        pipelineLayoutInfo.pPushConstantRanges = &pushRange;
+
+        if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &m_pipelineLayout) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create upscale pipeline layout.");
+        }
+
+        VkShaderModule module = m_logicalDevice->createShaderModule(readFile(SHADER_PATH "upscale_comp.spv"));
+
+        VkComputePipelineCreateInfo pipelineInfo = {};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = module;
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.layout = m_pipelineLayout;
+
+        VkResult result = vkCreateComputePipelines(device, PipelineCache::getInstance()->getPipelineCache(), 1,
+            &pipelineInfo, nullptr, &m_pipeline);
+        vkDestroyShaderModule(device, module, nullptr);
+        if (result != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create upscale pipeline.");
+        }
+    } /// createPipeline
+
+    /**
+     * @brief Point both sets at the current targets.
+     *
+     */
+    void DynamicResolution::writeDescriptorSets()
+    {
+        for (uint32_t i = 0; i < 2; i++)
+        {
+            std::array<VkDescriptorImageInfo, 4> imageInfos = {};
+            imageInfos[0] = { m_pointSampler, m_sceneColorTarget.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+            imageInfos[1] = { m_pointSampler, m_motionTarget.view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+            imageInfos[2] = { m_linearSampler, m_historyTargets[i].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+            imageInfos[3] = { VK_NULL_HANDLE, m_historyTargets[1 - i].view, VK_IMAGE_LAYOUT_GENERAL };
+
+            std::array<VkWriteDescriptorSet, 4> writes = {};
+            for (uint32_t j = 0; j < writes.size(); j++)
+            {
+                writes[j].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+                writes[j].dstSet = m_descriptorSets[i];
+                writes[j].dstBinding = j;
+                writes[j].descriptorCount = 1;
+                writes[j].descriptorType = j < 3 ? VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER :
+                    VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+                writes[j].pImageInfo = &imageInfos[j];
+            }
+            vkUpdateDescriptorSets(m_logicalDevice->getLogicalDevice(), static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+        }
+    }
+
+    /**
+     * @brief Pick the render extent and jitter of the next frame.
+     *
+     */
+    void DynamicResolution::beginFrame()
+    {
+        m_renderExtent.width = std::max(1u, static_cast<uint32_t>(std::lround(m_extent.width * m_renderScale)));
+        m_renderExtent.height = std::max(1u, static_cast<uint32_t>(std::lround(m_extent.height * m_renderScale)));
+
+        // Halton (2, 3) offsets in render pixels, centered on the pixel.
+        uint32_t phase = static_cast<uint32_t>(m_frame % JITTER_PHASES) + 1;
+        m_jitter = glm::vec2(halton(phase, 2), halton(phase, 3)) - 0.5f;
+    }
+
+    /******************************************************************
+        GPU time grows with the pixels drawn, the square of the scale,
+        so the scale that would just meet the target is the current
+        one times the square root of target over measured time.
+    *******************************************************************/
+    void DynamicResolution::endFrame(uint32_t image)
+    {
+        if (m_timestampPeriod > 0.0f)
+        {
+            uint64_t timestamps[2];
+            if (vkGetQueryPoolResults(m_logicalDevice->getLogicalDevice(), m_queryPool, 2 * image, 2,
+                sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT)
+                == VK_SUCCESS)
+            {
+                float frameTime = (timestamps[1] - timestamps[0]) * m_timestampPeriod / 1.0e6f;
+                m_gpuFrameTime = m_gpuFrameTime > 0.0f ?
+                    m_gpuFrameTime + (frameTime - m_gpuFrameTime) * FRAME_TIME_SMOOTHING : frameTime;
+
+                float ideal = m_renderScale * std::sqrt(m_targetFrameTime / std::max(m_gpuFrameTime, 0.001f));
+                if (std::fabs(ideal - m_renderScale) > SCALE_DEADBAND)
+                {
+                    m_renderScale += std::clamp(ideal - m_renderScale, -MAX_SCALE_STEP, MAX_SCALE_STEP);
+                    m_renderScale = std::clamp(m_renderScale, MIN_RENDER_SCALE, 1.0f);
+                }
+            }
+        }
+
+        // This frame's output is the next frame's history.
+        m_historyIndex = 1 - m_historyIndex;
+        m_historyValid = true;
+        m_frame++;
+    } /// endFrame
+
+    /**
+     * @brief Reset and write the first timestamp of an image's frame.
+     *
+     * @param command_buffer
+     * @param image
+     */
+    void DynamicResolution::recordFrameStart(VkCommandBuffer command_buffer, uint32_t image)
+    {
+        vkCmdResetQueryPool(command_buffer, m_queryPool, 2 * image, 2);
+        vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, m_queryPool, 2 * image);
+    }
+
+    /**
+     * @brief Write the last timestamp of an image's frame.
+     *
+     * @param command_buffer
+     * @param image
+     */
+    void DynamicResolution::recordFrameEnd(VkCommandBuffer command_buffer, uint32_t image)
+    {
+        vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, m_queryPool, 2 * image + 1);
+    }
+
+    /**
+     * @brief Add the scene targets to a frame graph.  They are cleared every frame.
+     *
+     * @param graph
+     * @return UpscaleResources
+     */
+    UpscaleResources DynamicResolution::importTargets(RenderGraph& graph)
+    {
+        UpscaleResources targets = {};
+        targets.sceneColor = graph.importImage("scene_color", m_sceneColorTarget.image, m_sceneColorTarget.view,
+            m_sceneColorTarget.desc, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        targets.motionVectors = graph.importImage("motion_vectors", m_motionTarget.image, m_motionTarget.view,
+            m_motionTarget.desc, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        return targets;
+    }
+
+    /******************************************************************
+        1) upscale: accumulate the scene into the history written this
+           frame, from the one written last frame.
+        2) upscale_present: blit it to the swap chain image.
+        Both histories are left in TRANSFER_SRC_OPTIMAL, the layout
+        the present blit leaves the output in.  Until a frame has
+        written one they hold nothing, and are taken from UNDEFINED.
+    *******************************************************************/
+    void DynamicResolution::addUpscalePasses(RenderGraph& graph, const UpscaleResources& targets,
+        RenderResource color)
+    {
+        uint32_t read = m_historyIndex;
+        uint32_t write = 1 - m_historyIndex;
+        VkImageLayout initialLayout = m_historyValid ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED;
+        const RenderTarget& readTarget = m_historyTargets[read];
+        const RenderTarget& writeTarget = m_historyTargets[write];
+        RenderResource history = graph.importImage("upscale_history", readTarget.image, readTarget.view,
+            readTarget.desc, initialLayout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT);
+        RenderResource output = graph.importImage("upscale_output", writeTarget.image, writeTarget.view,
+            writeTarget.desc, initialLayout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+        UpscaleConstants constants = {};
+        constants.renderSize = glm::vec4(m_renderExtent.width, m_renderExtent.height,
+            1.0f / m_renderExtent.width, 1.0f / m_renderExtent.height);
+        constants.outputSize = glm::vec4(m_extent.width, m_extent.height,
+            1.0f / m_extent.width, 1.0f / m_extent.height);
+        constants.jitter = glm::vec4(m_jitter, m_historyValid ? 1.0f : 0.0f, 0.0f);
+
+        VkDescriptorSet set = m_descriptorSets[read];
+        graph.addPass("upscale", [constants, set, this](VkCommandBuffer commandBuffer, RenderGraph&)
+        {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipeline);
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_pipelineLayout, 0, 1, &set, 0,
+                nullptr);
+            vkCmdPushConstants(commandBuffer, m_pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(constants),
+                &constants);
+            vkCmdDispatch(commandBuffer, (m_extent.width + UPSCALE_GROUP_SIZE - 1) / UPSCALE_GROUP_SIZE,
+                (m_extent.height + UPSCALE_GROUP_SIZE - 1) / UPSCALE_GROUP_SIZE, 1);
+        })
+            .read(targets.sceneColor, RenderAccess::Sampled)
+            .read(targets.motionVectors, RenderAccess::Sampled)
+            .read(history, RenderAccess::Sampled)
+            .write(output, RenderAccess::StorageWrite);
+
+        graph.addPass("upscale_present", [output, color, this](VkCommandBuffer commandBuffer,
+            RenderGraph& pass_graph)
+        {
+            VkImageBlit blit = {};
+            blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+            blit.srcOffsets[1] = { static_cast<int32_t>(m_extent.width), static_cast<int32_t>(m_extent.height), 1 };
+            blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+            blit.dstOffsets[1] = blit.srcOffsets[1];
+            vkCmdBlitImage(commandBuffer, pass_graph.getImage(output), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                pass_graph.getImage(color), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_NEAREST);
+        })
+            .read(output, RenderAccess::TransferSrc)
+            .write(color, RenderAccess::TransferDst);
+    } /// addUpscalePasses
+
+    /**
+     * @brief Offset the projection by this frame's jitter, in render pixels.
+     *
+     * @param projection
+     * @return glm::mat4
+     */
+    glm::mat4 DynamicResolution::jitterProjection(const glm::mat4& projection)
+    {
+        // Clip w is -z in view space, so the offsets are subtracted to move the image by +jitter.
+        glm::mat4 jittered = projection;
+        jittered[2][0] -= 2.0f * m_jitter.x / m_renderExtent.width;
+        jittered[2][1] -= 2.0f * m_jitter.y / m_renderExtent.height;
+        return jittered;
+    }
+
+    void DynamicResolution::setTargetFrameTime(float milliseconds) { m_targetFrameTime = milliseconds; }
+    VkExtent2D DynamicResolution::getRenderExtent() { return m_renderExtent; }
+    float DynamicResolution::getRenderScale() { return m_renderScale; }
+    float DynamicResolution::getGpuFrameTime() { return m_gpuFrameTime; }
+    Renderpass* DynamicResolution::getRenderPass() { return m_renderPass; }
+    VkFramebuffer DynamicResolution::getFramebuffer() { return m_framebuffer; }
+}
@@ -0,0 +1,236 @@
+#include "../include/FrameCapture.h"
+#include "../include/Renderer.h"
+#include "../include/SwapChain.h"
+#include "../include/CpuProfiler.h"
+
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+
+namespace KMDM
+{
+    namespace
+    {
+        std::string numbered(const char* format, uint64_t number)
+        {
+            char name[32];
+            std::snprintf(name, sizeof(name), format, static_cast<unsigned long long>(number));
+            return name;
+        }
+    }
+
+    /**
+     * @brief Construct a new Frame Capture:: Frame Capture object
+     *
+     * @param directory
+     * @param format
+     * @param slots
+     */
+    FrameCapture::FrameCapture(std::string directory, CaptureFormat format, uint32_t slots) :
+        m_directory(directory),
+        m_format(format)
+    {
+        std::filesystem::create_directories(m_directory);
+        m_readbackRing = new ReadbackRing(slots);
+        m_imageWriter = new ImageWriter();
+        std::cout << "Created frame capture." << std::endl;
+    }
+
+    /**
+     * @brief Destroy the Frame Capture:: Frame Capture object
+     *
+     */
+    FrameCapture::~FrameCapture()
+    {
+        destroyFrameCapture();
+    }
+
+    /**
+     * @brief Write out what was captured, then destroy the writer and the ring.
+     *
+     */
+    void FrameCapture::destroyFrameCapture()
+    {
+        if (!m_readbackRing)
+        {
+            return;
+        }
+        std::cout << "- Cleaning up FrameCapture." << std::endl;
+        stop();
+        flush();
+        delete(m_imageWriter);
+        m_imageWriter = nullptr;
+        delete(m_readbackRing);
+        m_readbackRing = nullptr;
+    }
+
+    /**
+     * @brief Start a new session in the next free session directory.
+     *
+     * @return true
+     * @return false
+     */
+    bool FrameCapture::start()
+    {
+        if (m_recording)
+        {
+            return true;
+        }
+        if (!SwapChain::getInstance()->isReadable())
+        {
+            std::cerr << "Frames cannot be recorded, the swapchain images cannot be read back." << std::endl;
+            return false;
+        }
+        while (std::filesystem::exists(m_directory + "/" + numbered("session_%03llu", m_session)))
+        {
+            m_session++;
+        }
+        std::filesystem::create_directories(m_directory + "/" + numbered("session_%03llu", m_session));
+
+        m_recording = true;
+        m_frame = 0;
+        m_captured = 0;
+        m_dropped = 0;
+        std::cout << "Recording to " << m_directory << "/" << numbered("session_%03llu", m_session) << "."
+                  << std::endl;
+        return true;
+    }
+
+    /**
+     * @brief Stop recording.  The frames still being copied and written are waited for, so a raw
+     * stream is complete when this returns.
+     *
+     */
+    void FrameCapture::stop()
+    {
+        if (!m_recording)
+        {
+            return;
+        }
+        // The frame asked for in the last update is not drawn yet, and would land after the stream closes.
+        m_recording = false;
+        Renderer::getInstance()->captureNextFrame(nullptr, 0);
+        flush();
+        m_outputs.clear();
+        m_imageWriter->closeStreams();
+        std::cout << "Recorded " << m_captured << " of " << m_frame << " frames, dropped " << m_dropped << "."
+                  << std::endl;
+        m_session++;
+    }
+
+    bool FrameCapture::isRecording()
+    {
+        return m_recording;
+    }
+
+    /******************************************************************
+        Retire the finished copies, then ask for this frame to be
+        copied if a slot is free.  A full ring drops the frame, the
+        render thread never waits for the writer.
+    *******************************************************************/
+    void FrameCapture::update()
+    {
+        KMDM_PROFILE_ZONE("frameCapture");
+        writeCompleted();
+        if (!m_recording)
+        {
+            return;
+        }
+
+        if (m_readbackRing->hasFreeSlot())
+        {
+            std::string session = m_directory + "/" + numbered("session_%03llu", m_session);
+            PendingOutput output = {};
+            switch (m_format)
+            {
+                case CaptureFormat::Png:
+                    output = { session + "/" + numbered("frame_%06llu.png", m_frame), ImageEncoding::Png };
+                    break;
+                case CaptureFormat::Qoi:
+                    output = { session + "/" + numbered("frame_%06llu.qoi", m_frame), ImageEncoding::Qoi };
+                    break;
+                case CaptureFormat::RawVideo:
+                    output = { session + "/frames", ImageEncoding::Raw };
+                    break;
+            }
+            m_outputs[m_nextTag] = output;
+            Renderer::getInstance()->captureNextFrame(m_readbackRing, m_nextTag++);
+            m_captured++;
+        }
+        else
+        {
+            m_dropped++;
+        }
+        m_frame++;
+    } /// update
+
+    /**
+     * @brief Copy an image once into the ring.
+     *
+     * @param image
+     * @param format
+     * @param extent
+     * @param layout
+     * @param name
+     * @return true
+     * @return false
+     */
+    bool FrameCapture::captureImage(VkImage image, VkFormat format, VkExtent2D extent, VkImageLayout layout,
+        std::string name)
+    {
+        if (!ImageWriter::isSupported(format))
+        {
+            throw std::runtime_error("Can not write a capture of this format.");
+        }
+        bool png = m_format == CaptureFormat::Png;
+        if (!m_readbackRing->capture(image, format, extent, layout, VK_NULL_HANDLE, m_nextTag))
+        {
+            return false;
+        }
+        m_outputs[m_nextTag++] = { m_directory + "/" + name + (png ? ".png" : ".qoi"),
+            png ? ImageEncoding::Png : ImageEncoding::Qoi };
+        return true;
+    }
+
+    /**
+     * @brief Hand the finished copies to the writer, which releases their slots.  Raw frames go to
+     * the stream for their size.
+     *
+     */
+    void FrameCapture::writeCompleted()
+    {
+        for (auto & image : m_readbackRing->takeCompleted())
+        {
+            ReadbackRing* ring = m_readbackRing;
+            uint32_t slot = image.slot;
+            PendingOutput output = m_outputs[image.tag];
+            m_outputs.erase(image.tag);
+            if (output.encoding == ImageEncoding::Raw)
+            {
+                output.path += "_" + std::to_string(image.extent.width) + "x" + std::to_string(image.extent.height) +
+                    ".rgba";
+            }
+            m_imageWriter->write({ output.path, image.pixels, image.rowPitch, image.extent.width,
+                image.extent.height, image.format, [ring, slot]()
+                {
+                    ring->release(slot);
+                }, output.encoding });
+        }
+    }
+
+    /**
+     * @brief Wait for the copies in flight and write everything out.
+     *
+     */
+    void FrameCapture::flush()
+    {
+        m_readbackRing->waitForCopies();
+        writeCompleted();
+        m_imageWriter->wait();
+    }
+
+    uint64_t FrameCapture::getCapturedCount() { return m_captured; }
+    uint64_t FrameCapture::getDroppedCount() { return m_dropped; }
+    uint64_t FrameCapture::getWrittenCount() { return m_imageWriter->getWrittenCount(); }
+}
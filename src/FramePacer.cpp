@@ -0,0 +1,154 @@
+#include "../include/FramePacer.h"
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+namespace KMDM
+{
+    namespace
+    {
+        // The prediction follows slower frames at once and faster ones by this weight, so a single
+        // fast frame does not make the next one start too late.
+        const float FRAME_COST_SMOOTHING = 0.1f;
+
+        // Sleeps are this much shorter than asked and the rest is spun, the scheduler wakes late.
+        const std::chrono::microseconds SPIN_TIME(500);
+
+        float toMilliseconds(std::chrono::steady_clock::duration duration)
+        {
+            return std::chrono::duration<float, std::milli>(duration).count();
+        }
+    }
+
+    /**
+     * @brief Construct a new FramePacer object
+     *
+     * @param refresh_rate
+     */
+    FramePacer::FramePacer(float refresh_rate)
+    {
+        m_refreshRate = refresh_rate > 0.0f ? refresh_rate : 60.0f;
+        m_frameRateLimit = FRAME_RATE_LIMIT;
+        m_presentMode = PRESENT_MODE;
+        m_deadline = Clock::now();
+        m_frameStart = m_deadline;
+        m_latchTime = m_deadline;
+        m_latched = false;
+        m_predictedFrameMs = 0.0f;
+        m_totalLatencyMs = 0.0;
+        updateInterval();
+        std::cout << "Created frame pacer at " << m_refreshRate << " Hz." << std::endl;
+    }
+
+    /**
+     * @brief Destroy the FramePacer object
+     *
+     */
+    FramePacer::~FramePacer()
+    {
+        destroyFramePacer();
+    }
+
+    void FramePacer::destroyFramePacer()
+    {
+        std::cout << "- Destroying frame pacer (" << m_stats.averageLatencyMs << " ms average latency over "
+                  << m_stats.frames << " frames)." << std::endl;
+    }
+
+    /******************************************************************
+        Start the frame as late as it can and still be presented by
+        its deadline.
+    *******************************************************************/
+    void FramePacer::waitForFrame()
+    {
+        Clock::time_point now = Clock::now();
+        m_stats.sleepMs = 0.0f;
+        if (m_interval != Clock::duration::zero())
+        {
+            auto predicted = std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<float, std::milli>(m_predictedFrameMs + FRAME_PACING_MARGIN_MS));
+            Clock::time_point start = m_deadline - predicted;
+            if (start > now)
+            {
+                if (start - now > SPIN_TIME)
+                {
+                    std::this_thread::sleep_until(start - SPIN_TIME);
+                }
+                while (Clock::now() < start)
+                {
+                    std::this_thread::yield();
+                }
+                m_stats.sleepMs = toMilliseconds(Clock::now() - now);
+            }
+        }
+        m_frameStart = Clock::now();
+        m_latched = false;
+    } /// waitForFrame
+
+    void FramePacer::latch()
+    {
+        m_latchTime = Clock::now();
+        m_latched = true;
+    }
+
+    /******************************************************************
+        Frames that miss their deadline restart the schedule from now
+        rather than rushing to catch up.
+    *******************************************************************/
+    void FramePacer::framePresented()
+    {
+        Clock::time_point now = Clock::now();
+
+        float frameMs = toMilliseconds(now - m_frameStart);
+        m_predictedFrameMs = frameMs > m_predictedFrameMs ? frameMs :
+            m_predictedFrameMs + (frameMs - m_predictedFrameMs) * FRAME_COST_SMOOTHING;
+
+        if (m_latched)
+        {
+            float latencyMs = toMilliseconds(now - m_latchTime);
+            m_stats.frames++;
+            m_stats.latencyMs = latencyMs;
+            m_stats.maxLatencyMs = std::max(m_stats.maxLatencyMs, latencyMs);
+            m_totalLatencyMs += latencyMs;
+            m_stats.averageLatencyMs = static_cast<float>(m_totalLatencyMs / m_stats.frames);
+        }
+        m_stats.predictedFrameMs = m_predictedFrameMs;
+
+        m_deadline += m_interval;
+        if (m_deadline < now)
+        {
+            m_deadline = now + m_interval;
+        }
+    } /// framePresented
+
+    /**
+     * @brief The FIFO modes present once per refresh whatever the limit, so they are paced to the
+     * slower of the two.
+     *
+     */
+    void FramePacer::updateInterval()
+    {
+        float rate = m_frameRateLimit;
+        if (m_presentMode == VK_PRESENT_MODE_FIFO_KHR || m_presentMode == VK_PRESENT_MODE_FIFO_RELAXED_KHR)
+        {
+            rate = rate > 0.0f ? std::min(rate, m_refreshRate) : m_refreshRate;
+        }
+        m_interval = rate > 0.0f ? std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<float>(1.0f / rate)) : Clock::duration::zero();
+    }
+
+    void FramePacer::setPresentMode(VkPresentModeKHR mode)
+    {
+        m_presentMode = mode;
+        updateInterval();
+    }
+
+    void FramePacer::setFrameRateLimit(float frames_per_second)
+    {
+        m_frameRateLimit = std::max(frames_per_second, 0.0f);
+        updateInterval();
+    }
+
+    FramePacingStats FramePacer::getStats() { return m_stats; }
+}
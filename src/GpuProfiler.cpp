@@ -0,0 +1,709 @@
+#include "../include/GpuProfiler.h"
+#include "../include/LogicalDevice.h"
+#include "../include/PhysicalDevice.h"
+#include "../include/SwapChain.h"
+#include "../include/RenderTargetPool.h"
+
+#include <vulkan/vulkan.h>
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+
+namespace KMDM
+{
+    GpuProfiler* GpuProfiler::m_gpuProfiler = nullptr;
+
+    // Counted statistics, in the order results are returned.
+    static const VkQueryPipelineStatisticFlags PIPELINE_STATISTICS =
+        VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_CLIPPING_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT |
+        VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+    static const uint32_t PIPELINE_STATISTIC_COUNT = 7;
+
+    /**
+     * @brief Get the Instance object
+     *
+     * @return GpuProfiler*
+     */
+    GpuProfiler* GpuProfiler::getInstance()
+    {
+        if (!m_gpuProfiler)
+        {
+            m_gpuProfiler = new GpuProfiler();
+        }
+        return m_gpuProfiler;
+    }
+
+    GpuProfiler* GpuProfiler::findInstance()
+    {
+        return m_gpuProfiler;
+    }
+
+    /******************************************************************
+        Timestamps need timestampComputeAndGraphics, or valid bits on
+        the graphics family, and a GPU_PROFILER build setting.
+        Without them every call is a no-op.
+    *******************************************************************/
+    GpuProfiler::GpuProfiler() :
+        m_enabled(false),
+        m_timestampPeriod(0.0f),
+        m_timestampMask(0),
+        m_imageCount(0),
+        m_frame(0),
+        m_countersSupported(false),
+        m_preciseOcclusion(false),
+        m_counterLevel(GpuCounterLevel::Off)
+    {
+        VkPhysicalDevice physicalDevice = PhysicalDevice::getInstance()->getPhysicalDevice();
+        VkPhysicalDeviceProperties properties = PhysicalDevice::getInstance()->getPhysicalDeviceProperties();
+        m_timestampPeriod = properties.limits.timestampPeriod;
+
+        uint32_t familyCount = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, nullptr);
+        std::vector<VkQueueFamilyProperties> families(familyCount);
+        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &familyCount, families.data());
+        uint32_t graphicsFamily = LogicalDevice::getInstance()->getQueueFamilyInfo().graphicsFamilyIndex.value();
+        uint32_t validBits = families[graphicsFamily].timestampValidBits;
+        m_timestampMask = validBits >= 64 ? ~0ull : (1ull << validBits) - 1;
+
+        m_enabled = GPU_PROFILER && validBits > 0 && m_timestampPeriod > 0.0f;
+        if (!m_enabled)
+        {
+            std::cout << "Created GPU profiler, timestamps are not available." << std::endl;
+            return;
+        }
+
+        VkPhysicalDeviceFeatures features = PhysicalDevice::getInstance()->getPhysicalDeviceFeatures();
+        m_countersSupported = features.pipelineStatisticsQuery == VK_TRUE;
+        m_preciseOcclusion = features.occlusionQueryPrecise == VK_TRUE;
+
+        m_imageCount = static_cast<uint32_t>(SwapChain::getInstance()->getSwapChainImages().size());
+        createQueryPools();
+        std::cout << "Created GPU profiler" << (m_countersSupported ? " with pipeline statistics." : ".") << std::endl;
+    }
+
+    /**
+     * @brief Create the query pools of every slot, and split them into regions for m_imageCount
+     * swap chain images.
+     *
+     */
+    void GpuProfiler::createQueryPools()
+    {
+        // A region per swap chain image and one for uploads, each with room for GPU_PROFILER_MAX_SCOPES.
+        uint32_t regionCount = m_imageCount + 1;
+        uint32_t regionSize = 2 * GPU_PROFILER_MAX_SCOPES;
+
+        VkQueryPoolCreateInfo queryInfo = {};
+        queryInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryInfo.queryCount = regionCount * regionSize;
+
+        // Nothing is reset here, which would wait for the queue.  Each scope resets its own queries in
+        // the command buffer that writes them, and collect() only asks for those.
+        m_slots.resize(MAX_FRAMES_IN_FLIGHT);
+        for (auto & slot : m_slots)
+        {
+            if (vkCreateQueryPool(LogicalDevice::getInstance()->getLogicalDevice(), &queryInfo, nullptr, &slot.pool)
+                != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to create GPU profiler query pool.");
+            }
+
+            slot.regions.resize(regionCount);
+            for (uint32_t i = 0; i < regionCount; i++)
+            {
+                slot.regions[i].firstQuery = i * regionSize;
+                slot.regions[i].firstCounter = i * GPU_PROFILER_MAX_COUNTERS;
+            }
+        }
+
+        // Counter pools have a range per swap chain image, uploads are not counted.
+        if (m_countersSupported)
+        {
+            VkQueryPoolCreateInfo statisticsInfo = {};
+            statisticsInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+            statisticsInfo.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+            statisticsInfo.queryCount = m_imageCount * GPU_PROFILER_MAX_COUNTERS;
+            statisticsInfo.pipelineStatistics = PIPELINE_STATISTICS;
+
+            VkQueryPoolCreateInfo occlusionInfo = statisticsInfo;
+            occlusionInfo.queryType = VK_QUERY_TYPE_OCCLUSION;
+            occlusionInfo.pipelineStatistics = 0;
+
+            for (auto & slot : m_slots)
+            {
+                if (vkCreateQueryPool(LogicalDevice::getInstance()->getLogicalDevice(), &statisticsInfo, nullptr,
+                    &slot.statisticsPool) != VK_SUCCESS ||
+                    vkCreateQueryPool(LogicalDevice::getInstance()->getLogicalDevice(), &occlusionInfo, nullptr,
+                    &slot.occlusionPool) != VK_SUCCESS)
+                {
+                    throw std::runtime_error("Failed to create GPU profiler counter query pools.");
+                }
+            }
+        }
+    } /// createQueryPools
+
+    /**
+     * @brief Follow a change of the swap chain image count.  The old pools are destroyed once the
+     * frames in flight are done with them, and their results are dropped.
+     *
+     * @param image_count
+     */
+    void GpuProfiler::setImageCount(uint32_t image_count)
+    {
+        if (!m_enabled || image_count == m_imageCount)
+        {
+            return;
+        }
+        VkDevice device = LogicalDevice::getInstance()->getLogicalDevice();
+        std::vector<VkQueryPool> pools;
+        for (auto & slot : m_slots)
+        {
+            pools.insert(pools.end(), { slot.pool, slot.statisticsPool, slot.occlusionPool });
+        }
+        RenderTargetPool::getInstance()->retire([device, pools]()
+        {
+            for (auto & pool : pools)
+            {
+                vkDestroyQueryPool(device, pool, nullptr);
+            }
+        });
+        m_slots.clear();
+        m_commandRegions.clear();
+
+        m_imageCount = image_count;
+        createQueryPools();
+    }
+
+    GpuProfiler::~GpuProfiler()
+    {
+        destroyGpuProfiler();
+    }
+
+    /**
+     * @brief Destroy the query pools.
+     *
+     */
+    void GpuProfiler::destroyGpuProfiler()
+    {
+        std::cout << "- Destroying GpuProfiler." << std::endl;
+        for (auto & slot : m_slots)
+        {
+            vkDestroyQueryPool(LogicalDevice::getInstance()->getLogicalDevice(), slot.pool, nullptr);
+            vkDestroyQueryPool(LogicalDevice::getInstance()->getLogicalDevice(), slot.statisticsPool, nullptr);
+            vkDestroyQueryPool(LogicalDevice::getInstance()->getLogicalDevice(), slot.occlusionPool, nullptr);
+        }
+        m_slots.clear();
+        m_gpuProfiler = nullptr;
+    }
+
+    /******************************************************************
+        Collect the slot's last frame if its fence says it is done,
+        otherwise drop it rather than wait.
+    *******************************************************************/
+    void GpuProfiler::beginFrame(uint32_t frame, VkFence fence)
+    {
+        if (!m_enabled)
+        {
+            return;
+        }
+        m_frame = frame;
+        Slot& slot = m_slots[frame];
+        if (vkGetFenceStatus(LogicalDevice::getInstance()->getLogicalDevice(), fence) == VK_SUCCESS)
+        {
+            collect(slot);
+        }
+        slot.submittedImage = -1;
+        clearRegion(slot.regions[m_imageCount]);
+        m_commandRegions.clear();
+    } /// beginFrame
+
+    void GpuProfiler::beginCommandBuffer(VkCommandBuffer command_buffer, uint32_t image)
+    {
+        if (!m_enabled)
+        {
+            return;
+        }
+        Slot& slot = m_slots[m_frame];
+        Region& region = slot.regions[image];
+        clearRegion(region);
+        m_commandRegions[command_buffer] = image;
+
+        // Draw counters begin inside render passes, where queries can not be reset.
+        region.level = m_countersSupported ? m_counterLevel : GpuCounterLevel::Off;
+        if (region.level != GpuCounterLevel::Off)
+        {
+            vkCmdResetQueryPool(command_buffer, slot.statisticsPool, region.firstCounter, GPU_PROFILER_MAX_COUNTERS);
+            vkCmdResetQueryPool(command_buffer, slot.occlusionPool, region.firstCounter, GPU_PROFILER_MAX_COUNTERS);
+        }
+    }
+
+    void GpuProfiler::beginUploadCommandBuffer(VkCommandBuffer command_buffer)
+    {
+        if (!m_enabled)
+        {
+            return;
+        }
+        m_commandRegions[command_buffer] = m_imageCount;
+    }
+
+    void GpuProfiler::frameSubmitted(uint32_t image)
+    {
+        if (!m_enabled)
+        {
+            return;
+        }
+        m_slots[m_frame].submittedImage = static_cast<int32_t>(image);
+    }
+
+    /******************************************************************
+        Each scope resets and writes its own pair of queries.
+    *******************************************************************/
+    void GpuProfiler::beginScope(VkCommandBuffer command_buffer, const std::string& name)
+    {
+        auto it = m_commandRegions.find(command_buffer);
+        if (!m_enabled || it == m_commandRegions.end())
+        {
+            return;
+        }
+        Slot& slot = m_slots[m_frame];
+        Region& region = slot.regions[it->second];
+        if (region.used + 2 > 2 * GPU_PROFILER_MAX_SCOPES)
+        {
+            region.open.push_back(-1);
+            return;
+        }
+
+        uint32_t query = region.firstQuery + region.used;
+        region.used += 2;
+        vkCmdResetQueryPool(command_buffer, slot.pool, query, 2);
+        vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, slot.pool, query);
+        region.open.push_back(static_cast<int32_t>(region.records.size()));
+        region.records.push_back({ name, query });
+    } /// beginScope
+
+    void GpuProfiler::endScope(VkCommandBuffer command_buffer)
+    {
+        auto it = m_commandRegions.find(command_buffer);
+        if (!m_enabled || it == m_commandRegions.end())
+        {
+            return;
+        }
+        Slot& slot = m_slots[m_frame];
+        Region& region = slot.regions[it->second];
+        if (region.open.empty())
+        {
+            throw std::runtime_error("GPU profiler scope ended without one open.");
+        }
+        int32_t record = region.open.back();
+        region.open.pop_back();
+        if (record >= 0)
+        {
+            vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, slot.pool,
+                region.records[record].query + 1);
+        }
+    }
+
+    void GpuProfiler::beginPassCounters(VkCommandBuffer command_buffer, const std::string& name)
+    {
+        beginCounters(command_buffer, name, -1);
+    }
+
+    void GpuProfiler::endPassCounters(VkCommandBuffer command_buffer)
+    {
+        auto it = m_commandRegions.find(command_buffer);
+        if (!m_enabled || it == m_commandRegions.end())
+        {
+            return;
+        }
+        Region& region = m_slots[m_frame].regions[it->second];
+        if (region.level == GpuCounterLevel::Passes)
+        {
+            endCounters(command_buffer);
+        }
+        region.pass.clear();
+    }
+
+    void GpuProfiler::beginDrawCounters(VkCommandBuffer command_buffer, uint32_t model)
+    {
+        beginCounters(command_buffer, "", static_cast<int32_t>(model));
+    }
+
+    void GpuProfiler::endDrawCounters(VkCommandBuffer command_buffer)
+    {
+        auto it = m_commandRegions.find(command_buffer);
+        if (!m_enabled || it == m_commandRegions.end())
+        {
+            return;
+        }
+        if (m_slots[m_frame].regions[it->second].level == GpuCounterLevel::Draws)
+        {
+            endCounters(command_buffer);
+        }
+    }
+
+    /******************************************************************
+        Begin a counter pair for a pass, or for a draw when model is
+        not -1, if that is the level of the command buffer.  A pass
+        at the Draws level only names the pass of its draws.
+    *******************************************************************/
+    void GpuProfiler::beginCounters(VkCommandBuffer command_buffer, const std::string& pass, int32_t model)
+    {
+        auto it = m_commandRegions.find(command_buffer);
+        if (!m_enabled || it == m_commandRegions.end())
+        {
+            return;
+        }
+        Slot& slot = m_slots[m_frame];
+        Region& region = slot.regions[it->second];
+        if (it->second == m_imageCount || region.level == GpuCounterLevel::Off)
+        {
+            return;
+        }
+        if (model < 0)
+        {
+            region.pass = pass;
+        }
+        GpuCounterLevel level = model < 0 ? GpuCounterLevel::Passes : GpuCounterLevel::Draws;
+        if (region.level != level)
+        {
+            return;
+        }
+        if (region.openCounter >= 0)
+        {
+            throw std::runtime_error("GPU profiler counters begun while others are open.");
+        }
+        if (region.countersUsed == GPU_PROFILER_MAX_COUNTERS)
+        {
+            return;
+        }
+
+        uint32_t query = region.firstCounter + region.countersUsed;
+        region.countersUsed++;
+        vkCmdBeginQuery(command_buffer, slot.statisticsPool, query, 0);
+        vkCmdBeginQuery(command_buffer, slot.occlusionPool, query,
+            m_preciseOcclusion ? VK_QUERY_CONTROL_PRECISE_BIT : 0);
+        region.openCounter = static_cast<int32_t>(region.counterRecords.size());
+        region.counterRecords.push_back({ region.pass, model, query });
+    } /// beginCounters
+
+    void GpuProfiler::endCounters(VkCommandBuffer command_buffer)
+    {
+        Slot& slot = m_slots[m_frame];
+        Region& region = slot.regions[m_commandRegions[command_buffer]];
+        if (region.openCounter < 0)
+        {
+            return;
+        }
+        uint32_t query = region.counterRecords[region.openCounter].query;
+        vkCmdEndQuery(command_buffer, slot.occlusionPool, query);
+        vkCmdEndQuery(command_buffer, slot.statisticsPool, query);
+        region.openCounter = -1;
+    }
+
+    /******************************************************************
+        Read the scopes of the submitted image and of the uploads.
+        Each query comes with its availability, scopes whose queries
+        are not both available are skipped.
+    *******************************************************************/
+    void GpuProfiler::collect(Slot& slot)
+    {
+        std::vector<Region*> regions = { &slot.regions[m_imageCount] };
+        if (slot.submittedImage >= 0)
+        {
+            regions.push_back(&slot.regions[slot.submittedImage]);
+        }
+
+        VkDevice device = LogicalDevice::getInstance()->getLogicalDevice();
+        for (Region* region : regions)
+        {
+            if (region->used == 0)
+            {
+                continue;
+            }
+            std::vector<uint64_t> results(2 * region->used);
+            VkResult result = vkGetQueryPoolResults(device, slot.pool, region->firstQuery, region->used,
+                results.size() * sizeof(uint64_t), results.data(), 2 * sizeof(uint64_t),
+                VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+            if (result != VK_SUCCESS && result != VK_NOT_READY)
+            {
+                continue;
+            }
+
+            for (auto & record : region->records)
+            {
+                uint32_t index = 2 * (record.query - region->firstQuery);
+                if (results[index + 1] == 0 || results[index + 3] == 0)
+                {
+                    continue;
+                }
+                uint64_t ticks = (results[index + 2] - results[index]) & m_timestampMask;
+                addSample(record.name, static_cast<float>(ticks * m_timestampPeriod / 1.0e6));
+            }
+        }
+
+        if (slot.submittedImage >= 0)
+        {
+            collectCounters(slot, slot.regions[slot.submittedImage]);
+        }
+    } /// collect
+
+    /******************************************************************
+        Sum the counters of a frame per pass and per model, and add
+        the sums as one sample each.  Draw counters only cover draws,
+        so passes that drew nothing are left out at that level.
+    *******************************************************************/
+    void GpuProfiler::collectCounters(Slot& slot, Region& region)
+    {
+        if (region.countersUsed == 0)
+        {
+            return;
+        }
+
+        VkDevice device = LogicalDevice::getInstance()->getLogicalDevice();
+        const uint32_t stride = PIPELINE_STATISTIC_COUNT + 1;
+        std::vector<uint64_t> statistics(stride * region.countersUsed);
+        std::vector<uint64_t> occlusion(2 * region.countersUsed);
+        VkResult statisticsResult = vkGetQueryPoolResults(device, slot.statisticsPool, region.firstCounter,
+            region.countersUsed, statistics.size() * sizeof(uint64_t), statistics.data(), stride * sizeof(uint64_t),
+            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+        VkResult occlusionResult = vkGetQueryPoolResults(device, slot.occlusionPool, region.firstCounter,
+            region.countersUsed, occlusion.size() * sizeof(uint64_t), occlusion.data(), 2 * sizeof(uint64_t),
+            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+        if ((statisticsResult != VK_SUCCESS && statisticsResult != VK_NOT_READY) ||
+            (occlusionResult != VK_SUCCESS && occlusionResult != VK_NOT_READY))
+        {
+            return;
+        }
+
+        std::vector<std::pair<std::string, GpuCounters>> passes;
+        std::vector<std::pair<std::string, GpuCounters>> models;
+        auto accumulate = [](std::vector<std::pair<std::string, GpuCounters>>& sums, const std::string& name,
+            const GpuCounters& counters)
+        {
+            auto it = std::find_if(sums.begin(), sums.end(), [&](const auto& sum) { return sum.first == name; });
+            if (it == sums.end())
+            {
+                it = sums.emplace(sums.end(), name, GpuCounters());
+            }
+            it->second.inputVertices += counters.inputVertices;
+            it->second.inputPrimitives += counters.inputPrimitives;
+            it->second.vertexInvocations += counters.vertexInvocations;
+            it->second.clippingInvocations += counters.clippingInvocations;
+            it->second.clippingPrimitives += counters.clippingPrimitives;
+            it->second.fragmentInvocations += counters.fragmentInvocations;
+            it->second.computeInvocations += counters.computeInvocations;
+            it->second.samplesPassed += counters.samplesPassed;
+        };
+
+        for (auto & record : region.counterRecords)
+        {
+            uint32_t index = record.query - region.firstCounter;
+            const uint64_t* values = &statistics[stride * index];
+            if (values[PIPELINE_STATISTIC_COUNT] == 0 || occlusion[2 * index + 1] == 0)
+            {
+                continue;
+            }
+
+            GpuCounters counters;
+            counters.inputVertices = values[0];
+            counters.inputPrimitives = values[1];
+            counters.vertexInvocations = values[2];
+            counters.clippingInvocations = values[3];
+            counters.clippingPrimitives = values[4];
+            counters.fragmentInvocations = values[5];
+            counters.computeInvocations = values[6];
+            counters.samplesPassed = occlusion[2 * index];
+
+            accumulate(passes, record.pass, counters);
+            if (record.model >= 0)
+            {
+                accumulate(models, "model " + std::to_string(record.model), counters);
+            }
+        }
+
+        for (auto & pass : passes)
+        {
+            addCounters(m_passCounters, m_passNames, pass.first, pass.second);
+        }
+        for (auto & model : models)
+        {
+            addCounters(m_modelCounters, m_modelNames, model.first, model.second);
+        }
+    } /// collectCounters
+
+    void GpuProfiler::clearRegion(Region& region)
+    {
+        region.used = 0;
+        region.records.clear();
+        region.open.clear();
+        region.countersUsed = 0;
+        region.counterRecords.clear();
+        region.openCounter = -1;
+        region.pass.clear();
+    }
+
+    void GpuProfiler::addCounters(std::unordered_map<std::string, std::deque<GpuCounters>>& samples,
+        std::vector<std::string>& names, const std::string& name, const GpuCounters& counters)
+    {
+        auto it = samples.find(name);
+        if (it == samples.end())
+        {
+            it = samples.emplace(name, std::deque<GpuCounters>()).first;
+            names.push_back(name);
+        }
+        it->second.push_back(counters);
+        if (it->second.size() > GPU_PROFILER_WINDOW)
+        {
+            it->second.pop_front();
+        }
+    }
+
+    void GpuProfiler::addSample(const std::string& name, float milliseconds)
+    {
+        auto it = m_samples.find(name);
+        if (it == m_samples.end())
+        {
+            it = m_samples.emplace(name, std::deque<float>()).first;
+            m_names.push_back(name);
+        }
+        it->second.push_back(milliseconds);
+        if (it->second.size() > GPU_PROFILER_WINDOW)
+        {
+            it->second.pop_front();
+        }
+    }
+
+    /******************************************************************
+        Statistics over each scope's window.
+    *******************************************************************/
+    std::vector<GpuScopeStats> GpuProfiler::getStats()
+    {
+        std::vector<GpuScopeStats> stats;
+        for (auto & name : m_names)
+        {
+            const std::deque<float>& samples = m_samples[name];
+            std::vector<float> sorted(samples.begin(), samples.end());
+            std::sort(sorted.begin(), sorted.end());
+
+            GpuScopeStats scope;
+            scope.name = name;
+            scope.samples = static_cast<uint32_t>(sorted.size());
+            scope.lastMs = samples.back();
+            scope.minMs = sorted.front();
+            float total = 0.0f;
+            for (float sample : sorted)
+            {
+                total += sample;
+            }
+            scope.avgMs = total / sorted.size();
+            size_t p99 = std::min(sorted.size() - 1, static_cast<size_t>(sorted.size() * 0.99f));
+            scope.p99Ms = sorted[p99];
+            stats.push_back(scope);
+        }
+        return stats;
+    } /// getStats
+
+    /******************************************************************
+        Last and average counters over each window.
+    *******************************************************************/
+    std::vector<GpuCounterStats> GpuProfiler::counterStats(
+        std::unordered_map<std::string, std::deque<GpuCounters>>& samples, const std::vector<std::string>& names)
+    {
+        std::vector<GpuCounterStats> stats;
+        for (auto & name : names)
+        {
+            const std::deque<GpuCounters>& window = samples[name];
+            GpuCounterStats counter;
+            counter.name = name;
+            counter.samples = static_cast<uint32_t>(window.size());
+            counter.last = window.back();
+
+            GpuCounters& average = counter.average;
+            for (const auto & sample : window)
+            {
+                average.inputVertices += sample.inputVertices;
+                average.inputPrimitives += sample.inputPrimitives;
+                average.vertexInvocations += sample.vertexInvocations;
+                average.clippingInvocations += sample.clippingInvocations;
+                average.clippingPrimitives += sample.clippingPrimitives;
+                average.fragmentInvocations += sample.fragmentInvocations;
+                average.computeInvocations += sample.computeInvocations;
+                average.samplesPassed += sample.samplesPassed;
+            }
+            average.inputVertices /= window.size();
+            average.inputPrimitives /= window.size();
+            average.vertexInvocations /= window.size();
+            average.clippingInvocations /= window.size();
+            average.clippingPrimitives /= window.size();
+            average.fragmentInvocations /= window.size();
+            average.computeInvocations /= window.size();
+            average.samplesPassed /= window.size();
+            stats.push_back(counter);
+        }
+        return stats;
+    } /// counterStats
+
+    /**
+     * @brief Write getStats() as CSV.
+     *
+     * @param path
+     */
+    void GpuProfiler::writeCsv(const std::string& path)
+    {
+        std::ofstream file(path);
+        if (!file)
+        {
+            throw std::runtime_error("Failed to open " + path + " for the GPU profile.");
+        }
+        file << "scope,samples,last_ms,min_ms,avg_ms,p99_ms" << std::endl;
+        file << std::fixed << std::setprecision(4);
+        for (auto & scope : getStats())
+        {
+            file << scope.name << "," << scope.samples << "," << scope.lastMs << "," << scope.minMs << ","
+                 << scope.avgMs << "," << scope.p99Ms << std::endl;
+        }
+    }
+
+    /**
+     * @brief Write the average counters of passes, then models, as CSV.
+     *
+     * @param path
+     */
+    void GpuProfiler::writeCountersCsv(const std::string& path)
+    {
+        std::ofstream file(path);
+        if (!file)
+        {
+            throw std::runtime_error("Failed to open " + path + " for the GPU counters.");
+        }
+        file << "kind,name,samples,input_vertices,input_primitives,vertex_invocations,clipping_invocations,"
+             << "clipping_primitives,fragment_invocations,compute_invocations,samples_passed" << std::endl;
+        auto write = [&file](const char* kind, const std::vector<GpuCounterStats>& stats)
+        {
+            for (auto & stat : stats)
+            {
+                const GpuCounters& average = stat.average;
+                file << kind << "," << stat.name << "," << stat.samples << "," << average.inputVertices << ","
+                     << average.inputPrimitives << "," << average.vertexInvocations << ","
+                     << average.clippingInvocations << "," << average.clippingPrimitives << ","
+                     << average.fragmentInvocations << "," << average.computeInvocations << ","
+                     << average.samplesPassed << std::endl;
+            }
+        };
+        write("pass", getPassCounters());
+        write("model", getModelCounters());
+    }
+
+    void GpuProfiler::setCounterLevel(GpuCounterLevel level) { m_counterLevel = level; }
+    GpuCounterLevel GpuProfiler::getCounterLevel() { return m_counterLevel; }
+    std::vector<GpuCounterStats> GpuProfiler::getPassCounters() { return counterStats(m_passCounters, m_passNames); }
+    std::vector<GpuCounterStats> GpuProfiler::getModelCounters() { return counterStats(m_modelCounters, m_modelNames); }
+    bool GpuProfiler::isEnabled() { return m_enabled; }
+}
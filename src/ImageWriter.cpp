@@ -0,0 +1,393 @@
+#include "../include/ImageWriter.h"
+#include "../include/CpuProfiler.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace KMDM
+{
+    namespace
+    {
+        bool isBgra(VkFormat format)
+        {
+            return format == VK_FORMAT_B8G8R8A8_SRGB || format == VK_FORMAT_B8G8R8A8_UNORM;
+        }
+
+        bool isRgba8(VkFormat format)
+        {
+            return format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_R8G8B8A8_UNORM || isBgra(format);
+        }
+
+        float halfToFloat(uint16_t half)
+        {
+            uint32_t exponent = (half >> 10) & 0x1f;
+            uint32_t mantissa = half & 0x3ff;
+            float value = exponent == 0 ? std::ldexp(static_cast<float>(mantissa), -24) :
+                std::ldexp(static_cast<float>(mantissa | 0x400), static_cast<int>(exponent) - 25);
+            return (half & 0x8000) ? -value : value;
+        }
+
+        unsigned char encodeChannel(float value, bool srgb)
+        {
+            value = value > 0.0f ? std::min(value, 1.0f) : 0.0f;
+            if (srgb)
+            {
+                value = value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+            }
+            return static_cast<unsigned char>(value * 255.0f + 0.5f);
+        }
+
+        /******************************************************************
+            Convert a row of RGBA16F to RGBA8.  The color is linear, so
+            it is sRGB encoded the way the swap chain stores it; alpha
+            is not.
+        *******************************************************************/
+        void convertHalfRow(const unsigned char* src, unsigned char* dst, uint32_t width)
+        {
+            for (uint32_t i = 0; i < width * 4; i++)
+            {
+                uint16_t half;
+                std::memcpy(&half, src + i * sizeof(uint16_t), sizeof(half));
+                dst[i] = encodeChannel(halfToFloat(half), i % 4 != 3);
+            }
+        }
+
+        void putBigEndian(std::vector<unsigned char>& out, uint32_t value)
+        {
+            out.push_back(static_cast<unsigned char>(value >> 24));
+            out.push_back(static_cast<unsigned char>(value >> 16));
+            out.push_back(static_cast<unsigned char>(value >> 8));
+            out.push_back(static_cast<unsigned char>(value));
+        }
+
+        /******************************************************************
+            Encode tightly packed RGBA8 as QOI, see qoiformat.org.  Each
+            pixel is a run of the last pixel, an index into the last 64
+            pixels seen, a small difference from the last pixel, or the
+            pixel itself.
+        *******************************************************************/
+        std::vector<unsigned char> encodeQoi(const std::vector<unsigned char>& rgba, uint32_t width, uint32_t height)
+        {
+            const unsigned char QOI_OP_INDEX = 0x00;
+            const unsigned char QOI_OP_DIFF = 0x40;
+            const unsigned char QOI_OP_LUMA = 0x80;
+            const unsigned char QOI_OP_RUN = 0xc0;
+            const unsigned char QOI_OP_RGB = 0xfe;
+            const unsigned char QOI_OP_RGBA = 0xff;
+
+            std::vector<unsigned char> out;
+            out.reserve(rgba.size() / 2 + 22);
+            out.insert(out.end(), { 'q', 'o', 'i', 'f' });
+            putBigEndian(out, width);
+            putBigEndian(out, height);
+            out.push_back(4);
+            out.push_back(0);
+
+            unsigned char index[64][4] = {};
+            unsigned char previous[4] = { 0, 0, 0, 255 };
+            uint32_t run = 0;
+            size_t last = rgba.size() - 4;
+            for (size_t i = 0; i < rgba.size(); i += 4)
+            {
+                const unsigned char* pixel = &rgba[i];
+                if (std::memcmp(pixel, previous, 4) == 0)
+                {
+                    run++;
+                    if (run == 62 || i == last)
+                    {
+                        out.push_back(QOI_OP_RUN | static_cast<unsigned char>(run - 1));
+                        run = 0;
+                    }
+                    continue;
+                }
+                if (run > 0)
+                {
+                    out.push_back(QOI_OP_RUN | static_cast<unsigned char>(run - 1));
+                    run = 0;
+                }
+
+                uint32_t hash = (pixel[0] * 3 + pixel[1] * 5 + pixel[2] * 7 + pixel[3] * 11) % 64;
+                if (std::memcmp(index[hash], pixel, 4) == 0)
+                {
+                    out.push_back(QOI_OP_INDEX | static_cast<unsigned char>(hash));
+                }
+                else
+                {
+                    std::memcpy(index[hash], pixel, 4);
+                    if (pixel[3] == previous[3])
+                    {
+                        signed char dr = static_cast<signed char>(pixel[0] - previous[0]);
+                        signed char dg = static_cast<signed char>(pixel[1] - previous[1]);
+                        signed char db = static_cast<signed char>(pixel[2] - previous[2]);
+                        int dr_dg = dr - dg;
+                        int db_dg = db - dg;
+                        if (dr >= -2 && dr <= 1 && dg >= -2 && dg <= 1 && db >= -2 && db <= 1)
+                        {
+                            out.push_back(QOI_OP_DIFF | static_cast<unsigned char>(((dr + 2) << 4) | ((dg + 2) << 2) | (db + 2)));
+                        }
+                        else if (dr_dg >= -8 && dr_dg <= 7 && dg >= -32 && dg <= 31 && db_dg >= -8 && db_dg <= 7)
+                        {
+                            out.push_back(QOI_OP_LUMA | static_cast<unsigned char>(dg + 32));
+                            out.push_back(static_cast<unsigned char>(((dr_dg + 8) << 4) | (db_dg + 8)));
+                        }
+                        else
+                        {
+                            out.insert(out.end(), { QOI_OP_RGB, pixel[0], pixel[1], pixel[2] });
+                        }
+                    }
+                    else
+                    {
+                        out.insert(out.end(), { QOI_OP_RGBA, pixel[0], pixel[1], pixel[2], pixel[3] });
+                    }
+                }
+                std::memcpy(previous, pixel, 4);
+            }
+            out.insert(out.end(), { 0, 0, 0, 0, 0, 0, 0, 1 });
+            return out;
+        } /// encodeQoi
+    }
+
+    /**
+     * @brief Construct a new Image Writer:: Image Writer object
+     *
+     * @param threads
+     */
+    ImageWriter::ImageWriter(uint32_t threads)
+    {
+        if (threads == 0)
+        {
+            // Leave a core for the render thread.
+            uint32_t cores = std::thread::hardware_concurrency();
+            threads = std::max(1u, cores > 1 ? cores - 1 : 1u);
+        }
+
+        for (uint32_t i = 0; i < threads; i++)
+        {
+            m_threads.emplace_back(&ImageWriter::worker, this);
+        }
+        std::cout << "Created image writer with " << threads << " threads." << std::endl;
+    }
+
+    /**
+     * @brief Destroy the Image Writer:: Image Writer object
+     *
+     */
+    ImageWriter::~ImageWriter()
+    {
+        destroyImageWriter();
+    }
+
+    /**
+     * @brief Write out the queued images, so their slots are released, and join the worker threads.
+     *
+     */
+    void ImageWriter::destroyImageWriter()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_stopping)
+            {
+                return;
+            }
+            m_stopping = true;
+        }
+        m_queued.notify_all();
+
+        for (auto & thread : m_threads)
+        {
+            if (thread.joinable())
+            {
+                thread.join();
+            }
+        }
+        std::cout << "- Cleaning up ImageWriter." << std::endl;
+    }
+
+    bool ImageWriter::isSupported(VkFormat format)
+    {
+        return isRgba8(format) || format == VK_FORMAT_R16G16B16A16_SFLOAT;
+    }
+
+    /**
+     * @brief Queue an image to be written.
+     *
+     * @param job
+     */
+    void ImageWriter::write(ImageWriteJob job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            uint64_t sequence = job.encoding == ImageEncoding::Raw ? m_nextStreamSequence++ : 0;
+            m_queue.push_back({ std::move(job), sequence });
+        }
+        m_queued.notify_one();
+    }
+
+    /**
+     * @brief Block until every queued image has been written.
+     *
+     */
+    void ImageWriter::wait()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_idle.wait(lock, [this] { return m_queue.empty() && m_active == 0; });
+    }
+
+    /**
+     * @brief Close the stream files.
+     *
+     */
+    void ImageWriter::closeStreams()
+    {
+        std::lock_guard<std::mutex> lock(m_streamMutex);
+        m_streams.clear();
+    }
+
+    /**
+     * @brief Append a frame to its stream file once every frame queued before it has been.
+     *
+     * @param job
+     * @param rgba
+     * @param sequence
+     * @return true
+     * @return false
+     */
+    bool ImageWriter::appendToStream(const ImageWriteJob& job, const std::vector<unsigned char>& rgba,
+        uint64_t sequence)
+    {
+        std::unique_lock<std::mutex> lock(m_streamMutex);
+        m_streamTurn.wait(lock, [this, sequence] { return m_streamSequence == sequence; });
+
+        auto stream = m_streams.find(job.path);
+        if (stream == m_streams.end())
+        {
+            stream = m_streams.emplace(job.path, std::ofstream(job.path, std::ios::binary | std::ios::trunc)).first;
+        }
+        stream->second.write(reinterpret_cast<const char*>(rgba.data()), static_cast<std::streamsize>(rgba.size()));
+        bool written = stream->second.good();
+
+        m_streamSequence++;
+        lock.unlock();
+        m_streamTurn.notify_all();
+        return written;
+    }
+
+    /**
+     * @brief Copy the pixels out as tightly packed RGBA, release them, and encode.
+     *
+     */
+    void ImageWriter::worker()
+    {
+        KMDM_PROFILE_THREAD("Image writer");
+        while (true)
+        {
+            ImageWriteJob job;
+            uint64_t sequence;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_queued.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+                if (m_queue.empty())
+                {
+                    return;
+                }
+                job = std::move(m_queue.front().job);
+                sequence = m_queue.front().sequence;
+                m_queue.pop_front();
+                m_active++;
+            }
+
+            KMDM_PROFILE_ZONE("writeImage");
+            size_t row_size = static_cast<size_t>(job.width) * 4;
+            std::vector<unsigned char> rgba(row_size * job.height);
+            for (uint32_t y = 0; y < job.height; y++)
+            {
+                if (job.format == VK_FORMAT_R16G16B16A16_SFLOAT)
+                {
+                    convertHalfRow(job.pixels + y * job.rowPitch, rgba.data() + y * row_size, job.width);
+                }
+                else
+                {
+                    std::memcpy(rgba.data() + y * row_size, job.pixels + y * job.rowPitch, row_size);
+                }
+            }
+            if (job.release)
+            {
+                job.release();
+            }
+            if (isBgra(job.format))
+            {
+                for (size_t i = 0; i < rgba.size(); i += 4)
+                {
+                    std::swap(rgba[i], rgba[i + 2]);
+                }
+            }
+
+            bool written = false;
+            if (job.encoding == ImageEncoding::Raw)
+            {
+                written = appendToStream(job, rgba, sequence);
+            }
+            else if (job.encoding == ImageEncoding::Qoi)
+            {
+                std::vector<unsigned char> encoded = encodeQoi(rgba, job.width, job.height);
+                std::ofstream file(job.path, std::ios::binary);
+                file.write(reinterpret_cast<const char*>(encoded.data()), static_cast<std::streamsize>(encoded.size()));
+                written = file.good();
+            }
+            else
+            {
+                written = stbi_write_png(job.path.c_str(), static_cast<int>(job.width), static_cast<int>(job.height),
+                    4, rgba.data(), static_cast<int>(row_size)) != 0;
+            }
+            if (!written)
+            {
+                std::cerr << "Failed to write " << job.path << "." << std::endl;
+            }
+            else if (job.written)
+            {
+                job.written();
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_active--;
+                if (written)
+                {
+                    m_written++;
+                }
+                else
+                {
+                    m_failed++;
+                }
+            }
+            m_idle.notify_all();
+        }
+    }
+
+    /**
+     * @brief Images written so far.
+     *
+     * @return uint64_t
+     */
+    uint64_t ImageWriter::getWrittenCount()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_written;
+    }
+
+    /**
+     * @brief Images that could not be written.
+     *
+     * @return uint64_t
+     */
+    uint64_t ImageWriter::getFailedCount()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_failed;
+    }
+}
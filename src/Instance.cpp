@@ -52,18 +52,22 @@ namespace KMDM
         create_info.pApplicationInfo = &app_info;
         create_info.pNext = nullptr;
 
-        // SDL extensions.
-        uint32_t SDLextensionCount;
-        SDL_Vulkan_GetInstanceExtensions(Window::getInstance()->getWindow(), &SDLextensionCount, nullptr);
-        const char* SDLextensions[SDLextensionCount];
-        if (SDL_Vulkan_GetInstanceExtensions(Window::getInstance()->getWindow(), &SDLextensionCount, SDLextensions)
-            != SDL_TRUE)
+        // SDL extensions.  Headless runs have no surface, and need none.
+        uint32_t SDLextensionCount = 0;
+        std::vector<const char*> SDLextensions;
+        if (!Window::isHeadless())
         {
-            throw std::runtime_error("Failed to determine SDL extensions.");
+            SDL_Vulkan_GetInstanceExtensions(Window::getInstance()->getWindow(), &SDLextensionCount, nullptr);
+            SDLextensions.resize(SDLextensionCount);
+            if (SDL_Vulkan_GetInstanceExtensions(Window::getInstance()->getWindow(), &SDLextensionCount,
+                SDLextensions.data()) != SDL_TRUE)
+            {
+                throw std::runtime_error("Failed to determine SDL extensions.");
+            }
         }
 
         create_info.enabledExtensionCount = SDLextensionCount;
-        create_info.ppEnabledExtensionNames = SDLextensions;
+        create_info.ppEnabledExtensionNames = SDLextensions.data();
 
         // Validation layers.
         create_info.enabledLayerCount = static_cast<uint32_t>(VALIDATION_LAYERS.size());
@@ -0,0 +1,280 @@
+#include "../include/Ktx2.h"
+#include "../include/TextureCompression.h"
+
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+namespace KMDM
+{
+    namespace
+    {
+        const unsigned char KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+        const size_t KTX2_HEADER_SIZE = 80;
+        const size_t KTX2_LEVEL_INDEX_SIZE = 24;
+
+        // Khronos data format descriptor values.
+        const uint32_t KHR_DF_MODEL_RGBSDA = 1;
+        const uint32_t KHR_DF_MODEL_BC1A = 128;
+        const uint32_t KHR_DF_MODEL_BC3 = 130;
+        const uint32_t KHR_DF_MODEL_BC5 = 132;
+        const uint32_t KHR_DF_MODEL_BC7 = 134;
+        const uint32_t KHR_DF_PRIMARIES_BT709 = 1;
+        const uint32_t KHR_DF_TRANSFER_LINEAR = 1;
+        const uint32_t KHR_DF_TRANSFER_SRGB = 2;
+        const uint32_t KHR_DF_CHANNEL_RED = 0;
+        const uint32_t KHR_DF_CHANNEL_GREEN = 1;
+        const uint32_t KHR_DF_CHANNEL_BLUE = 2;
+        const uint32_t KHR_DF_CHANNEL_ALPHA = 15;
+        const uint32_t KHR_DF_QUALIFIER_LINEAR = 0x10;
+
+        uint32_t readU32(const unsigned char* bytes)
+        {
+            return bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+        }
+
+        uint64_t readU64(const unsigned char* bytes)
+        {
+            return readU32(bytes) | (static_cast<uint64_t>(readU32(bytes + 4)) << 32);
+        }
+
+        void writeU32(std::vector<unsigned char>& out, uint32_t value)
+        {
+            for (int i = 0; i < 4; i++)
+            {
+                out.push_back(static_cast<unsigned char>((value >> (8 * i)) & 0xFF));
+            }
+        }
+
+        void writeU64(std::vector<unsigned char>& out, uint64_t value)
+        {
+            writeU32(out, static_cast<uint32_t>(value & 0xFFFFFFFF));
+            writeU32(out, static_cast<uint32_t>(value >> 32));
+        }
+
+        void patchU64(std::vector<unsigned char>& out, size_t offset, uint64_t value)
+        {
+            for (int i = 0; i < 8; i++)
+            {
+                out[offset + i] = static_cast<unsigned char>((value >> (8 * i)) & 0xFF);
+            }
+        }
+
+        bool isSrgbFormat(VkFormat format)
+        {
+            return format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_BC1_RGB_SRGB_BLOCK ||
+                   format == VK_FORMAT_BC1_RGBA_SRGB_BLOCK || format == VK_FORMAT_BC3_SRGB_BLOCK ||
+                   format == VK_FORMAT_BC7_SRGB_BLOCK;
+        }
+
+        struct DfdSample
+        {
+            uint32_t channel;
+            uint32_t bitOffset;
+            uint32_t bitLength;
+            uint32_t upper;
+        };
+
+        /******************************************************************
+            Basic data format descriptor for the formats we write.
+        *******************************************************************/
+        void writeDfd(std::vector<unsigned char>& out, VkFormat format)
+        {
+            uint32_t block_width, block_height, block_bytes;
+            getFormatBlockInfo(format, block_width, block_height, block_bytes);
+
+            uint32_t model = KHR_DF_MODEL_RGBSDA;
+            std::vector<DfdSample> samples;
+            switch (format)
+            {
+                case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+                case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+                case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+                case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+                    model = KHR_DF_MODEL_BC1A;
+                    samples.push_back({ KHR_DF_CHANNEL_RED, 0, 64, 0xFFFFFFFF });
+                    break;
+                case VK_FORMAT_BC3_UNORM_BLOCK:
+                case VK_FORMAT_BC3_SRGB_BLOCK:
+                    model = KHR_DF_MODEL_BC3;
+                    samples.push_back({ KHR_DF_CHANNEL_ALPHA, 0, 64, 0xFFFFFFFF });
+                    samples.push_back({ KHR_DF_CHANNEL_RED, 64, 64, 0xFFFFFFFF });
+                    break;
+                case VK_FORMAT_BC5_UNORM_BLOCK:
+                    model = KHR_DF_MODEL_BC5;
+                    samples.push_back({ KHR_DF_CHANNEL_RED, 0, 64, 0xFFFFFFFF });
+                    samples.push_back({ KHR_DF_CHANNEL_GREEN, 64, 64, 0xFFFFFFFF });
+                    break;
+                case VK_FORMAT_BC7_UNORM_BLOCK:
+                case VK_FORMAT_BC7_SRGB_BLOCK:
+                    model = KHR_DF_MODEL_BC7;
+                    samples.push_back({ KHR_DF_CHANNEL_RED, 0, 128, 0xFFFFFFFF });
+                    break;
+                default:
+                    samples.push_back({ KHR_DF_CHANNEL_RED, 0, 8, 255 });
+                    samples.push_back({ KHR_DF_CHANNEL_GREEN, 8, 8, 255 });
+                    samples.push_back({ KHR_DF_CHANNEL_BLUE, 16, 8, 255 });
+                    samples.push_back({ KHR_DF_CHANNEL_ALPHA, 24, 8, 255 });
+                    break;
+            }
+
+            bool srgb = isSrgbFormat(format);
+            uint32_t block_size = 24 + 16 * static_cast<uint32_t>(samples.size());
+
+            writeU32(out, 4 + block_size);
+            writeU32(out, 0);                                   // vendorId, descriptorType
+            writeU32(out, 2 | (block_size << 16));              // versionNumber, descriptorBlockSize
+            writeU32(out, model | (KHR_DF_PRIMARIES_BT709 << 8) |
+                (srgb ? KHR_DF_TRANSFER_SRGB : KHR_DF_TRANSFER_LINEAR) << 16);
+            writeU32(out, (block_width - 1) | ((block_height - 1) << 8));
+            writeU32(out, block_bytes);                         // bytesPlane0..3
+            writeU32(out, 0);                                   // bytesPlane4..7
+
+            for (auto & sample : samples)
+            {
+                uint32_t channel = sample.channel;
+                if (srgb && channel == KHR_DF_CHANNEL_ALPHA)
+                {
+                    channel |= KHR_DF_QUALIFIER_LINEAR;
+                }
+                writeU32(out, sample.bitOffset | ((sample.bitLength - 1) << 16) | (channel << 24));
+                writeU32(out, 0);                               // samplePosition
+                writeU32(out, 0);                               // sampleLower
+                writeU32(out, sample.upper);
+            }
+        }
+    }
+
+    bool isKtx2(const unsigned char* bytes, size_t size)
+    {
+        return size >= KTX2_HEADER_SIZE && memcmp(bytes, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0;
+    }
+
+    VkFormat peekKtx2Format(const unsigned char* bytes, size_t size)
+    {
+        if (!isKtx2(bytes, size))
+        {
+            return VK_FORMAT_UNDEFINED;
+        }
+        return static_cast<VkFormat>(readU32(bytes + 12));
+    }
+
+    /******************************************************************
+        Parse a KTX2 file.
+    *******************************************************************/
+    TextureData readKtx2(const unsigned char* bytes, size_t size)
+    {
+        if (!isKtx2(bytes, size))
+        {
+            throw std::runtime_error("Not a KTX2 file.");
+        }
+
+        TextureData texture;
+        texture.format = static_cast<VkFormat>(readU32(bytes + 12));
+        texture.width = readU32(bytes + 20);
+        texture.height = readU32(bytes + 24);
+        uint32_t depth = readU32(bytes + 28);
+        uint32_t layers = readU32(bytes + 32);
+        uint32_t faces = readU32(bytes + 36);
+        uint32_t levels = std::max(1u, readU32(bytes + 40));
+        uint32_t supercompression = readU32(bytes + 44);
+
+        if (supercompression != 0)
+        {
+            throw std::runtime_error("Supercompressed KTX2 files are not supported.");
+        }
+        if (depth > 1 || layers > 1 || faces != 1 || levels > 32 || texture.width == 0 || texture.height == 0)
+        {
+            throw std::runtime_error("Only single layer 2D KTX2 textures are supported.");
+        }
+        if (KTX2_HEADER_SIZE + levels * KTX2_LEVEL_INDEX_SIZE > size)
+        {
+            throw std::runtime_error("Truncated KTX2 level index.");
+        }
+
+        std::vector<TextureMip> mips(levels);
+        size_t total = 0;
+        for (uint32_t level = 0; level < levels; level++)
+        {
+            const unsigned char* index = bytes + KTX2_HEADER_SIZE + level * KTX2_LEVEL_INDEX_SIZE;
+            uint64_t offset = readU64(index);
+            uint64_t length = readU64(index + 8);
+
+            TextureMip& mip = mips[level];
+            mip.width = std::max(1u, texture.width >> level);
+            mip.height = std::max(1u, texture.height >> level);
+            mip.size = getMipSize(texture.format, mip.width, mip.height);
+            if (length != mip.size || offset > size || length > size - offset)
+            {
+                throw std::runtime_error("Invalid KTX2 level " + std::to_string(level) + ".");
+            }
+            // Remember the file offset for now, replaced below.
+            mip.offset = static_cast<size_t>(offset);
+            total += mip.size;
+        }
+
+        texture.data.resize(total);
+        size_t position = 0;
+        for (auto & mip : mips)
+        {
+            memcpy(texture.data.data() + position, bytes + mip.offset, mip.size);
+            mip.offset = position;
+            position += mip.size;
+        }
+        texture.mips = mips;
+        return texture;
+    } /// readKtx2
+
+    /******************************************************************
+        Write a KTX2 file.  Levels are laid out smallest first, as the
+        specification recommends for streaming.
+    *******************************************************************/
+    std::vector<unsigned char> writeKtx2(const TextureData& texture)
+    {
+        uint32_t block_width, block_height, block_bytes;
+        getFormatBlockInfo(texture.format, block_width, block_height, block_bytes);
+        size_t alignment = std::lcm<size_t>(block_bytes, 4);
+        uint32_t levels = static_cast<uint32_t>(texture.mips.size());
+
+        std::vector<unsigned char> out(KTX2_IDENTIFIER, KTX2_IDENTIFIER + sizeof(KTX2_IDENTIFIER));
+        writeU32(out, texture.format);
+        writeU32(out, 1);                                           // typeSize
+        writeU32(out, texture.width);
+        writeU32(out, texture.height);
+        writeU32(out, 0);                                           // pixelDepth
+        writeU32(out, 0);                                           // layerCount
+        writeU32(out, 1);                                           // faceCount
+        writeU32(out, levels);
+        writeU32(out, 0);                                           // supercompressionScheme
+
+        std::vector<unsigned char> dfd;
+        writeDfd(dfd, texture.format);
+        uint32_t dfd_offset = static_cast<uint32_t>(KTX2_HEADER_SIZE + levels * KTX2_LEVEL_INDEX_SIZE);
+        writeU32(out, dfd_offset);
+        writeU32(out, static_cast<uint32_t>(dfd.size()));
+        writeU32(out, 0);                                           // kvdByteOffset
+        writeU32(out, 0);                                           // kvdByteLength
+        writeU64(out, 0);                                           // sgdByteOffset
+        writeU64(out, 0);                                           // sgdByteLength
+
+        size_t index_offset = out.size();
+        for (uint32_t level = 0; level < levels; level++)
+        {
+            writeU64(out, 0);
+            writeU64(out, texture.mips[level].size);
+            writeU64(out, texture.mips[level].size);
+        }
+        out.insert(out.end(), dfd.begin(), dfd.end());
+
+        for (uint32_t level = levels; level-- > 0;)
+        {
+            const TextureMip& mip = texture.mips[level];
+            out.resize((out.size() + alignment - 1) / alignment * alignment, 0);
+            patchU64(out, index_offset + level * KTX2_LEVEL_INDEX_SIZE, out.size());
+            out.insert(out.end(), texture.data.begin() + mip.offset, texture.data.begin() + mip.offset + mip.size);
+        }
+        return out;
+    } /// writeKtx2
+}
@@ -1,6 +1,7 @@
 #include "../include/LogicalDevice.h"
 #include "../include/PhysicalDevice.h"
 #include "../include/Surface.h"
+#include "../include/Window.h"
 #include "../include/Common.h"
 #include "../include/types.h"
 
@@ -39,6 +40,11 @@ namespace KMDM
         return m_logicalDevice->m_presentationQueue;
     }
 
+    VkQueue LogicalDevice::getTransferQueue()
+    {
+        return m_logicalDevice->m_transferQueue;
+    }
+
     QueueFamilyInfo LogicalDevice::getQueueFamilyInfo()
     {
         return m_logicalDevice->m_queueFamilyInfo;
@@ -51,49 +57,72 @@ namespace KMDM
         {
             findSuitableQueueFamily(QUEUE_FLAGS);
         }
+        findTransferQueueFamily();
+
         std::set<uint32_t> queue_indices =
         {
             m_queueFamilyInfo.graphicsFamilyIndex.value(),
             m_queueFamilyInfo.presentationFamilyIndex.value()
         };
-        std::vector<VkDeviceQueueCreateInfo> queues;
-        float priority = 1.0f;
-        uint32_t num_indices = static_cast<uint32_t>(queue_indices.size());
-        std::vector<float> qpriorities(num_indices);
-        for (size_t i = 0; i < qpriorities.size(); i++)
+        if (m_queueFamilyInfo.hasTransfer())
         {
-            qpriorities[i] = priority;
+            queue_indices.insert(m_queueFamilyInfo.transferFamilyIndex.value());
         }
+        std::vector<VkDeviceQueueCreateInfo> queues;
+        float priority = 1.0f;
 
+        // One queue from each family.
         for (uint32_t q : queue_indices)
         {
             VkDeviceQueueCreateInfo qCreateInfo = {};
             qCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
             qCreateInfo.queueFamilyIndex = q; //need to dereference optional variables.
-            qCreateInfo.queueCount = num_indices;
-            qCreateInfo.pQueuePriorities = qpriorities.data();
+            qCreateInfo.queueCount = 1;
+            qCreateInfo.pQueuePriorities = &priority;
             qCreateInfo.pNext = nullptr;
             queues.push_back(qCreateInfo);
         }
 
-        // For now we will only set the priority for 1 queue.
-
         // Device features.
         VkPhysicalDeviceFeatures deviceFeatures = {};
         deviceFeatures.geometryShader = VK_TRUE;
         deviceFeatures.samplerAnisotropy = VK_TRUE;
 
+        // Optional, for the GPU profiler's pipeline statistics and sample counts.
+        VkPhysicalDeviceFeatures supported = PhysicalDevice::getInstance()->getPhysicalDeviceFeatures();
+        deviceFeatures.pipelineStatisticsQuery = supported.pipelineStatisticsQuery;
+        deviceFeatures.occlusionQueryPrecise = supported.occlusionQueryPrecise;
+
+        // Timeline semaphores are used to track uploads.  Visibility buffer shading indexes its
+        // texture array per pixel.
+        VkPhysicalDeviceVulkan12Features features12 = {};
+        features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        features12.timelineSemaphore = VK_TRUE;
+        features12.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+
+        // Heap budgets for the memory telemetry, when the driver reports them.
+        std::vector<const char*> extensions;
+        if (!Window::isHeadless())
+        {
+            extensions = REQUIRED_DEVICE_EXTENSIONS;
+        }
+        m_memoryBudget = PhysicalDevice::getInstance()->isExtensionSupported(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        if (m_memoryBudget)
+        {
+            extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        }
+
         // VkDeviceCreateInfo
         VkDeviceCreateInfo create_info = {};
         create_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
         create_info.pQueueCreateInfos = queues.data();
         create_info.queueCreateInfoCount = static_cast<uint32_t>(queues.size());
         create_info.pEnabledFeatures = &deviceFeatures;
-        create_info.enabledExtensionCount = static_cast<uint32_t>(REQUIRED_DEVICE_EXTENSIONS.size());
-        create_info.ppEnabledExtensionNames = REQUIRED_DEVICE_EXTENSIONS.data();
+        create_info.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+        create_info.ppEnabledExtensionNames = extensions.data();
         create_info.enabledLayerCount = static_cast<uint32_t>(VALIDATION_LAYERS.size());
         create_info.ppEnabledLayerNames = VALIDATION_LAYERS.data();
-        create_info.pNext = nullptr;
+        create_info.pNext = &features12;
 
         // Create the device.
         VkPhysicalDevice phys_dev = PhysicalDevice::getInstance()->getPhysicalDevice();
@@ -147,9 +176,17 @@ namespace KMDM
                 m_queueFamilyInfo.graphicsFamilyIndex = i;
                 m_queueFamilyInfo.qProperties = families[i];
             }
-            // Make sure the queue family supports presentation to a surface.
+            // Make sure the queue family supports presentation to a surface.  Headless runs
+            // "present" on the graphics queue, which only waits for the frame.
             VkBool32 presentation = false;
-            vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentation);
+            if (Window::isHeadless())
+            {
+                presentation = m_queueFamilyInfo.graphicsFamilyIndex.has_value();
+            }
+            else
+            {
+                vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentation);
+            }
             if (presentation)
             {
                 // std::cout << i << std::endl;
@@ -165,6 +202,41 @@ namespace KMDM
         }
     } /// findSuitableQueueFamily
 
+    /******************************************************************
+        Find a transfer queue family separate from the graphics family.
+        Prefer a transfer only family (usually the copy engine), then
+        any family without graphics.  If there is none, uploads use the
+        graphics queue.
+    *******************************************************************/
+    void LogicalDevice::findTransferQueueFamily()
+    {
+        VkPhysicalDevice device = PhysicalDevice::getInstance()->getPhysicalDevice();
+
+        uint32_t queue_family_count = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(device, &queue_family_count, nullptr);
+        std::vector<VkQueueFamilyProperties> families(queue_family_count);
+        vkGetPhysicalDeviceQueueFamilyProperties(device, &queue_family_count, families.data());
+
+        for (uint32_t i = 0; i < queue_family_count; i++)
+        {
+            VkQueueFlags flags = families[i].queueFlags;
+            if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)))
+            {
+                m_queueFamilyInfo.transferFamilyIndex = i;
+                return;
+            }
+        }
+        for (uint32_t i = 0; i < queue_family_count; i++)
+        {
+            VkQueueFlags flags = families[i].queueFlags;
+            if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT))
+            {
+                m_queueFamilyInfo.transferFamilyIndex = i;
+                return;
+            }
+        }
+    } /// findTransferQueueFamily
+
 
     /******************************************************************
         void getQueueHandle(void): Get a queue handle.
@@ -172,10 +244,15 @@ namespace KMDM
     void LogicalDevice::getQueueHandle()
     {
         // QueueFamilyInfo q = m_queueFamilyInfo;
-        vkGetDeviceQueue(m_VKDevice, m_queueFamilyInfo.graphicsFamilyIndex.value(),
-            m_queueFamilyInfo.graphicsFamilyIndex.value(), &m_graphicsQueue);
-        vkGetDeviceQueue(m_VKDevice, m_queueFamilyInfo.presentationFamilyIndex.value(),
-            m_queueFamilyInfo.presentationFamilyIndex.value(), &m_presentationQueue);
+        // Each family only has one queue created, so the queue index is always 0.
+        vkGetDeviceQueue(m_VKDevice, m_queueFamilyInfo.graphicsFamilyIndex.value(), 0, &m_graphicsQueue);
+        vkGetDeviceQueue(m_VKDevice, m_queueFamilyInfo.presentationFamilyIndex.value(), 0, &m_presentationQueue);
+
+        m_transferQueue = VK_NULL_HANDLE;
+        if (m_queueFamilyInfo.hasTransfer())
+        {
+            vkGetDeviceQueue(m_VKDevice, m_queueFamilyInfo.transferFamilyIndex.value(), 0, &m_transferQueue);
+        }
     } // getQueueHandle
 
 
@@ -198,4 +275,9 @@ namespace KMDM
     {
         return m_physicalDeviceProperties;
     }
+
+    bool LogicalDevice::hasMemoryBudget()
+    {
+        return m_memoryBudget;
+    }
 }
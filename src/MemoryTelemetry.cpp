@@ -0,0 +1,255 @@
+#include "../include/MemoryTelemetry.h"
+#include "../include/LogicalDevice.h"
+#include "../include/PhysicalDevice.h"
+
+#include <vulkan/vulkan.h>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace KMDM
+{
+    MemoryTelemetry* MemoryTelemetry::m_memoryTelemetry = nullptr;
+
+    /**
+     * @brief Get the Instance object
+     *
+     * @return MemoryTelemetry*
+     */
+    MemoryTelemetry* MemoryTelemetry::getInstance()
+    {
+        if (!m_memoryTelemetry)
+        {
+            m_memoryTelemetry = new MemoryTelemetry();
+        }
+        return m_memoryTelemetry;
+    }
+
+    MemoryTelemetry* MemoryTelemetry::findInstance()
+    {
+        return m_memoryTelemetry;
+    }
+
+    MemoryTelemetry::MemoryTelemetry()
+    {
+        m_memoryProperties = PhysicalDevice::getInstance()->getMemoryProperties();
+        m_budgetSupported = LogicalDevice::getInstance()->hasMemoryBudget();
+
+        for (uint32_t i = 0; i < MEMORY_CATEGORY_COUNT; i++)
+        {
+            m_categories[i].name = getCategoryName(static_cast<MemoryCategory>(i));
+        }
+        m_heaps.resize(m_memoryProperties.memoryHeapCount);
+        m_overBudget.resize(m_memoryProperties.memoryHeapCount, false);
+        for (uint32_t i = 0; i < m_memoryProperties.memoryHeapCount; i++)
+        {
+            m_heaps[i].heap = i;
+            m_heaps[i].size = m_memoryProperties.memoryHeaps[i].size;
+            m_heaps[i].deviceLocal = (m_memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+        }
+        readBudget();
+        std::cout << "Created memory telemetry" << (m_budgetSupported ? " with memory budgets." : ".") << std::endl;
+    }
+
+    MemoryTelemetry::~MemoryTelemetry()
+    {
+        destroyMemoryTelemetry();
+    }
+
+    void MemoryTelemetry::destroyMemoryTelemetry()
+    {
+        std::cout << "- Destroying MemoryTelemetry (" << m_allocations.size() + m_vmaAllocations.size()
+                  << " allocations still tracked)." << std::endl;
+        m_allocations.clear();
+        m_vmaAllocations.clear();
+        m_memoryTelemetry = nullptr;
+    }
+
+    void MemoryTelemetry::trackAllocation(VkDeviceMemory memory, VkDeviceSize size, uint32_t memory_type,
+        MemoryCategory category)
+    {
+        Allocation allocation = { size, m_memoryProperties.memoryTypes[memory_type].heapIndex, category };
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_allocations[memory] = allocation;
+        addAllocation(allocation);
+    }
+
+    void MemoryTelemetry::trackFree(VkDeviceMemory memory)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_allocations.find(memory);
+        if (it != m_allocations.end())
+        {
+            removeAllocation(it->second);
+            m_allocations.erase(it);
+        }
+    }
+
+    void MemoryTelemetry::trackVmaAllocation(const void* allocation, VkDeviceSize size, uint32_t memory_type,
+        MemoryCategory category)
+    {
+        Allocation tracked = { size, m_memoryProperties.memoryTypes[memory_type].heapIndex, category };
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_vmaAllocations[allocation] = tracked;
+        addAllocation(tracked);
+    }
+
+    void MemoryTelemetry::trackVmaFree(const void* allocation)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_vmaAllocations.find(allocation);
+        if (it != m_vmaAllocations.end())
+        {
+            removeAllocation(it->second);
+            m_vmaAllocations.erase(it);
+        }
+    }
+
+    void MemoryTelemetry::addAllocation(const Allocation& allocation)
+    {
+        MemoryCategoryStats& category = m_categories[static_cast<uint32_t>(allocation.category)];
+        category.allocations++;
+        category.bytes += allocation.size;
+        category.peakBytes = std::max(category.peakBytes, category.bytes);
+
+        MemoryHeapStats& heap = m_heaps[allocation.heap];
+        heap.tracked += allocation.size;
+        heap.peakTracked = std::max(heap.peakTracked, heap.tracked);
+
+        m_frame.allocations++;
+        m_frame.allocatedBytes += allocation.size;
+    }
+
+    void MemoryTelemetry::removeAllocation(const Allocation& allocation)
+    {
+        MemoryCategoryStats& category = m_categories[static_cast<uint32_t>(allocation.category)];
+        category.allocations--;
+        category.bytes -= allocation.size;
+        m_heaps[allocation.heap].tracked -= allocation.size;
+
+        m_frame.frees++;
+        m_frame.freedBytes += allocation.size;
+    }
+
+    /******************************************************************
+        Read the driver's budget and usage of each heap.  Without
+        VK_EXT_memory_budget the whole heap is the budget.
+    *******************************************************************/
+    void MemoryTelemetry::readBudget()
+    {
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budget = {};
+        budget.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+        if (m_budgetSupported)
+        {
+            VkPhysicalDeviceMemoryProperties2 properties = {};
+            properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+            properties.pNext = &budget;
+            vkGetPhysicalDeviceMemoryProperties2(PhysicalDevice::getInstance()->getPhysicalDevice(), &properties);
+        }
+
+        for (auto & heap : m_heaps)
+        {
+            heap.budget = m_budgetSupported ? budget.heapBudget[heap.heap] : heap.size;
+            heap.usage = m_budgetSupported ? budget.heapUsage[heap.heap] : heap.tracked;
+            heap.peakUsage = std::max(heap.peakUsage, heap.usage);
+        }
+    } /// readBudget
+
+    /******************************************************************
+        Warn once each time a heap's usage crosses the warning level,
+        before the driver has to start moving memory out.
+    *******************************************************************/
+    void MemoryTelemetry::update()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        readBudget();
+        for (auto & heap : m_heaps)
+        {
+            bool over = heap.budget > 0 && heap.usage > heap.budget * MEMORY_BUDGET_WARNING;
+            if (over && !m_overBudget[heap.heap])
+            {
+                std::cout << "Memory heap " << heap.heap << " is at " << heap.usage / (1024 * 1024) << " of its "
+                          << heap.budget / (1024 * 1024) << " MB budget." << std::endl;
+            }
+            m_overBudget[heap.heap] = over;
+        }
+
+        m_lastFrame = m_frame;
+        m_frame = {};
+        m_frame.frame = m_lastFrame.frame + 1;
+    } /// update
+
+    MemoryStats MemoryTelemetry::getStats()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        MemoryStats stats;
+        stats.budgetSupported = m_budgetSupported;
+        stats.categories.assign(m_categories, m_categories + MEMORY_CATEGORY_COUNT);
+        stats.heaps = m_heaps;
+        stats.lastFrame = m_lastFrame;
+        return stats;
+    }
+
+    /******************************************************************
+        Sizes are in bytes.
+    *******************************************************************/
+    void MemoryTelemetry::writeJson(const std::string& path)
+    {
+        std::ofstream file(path);
+        if (!file)
+        {
+            throw std::runtime_error("Failed to open " + path + " for the memory telemetry.");
+        }
+        writeJson(file);
+        file << std::endl;
+    }
+
+    void MemoryTelemetry::writeJson(std::ostream& file)
+    {
+        MemoryStats stats = getStats();
+        file << "{\n  \"budgetSupported\": " << (stats.budgetSupported ? "true" : "false") << ",\n";
+        file << "  \"lastFrame\": {\"frame\": " << stats.lastFrame.frame
+             << ", \"allocations\": " << stats.lastFrame.allocations
+             << ", \"frees\": " << stats.lastFrame.frees
+             << ", \"allocatedBytes\": " << stats.lastFrame.allocatedBytes
+             << ", \"freedBytes\": " << stats.lastFrame.freedBytes << "},\n";
+
+        file << "  \"categories\": [";
+        for (size_t i = 0; i < stats.categories.size(); i++)
+        {
+            const MemoryCategoryStats& category = stats.categories[i];
+            file << (i ? ",\n" : "\n") << "    {\"name\": \"" << category.name
+                 << "\", \"allocations\": " << category.allocations
+                 << ", \"bytes\": " << category.bytes
+                 << ", \"peakBytes\": " << category.peakBytes << "}";
+        }
+        file << "\n  ],\n  \"heaps\": [";
+        for (size_t i = 0; i < stats.heaps.size(); i++)
+        {
+            const MemoryHeapStats& heap = stats.heaps[i];
+            file << (i ? ",\n" : "\n") << "    {\"heap\": " << heap.heap
+                 << ", \"deviceLocal\": " << (heap.deviceLocal ? "true" : "false")
+                 << ", \"size\": " << heap.size
+                 << ", \"budget\": " << heap.budget
+                 << ", \"usage\": " << heap.usage
+                 << ", \"peakUsage\": " << heap.peakUsage
+                 << ", \"tracked\": " << heap.tracked
+                 << ", \"peakTracked\": " << heap.peakTracked << "}";
+        }
+        file << "\n  ]\n}";
+    } /// writeJson
+
+    const char* MemoryTelemetry::getCategoryName(MemoryCategory category)
+    {
+        switch (category)
+        {
+            case MemoryCategory::Geometry: return "geometry";
+            case MemoryCategory::Texture: return "texture";
+            case MemoryCategory::Staging: return "staging";
+            case MemoryCategory::Uniform: return "uniform";
+            case MemoryCategory::RenderTarget: return "render_target";
+            default: return "other";
+        }
+    }
+}
@@ -56,8 +56,7 @@ namespace KMDM
         Allocator::getInstance()->cleanupAllcatedBuffer(m_indexBuffer);
         vkDestroyImageView(LogicalDevice::getInstance()->getLogicalDevice(),
             m_textureImageView, nullptr);
-        vmaDestroyImage(Allocator::getInstance()->getAllocator(),
-            m_textureImage.image, m_textureImage.allocation);        
+        Allocator::getInstance()->cleanupAllocatedImage(m_textureImage);
     }
 
 
@@ -70,7 +69,7 @@ namespace KMDM
         VkDeviceSize bufferSize = m_vertices.size() * sizeof(Vertex);
         // m_vertexBuffer = loadGpuBuffer(m_vertices.data(), bufferSize, 0, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT);
         m_vertexBuffer = Allocator::getInstance()->getVMABuffer(bufferSize, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | 
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY, MemoryCategory::Geometry);
         
         // Load the data into the buffer.
         void *data;
@@ -89,7 +88,7 @@ namespace KMDM
         VkDeviceSize bufferSize = m_indices.size() * sizeof(uint32_t);
         // m_indexBuffer = loadGpuBuffer(m_indices.data(), bufferSize, 0, VK_BUFFER_USAGE_INDEX_BUFFER_BIT);
         m_indexBuffer = Allocator::getInstance()->getVMABuffer(bufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
-           VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+           VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY, MemoryCategory::Geometry);
 
         // Load the data into the buffer.
         void *data;
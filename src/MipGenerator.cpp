@@ -0,0 +1,291 @@
+#include "../include/MipGenerator.h"
+#include "../include/WorkerPool.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace KMDM
+{
+    namespace
+    {
+        // Kaiser filter support, in destination texels, and window shape.
+        const float KAISER_RADIUS = 2.0f;
+        const float KAISER_ALPHA = 4.0f;
+        const float PI = 3.14159265358979f;
+
+        // Rows a resample pass has to have per worker before it is spread over the pool.
+        const uint32_t ROW_GRAIN = 16;
+
+        /******************************************************************
+            One RGBA texel in linear floats.
+        *******************************************************************/
+#if defined(__SSE2__)
+        typedef __m128 Texel;
+        inline Texel zeroTexel() { return _mm_setzero_ps(); }
+        inline Texel loadTexel(const float* p) { return _mm_loadu_ps(p); }
+        inline void storeTexel(float* p, Texel t) { _mm_storeu_ps(p, t); }
+        inline Texel madd(Texel acc, Texel t, float w) { return _mm_add_ps(acc, _mm_mul_ps(t, _mm_set1_ps(w))); }
+#else
+        struct Texel { float v[4]; };
+        inline Texel zeroTexel() { return Texel{ { 0.0f, 0.0f, 0.0f, 0.0f } }; }
+        inline Texel loadTexel(const float* p) { return Texel{ { p[0], p[1], p[2], p[3] } }; }
+        inline void storeTexel(float* p, Texel t) { std::copy(t.v, t.v + 4, p); }
+        inline Texel madd(Texel acc, Texel t, float w)
+        {
+            for (int c = 0; c < 4; c++)
+            {
+                acc.v[c] += t.v[c] * w;
+            }
+            return acc;
+        }
+#endif
+
+        /******************************************************************
+            sRGB conversion tables.  Encoding rounds in sRGB space, so the
+            thresholds are the linear values half way between codes.
+        *******************************************************************/
+        struct SrgbTables
+        {
+            std::array<float, 256> toLinear;
+            std::array<float, 255> thresholds;
+
+            static float decode(float c)
+            {
+                return c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+            }
+
+            SrgbTables()
+            {
+                for (int i = 0; i < 256; i++)
+                {
+                    toLinear[i] = decode(i / 255.0f);
+                }
+                for (int i = 0; i < 255; i++)
+                {
+                    thresholds[i] = decode((i + 0.5f) / 255.0f);
+                }
+            }
+        };
+
+        const SrgbTables& getSrgbTables()
+        {
+            static const SrgbTables tables;
+            return tables;
+        }
+
+        unsigned char encodeChannel(float value, bool srgb)
+        {
+            if (srgb)
+            {
+                const SrgbTables& tables = getSrgbTables();
+                return static_cast<unsigned char>(
+                    std::upper_bound(tables.thresholds.begin(), tables.thresholds.end(), value) - tables.thresholds.begin());
+            }
+            return static_cast<unsigned char>(std::lround(std::clamp(value, 0.0f, 1.0f) * 255.0f));
+        }
+
+        float sinc(float x)
+        {
+            if (std::fabs(x) < 1e-5f)
+            {
+                return 1.0f;
+            }
+            x *= PI;
+            return std::sin(x) / x;
+        }
+
+        // Zeroth order modified Bessel function of the first kind.
+        float besselI0(float x)
+        {
+            float sum = 1.0f;
+            float term = 1.0f;
+            for (int k = 1; k < 25; k++)
+            {
+                float f = x / (2.0f * k);
+                term *= f * f;
+                sum += term;
+            }
+            return sum;
+        }
+
+        float kaiser(float t)
+        {
+            if (std::fabs(t) >= KAISER_RADIUS)
+            {
+                return 0.0f;
+            }
+            float r = t / KAISER_RADIUS;
+            return sinc(t) * besselI0(KAISER_ALPHA * std::sqrt(1.0f - r * r)) / besselI0(KAISER_ALPHA);
+        }
+
+        /**
+         * @brief Normalised filter taps of one axis.  The taps of destination texel i are
+         * [begin[i], begin[i + 1]).
+         *
+         */
+        struct FilterTaps
+        {
+            std::vector<uint32_t> begin;
+            std::vector<uint32_t> source;
+            std::vector<float> weight;
+        };
+
+        FilterTaps buildTaps(uint32_t src_size, uint32_t dst_size, MipFilter filter)
+        {
+            FilterTaps taps;
+            float scale = static_cast<float>(src_size) / dst_size;
+            float radius = filter == MipFilter::Box ? 0.5f * scale : KAISER_RADIUS * scale;
+
+            for (uint32_t d = 0; d < dst_size; d++)
+            {
+                taps.begin.push_back(static_cast<uint32_t>(taps.source.size()));
+                size_t first = taps.weight.size();
+                float center = (d + 0.5f) * scale;
+                int lo = static_cast<int>(std::floor(center - radius));
+                int hi = static_cast<int>(std::ceil(center + radius));
+
+                float total = 0.0f;
+                for (int s = lo; s < hi; s++)
+                {
+                    float w;
+                    if (filter == MipFilter::Box)
+                    {
+                        // Coverage of the source texel by the destination footprint.
+                        w = std::min(s + 1.0f, center + radius) - std::max(static_cast<float>(s), center - radius);
+                    }
+                    else
+                    {
+                        w = kaiser((s + 0.5f - center) / scale);
+                    }
+                    if (std::fabs(w) < 1e-6f)
+                    {
+                        continue;
+                    }
+
+                    // Clamp to the edge.
+                    taps.source.push_back(static_cast<uint32_t>(std::clamp(s, 0, static_cast<int>(src_size) - 1)));
+                    taps.weight.push_back(w);
+                    total += w;
+                }
+                for (size_t k = first; k < taps.weight.size(); k++)
+                {
+                    taps.weight[k] /= total;
+                }
+            }
+            taps.begin.push_back(static_cast<uint32_t>(taps.source.size()));
+            return taps;
+        }
+
+        /******************************************************************
+            Separable resample of a linear RGBA float image.
+        *******************************************************************/
+        void downsample(const std::vector<float>& src, uint32_t src_width, uint32_t src_height,
+            std::vector<float>& dst, uint32_t dst_width, uint32_t dst_height, MipFilter filter)
+        {
+            FilterTaps horizontal = buildTaps(src_width, dst_width, filter);
+            FilterTaps vertical = buildTaps(src_height, dst_height, filter);
+
+            std::vector<float> columns(static_cast<size_t>(dst_width) * src_height * 4);
+            WorkerPool::getInstance()->parallelFor(src_height, [&](uint32_t y)
+            {
+                const float* in = src.data() + static_cast<size_t>(y) * src_width * 4;
+                float* out = columns.data() + static_cast<size_t>(y) * dst_width * 4;
+                for (uint32_t x = 0; x < dst_width; x++)
+                {
+                    Texel acc = zeroTexel();
+                    for (uint32_t k = horizontal.begin[x]; k < horizontal.begin[x + 1]; k++)
+                    {
+                        acc = madd(acc, loadTexel(in + horizontal.source[k] * 4), horizontal.weight[k]);
+                    }
+                    storeTexel(out + x * 4, acc);
+                }
+            }, ROW_GRAIN);
+
+            dst.assign(static_cast<size_t>(dst_width) * dst_height * 4, 0.0f);
+            WorkerPool::getInstance()->parallelFor(dst_height, [&](uint32_t y)
+            {
+                float* out = dst.data() + static_cast<size_t>(y) * dst_width * 4;
+                for (uint32_t k = vertical.begin[y]; k < vertical.begin[y + 1]; k++)
+                {
+                    const float* in = columns.data() + static_cast<size_t>(vertical.source[k]) * dst_width * 4;
+                    float w = vertical.weight[k];
+                    for (uint32_t x = 0; x < dst_width; x++)
+                    {
+                        storeTexel(out + x * 4, madd(loadTexel(out + x * 4), loadTexel(in + x * 4), w));
+                    }
+                }
+            }, ROW_GRAIN);
+        }
+    }
+
+    uint32_t getMipLevelCount(uint32_t width, uint32_t height)
+    {
+        uint32_t levels = 1;
+        for (uint32_t size = std::max(width, height); size > 1; size >>= 1)
+        {
+            levels++;
+        }
+        return levels;
+    }
+
+    /******************************************************************
+        Build the mip chain of an RGBA8 texture.  Each level is filtered
+        from the float copy of the previous one, so rounding does not
+        accumulate down the chain.
+    *******************************************************************/
+    void generateMipChain(TextureData& texture, MipFilter filter)
+    {
+        if (texture.format != VK_FORMAT_R8G8B8A8_UNORM && texture.format != VK_FORMAT_R8G8B8A8_SRGB)
+        {
+            throw std::runtime_error("Mip chains can only be generated for RGBA8 textures.");
+        }
+        if (texture.mips.size() != 1)
+        {
+            throw std::runtime_error("Mip chains are generated from a single level texture.");
+        }
+
+        bool srgb = texture.format == VK_FORMAT_R8G8B8A8_SRGB;
+        const SrgbTables& tables = getSrgbTables();
+
+        uint32_t width = texture.width;
+        uint32_t height = texture.height;
+        std::vector<float> level(static_cast<size_t>(width) * height * 4);
+        for (size_t i = 0; i < level.size(); i++)
+        {
+            unsigned char value = texture.data[texture.mips[0].offset + i];
+            level[i] = (srgb && i % 4 != 3) ? tables.toLinear[value] : value / 255.0f;
+        }
+
+        texture.data.reserve(texture.data.size() * 4 / 3 + 4);
+        std::vector<float> next;
+        while (width > 1 || height > 1)
+        {
+            uint32_t next_width = std::max(1u, width / 2);
+            uint32_t next_height = std::max(1u, height / 2);
+            downsample(level, width, height, next, next_width, next_height, filter);
+
+            TextureMip mip = {};
+            mip.offset = texture.data.size();
+            mip.size = next.size();
+            mip.width = next_width;
+            mip.height = next_height;
+            for (size_t i = 0; i < next.size(); i++)
+            {
+                texture.data.push_back(encodeChannel(next[i], srgb && i % 4 != 3));
+            }
+            texture.mips.push_back(mip);
+
+            level.swap(next);
+            width = next_width;
+            height = next_height;
+        }
+    } /// generateMipChain
+}
@@ -2,8 +2,14 @@
 #include "../include/Common.h"
 #include "../include/Util.h"
 #include "../include/LogicalDevice.h"
-#include "../include/CommandPool.h"
 #include "../include/PhysicalDevice.h"
+#include "../include/UploadManager.h"
+#include "../include/TextureCompression.h"
+#include "../include/Ktx2.h"
+#include "../include/MipGenerator.h"
+#include "../include/TextureResidency.h"
+#include "../include/SamplerCache.h"
+#include "../include/CpuProfiler.h"
 #include "../include/types.h"
 
 #define STB_IMAGE_IMPLEMENTATION
@@ -14,36 +20,62 @@
 
 #include <glm/glm.hpp>
 
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+#include <cmath>
+
 namespace KMDM
 {
+    // Features a texture format needs to be uploaded and sampled.
+    const VkFormatFeatureFlags TEXTURE_FORMAT_FEATURES = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT |
+        VK_FORMAT_FEATURE_TRANSFER_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
     Model::Model(std::string model_path, std::string texture_path)
+        : Model(loadModelData(model_path, texture_path))
+    {
+    }
+
+    /**
+     * @brief Construct a Model from already decoded data.  This is the part of model
+     * creation that talks to the GPU, so it has to run on the render thread.
+     * 
+     * @param data 
+     */
+    Model::Model(const ModelData& data)
     {
-        loadModel(model_path);
+        m_vertices = data.vertices;
+        m_indices = data.indices;
+
         createVertexBuffer();
         createIndexBuffer();
-        createTextureImage(texture_path);
-        createTextureImageView();
+        createTextureImage(data.texture);
         createTextureSampler();
+        computeBounds();
 
         m_transBufferObj.rotate = glm::mat4(1.0);
         m_transBufferObj.scale = glm::float32(1.0);
         m_transBufferObj.translate = glm::mat4(1.0);
 
         creatteTransBuffer();
+
+        // Submit every upload of the model in one batch.
+        m_uploadTicket = UploadManager::getInstance()->flush();
     }
 
     void Model::destroyModel()
     {
         vkDestroyBuffer(LogicalDevice::getInstance()->getLogicalDevice(), m_vertexBuffer, nullptr);
-        vkFreeMemory(LogicalDevice::getInstance()->getLogicalDevice(), m_vertexBufferMemory, nullptr);
+        freeMemory(m_vertexBufferMemory);
+
+        vkDestroyBuffer(LogicalDevice::getInstance()->getLogicalDevice(), m_positionBuffer, nullptr);
+        freeMemory(m_positionBufferMemory);
 
         vkDestroyBuffer(LogicalDevice::getInstance()->getLogicalDevice(), m_indexBuffer, nullptr);
-        vkFreeMemory(LogicalDevice::getInstance()->getLogicalDevice(), m_indexBufferMemory, nullptr);
+        freeMemory(m_indexBufferMemory);
 
-        vkDestroySampler(LogicalDevice::getInstance()->getLogicalDevice(), m_textureImageSampler, nullptr);
-        vkDestroyImageView(LogicalDevice::getInstance()->getLogicalDevice(), m_textureImageView, nullptr);
-        vkDestroyImage(LogicalDevice::getInstance()->getLogicalDevice(), m_textureImage, nullptr);
-        vkFreeMemory(LogicalDevice::getInstance()->getLogicalDevice(), m_textureImageMemory, nullptr);
+        TextureResidency::getInstance()->releaseTexture(m_texture);
     }
 
     Model::~Model()
@@ -52,17 +84,81 @@ namespace KMDM
     }
 
     /******************************************************************
-        Load the model.
+        Read the model and texture files and decode them.
+    *******************************************************************/
+    ModelData Model::loadModelData(std::string model_path, std::string texture_path)
+    {
+        KMDM_PROFILE_ZONE("loadModelData");
+        return decodeModelData(readFile(model_path), readTextureFile(texture_path));
+    } /// loadModelData
+
+    /******************************************************************
+        Read the texture, preferring a cooked KTX2 file.
     *******************************************************************/
-    void Model::loadModel(std::string path)
+    std::vector<char> Model::readTextureFile(std::string texture_path)
     {
+        size_t dot = texture_path.find_last_of('.');
+        std::string base = dot == std::string::npos ? texture_path : texture_path.substr(0, dot);
+        std::string extension = dot == std::string::npos ? "" : texture_path.substr(dot);
+
+        std::string ktx2_path = base + ".ktx2";
+        if (std::ifstream(ktx2_path, std::ios::binary).good())
+        {
+            std::vector<char> bytes = readFile(ktx2_path);
+            VkFormat format = peekKtx2Format(reinterpret_cast<const unsigned char*>(bytes.data()), bytes.size());
+            if (isTextureFormatUsable(format))
+            {
+                return bytes;
+            }
+
+            std::string png_path = base + ".png";
+            if (extension == ".ktx2" && std::ifstream(png_path, std::ios::binary).good())
+            {
+                std::cout << "Texture format of " << ktx2_path << " is not supported, using " << png_path << std::endl;
+                return readFile(png_path);
+            }
+        }
+        return readFile(texture_path);
+    } /// readTextureFile
+
+    bool Model::isTextureFormatSampleable(VkFormat format)
+    {
+        return PhysicalDevice::getInstance()->isFormatSupported(format, VK_IMAGE_TILING_OPTIMAL, TEXTURE_FORMAT_FEATURES);
+    }
+
+    bool Model::isTextureFormatUsable(VkFormat format)
+    {
+        return isTextureFormatHandled(format) && (isTextureFormatSampleable(format) || canDecompressTexture(format));
+    }
+
+    /******************************************************************
+        Decode the model and texture from memory.
+    *******************************************************************/
+    ModelData Model::decodeModelData(const std::vector<char>& obj_bytes,
+        const std::vector<char>& texture_bytes)
+    {
+        KMDM_PROFILE_ZONE_VALUE("decodeModelData", obj_bytes.size() + texture_bytes.size());
+        ModelData data;
+
+        std::istringstream stream(std::string(obj_bytes.begin(), obj_bytes.end()));
+        parseModel(stream, data);
+        decodeTexture(reinterpret_cast<const unsigned char*>(texture_bytes.data()), texture_bytes.size(), data);
+        return data;
+    } /// decodeModelData
+
+    /******************************************************************
+        Parse the model.
+    *******************************************************************/
+    void Model::parseModel(std::istream& stream, ModelData& data)
+    {
+        KMDM_PROFILE_ZONE("parseModel");
         // Load the model with tinyobj
         tinyobj::attrib_t attrib;
         std::vector<tinyobj::shape_t> shapes;
         std::vector<tinyobj::material_t> materials;
         std::string warn, err;
 
-        if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.c_str()))
+        if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, &stream))
         {
             throw std::runtime_error(warn + err);
         }
@@ -100,70 +196,152 @@ namespace KMDM
 
                 if (unique_vertices.count(vertex) == 0)
                 {
-                    unique_vertices[vertex] = static_cast<uint32_t>(m_vertices.size());
-                    m_vertices.push_back(vertex);
+                    unique_vertices[vertex] = static_cast<uint32_t>(data.vertices.size());
+                    data.vertices.push_back(vertex);
                 }
                 //vertices.push_back(vertex);
-                m_indices.push_back(unique_vertices[vertex]);
+                data.indices.push_back(unique_vertices[vertex]);
+            }
+        }
+    } /// parseModel
+
+    /******************************************************************
+        Decode the texture.  KTX2 files are used as they are, falling
+        back to decoding them on the CPU when the device cannot sample
+        their format.  Anything else is decoded to RGBA8 and given a
+        mip chain.
+    *******************************************************************/
+    void Model::decodeTexture(const unsigned char* bytes, size_t size, ModelData& data)
+    {
+        KMDM_PROFILE_ZONE_VALUE("decodeTexture", size);
+        if (isKtx2(bytes, size))
+        {
+            data.texture = readKtx2(bytes, size);
+            if (!isTextureFormatSampleable(data.texture.format))
+            {
+                if (!canDecompressTexture(data.texture.format))
+                {
+                    throw std::runtime_error("Texture format is not supported by the device.");
+                }
+                data.texture = decompressTexture(data.texture);
+            }
+        }
+        else
+        {
+            int tex_width, tex_height, tex_channels;
+            stbi_uc *pixels = stbi_load_from_memory(bytes, static_cast<int>(size), &tex_width,
+                                                    &tex_height, &tex_channels, STBI_rgb_alpha);
+            if (!pixels)
+            {
+                throw std::runtime_error("Failed to load texture image.");
+            }
+
+            TextureData& texture = data.texture;
+            texture.format = VK_FORMAT_R8G8B8A8_SRGB;
+            texture.width = static_cast<uint32_t>(tex_width);
+            texture.height = static_cast<uint32_t>(tex_height);
+            texture.data.assign(pixels, pixels + static_cast<size_t>(tex_width) * tex_height * 4);
+            texture.mips = { { 0, texture.data.size(), texture.width, texture.height } };
+            stbi_image_free(pixels);
+        }
+
+        // Sources that were not cooked get their mip chain here, on the decode thread.
+        if (data.texture.mips.size() == 1 && !isBlockCompressed(data.texture.format))
+        {
+            generateMipChain(data.texture);
+        }
+    } /// decodeTexture
+
+    /******************************************************************
+        Placeholder geometry: a unit cube with a 1x1 grey texel.
+    *******************************************************************/
+    ModelData Model::createPlaceholderData()
+    {
+        ModelData data;
+
+        const glm::vec3 normals[] =
+        {
+            { 1.0f, 0.0f, 0.0f }, { -1.0f, 0.0f, 0.0f },
+            { 0.0f, 1.0f, 0.0f }, { 0.0f, -1.0f, 0.0f },
+            { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, -1.0f }
+        };
+        const glm::vec2 corners[] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f }, { 0.0f, 1.0f } };
+
+        // Build each face from its normal and two tangent axes.
+        for (const auto & n : normals)
+        {
+            glm::vec3 u = glm::abs(n.x) > 0.5f ? glm::vec3(0.0f, 1.0f, 0.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+            glm::vec3 v = glm::cross(n, u);
+            uint32_t base = static_cast<uint32_t>(data.vertices.size());
+
+            for (const auto & c : corners)
+            {
+                Vertex vertex = {};
+                vertex.position = 0.5f * n + (c.x - 0.5f) * u + (c.y - 0.5f) * v;
+                vertex.normal = n;
+                vertex.color = {1.0f, 1.0f, 1.0f};
+                vertex.texCoord = c;
+                data.vertices.push_back(vertex);
+            }
+            uint32_t face[] = { 0, 1, 2, 2, 3, 0 };
+            for (uint32_t i : face)
+            {
+                data.indices.push_back(base + i);
             }
         }
-    } /// loadModel
+
+        data.texture.format = VK_FORMAT_R8G8B8A8_SRGB;
+        data.texture.width = 1;
+        data.texture.height = 1;
+        data.texture.data = { 128, 128, 128, 255 };
+        data.texture.mips = { { 0, 4, 1, 1 } };
+        return data;
+    } /// createPlaceholderData
 
     /**
-     * @brief Load the verticies into a buffer in device local memory.
+     * @brief Create the vertex and position buffers in device local memory and queue their uploads.
      * 
      */
     void Model::createVertexBuffer()
     {
         VkDeviceSize bufferSize = sizeof(m_vertices[0]) * m_vertices.size();
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingMemory;
-
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-                     stagingBuffer, stagingMemory);
-
-        // Copy vertex data to the buffer.
-        void *data;
-        vkMapMemory(LogicalDevice::getInstance()->getLogicalDevice(), stagingMemory, 0, bufferSize, 0, &data);
-        memcpy(data, m_vertices.data(), (size_t)bufferSize);
-        vkUnmapMemory(LogicalDevice::getInstance()->getLogicalDevice(), stagingMemory);
 
         // Create transfer destination buffer.
         createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_vertexBuffer, m_vertexBufferMemory);
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_vertexBuffer, m_vertexBufferMemory, MemoryCategory::Geometry);
 
-        // Copy the buffer contents
-        copyBuffer(stagingBuffer, m_vertexBuffer, bufferSize);
-        vkDestroyBuffer(LogicalDevice::getInstance()->getLogicalDevice(), stagingBuffer, nullptr);
-        vkFreeMemory(LogicalDevice::getInstance()->getLogicalDevice(), stagingMemory, nullptr);
+        UploadManager::getInstance()->uploadBuffer(m_vertexBuffer, m_vertices.data(), bufferSize,
+            VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
+
+        // Position stream for the depth pre-pass.
+        std::vector<glm::vec3> positions;
+        positions.reserve(m_vertices.size());
+        for (const auto & vertex : m_vertices)
+        {
+            positions.push_back(vertex.position);
+        }
+        VkDeviceSize positionSize = sizeof(glm::vec3) * positions.size();
+
+        createBuffer(positionSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                     VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_positionBuffer, m_positionBufferMemory, MemoryCategory::Geometry);
+
+        UploadManager::getInstance()->uploadBuffer(m_positionBuffer, positions.data(), positionSize,
+            VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
     } /// createVertexBuffer
 
     /**
-     * @brief Create the index buffer and load it into device memory.
+     * @brief Create the index buffer and queue its upload.
      * 
      */
     void Model::createIndexBuffer()
     {
         VkDeviceSize bufferSize = sizeof(m_indices[0]) * m_indices.size();
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingMemory;
-
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
-            | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingMemory);
-        
-        void *data;
-        vkMapMemory(LogicalDevice::getInstance()->getLogicalDevice(), stagingMemory, 0, bufferSize, 0, &data);
-        memcpy(data, m_indices.data(), (size_t)bufferSize);
-        vkUnmapMemory(LogicalDevice::getInstance()->getLogicalDevice(), stagingMemory);
-        
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_indexBuffer, m_indexBufferMemory);
 
-        copyBuffer(stagingBuffer, m_indexBuffer, bufferSize);
+        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_indexBuffer, m_indexBufferMemory, MemoryCategory::Geometry);
 
-        vkDestroyBuffer(LogicalDevice::getInstance()->getLogicalDevice(), stagingBuffer, nullptr);
-        vkFreeMemory(LogicalDevice::getInstance()->getLogicalDevice(), stagingMemory, nullptr);
+        UploadManager::getInstance()->uploadBuffer(m_indexBuffer, m_indices.data(), bufferSize,
+            VK_ACCESS_INDEX_READ_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT);
     }
 
     /**
@@ -173,256 +351,50 @@ namespace KMDM
     void Model::creatteTransBuffer()
     {
         VkDeviceSize bufferSize = sizeof(m_transBufferObj);
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingMemory;
-
-        createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
-            | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingMemory);
-        
-        void *data;
-        vkMapMemory(LogicalDevice::getInstance()->getLogicalDevice(), stagingMemory, 0, bufferSize, 0, &data);
-        memcpy(data, &m_transBufferObj, (size_t)bufferSize);
-        vkUnmapMemory(LogicalDevice::getInstance()->getLogicalDevice(), stagingMemory);
 
         createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT |
             VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 
-            m_translationBufffer, m_translationMemory);
-        
-        copyBuffer(stagingBuffer, m_translationBufffer, bufferSize);
+            m_translationBufffer, m_translationMemory, MemoryCategory::Uniform);
 
-        vkDestroyBuffer(LogicalDevice::getInstance()->getLogicalDevice(), stagingBuffer, nullptr);
-        vkFreeMemory(LogicalDevice::getInstance()->getLogicalDevice(), stagingMemory, nullptr);
+        UploadManager::getInstance()->uploadBuffer(m_translationBufffer, &m_transBufferObj, bufferSize,
+            VK_ACCESS_UNIFORM_READ_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
     }
 
     /******************************************************************
-        Create the texture image.
+        Hand the texture to the residency manager, which uploads its
+        mip tail now and streams the finer levels on demand.
     *******************************************************************/
-    void Model::createTextureImage(std::string path)
+    void Model::createTextureImage(const TextureData& texture)
     {
-        int tex_width, tex_height, tex_channels;
-
-        // Load the image.
-        stbi_uc *pixels = stbi_load(path.c_str(), &tex_width, &tex_height,
-                                    &tex_channels, STBI_rgb_alpha);
-        if (!pixels)
-        {
-            throw std::runtime_error("Failed to load texture image.");
-        }
-        VkDeviceSize image_size = tex_width * tex_height * 4;  // 4 bytes per pixel
-        m_mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(tex_width, tex_height)))) + 1;
-
-        // Staging buffer.
-        VkBuffer staging_buffer;
-        VkDeviceMemory staging_memory;
-        createBuffer(image_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
-                     VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, staging_buffer, staging_memory);
-        // Transfer data to staging buffer.
-        void *data;
-        vkMapMemory(LogicalDevice::getInstance()->getLogicalDevice(), staging_memory, 0, image_size, 0, &data);
-        memcpy(data, pixels, static_cast<size_t>(image_size));
-        vkUnmapMemory(LogicalDevice::getInstance()->getLogicalDevice(), staging_memory);
-
-        // Free the pixel array.
-        stbi_image_free(pixels);
-
-        // Create the texture image.
-        createImage(tex_width, tex_height, m_mipLevels, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
-                    VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                    m_textureImage, m_textureImageMemory);
-
-        // Copy the staging buffer to the texture image.
-        transitionImageLayout(m_textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED,
-                              VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, m_mipLevels);
-
-        // Copy the staging buffer to the image.
-        copyBufferToImage(staging_buffer, m_textureImage, static_cast<uint32_t>(tex_width),
-                          static_cast<uint32_t>(tex_height));
-
-        // Generate the mipmaps.
-        generateMipmaps(m_textureImage, tex_width, tex_height, VK_FORMAT_R8G8B8A8_SRGB, m_mipLevels);
-
-        // Cleanup.
-        vkDestroyBuffer(LogicalDevice::getInstance()->getLogicalDevice(), staging_buffer, nullptr);
-        vkFreeMemory(LogicalDevice::getInstance()->getLogicalDevice(), staging_memory, nullptr);
+        m_texture = TextureResidency::getInstance()->registerTexture(texture);
     } /// createTextureImage
 
     /******************************************************************
-        Create the texture image view.
-    ******************************************************************/
-    void Model::createTextureImageView()
-    {
-       m_textureImageView  = createImageView(m_textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, m_mipLevels);
-    } /// createTextureImageView
-
-    /******************************************************************
-        Generate mip maps.
+        Bounding sphere around the vertices' axis aligned box.
     *******************************************************************/
-    void Model::generateMipmaps(VkImage image, int32_t tex_width, int32_t tex_height, VkFormat format, uint32_t mip_levels)
+    void Model::computeBounds()
     {
-        // Check device capabilities.
-        VkFormatProperties format_properties;
-        vkGetPhysicalDeviceFormatProperties(PhysicalDevice::getInstance()->getPhysicalDevice(), format, &format_properties);
-        if (!(format_properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT))
+        glm::vec3 lo(0.0f);
+        glm::vec3 hi(0.0f);
+        if (!m_vertices.empty())
         {
-            throw std::runtime_error("Texture image format does not support linear blitting.");
+            lo = hi = glm::vec3(m_vertices[0].position);
         }
-
-        // Get a command buffer
-        VkCommandBuffer command_buffer = CommandPool::getInstance()->beginSingleTimeCommands();
-
-        // Set up an image barrier.
-        VkImageMemoryBarrier barrier = {};
-        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        barrier.image = image;
-        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        barrier.subresourceRange.baseArrayLayer = 0;
-        barrier.subresourceRange.layerCount = 1;
-        barrier.subresourceRange.levelCount = 1;
-
-        int32_t mip_width = tex_width;
-        int32_t mip_height = tex_height;
-
-        for (uint32_t i = 1; i < mip_levels; i++)
-        {
-            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-            barrier.subresourceRange.baseMipLevel = i - 1;
-
-            vkCmdPipelineBarrier(command_buffer,
-                                 VK_PIPELINE_STAGE_TRANSFER_BIT,VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
-                                 0, nullptr,
-                                 0, nullptr,
-                                 1, &barrier);
-
-            // Blit info.
-            VkImageBlit blit = {};
-            blit.srcOffsets[0] = {0, 0, 0};
-            blit.srcOffsets[1] = { mip_width, mip_height, 1 };
-            blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            blit.srcSubresource.mipLevel = i - 1;
-            blit.srcSubresource.baseArrayLayer = 0;
-            blit.srcSubresource.layerCount = 1;
-
-            blit.dstOffsets[0] = {0, 0, 0};
-            blit.dstOffsets[1] = { mip_width > 1 ? mip_width / 2 : 1, mip_height > 1 ? mip_height / 2 : 1, 1};
-            blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-            blit.dstSubresource.mipLevel = i;
-            blit.dstSubresource.baseArrayLayer = 0;
-            blit.dstSubresource.layerCount = 1;
-
-            vkCmdBlitImage(command_buffer,
-                           image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                           image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                           1, &blit,
-                           VK_FILTER_LINEAR);
-
-            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
-            barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-            vkCmdPipelineBarrier(command_buffer,
-                                 VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-                                 0, nullptr,
-                                 0, nullptr,
-                                 1, &barrier);
-
-            if  (mip_width > 1)
-                mip_width /= 2;
-            if (mip_height > 1)
-                mip_height /= 2;
-        }
-
-        barrier.subresourceRange.baseMipLevel = mip_levels - 1;
-        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
-        barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-        vkCmdPipelineBarrier(command_buffer,
-                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
-                             0, nullptr,
-                             0, nullptr,
-                             1, &barrier);
-
-        CommandPool::getInstance()->endSingleTimeCommands(command_buffer);
-    } /// generateMipmaps
-
-
-    /******************************************************************
-        Transition image layout.
-    *******************************************************************/
-    void Model::transitionImageLayout(VkImage image, VkFormat format,
-        VkImageLayout old_layout, VkImageLayout new_layout, uint32_t mip_levels)
-    {
-
-        // Get a command buffer.
-        VkCommandBuffer buffer = CommandPool::getInstance()->beginSingleTimeCommands();
-
-        VkImageMemoryBarrier barrier = {};
-        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        barrier.oldLayout = old_layout;
-        barrier.newLayout = new_layout;
-        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-
-        barrier.image = image;
-        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        barrier.subresourceRange.baseMipLevel = 0;
-        barrier.subresourceRange.levelCount = mip_levels;
-        barrier.subresourceRange.baseArrayLayer = 0;
-        barrier.subresourceRange.layerCount = 1;
-
-        VkPipelineStageFlags source_stage;
-        VkPipelineStageFlags dest_stage;
-        if (old_layout == VK_IMAGE_LAYOUT_UNDEFINED && new_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
-        {
-            barrier.srcAccessMask = 0;
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-            source_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-            dest_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-
-        }
-        else if (old_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL &&
-                 new_layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
-        {
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-            source_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-            dest_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-        }
-        else
+        for (const auto & vertex : m_vertices)
         {
-            throw std::invalid_argument("Unsupported layout transition.");
+            lo = glm::min(lo, glm::vec3(vertex.position));
+            hi = glm::max(hi, glm::vec3(vertex.position));
         }
-
-        vkCmdPipelineBarrier(
-            buffer,
-            source_stage, dest_stage,
-            0,
-            0, nullptr,
-            0, nullptr,
-            1, &barrier
-        );
-
-        // End the command buffer.
-        CommandPool::getInstance()->endSingleTimeCommands(buffer);
-    } /// transitionImageLayout
+        m_boundsCenter = 0.5f * (lo + hi);
+        m_boundsRadius = glm::length(0.5f * (hi - lo));
+    } /// computeBounds
 
     /******************************************************************
-        Create texture sampler.
+        Settings of the sampler every model texture uses.  The LOD is
+        not clamped, so one sampler serves any mip chain length.
     *******************************************************************/
-    void Model::createTextureSampler()
+    VkSamplerCreateInfo Model::getTextureSamplerInfo()
     {
-        // Sampler create info
         VkSamplerCreateInfo sampler_info = {};
         sampler_info.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
         sampler_info.magFilter = VK_FILTER_LINEAR;
@@ -432,11 +404,8 @@ namespace KMDM
         sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
         sampler_info.anisotropyEnable = VK_TRUE;
 
-        // Get maximum anisotropy level from the physical device.
-        VkPhysicalDeviceProperties properties = {};
-        vkGetPhysicalDeviceProperties(PhysicalDevice::getInstance()->getPhysicalDevice(), &properties);
-
-        sampler_info.maxAnisotropy = properties.limits.maxSamplerAnisotropy;
+        // Maximum anisotropy level of the physical device.
+        sampler_info.maxAnisotropy = LogicalDevice::getInstance()->getPhysicalDeviceProperties().limits.maxSamplerAnisotropy;
         sampler_info.borderColor = VK_BORDER_COLOR_INT_OPAQUE_BLACK;
         sampler_info.unnormalizedCoordinates = VK_FALSE;
         sampler_info.compareEnable = VK_FALSE;
@@ -444,20 +413,29 @@ namespace KMDM
         sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
         sampler_info.mipLodBias = 0.0f;
         sampler_info.minLod = 0.0f;
-        sampler_info.maxLod = static_cast<float>(m_mipLevels);
+        sampler_info.maxLod = VK_LOD_CLAMP_NONE;
+        return sampler_info;
+    } /// getTextureSamplerInfo
 
-        // Create the texture sampler.
-        if (vkCreateSampler(LogicalDevice::getInstance()->getLogicalDevice(), &sampler_info, nullptr, &m_textureImageSampler)
-            != VK_SUCCESS)
-        {
-            throw std::runtime_error("Failed to create texture sampler.");
-        }
+    /******************************************************************
+        Get the texture sampler, shared with every other model.
+    *******************************************************************/
+    void Model::createTextureSampler()
+    {
+        m_textureImageSampler = SamplerCache::getInstance()->getSampler(getTextureSamplerInfo());
     } /// createTextureSampler
 
     uint32_t Model::getIndexCount() { return static_cast<uint32_t>(m_indices.size()); }
+    const std::vector<Vertex>& Model::getVertices() { return m_vertices; }
+    const std::vector<uint32_t>& Model::getIndices() { return m_indices; }
     VkBuffer* Model::getVertexBuffer() { return &m_vertexBuffer; }
+    VkBuffer* Model::getPositionBuffer() { return &m_positionBuffer; }
     VkBuffer* Model::getIndexBuffer() { return &m_indexBuffer; }
-    VkImageView Model::getTextureImageView() { return m_textureImageView; }
+    VkImageView Model::getTextureImageView() { return TextureResidency::getInstance()->getImageView(m_texture); }
+    uint32_t Model::getTexture() { return m_texture; }
+    glm::vec3 Model::getBoundsCenter() { return m_boundsCenter; }
+    float Model::getBoundsRadius() { return m_boundsRadius; }
     VkSampler Model::getTextureSampler() { return m_textureImageSampler; }
     VkBuffer Model::getTranslationMatrix() { return m_translationBufffer; }
+    uint64_t Model::getUploadTicket() { return m_uploadTicket; }
 }
@@ -2,6 +2,7 @@
 #include "../include/Common.h"
 #include "../include/Instance.h"
 #include "../include/Surface.h"
+#include "../include/Window.h"
 #include "../include/types.h"
 
 #include <vector>
@@ -14,6 +15,7 @@ namespace KMDM
 {
     PhysicalDevice* PhysicalDevice::m_physicalDevice = nullptr;
     VkPhysicalDevice PhysicalDevice::m_VKphysicalDevice = VK_NULL_HANDLE;
+    int PhysicalDevice::m_deviceIndex = -1;
 
     PhysicalDevice* PhysicalDevice::getInstance()
     {
@@ -48,13 +50,34 @@ namespace KMDM
         vkEnumeratePhysicalDevices(instance->getVulkanInstance(), &device_count, devices.data());
 
         // Check device capabilities & choose a suitable device.
-        // This chooses the first suitable device, not necessarily the best one.
+        // This chooses the first suitable device, not necessarily the best one.  Headless runs
+        // take any suitable device, but still prefer a discrete GPU to an integrated or CPU one.
+        // A device index picks that suitable device instead.
+        int suitable = 0;
         for (size_t i = 0; i < devices.size(); i++)
         {
+            if (m_deviceIndex >= 0)
+            {
+                if (isDeviceSuitable(devices[i]) && suitable++ == m_deviceIndex)
+                {
+                    m_VKphysicalDevice = devices[i];
+                    break;
+                }
+                continue;
+            }
             if(isDeviceSuitable(devices[i]))
             {
-                m_VKphysicalDevice = devices[i];
-                break;
+                VkPhysicalDeviceProperties device_properties;
+                vkGetPhysicalDeviceProperties(devices[i], &device_properties);
+                if (m_VKphysicalDevice == VK_NULL_HANDLE)
+                {
+                    m_VKphysicalDevice = devices[i];
+                }
+                if (device_properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU)
+                {
+                    m_VKphysicalDevice = devices[i];
+                    break;
+                }
             }
         }
         if (m_VKphysicalDevice == VK_NULL_HANDLE)
@@ -64,6 +87,8 @@ namespace KMDM
         VkPhysicalDeviceProperties props;
         vkGetPhysicalDeviceProperties(m_VKphysicalDevice, &props);
         vkGetPhysicalDeviceMemoryProperties(m_VKphysicalDevice, &m_physicalDeviceMemoryProperties);
+        vkGetPhysicalDeviceFeatures(m_VKphysicalDevice, &m_physicalDeviceFeatures);
+        m_physicalDeviceProperties = props;
 //        std::cout << "Found physical device: " << props.deviceName << std::endl;
     }
 
@@ -72,6 +97,15 @@ namespace KMDM
         //dtor
     }
 
+    void PhysicalDevice::setDeviceIndex(int index)
+    {
+        if (m_physicalDevice)
+        {
+            throw std::runtime_error("The device index has to be set before the device is chosen.");
+        }
+        m_deviceIndex = index;
+    }
+
     SwapChainSupportDetails PhysicalDevice::getSwapChainSupportDetails()
     {
         return m_physicalDevice->m_SwapChainDetails;
@@ -100,12 +134,14 @@ namespace KMDM
         std::vector<VkExtensionProperties> device_extension_properties(device_extension_count);
         vkEnumerateDeviceExtensionProperties(device, nullptr, &device_extension_count, device_extension_properties.data());
 
-        // Verify the desired extensions are supported.
+        // Verify the desired extensions are supported.  Headless runs draw offscreen, and need
+        // neither the swapchain extension nor a surface.
+        bool headless = Window::isHeadless();
         bool extension_supported = true;
         Instance* instance = Instance::getInstance();
         for (auto & extension : REQUIRED_DEVICE_EXTENSIONS)
         {
-            if (!instance->verifyExtensionSupport(device_extension_properties, extension))
+            if (!headless && !instance->verifyExtensionSupport(device_extension_properties, extension))
             {
                 extension_supported = false;
             }
@@ -113,21 +149,33 @@ namespace KMDM
 
         // Verify the swapchain is adequate.
         bool swapchain_adequate = true;
-        if (extension_supported)
+        if (extension_supported && !headless)
         {
             m_SwapChainDetails = querySwapChainSupport(device);
             swapchain_adequate = !m_SwapChainDetails.formats.empty() &&
                                  !m_SwapChainDetails.presentModes.empty();
         }
 
+        // Headless benchmarks also run on integrated, virtual and CPU devices such as lavapipe.
         bool is_gpu = false;
-        if (device_properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU &&
+        if ((headless || device_properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) &&
                 device_features.geometryShader && device_features.samplerAnisotropy)
         {
             is_gpu = true;
         }
 
-        return (is_gpu && extension_supported && swapchain_adequate);
+        // Uploads are tracked with timeline semaphores, and the visibility buffer picks a
+        // material texture per pixel.
+        VkPhysicalDeviceVulkan12Features features12 = {};
+        features12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+        VkPhysicalDeviceFeatures2 features2 = {};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &features12;
+        vkGetPhysicalDeviceFeatures2(device, &features2);
+        bool timeline_supported = features12.timelineSemaphore == VK_TRUE;
+        bool indexing_supported = features12.shaderSampledImageArrayNonUniformIndexing == VK_TRUE;
+
+        return (is_gpu && extension_supported && swapchain_adequate && timeline_supported && indexing_supported);
     } /// isDeviceSuitable
 
 
@@ -186,5 +234,25 @@ namespace KMDM
         throw std::runtime_error("Failed to find suitable format.");
     }
 
+    bool PhysicalDevice::isFormatSupported(VkFormat format, VkImageTiling tiling, VkFormatFeatureFlags features)
+    {
+        VkFormatProperties props;
+        vkGetPhysicalDeviceFormatProperties(m_VKphysicalDevice, format, &props);
+        VkFormatFeatureFlags supported = tiling == VK_IMAGE_TILING_LINEAR ?
+            props.linearTilingFeatures : props.optimalTilingFeatures;
+        return (supported & features) == features;
+    }
+
     VkPhysicalDeviceMemoryProperties PhysicalDevice::getMemoryProperties() { return m_physicalDeviceMemoryProperties; }
+    VkPhysicalDeviceProperties PhysicalDevice::getPhysicalDeviceProperties() { return m_physicalDeviceProperties; }
+    VkPhysicalDeviceFeatures PhysicalDevice::getPhysicalDeviceFeatures() { return m_physicalDeviceFeatures; }
+
+    bool PhysicalDevice::isExtensionSupported(const char* extension)
+    {
+        uint32_t count = 0;
+        vkEnumerateDeviceExtensionProperties(m_VKphysicalDevice, nullptr, &count, nullptr);
+        std::vector<VkExtensionProperties> extensions(count);
+        vkEnumerateDeviceExtensionProperties(m_VKphysicalDevice, nullptr, &count, extensions.data());
+        return Instance::getInstance()->verifyExtensionSupport(extensions, extension);
+    }
 }
@@ -0,0 +1,182 @@
+#include "../include/PipelineCache.h"
+#include "../include/LogicalDevice.h"
+
+#include <vulkan/vulkan.h>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+
+namespace KMDM
+{
+    PipelineCache* PipelineCache::m_pipelineCache = nullptr;
+    std::string PipelineCache::m_path = PIPELINE_CACHE_PATH;
+
+    /**
+     * @brief Get the Instance object
+     *
+     * @return PipelineCache*
+     */
+    PipelineCache* PipelineCache::getInstance()
+    {
+        if (!m_pipelineCache)
+        {
+            m_pipelineCache = new PipelineCache();
+        }
+        return m_pipelineCache;
+    }
+
+    void PipelineCache::setCachePath(const std::string& path)
+    {
+        m_path = path;
+    }
+
+    /**
+     * @brief Construct a new Pipeline Cache:: Pipeline Cache object
+     *
+     */
+    PipelineCache::PipelineCache()
+    {
+        std::vector<char> data = loadCacheData();
+
+        VkPipelineCacheCreateInfo cache_info = {};
+        cache_info.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        cache_info.initialDataSize = data.size();
+        cache_info.pInitialData = data.empty() ? nullptr : data.data();
+
+        if (vkCreatePipelineCache(LogicalDevice::getInstance()->getLogicalDevice(), &cache_info, nullptr, &m_cache)
+            != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create pipeline cache.");
+        }
+
+        m_warm = !data.empty();
+        m_savedSize = data.size();
+        m_lastSave = std::chrono::steady_clock::now();
+
+        if (m_warm)
+        {
+            std::cout << "Created pipeline cache from " << m_path << " (" << data.size() << " bytes)." << std::endl;
+        }
+        else
+        {
+            std::cout << "Created empty pipeline cache." << std::endl;
+        }
+    }
+
+    PipelineCache::~PipelineCache()
+    {
+        destroyPipelineCache();
+    }
+
+    /**
+     * @brief Save the cache and destroy it.
+     *
+     */
+    void PipelineCache::destroyPipelineCache()
+    {
+        std::cout << "- Destroying PipelineCache." << std::endl;
+        save();
+        vkDestroyPipelineCache(LogicalDevice::getInstance()->getLogicalDevice(), m_cache, nullptr);
+        m_cache = VK_NULL_HANDLE;
+        m_pipelineCache = nullptr;
+    }
+
+    /******************************************************************
+        Read the cache file.  Anything that is missing, truncated or
+        was written for another device or driver is ignored.
+    *******************************************************************/
+    std::vector<char> PipelineCache::loadCacheData()
+    {
+        std::ifstream file(m_path, std::ios::binary);
+        if (!file.is_open())
+        {
+            return {};
+        }
+
+        std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (!isCacheDataValid(data))
+        {
+            std::cout << "Ignoring stale pipeline cache " << m_path << "." << std::endl;
+            return {};
+        }
+        return data;
+    } /// loadCacheData
+
+    /******************************************************************
+        Compare the cache header with the device.  The UUID changes
+        with the driver version, so it covers driver updates too.
+    *******************************************************************/
+    bool PipelineCache::isCacheDataValid(const std::vector<char>& data)
+    {
+        VkPipelineCacheHeaderVersionOne header = {};
+        if (data.size() < sizeof(header))
+        {
+            return false;
+        }
+        memcpy(&header, data.data(), sizeof(header));
+
+        VkPhysicalDeviceProperties properties = LogicalDevice::getInstance()->getPhysicalDeviceProperties();
+        return header.headerSize >= sizeof(header) &&
+               header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+               header.vendorID == properties.vendorID &&
+               header.deviceID == properties.deviceID &&
+               memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+    } /// isCacheDataValid
+
+    /******************************************************************
+        Write the cache through a temporary file and rename it over the
+        old one.  Cache data only grows, so an unchanged size means
+        there is nothing new to write.
+    *******************************************************************/
+    void PipelineCache::save()
+    {
+        VkDevice device = LogicalDevice::getInstance()->getLogicalDevice();
+        m_lastSave = std::chrono::steady_clock::now();
+
+        size_t size = 0;
+        if (vkGetPipelineCacheData(device, m_cache, &size, nullptr) != VK_SUCCESS || size == m_savedSize)
+        {
+            return;
+        }
+
+        std::vector<char> data(size);
+        if (vkGetPipelineCacheData(device, m_cache, &size, data.data()) != VK_SUCCESS)
+        {
+            std::cerr << "Failed to read the pipeline cache." << std::endl;
+            return;
+        }
+        data.resize(size);
+
+        std::string temp_path = m_path + ".tmp";
+        {
+            std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+            if (!file.write(data.data(), data.size()) || !file.flush())
+            {
+                std::cerr << "Failed to write " << temp_path << "." << std::endl;
+                return;
+            }
+        }
+        if (std::rename(temp_path.c_str(), m_path.c_str()) != 0)
+        {
+            std::cerr << "Failed to replace " << m_path << "." << std::endl;
+            std::remove(temp_path.c_str());
+            return;
+        }
+        m_savedSize = size;
+    } /// save
+
+    void PipelineCache::update()
+    {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - m_lastSave;
+        if (elapsed.count() >= PIPELINE_CACHE_SAVE_INTERVAL)
+        {
+            save();
+        }
+    }
+
+    VkPipelineCache PipelineCache::getPipelineCache() { return m_cache; }
+    bool PipelineCache::isWarm() { return m_warm; }
+}
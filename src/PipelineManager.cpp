@@ -0,0 +1,536 @@
+#include "../include/PipelineManager.h"
+#include "../include/PipelineCache.h"
+#include "../include/LogicalDevice.h"
+
+#include <vulkan/vulkan.h>
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+
+namespace KMDM
+{
+    PipelineManager* PipelineManager::m_pipelineManager = nullptr;
+
+    namespace
+    {
+        void hashCombine(size_t& seed, size_t value)
+        {
+            seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        }
+    }
+
+    bool PipelineDesc::operator==(const PipelineDesc& other) const
+    {
+        if (vertexShader != other.vertexShader || fragmentShader != other.fragmentShader ||
+            specialization.size() != other.specialization.size() ||
+            vertexBindings.size() != other.vertexBindings.size() ||
+            vertexAttributes.size() != other.vertexAttributes.size())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < specialization.size(); i++)
+        {
+            if (specialization[i].id != other.specialization[i].id ||
+                specialization[i].value != other.specialization[i].value)
+            {
+                return false;
+            }
+        }
+        for (size_t i = 0; i < vertexBindings.size(); i++)
+        {
+            const VkVertexInputBindingDescription& a = vertexBindings[i];
+            const VkVertexInputBindingDescription& b = other.vertexBindings[i];
+            if (a.binding != b.binding || a.stride != b.stride || a.inputRate != b.inputRate)
+            {
+                return false;
+            }
+        }
+        for (size_t i = 0; i < vertexAttributes.size(); i++)
+        {
+            const VkVertexInputAttributeDescription& a = vertexAttributes[i];
+            const VkVertexInputAttributeDescription& b = other.vertexAttributes[i];
+            if (a.location != b.location || a.binding != b.binding || a.format != b.format || a.offset != b.offset)
+            {
+                return false;
+            }
+        }
+        return topology == other.topology && polygonMode == other.polygonMode && cullMode == other.cullMode &&
+               frontFace == other.frontFace && samples == other.samples && depthTest == other.depthTest &&
+               depthWrite == other.depthWrite && depthCompareOp == other.depthCompareOp &&
+               blendEnable == other.blendEnable && colorAttachmentCount == other.colorAttachmentCount &&
+               layout == other.layout &&
+               renderPass == other.renderPass && subpass == other.subpass;
+    }
+
+    size_t hashPipelineDesc(const PipelineDesc& desc)
+    {
+        size_t seed = 0;
+        hashCombine(seed, std::hash<std::string>()(desc.vertexShader));
+        hashCombine(seed, std::hash<std::string>()(desc.fragmentShader));
+        for (const auto & constant : desc.specialization)
+        {
+            hashCombine(seed, constant.id);
+            hashCombine(seed, constant.value);
+        }
+        for (const auto & binding : desc.vertexBindings)
+        {
+            hashCombine(seed, binding.binding);
+            hashCombine(seed, binding.stride);
+            hashCombine(seed, binding.inputRate);
+        }
+        for (const auto & attribute : desc.vertexAttributes)
+        {
+            hashCombine(seed, attribute.location);
+            hashCombine(seed, attribute.binding);
+            hashCombine(seed, attribute.format);
+            hashCombine(seed, attribute.offset);
+        }
+        hashCombine(seed, desc.topology);
+        hashCombine(seed, desc.polygonMode);
+        hashCombine(seed, desc.cullMode);
+        hashCombine(seed, desc.frontFace);
+        hashCombine(seed, desc.samples);
+        hashCombine(seed, desc.depthTest);
+        hashCombine(seed, desc.depthWrite);
+        hashCombine(seed, desc.depthCompareOp);
+        hashCombine(seed, desc.blendEnable);
+        hashCombine(seed, desc.colorAttachmentCount);
+        hashCombine(seed, std::hash<VkPipelineLayout>()(desc.layout));
+        hashCombine(seed, std::hash<VkRenderPass>()(desc.renderPass));
+        hashCombine(seed, desc.subpass);
+        return seed;
+    }
+
+    /**
+     * @brief Get the Instance object
+     *
+     * @return PipelineManager*
+     */
+    PipelineManager* PipelineManager::getInstance()
+    {
+        if (!m_pipelineManager)
+        {
+            m_pipelineManager = new PipelineManager();
+        }
+        return m_pipelineManager;
+    }
+
+    /**
+     * @brief Construct a new Pipeline Manager:: Pipeline Manager object
+     *
+     * @param compile_threads Number of background compile threads, 0 picks a quarter of the cores.
+     */
+    PipelineManager::PipelineManager(uint32_t compile_threads)
+    {
+        if (compile_threads == 0)
+        {
+            // Compiles are long but rare, keep most cores for the frame and the asset streamer.
+            compile_threads = std::max(1u, std::thread::hardware_concurrency() / 4);
+        }
+
+        // Created here so the compile threads never race to create it.
+        PipelineCache::getInstance();
+
+        for (uint32_t i = 0; i < compile_threads; i++)
+        {
+            m_threads.emplace_back(&PipelineManager::compileWorker, this);
+        }
+        std::cout << "Created pipeline manager with " << compile_threads << " compile threads." << std::endl;
+    }
+
+    PipelineManager::~PipelineManager()
+    {
+        destroyPipelineManager();
+    }
+
+    /**
+     * @brief Stop the compile threads and destroy every pipeline.
+     *
+     */
+    void PipelineManager::destroyPipelineManager()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_stopping)
+            {
+                return;
+            }
+            m_stopping = true;
+        }
+        m_queueCondition.notify_all();
+        for (auto & thread : m_threads)
+        {
+            if (thread.joinable())
+            {
+                thread.join();
+            }
+        }
+
+        std::cout << "- Destroying PipelineManager." << std::endl;
+        VkDevice device = LogicalDevice::getInstance()->getLogicalDevice();
+        for (auto & bucket : m_variants)
+        {
+            for (auto & variant : bucket.second)
+            {
+                if (variant->pipeline != VK_NULL_HANDLE)
+                {
+                    vkDestroyPipeline(device, variant->pipeline, nullptr);
+                }
+            }
+        }
+        m_variants.clear();
+        m_queue.clear();
+
+        for (auto & module : m_shaderModules)
+        {
+            vkDestroyShaderModule(device, module.second, nullptr);
+        }
+        m_shaderModules.clear();
+        m_pipelineManager = nullptr;
+    }
+
+    /******************************************************************
+        Get a pipeline, compiling it here when nobody else is.
+    *******************************************************************/
+    VkPipeline PipelineManager::getPipeline(const PipelineDesc& desc)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        bool added = false;
+        Variant* variant = findVariant(desc, added);
+
+        if (variant->state == VariantState::Queued)
+        {
+            // Take it off the background queue rather than wait for a compile thread.
+            variant->state = VariantState::Compiling;
+            m_queue.erase(std::remove(m_queue.begin(), m_queue.end(), variant), m_queue.end());
+            lock.unlock();
+
+            VkPipeline pipeline = VK_NULL_HANDLE;
+            try
+            {
+                pipeline = compile(desc);
+            }
+            catch (...)
+            {
+                finishCompile(variant, VK_NULL_HANDLE, true);
+                throw;
+            }
+            finishCompile(variant, pipeline, false);
+            return pipeline;
+        }
+
+        m_readyCondition.wait(lock, [variant]
+        {
+            return variant->state == VariantState::Ready || variant->state == VariantState::Failed;
+        });
+        if (variant->state == VariantState::Failed)
+        {
+            throw std::runtime_error("Failed to create graphics pipeline.");
+        }
+        return variant->pipeline;
+    } /// getPipeline
+
+    /******************************************************************
+        Get a pipeline if it is ready, otherwise queue it and use the
+        fallback.
+    *******************************************************************/
+    VkPipeline PipelineManager::requestPipeline(const PipelineDesc& desc, const PipelineDesc& fallback)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            bool added = false;
+            Variant* variant = findVariant(desc, added);
+            if (variant->state == VariantState::Ready)
+            {
+                return variant->pipeline;
+            }
+            if (added)
+            {
+                m_queue.push_back(variant);
+                m_queueCondition.notify_one();
+            }
+            m_stats.fallbacks++;
+        }
+        return getPipeline(fallback);
+    } /// requestPipeline
+
+    bool PipelineManager::isReady(const PipelineDesc& desc)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto bucket = m_variants.find(hashPipelineDesc(desc));
+        if (bucket == m_variants.end())
+        {
+            return false;
+        }
+        for (auto & variant : bucket->second)
+        {
+            if (variant->desc == desc)
+            {
+                return variant->state == VariantState::Ready;
+            }
+        }
+        return false;
+    }
+
+    PipelineManager::Variant* PipelineManager::findVariant(const PipelineDesc& desc, bool& added)
+    {
+        std::vector<std::unique_ptr<Variant>>& bucket = m_variants[hashPipelineDesc(desc)];
+        for (auto & variant : bucket)
+        {
+            if (variant->desc == desc)
+            {
+                added = false;
+                return variant.get();
+            }
+        }
+
+        bucket.push_back(std::make_unique<Variant>());
+        bucket.back()->desc = desc;
+        added = true;
+        return bucket.back().get();
+    }
+
+    void PipelineManager::finishCompile(Variant* variant, VkPipeline pipeline, bool failed)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            variant->pipeline = pipeline;
+            variant->state = failed ? VariantState::Failed : VariantState::Ready;
+        }
+        m_readyCondition.notify_all();
+    }
+
+    /**
+     * @brief Compile the queued variants.
+     *
+     */
+    void PipelineManager::compileWorker()
+    {
+        while (true)
+        {
+            Variant* variant = nullptr;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_queueCondition.wait(lock, [this] { return m_stopping || !m_queue.empty(); });
+                if (m_stopping)
+                {
+                    return;
+                }
+                variant = m_queue.front();
+                m_queue.pop_front();
+                variant->state = VariantState::Compiling;
+            }
+
+            // The description is never changed once added, so it can be read unlocked.
+            try
+            {
+                VkPipeline pipeline = compile(variant->desc);
+                finishCompile(variant, pipeline, false);
+
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stats.backgroundCompiles++;
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << "Failed to compile pipeline variant: " << e.what() << std::endl;
+                finishCompile(variant, VK_NULL_HANDLE, true);
+            }
+        }
+    }
+
+    PipelineManagerStats PipelineManager::getStats()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        PipelineManagerStats stats = m_stats;
+        stats.pipelines = 0;
+        stats.pending = 0;
+        for (auto & bucket : m_variants)
+        {
+            for (auto & variant : bucket.second)
+            {
+                stats.pipelines += variant->state == VariantState::Ready ? 1 : 0;
+                stats.pending += variant->state == VariantState::Queued || variant->state == VariantState::Compiling;
+            }
+        }
+        return stats;
+    }
+
+    /******************************************************************
+        Shader modules are loaded once and kept for later variants.
+    *******************************************************************/
+    VkShaderModule PipelineManager::getShaderModule(const std::string& path)
+    {
+        std::lock_guard<std::mutex> lock(m_shaderMutex);
+        auto it = m_shaderModules.find(path);
+        if (it != m_shaderModules.end())
+        {
+            return it->second;
+        }
+
+        VkShaderModule module = LogicalDevice::getInstance()->createShaderModule(readFile(path));
+        m_shaderModules[path] = module;
+        return module;
+    } /// getShaderModule
+
+    /******************************************************************
+        Create graphics pipeline.  Pipeline stages:
+
+        1) Input assembler.
+        2) Vertex shader (programmable).
+        3) Tessellation shader (programmable).
+        4) Geometry shader (programmable).
+        5) Rasterization.
+        6) Fragment shader (programmable).
+        7) Color blending.
+
+        Runs on the compile threads as well as the render thread.
+    *******************************************************************/
+    VkPipeline PipelineManager::compile(const PipelineDesc& desc)
+    {
+        // Specialization constants are packed as consecutive 32 bit values.
+        std::vector<VkSpecializationMapEntry> specializationEntries;
+        std::vector<uint32_t> specializationData;
+        for (const auto & constant : desc.specialization)
+        {
+            VkSpecializationMapEntry entry = {};
+            entry.constantID = constant.id;
+            entry.offset = static_cast<uint32_t>(specializationData.size() * sizeof(uint32_t));
+            entry.size = sizeof(uint32_t);
+            specializationEntries.push_back(entry);
+            specializationData.push_back(constant.value);
+        }
+
+        VkSpecializationInfo specializationInfo = {};
+        specializationInfo.mapEntryCount = static_cast<uint32_t>(specializationEntries.size());
+        specializationInfo.pMapEntries = specializationEntries.data();
+        specializationInfo.dataSize = specializationData.size() * sizeof(uint32_t);
+        specializationInfo.pData = specializationData.data();
+
+        // Vertex shader stage.
+        VkPipelineShaderStageCreateInfo shaderStages[2] = {};
+        shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+        shaderStages[0].module = getShaderModule(desc.vertexShader);
+        shaderStages[0].pName = "main";
+        shaderStages[0].pSpecializationInfo = specializationEntries.empty() ? nullptr : &specializationInfo;
+        // Fragment shader stage, left out of depth only pipelines.
+        uint32_t stageCount = 1;
+        if (!desc.fragmentShader.empty())
+        {
+            shaderStages[1] = shaderStages[0];
+            shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+            shaderStages[1].module = getShaderModule(desc.fragmentShader);
+            stageCount = 2;
+        }
+
+        // Vertex input.
+        VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+        vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+        vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(desc.vertexBindings.size());
+        vertexInputInfo.pVertexBindingDescriptions = desc.vertexBindings.data();
+        vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(desc.vertexAttributes.size());
+        vertexInputInfo.pVertexAttributeDescriptions = desc.vertexAttributes.data();
+
+        // Input assembly.
+        VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+        inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+        inputAssembly.topology = desc.topology;
+        inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+        // Viewport and scissor are dynamic, so pipelines outlive swapchain recreation.
+        VkPipelineViewportStateCreateInfo viewportState = {};
+        viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+        viewportState.viewportCount = 1;
+        viewportState.pViewports = nullptr;
+        viewportState.scissorCount = 1;
+        viewportState.pScissors = nullptr;
+
+        // Rasterizer.
+        VkPipelineRasterizationStateCreateInfo rasterizer = {};
+        rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+        rasterizer.depthClampEnable = VK_FALSE; // using this requires enabling a gpu feature.
+        rasterizer.rasterizerDiscardEnable = VK_FALSE;
+        rasterizer.polygonMode = desc.polygonMode;
+        rasterizer.lineWidth = 1.0f;
+        rasterizer.cullMode = desc.cullMode;
+        rasterizer.frontFace = desc.frontFace;
+        rasterizer.depthBiasEnable = VK_FALSE;
+
+        // Multisampling.
+        VkPipelineMultisampleStateCreateInfo multisampling = {};
+        multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+        multisampling.sampleShadingEnable = VK_FALSE;
+        multisampling.rasterizationSamples = desc.samples;
+        multisampling.minSampleShading = 1.0f;
+        multisampling.pSampleMask = nullptr;
+        multisampling.alphaToCoverageEnable = VK_FALSE;
+        multisampling.alphaToOneEnable = VK_FALSE;
+
+        // Color blending.
+        VkPipelineColorBlendAttachmentState colorBlendAttachment = {};
+        colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT
+                                              | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+        colorBlendAttachment.blendEnable = desc.blendEnable;
+        colorBlendAttachment.srcColorBlendFactor = desc.blendEnable ? VK_BLEND_FACTOR_SRC_ALPHA : VK_BLEND_FACTOR_ONE;
+        colorBlendAttachment.dstColorBlendFactor = desc.blendEnable ? VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA : VK_BLEND_FACTOR_ZERO;
+        colorBlendAttachment.colorBlendOp = VK_BLEND_OP_ADD;
+        colorBlendAttachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        colorBlendAttachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+        colorBlendAttachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+        VkPipelineColorBlendStateCreateInfo colorBlending = {};
+        colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+        colorBlending.logicOpEnable = VK_FALSE;
+        std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachments(desc.colorAttachmentCount,
+            colorBlendAttachment);
+        colorBlending.attachmentCount = desc.colorAttachmentCount;
+        colorBlending.pAttachments = colorBlendAttachments.data();
+
+        // Depth stencil.
+        VkPipelineDepthStencilStateCreateInfo depthStencil = {};
+        depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+        depthStencil.depthTestEnable = desc.depthTest;
+        depthStencil.depthWriteEnable = desc.depthWrite;
+        depthStencil.depthCompareOp = desc.depthCompareOp;
+        depthStencil.depthBoundsTestEnable = VK_FALSE;
+        depthStencil.minDepthBounds = 0.0f;
+        depthStencil.maxDepthBounds = 1.0f;
+        depthStencil.stencilTestEnable = VK_FALSE;
+
+        // The render area changes with the render scale, so passes set the viewport and scissor.
+        VkDynamicState dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+        VkPipelineDynamicStateCreateInfo dynamicState = {};
+        dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        dynamicState.dynamicStateCount = 2;
+        dynamicState.pDynamicStates = dynamicStates;
+
+        // Throw it all together.
+        VkGraphicsPipelineCreateInfo pipelineInfo = {};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        pipelineInfo.stageCount = stageCount;
+        pipelineInfo.pStages = shaderStages;
+        pipelineInfo.pVertexInputState = &vertexInputInfo;
+        pipelineInfo.pInputAssemblyState = &inputAssembly;
+        pipelineInfo.pViewportState = &viewportState;
+        pipelineInfo.pRasterizationState = &rasterizer;
+        pipelineInfo.pMultisampleState = &multisampling;
+        pipelineInfo.pDepthStencilState = &depthStencil;
+        pipelineInfo.pColorBlendState = &colorBlending;
+        pipelineInfo.pDynamicState = &dynamicState;
+        pipelineInfo.layout = desc.layout;
+        pipelineInfo.renderPass = desc.renderPass;
+        pipelineInfo.subpass = desc.subpass;
+        pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+        pipelineInfo.basePipelineIndex = -1;
+
+        // The pipeline cache is internally synchronized, so every thread can use it.
+        VkPipeline pipeline;
+        if (vkCreateGraphicsPipelines(LogicalDevice::getInstance()->getLogicalDevice(),
+            PipelineCache::getInstance()->getPipelineCache(), 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create graphics pipeline.");
+        }
+        return pipeline;
+    } /// compile
+}
@@ -0,0 +1,396 @@
+#include "../include/ReadbackRing.h"
+#include "../include/LogicalDevice.h"
+#include "../include/PhysicalDevice.h"
+#include "../include/CommandPool.h"
+#include "../include/Util.h"
+
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <stdexcept>
+
+namespace KMDM
+{
+    /**
+     * @brief Construct a new Readback Ring:: Readback Ring object
+     *
+     * @param slots
+     */
+    ReadbackRing::ReadbackRing(uint32_t slots) :
+        m_device(LogicalDevice::getInstance()->getLogicalDevice()),
+        m_queue(LogicalDevice::getInstance()->getGraphicsQueue()),
+        m_slots(slots)
+    {
+        // Reading back through uncached memory is slow, so prefer a cached type when the device has one.
+        m_memoryProperties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        VkPhysicalDeviceMemoryProperties memory_properties = PhysicalDevice::getInstance()->getMemoryProperties();
+        VkMemoryPropertyFlags cached = m_memoryProperties | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+        for (uint32_t i = 0; i < memory_properties.memoryTypeCount; i++)
+        {
+            if ((memory_properties.memoryTypes[i].propertyFlags & cached) == cached)
+            {
+                m_memoryProperties = cached;
+                break;
+            }
+        }
+
+        std::vector<VkCommandBuffer> command_buffers(slots);
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = CommandPool::getInstance()->getCommandPool();
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = slots;
+        if (vkAllocateCommandBuffers(m_device, &allocInfo, command_buffers.data()) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to allocate readback command buffers.");
+        }
+
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        for (uint32_t i = 0; i < slots; i++)
+        {
+            m_slots[i].commandBuffer = command_buffers[i];
+            if (vkCreateFence(m_device, &fenceInfo, nullptr, &m_slots[i].fence) != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to create readback fence.");
+            }
+        }
+        std::cout << "Created readback ring." << std::endl;
+    }
+
+    ReadbackRing::~ReadbackRing()
+    {
+        destroyReadbackRing();
+    }
+
+    /**
+     * @brief Wait for the copies in flight and destroy the slots.
+     *
+     */
+    void ReadbackRing::destroyReadbackRing()
+    {
+        if (m_slots.empty())
+        {
+            return;
+        }
+        std::cout << "- Destroying ReadbackRing." << std::endl;
+        for (Slot& slot : m_slots)
+        {
+            if (slot.state == SlotState::InFlight)
+            {
+                vkWaitForFences(m_device, 1, &slot.fence, VK_TRUE, UINT64_MAX);
+            }
+            if (slot.buffer != VK_NULL_HANDLE)
+            {
+                vkUnmapMemory(m_device, slot.memory);
+                vkDestroyBuffer(m_device, slot.buffer, nullptr);
+                freeMemory(slot.memory);
+            }
+            vkDestroyFence(m_device, slot.fence, nullptr);
+            vkFreeCommandBuffers(m_device, CommandPool::getInstance()->getCommandPool(), 1, &slot.commandBuffer);
+        }
+        m_slots.clear();
+    }
+
+    uint32_t ReadbackRing::getTexelSize(VkFormat format)
+    {
+        switch (format)
+        {
+            case VK_FORMAT_R8G8B8A8_UNORM:
+            case VK_FORMAT_R8G8B8A8_SRGB:
+            case VK_FORMAT_B8G8R8A8_UNORM:
+            case VK_FORMAT_B8G8R8A8_SRGB:
+            case VK_FORMAT_R16G16_SFLOAT:
+            case VK_FORMAT_R32_UINT:
+                return 4;
+            case VK_FORMAT_R16G16B16A16_SFLOAT:
+                return 8;
+            default:
+                return 0;
+        }
+    }
+
+    /**
+     * @brief Whether capture() would find a free slot.
+     *
+     * @return true
+     * @return false
+     */
+    bool ReadbackRing::hasFreeSlot()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const Slot& slot : m_slots)
+        {
+            if (slot.state == SlotState::Free)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * @brief Grow a slot's buffer to hold at least size bytes.  Only free slots are resized.
+     *
+     * @param slot
+     * @param size
+     */
+    void ReadbackRing::ensureCapacity(uint32_t slot, VkDeviceSize size)
+    {
+        Slot& s = m_slots[slot];
+        if (s.size >= size)
+        {
+            return;
+        }
+        if (s.buffer != VK_NULL_HANDLE)
+        {
+            vkUnmapMemory(m_device, s.memory);
+            vkDestroyBuffer(m_device, s.buffer, nullptr);
+            freeMemory(s.memory);
+        }
+        createBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, m_memoryProperties, s.buffer, s.memory,
+            MemoryCategory::Staging);
+        vkMapMemory(m_device, s.memory, 0, size, 0, &s.mapped);
+        s.size = size;
+    }
+
+    /******************************************************************************************************
+     ******************************************************************************************************/
+    bool ReadbackRing::capture(VkImage image, VkFormat format, VkExtent2D extent, VkImageLayout layout,
+        VkSemaphore signal_semaphore, uint64_t tag)
+    {
+        uint32_t texel_size = getTexelSize(format);
+        if (texel_size == 0)
+        {
+            throw std::runtime_error("Can not read back an image of this format.");
+        }
+
+        uint32_t index = static_cast<uint32_t>(m_slots.size());
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (uint32_t i = 0; i < m_slots.size(); i++)
+            {
+                if (m_slots[i].state == SlotState::Free)
+                {
+                    index = i;
+                    break;
+                }
+            }
+        }
+        if (index == m_slots.size())
+        {
+            return false;
+        }
+
+        Slot& slot = m_slots[index];
+        ensureCapacity(index, static_cast<VkDeviceSize>(extent.width) * extent.height * texel_size);
+
+        vkResetCommandBuffer(slot.commandBuffer, 0);
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(slot.commandBuffer, &beginInfo);
+
+        // Wait for whatever last wrote the image, which is the frame submitted just before.
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_MEMORY_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.oldLayout = layout;
+        barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = 1;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = 1;
+        vkCmdPipelineBarrier(slot.commandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+        VkBufferImageCopy region = {};
+        region.bufferOffset = 0;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = 0;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = { 0, 0, 0 };
+        region.imageExtent = { extent.width, extent.height, 1 };
+        vkCmdCopyImageToBuffer(slot.commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, slot.buffer, 1,
+            &region);
+
+        // Put the image back for the presentation engine or the next pass that reads it.
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.dstAccessMask = 0;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        barrier.newLayout = layout;
+
+        VkBufferMemoryBarrier host_barrier = {};
+        host_barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        host_barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        host_barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+        host_barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        host_barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        host_barrier.buffer = slot.buffer;
+        host_barrier.offset = 0;
+        host_barrier.size = VK_WHOLE_SIZE;
+
+        vkCmdPipelineBarrier(slot.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        vkCmdPipelineBarrier(slot.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT,
+            0, 0, nullptr, 1, &host_barrier, 0, nullptr);
+
+        if (vkEndCommandBuffer(slot.commandBuffer) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to record readback command buffer.");
+        }
+
+        VkSubmitInfo submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &slot.commandBuffer;
+        submitInfo.signalSemaphoreCount = signal_semaphore != VK_NULL_HANDLE ? 1 : 0;
+        submitInfo.pSignalSemaphores = &signal_semaphore;
+
+        vkResetFences(m_device, 1, &slot.fence);
+        if (vkQueueSubmit(m_queue, 1, &submitInfo, slot.fence) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to submit readback command buffer.");
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        slot.state = SlotState::InFlight;
+        slot.tag = tag;
+        slot.format = format;
+        slot.extent = extent;
+        return true;
+    } /// capture
+
+    /**
+     * @brief Take the images whose copies have finished, without waiting.
+     *
+     * @return std::vector<ReadbackImage>
+     */
+    std::vector<ReadbackImage> ReadbackRing::takeCompleted()
+    {
+        std::vector<ReadbackImage> images;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (uint32_t i = 0; i < m_slots.size(); i++)
+        {
+            Slot& slot = m_slots[i];
+            if (slot.state == SlotState::InFlight && vkGetFenceStatus(m_device, slot.fence) == VK_SUCCESS)
+            {
+                slot.state = SlotState::Completed;
+            }
+            if (slot.state == SlotState::Completed)
+            {
+                slot.state = SlotState::Held;
+                images.push_back({ i, slot.tag, slot.format, slot.extent,
+                    static_cast<const unsigned char*>(slot.mapped),
+                    static_cast<size_t>(slot.extent.width) * getTexelSize(slot.format) });
+            }
+        }
+        return images;
+    }
+
+    /**
+     * @brief Hand a slot back.
+     *
+     * @param slot
+     */
+    void ReadbackRing::release(uint32_t slot)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_slots[slot].state = SlotState::Free;
+        }
+        m_released.notify_all();
+    }
+
+    /**
+     * @brief Block until a slot is free, or a copy has finished and can be taken.  The oldest copy
+     * in flight is waited on if there is one, otherwise the slots are all held and the wait is for
+     * one to be released.
+     *
+     */
+    void ReadbackRing::waitForSlot()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        VkFence fence = VK_NULL_HANDLE;
+        uint64_t oldest = UINT64_MAX;
+        for (Slot& slot : m_slots)
+        {
+            if (slot.state == SlotState::Free || slot.state == SlotState::Completed)
+            {
+                return;
+            }
+            if (slot.state == SlotState::InFlight && slot.tag <= oldest)
+            {
+                oldest = slot.tag;
+                fence = slot.fence;
+            }
+        }
+
+        if (fence != VK_NULL_HANDLE)
+        {
+            lock.unlock();
+            vkWaitForFences(m_device, 1, &fence, VK_TRUE, UINT64_MAX);
+            return;
+        }
+        m_released.wait(lock, [this]()
+        {
+            for (const Slot& slot : m_slots)
+            {
+                if (slot.state == SlotState::Free)
+                {
+                    return true;
+                }
+            }
+            return false;
+        });
+    }
+
+    /**
+     * @brief Block until every copy in flight has finished.
+     *
+     */
+    void ReadbackRing::waitForCopies()
+    {
+        std::vector<VkFence> fences;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (const Slot& slot : m_slots)
+            {
+                if (slot.state == SlotState::InFlight)
+                {
+                    fences.push_back(slot.fence);
+                }
+            }
+        }
+        if (!fences.empty())
+        {
+            vkWaitForFences(m_device, static_cast<uint32_t>(fences.size()), fences.data(), VK_TRUE, UINT64_MAX);
+        }
+    }
+
+    /**
+     * @brief Whether any copy is in flight or any image is still held.
+     *
+     * @return true
+     * @return false
+     */
+    bool ReadbackRing::isBusy()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const Slot& slot : m_slots)
+        {
+            if (slot.state != SlotState::Free)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+}
@@ -0,0 +1,890 @@
+#include "../include/RenderGraph.h"
+#include "../include/LogicalDevice.h"
+#include "../include/RenderTargetPool.h"
+#include "../include/GpuProfiler.h"
+#include "../include/Util.h"
+
+#include <vulkan/vulkan.h>
+#include <algorithm>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+namespace KMDM
+{
+    namespace
+    {
+        struct AccessInfo
+        {
+            VkPipelineStageFlags stages;
+            VkAccessFlags readAccess;
+            VkAccessFlags writeAccess;
+            VkImageLayout layout;   // Ignored for buffers.
+            VkImageUsageFlags imageUsage;
+            VkBufferUsageFlags bufferUsage;
+        };
+
+        const VkPipelineStageFlags SHADER_STAGES = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT |
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        const VkPipelineStageFlags DEPTH_STAGES = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT |
+            VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+
+        AccessInfo getAccessInfo(RenderAccess access)
+        {
+            switch (access)
+            {
+                case RenderAccess::ColorAttachment:
+                    return { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_COLOR_ATTACHMENT_READ_BIT,
+                        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT, 0 };
+                case RenderAccess::DepthAttachment:
+                    return { DEPTH_STAGES, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT,
+                        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+                        VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 0 };
+                case RenderAccess::DepthRead:
+                    return { DEPTH_STAGES | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                        VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_SHADER_READ_BIT, 0,
+                        VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, 0 };
+                case RenderAccess::Sampled:
+                    return { SHADER_STAGES, VK_ACCESS_SHADER_READ_BIT, 0, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                        VK_IMAGE_USAGE_SAMPLED_BIT, 0 };
+                case RenderAccess::StorageRead:
+                    return { SHADER_STAGES, VK_ACCESS_SHADER_READ_BIT, 0, VK_IMAGE_LAYOUT_GENERAL,
+                        VK_IMAGE_USAGE_STORAGE_BIT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT };
+                case RenderAccess::StorageWrite:
+                    return { SHADER_STAGES, VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_SHADER_WRITE_BIT,
+                        VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_USAGE_STORAGE_BIT,
+                        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT };
+                case RenderAccess::TransferSrc:
+                    return { VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT, 0,
+                        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+                        VK_BUFFER_USAGE_TRANSFER_SRC_BIT };
+                case RenderAccess::TransferDst:
+                    return { VK_PIPELINE_STAGE_TRANSFER_BIT, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                        VK_BUFFER_USAGE_TRANSFER_DST_BIT };
+                case RenderAccess::Present:
+                    return { VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, 0, 0 };
+                case RenderAccess::VertexBuffer:
+                    return { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT, 0,
+                        VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT };
+                case RenderAccess::IndexBuffer:
+                    return { VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT, 0,
+                        VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_BUFFER_USAGE_INDEX_BUFFER_BIT };
+                case RenderAccess::UniformBuffer:
+                    return { SHADER_STAGES, VK_ACCESS_UNIFORM_READ_BIT, 0, VK_IMAGE_LAYOUT_UNDEFINED,
+                        0, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT };
+                case RenderAccess::IndirectBuffer:
+                    return { VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, VK_ACCESS_INDIRECT_COMMAND_READ_BIT, 0,
+                        VK_IMAGE_LAYOUT_UNDEFINED, 0, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT };
+            }
+            throw std::runtime_error("Unknown render graph access.");
+        }
+
+        // Storage and transfer accesses apply to both images and buffers, the others to one of them.
+        bool isImageAccess(RenderAccess access)
+        {
+            return access == RenderAccess::ColorAttachment || access == RenderAccess::DepthAttachment ||
+                   access == RenderAccess::DepthRead || access == RenderAccess::Sampled ||
+                   access == RenderAccess::Present;
+        }
+
+        bool isBufferAccess(RenderAccess access)
+        {
+            return access == RenderAccess::VertexBuffer || access == RenderAccess::IndexBuffer ||
+                   access == RenderAccess::UniformBuffer || access == RenderAccess::IndirectBuffer;
+        }
+
+        void hashCombine(size_t& seed, uint64_t value)
+        {
+            seed ^= std::hash<uint64_t>()(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        }
+    }
+
+    RenderGraph::PassBuilder::PassBuilder(RenderGraph* graph, uint32_t pass) : m_graph(graph), m_pass(pass)
+    {
+    }
+
+    RenderGraph::PassBuilder& RenderGraph::PassBuilder::read(RenderResource resource, RenderAccess access)
+    {
+        m_graph->addUse(m_pass, resource, access, false);
+        return *this;
+    }
+
+    RenderGraph::PassBuilder& RenderGraph::PassBuilder::write(RenderResource resource, RenderAccess access)
+    {
+        m_graph->addUse(m_pass, resource, access, true);
+        return *this;
+    }
+
+    RenderGraph::PassBuilder& RenderGraph::PassBuilder::sideEffect()
+    {
+        m_graph->m_passes[m_pass].sideEffect = true;
+        return *this;
+    }
+
+    /**
+     * @brief Construct a new Render Graph:: Render Graph object
+     *
+     */
+    RenderGraph::RenderGraph()
+    {
+        std::cout << "Created render graph." << std::endl;
+    }
+
+    RenderGraph::~RenderGraph()
+    {
+        destroyRenderGraph();
+    }
+
+    /**
+     * @brief Wait for the device and destroy the transient resources.
+     *
+     */
+    void RenderGraph::destroyRenderGraph()
+    {
+        std::cout << "- Destroying RenderGraph." << std::endl;
+        if (m_allocated)
+        {
+            vkDeviceWaitIdle(LogicalDevice::getInstance()->getLogicalDevice());
+            destroyTransients();
+        }
+        reset();
+    }
+
+    void RenderGraph::reset()
+    {
+        m_resources.clear();
+        m_passes.clear();
+        m_finalBarriers.clear();
+        m_finalSrcStages = 0;
+        m_finalDstStages = 0;
+        m_compiled = false;
+    }
+
+    RenderResource RenderGraph::addResource(const Resource& resource)
+    {
+        m_resources.push_back(resource);
+        m_compiled = false;
+        return static_cast<RenderResource>(m_resources.size() - 1);
+    }
+
+    RenderResource RenderGraph::createImage(const std::string& name, const RenderImageDesc& desc)
+    {
+        if (desc.extent.width == 0 || desc.extent.height == 0)
+        {
+            throw std::runtime_error("Render graph image " + name + " has no size.");
+        }
+        Resource resource;
+        resource.name = name;
+        resource.imageDesc = desc;
+        return addResource(resource);
+    }
+
+    RenderResource RenderGraph::createBuffer(const std::string& name, const RenderBufferDesc& desc)
+    {
+        if (desc.size == 0)
+        {
+            throw std::runtime_error("Render graph buffer " + name + " has no size.");
+        }
+        Resource resource;
+        resource.name = name;
+        resource.isImage = false;
+        resource.bufferDesc = desc;
+        return addResource(resource);
+    }
+
+    RenderResource RenderGraph::importImage(const std::string& name, VkImage image, VkImageView view,
+        const RenderImageDesc& desc, VkImageLayout initial_layout, VkImageLayout final_layout,
+        VkPipelineStageFlags initial_stages)
+    {
+        Resource resource;
+        resource.name = name;
+        resource.imported = true;
+        resource.imageDesc = desc;
+        resource.image = image;
+        resource.view = view;
+        resource.initialLayout = initial_layout;
+        resource.finalLayout = final_layout;
+        resource.initialStages = initial_stages;
+        return addResource(resource);
+    }
+
+    RenderResource RenderGraph::importBuffer(const std::string& name, VkBuffer buffer, VkDeviceSize size,
+        VkPipelineStageFlags initial_stages)
+    {
+        Resource resource;
+        resource.name = name;
+        resource.isImage = false;
+        resource.imported = true;
+        resource.bufferDesc.size = size;
+        resource.buffer = buffer;
+        resource.initialStages = initial_stages;
+        return addResource(resource);
+    }
+
+    RenderGraph::PassBuilder RenderGraph::addPass(const std::string& name, PassCallback callback)
+    {
+        Pass pass;
+        pass.name = name;
+        pass.callback = callback;
+        m_passes.push_back(pass);
+        m_compiled = false;
+        return PassBuilder(this, static_cast<uint32_t>(m_passes.size() - 1));
+    }
+
+    /******************************************************************
+        Add a resource to a pass.  A resource can only be used one way
+        per pass; reading and writing it with the same access is a
+        write that keeps the old contents.
+    *******************************************************************/
+    void RenderGraph::addUse(uint32_t pass, RenderResource resource, RenderAccess access, bool write)
+    {
+        if (resource >= m_resources.size())
+        {
+            throw std::runtime_error("Unknown render graph resource in pass " + m_passes[pass].name + ".");
+        }
+        if ((isImageAccess(access) && !m_resources[resource].isImage) ||
+            (isBufferAccess(access) && m_resources[resource].isImage))
+        {
+            throw std::runtime_error("Render graph resource " + m_resources[resource].name +
+                " is used with the wrong access in pass " + m_passes[pass].name + ".");
+        }
+        if (write && getAccessInfo(access).writeAccess == 0)
+        {
+            throw std::runtime_error("Render graph resource " + m_resources[resource].name +
+                " is written with a read only access in pass " + m_passes[pass].name + ".");
+        }
+
+        for (auto & use : m_passes[pass].uses)
+        {
+            if (use.resource != resource)
+            {
+                continue;
+            }
+            if (use.access != access)
+            {
+                throw std::runtime_error("Render graph resource " + m_resources[resource].name +
+                    " is used twice in pass " + m_passes[pass].name + ".");
+            }
+            use.read = use.read || !write;
+            use.write = use.write || write;
+            return;
+        }
+        m_passes[pass].uses.push_back({resource, access, !write, write});
+        m_compiled = false;
+    } /// addUse
+
+    /******************************************************************
+        Compile the graph.  Transients are allocated before the
+        barriers are worked out, since the barriers name the images.
+    *******************************************************************/
+    void RenderGraph::compile()
+    {
+        cullPasses();
+        computeLifetimes();
+        allocateTransients();
+        computeBarriers();
+
+        m_stats.passes = 0;
+        m_stats.culledPasses = 0;
+        for (const auto & pass : m_passes)
+        {
+            pass.culled ? m_stats.culledPasses++ : m_stats.passes++;
+        }
+        m_compiled = true;
+    } /// compile
+
+    /******************************************************************
+        Walk the passes backwards from the ones with visible results.
+        A live pass needs the last writers of everything it reads, and
+        a resource it writes without reading is no longer needed from
+        the passes before it.
+    *******************************************************************/
+    void RenderGraph::cullPasses()
+    {
+        std::vector<bool> needed(m_resources.size(), false);
+        for (size_t i = m_passes.size(); i-- > 0;)
+        {
+            Pass& pass = m_passes[i];
+            bool live = pass.sideEffect;
+            for (const auto & use : pass.uses)
+            {
+                if (use.write && (m_resources[use.resource].imported || needed[use.resource]))
+                {
+                    live = true;
+                }
+            }
+
+            pass.culled = !live;
+            if (!live)
+            {
+                continue;
+            }
+            for (const auto & use : pass.uses)
+            {
+                needed[use.resource] = use.read;
+            }
+        }
+    } /// cullPasses
+
+    /******************************************************************
+        Find the first and last live pass of every resource, and
+        everything a transient is used for, so the images can be
+        created with the usage they need.
+    *******************************************************************/
+    void RenderGraph::computeLifetimes()
+    {
+        for (auto & resource : m_resources)
+        {
+            resource.firstPass = -1;
+            resource.lastPass = -1;
+            resource.useStages = 0;
+            resource.writeAccess = 0;
+            resource.aliasOf = -1;
+        }
+
+        for (size_t i = 0; i < m_passes.size(); i++)
+        {
+            if (m_passes[i].culled)
+            {
+                continue;
+            }
+            for (const auto & use : m_passes[i].uses)
+            {
+                Resource& resource = m_resources[use.resource];
+                AccessInfo info = getAccessInfo(use.access);
+                if (resource.firstPass < 0)
+                {
+                    resource.firstPass = static_cast<int32_t>(i);
+                }
+                resource.lastPass = static_cast<int32_t>(i);
+                resource.useStages |= info.stages;
+                resource.writeAccess |= use.write ? info.writeAccess : 0;
+
+                if (!resource.imported)
+                {
+                    if (resource.isImage)
+                    {
+                        resource.imageDesc.usage |= info.imageUsage;
+                    }
+                    else
+                    {
+                        resource.bufferDesc.usage |= info.bufferUsage;
+                    }
+                }
+            }
+        }
+    } /// computeLifetimes
+
+    size_t RenderGraph::getTransientSignature()
+    {
+        size_t seed = 0;
+        for (const auto & resource : m_resources)
+        {
+            if (resource.imported)
+            {
+                continue;
+            }
+            hashCombine(seed, resource.isImage);
+            hashCombine(seed, static_cast<uint64_t>(resource.firstPass + 1));
+            hashCombine(seed, static_cast<uint64_t>(resource.lastPass + 1));
+            if (resource.isImage)
+            {
+                hashCombine(seed, resource.imageDesc.format);
+                hashCombine(seed, resource.imageDesc.extent.width);
+                hashCombine(seed, resource.imageDesc.extent.height);
+                hashCombine(seed, resource.imageDesc.usage);
+                hashCombine(seed, resource.imageDesc.aspect);
+            }
+            else
+            {
+                hashCombine(seed, resource.bufferDesc.size);
+                hashCombine(seed, resource.bufferDesc.usage);
+            }
+        }
+        return seed;
+    }
+
+    /******************************************************************
+        Create the transient images and buffers.  Images are placed in
+        memory blocks in order of their first pass: an image shares a
+        block whose last occupant is done before it starts, and blocks
+        grow to their largest occupant.  The first occupant of a block
+        waits for the last one, which was used in the previous frame.
+
+        Buffers are small next to attachments and get memory of their
+        own.  Everything is kept while the graph keeps its shape.
+    *******************************************************************/
+    void RenderGraph::allocateTransients()
+    {
+        size_t signature = getTransientSignature();
+        if (!m_allocated || signature != m_signature)
+        {
+            VkDevice device = LogicalDevice::getInstance()->getLogicalDevice();
+            if (m_allocated)
+            {
+                retireTransients();
+            }
+
+            // Create the images and buffers used by live passes.
+            std::vector<uint32_t> order;
+            for (const auto & resource : m_resources)
+            {
+                if (resource.imported)
+                {
+                    continue;
+                }
+                if (!resource.isImage)
+                {
+                    PhysicalBuffer physical;
+                    if (resource.firstPass >= 0)
+                    {
+                        createBuffer(resource.bufferDesc.size, resource.bufferDesc.usage,
+                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, physical.buffer, physical.memory,
+                            MemoryCategory::RenderTarget);
+                    }
+                    m_buffers.push_back(physical);
+                    continue;
+                }
+
+                PhysicalImage physical;
+                if (resource.firstPass >= 0)
+                {
+                    VkImageCreateInfo image_info = {};
+                    image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+                    image_info.imageType = VK_IMAGE_TYPE_2D;
+                    image_info.format = resource.imageDesc.format;
+                    image_info.extent = {resource.imageDesc.extent.width, resource.imageDesc.extent.height, 1};
+                    image_info.mipLevels = 1;
+                    image_info.arrayLayers = 1;
+                    image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+                    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+                    image_info.usage = resource.imageDesc.usage;
+                    image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+                    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+                    if (vkCreateImage(device, &image_info, nullptr, &physical.image) != VK_SUCCESS)
+                    {
+                        throw std::runtime_error("Failed to create render graph image " + resource.name + ".");
+                    }
+                    vkGetImageMemoryRequirements(device, physical.image, &physical.requirements);
+                    order.push_back(static_cast<uint32_t>(m_images.size()));
+                }
+                m_images.push_back(physical);
+            }
+
+            // Resource of each physical image, for the lifetimes.
+            std::vector<Resource*> owners;
+            for (auto & resource : m_resources)
+            {
+                if (!resource.imported && resource.isImage)
+                {
+                    owners.push_back(&resource);
+                }
+            }
+            std::stable_sort(order.begin(), order.end(), [&owners](uint32_t a, uint32_t b) {
+                return owners[a]->firstPass < owners[b]->firstPass;
+            });
+
+            // Place each image in the free block it grows the least.
+            m_stats.unaliasedBytes = 0;
+            for (uint32_t index : order)
+            {
+                PhysicalImage& physical = m_images[index];
+                m_stats.unaliasedBytes += physical.requirements.size;
+
+                int32_t best = -1;
+                VkDeviceSize best_growth = std::numeric_limits<VkDeviceSize>::max();
+                for (size_t b = 0; b < m_blocks.size(); b++)
+                {
+                    MemoryBlock& block = m_blocks[b];
+                    if (!(physical.requirements.memoryTypeBits & (1u << block.memoryType)) ||
+                        owners[block.images.back()]->lastPass >= owners[index]->firstPass)
+                    {
+                        continue;
+                    }
+                    VkDeviceSize growth = physical.requirements.size > block.size ?
+                        physical.requirements.size - block.size : 0;
+                    if (growth < best_growth)
+                    {
+                        best = static_cast<int32_t>(b);
+                        best_growth = growth;
+                    }
+                }
+
+                if (best < 0)
+                {
+                    MemoryBlock block;
+                    block.memoryType = findMemoryType(physical.requirements.memoryTypeBits,
+                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+                    m_blocks.push_back(block);
+                    best = static_cast<int32_t>(m_blocks.size() - 1);
+                }
+
+                MemoryBlock& block = m_blocks[best];
+                block.size = std::max(block.size, physical.requirements.size);
+                block.images.push_back(index);
+                physical.block = static_cast<uint32_t>(best);
+            }
+
+            // Allocate the blocks and bind the images.
+            m_stats.transientBytes = 0;
+            for (auto & block : m_blocks)
+            {
+                VkMemoryAllocateInfo alloc_info = {};
+                alloc_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+                alloc_info.allocationSize = block.size;
+                alloc_info.memoryTypeIndex = block.memoryType;
+                if (vkAllocateMemory(device, &alloc_info, nullptr, &block.memory) != VK_SUCCESS)
+                {
+                    throw std::runtime_error("Failed to allocate render graph memory.");
+                }
+                MemoryTelemetry::getInstance()->trackAllocation(block.memory, block.size, block.memoryType,
+                    MemoryCategory::RenderTarget);
+                m_stats.transientBytes += block.size;
+
+                for (uint32_t index : block.images)
+                {
+                    PhysicalImage& physical = m_images[index];
+                    vkBindImageMemory(device, physical.image, block.memory, 0);
+                    physical.view = createImageView(physical.image, owners[index]->imageDesc.format,
+                        owners[index]->imageDesc.aspect, 1);
+                }
+            }
+
+            m_stats.transientImages = static_cast<uint32_t>(order.size());
+            m_stats.memoryBlocks = static_cast<uint32_t>(m_blocks.size());
+            m_signature = signature;
+            m_allocated = true;
+
+            std::cout << "Created " << order.size() << " render graph images in " << m_blocks.size()
+                      << " memory blocks (" << (m_stats.transientBytes >> 10) << " KB, "
+                      << (m_stats.unaliasedBytes >> 10) << " KB without aliasing)." << std::endl;
+        }
+
+        // Hand the physical resources to this frame's resources.
+        size_t image = 0;
+        size_t buffer = 0;
+        std::vector<RenderResource> image_owners;
+        for (size_t i = 0; i < m_resources.size(); i++)
+        {
+            Resource& resource = m_resources[i];
+            if (resource.imported)
+            {
+                continue;
+            }
+            if (resource.isImage)
+            {
+                resource.image = m_images[image].image;
+                resource.view = m_images[image].view;
+                image_owners.push_back(static_cast<RenderResource>(i));
+                image++;
+            }
+            else
+            {
+                resource.buffer = m_buffers[buffer].buffer;
+                buffer++;
+            }
+        }
+
+        // Each image waits for the occupant of its block before it, the first one for the last.
+        for (const auto & block : m_blocks)
+        {
+            for (size_t i = 0; i < block.images.size(); i++)
+            {
+                size_t previous = (i + block.images.size() - 1) % block.images.size();
+                m_resources[image_owners[block.images[i]]].aliasOf =
+                    static_cast<int32_t>(image_owners[block.images[previous]]);
+            }
+        }
+    } /// allocateTransients
+
+    void RenderGraph::destroyTransients()
+    {
+        destroyPhysical(m_images, m_blocks, m_buffers);
+        m_images.clear();
+        m_blocks.clear();
+        m_buffers.clear();
+        m_allocated = false;
+    }
+
+    /**
+     * @brief Hand the transients to the render target pool, which destroys them once the frames in
+     * flight are done with them, so a change of shape does not wait for the device.
+     *
+     */
+    void RenderGraph::retireTransients()
+    {
+        std::vector<PhysicalImage> images = m_images;
+        std::vector<MemoryBlock> blocks = m_blocks;
+        std::vector<PhysicalBuffer> buffers = m_buffers;
+        RenderTargetPool::getInstance()->retire([images, blocks, buffers]()
+        {
+            destroyPhysical(images, blocks, buffers);
+        });
+        m_images.clear();
+        m_blocks.clear();
+        m_buffers.clear();
+        m_allocated = false;
+    }
+
+    void RenderGraph::destroyPhysical(const std::vector<PhysicalImage>& images,
+        const std::vector<MemoryBlock>& blocks, const std::vector<PhysicalBuffer>& buffers)
+    {
+        VkDevice device = LogicalDevice::getInstance()->getLogicalDevice();
+        for (auto & physical : images)
+        {
+            if (physical.image != VK_NULL_HANDLE)
+            {
+                vkDestroyImageView(device, physical.view, nullptr);
+                vkDestroyImage(device, physical.image, nullptr);
+            }
+        }
+        for (auto & block : blocks)
+        {
+            freeMemory(block.memory);
+        }
+        for (auto & physical : buffers)
+        {
+            if (physical.buffer != VK_NULL_HANDLE)
+            {
+                vkDestroyBuffer(device, physical.buffer, nullptr);
+                freeMemory(physical.memory);
+            }
+        }
+    }
+
+    /******************************************************************
+        Replay the live passes against the state of every resource and
+        collect the barriers each one needs.  Imported images are left
+        in their final layout by one more batch after the last pass.
+    *******************************************************************/
+    void RenderGraph::computeBarriers()
+    {
+        std::vector<ResourceState> states(m_resources.size());
+        for (size_t i = 0; i < m_resources.size(); i++)
+        {
+            states[i].layout = m_resources[i].initialLayout;
+            states[i].writeStages = m_resources[i].initialStages;
+        }
+
+        m_stats.barriers = 0;
+        m_stats.imageBarriers = 0;
+        m_stats.bufferBarriers = 0;
+        for (size_t p = 0; p < m_passes.size(); p++)
+        {
+            Pass& pass = m_passes[p];
+            pass.srcStages = 0;
+            pass.dstStages = 0;
+            pass.imageBarriers.clear();
+            pass.bufferBarriers.clear();
+            if (pass.culled)
+            {
+                continue;
+            }
+
+            for (const auto & use : pass.uses)
+            {
+                const Resource& resource = m_resources[use.resource];
+                ResourceState& state = states[use.resource];
+
+                // The first use of an aliased image waits for whatever used its memory before.
+                if (resource.firstPass == static_cast<int32_t>(p) && resource.aliasOf >= 0)
+                {
+                    const Resource& previous = m_resources[resource.aliasOf];
+                    state.writeStages |= previous.useStages;
+                    state.writeAccess |= previous.writeAccess;
+                }
+
+                AccessInfo info = getAccessInfo(use.access);
+                addBarrier(pass, use.resource, state, info.stages, info.readAccess,
+                    use.write ? info.writeAccess : 0, info.layout);
+            }
+
+            if (!pass.imageBarriers.empty() || !pass.bufferBarriers.empty())
+            {
+                m_stats.barriers++;
+                m_stats.imageBarriers += static_cast<uint32_t>(pass.imageBarriers.size());
+                m_stats.bufferBarriers += static_cast<uint32_t>(pass.bufferBarriers.size());
+            }
+        }
+
+        m_finalSrcStages = 0;
+        m_finalDstStages = 0;
+        m_finalBarriers.clear();
+        for (size_t i = 0; i < m_resources.size(); i++)
+        {
+            const Resource& resource = m_resources[i];
+            const ResourceState& state = states[i];
+            if (!resource.imported || !resource.isImage || resource.finalLayout == VK_IMAGE_LAYOUT_UNDEFINED ||
+                resource.finalLayout == state.layout)
+            {
+                continue;
+            }
+
+            VkImageMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.srcAccessMask = state.writeAccess;
+            barrier.dstAccessMask = 0;
+            barrier.oldLayout = state.layout;
+            barrier.newLayout = resource.finalLayout;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = resource.image;
+            barrier.subresourceRange = {resource.imageDesc.aspect, 0, 1, 0, 1};
+            m_finalBarriers.push_back(barrier);
+
+            m_finalSrcStages |= state.writeStages | state.readStages;
+            m_finalDstStages |= VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+        }
+        if (!m_finalBarriers.empty())
+        {
+            m_finalSrcStages = m_finalSrcStages ? m_finalSrcStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+            m_stats.barriers++;
+            m_stats.imageBarriers += static_cast<uint32_t>(m_finalBarriers.size());
+        }
+    } /// computeBarriers
+
+    /******************************************************************
+        Work out the barrier in front of one use of a resource.  Writes
+        and layout transitions wait for every access since the last
+        write.  Reads wait for the last write, unless an earlier barrier
+        already made it visible to the same stages and accesses.
+    *******************************************************************/
+    void RenderGraph::addBarrier(Pass& pass, RenderResource resource, ResourceState& state, VkPipelineStageFlags stages,
+        VkAccessFlags read_access, VkAccessFlags write_access, VkImageLayout layout)
+    {
+        const Resource& owner = m_resources[resource];
+        bool write = write_access != 0;
+        bool transition = owner.isImage && layout != state.layout;
+        VkAccessFlags access = read_access | write_access;
+
+        VkPipelineStageFlags src_stages = 0;
+        VkAccessFlags src_access = 0;
+        bool needed = false;
+        if (write || transition)
+        {
+            src_stages = state.writeStages | state.readStages;
+            src_access = state.writeAccess;
+            needed = transition || src_stages != 0;
+        }
+        else if (state.writeStages != 0 && ((stages & ~state.readStages) || (access & ~state.readAccess)))
+        {
+            src_stages = state.writeStages;
+            src_access = state.writeAccess;
+            needed = true;
+        }
+
+        if (needed)
+        {
+            pass.srcStages |= src_stages ? src_stages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+            pass.dstStages |= stages;
+
+            if (owner.isImage)
+            {
+                VkImageMemoryBarrier barrier = {};
+                barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+                barrier.srcAccessMask = src_access;
+                barrier.dstAccessMask = access;
+                barrier.oldLayout = state.layout;
+                barrier.newLayout = layout;
+                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.image = owner.image;
+                barrier.subresourceRange = {owner.imageDesc.aspect, 0, 1, 0, 1};
+                pass.imageBarriers.push_back(barrier);
+            }
+            else
+            {
+                VkBufferMemoryBarrier barrier = {};
+                barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+                barrier.srcAccessMask = src_access;
+                barrier.dstAccessMask = access;
+                barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+                barrier.buffer = owner.buffer;
+                barrier.offset = 0;
+                barrier.size = VK_WHOLE_SIZE;
+                pass.bufferBarriers.push_back(barrier);
+            }
+        }
+
+        if (write || transition)
+        {
+            // A transition is a write as far as later reads are concerned.
+            state.layout = layout;
+            state.writeStages = stages;
+            state.writeAccess = write_access;
+            state.readStages = write ? 0 : stages;
+            state.readAccess = write ? 0 : access;
+        }
+        else
+        {
+            state.readStages |= stages;
+            state.readAccess |= access;
+        }
+    } /// addBarrier
+
+    /******************************************************************
+        Record the live passes, each behind a single batched barrier.
+    *******************************************************************/
+    void RenderGraph::execute(VkCommandBuffer command_buffer)
+    {
+        if (!m_compiled)
+        {
+            throw std::runtime_error("Render graph executed before it was compiled.");
+        }
+
+        // Every pass is a profiler scope when the GPU profiler runs, and is counted when it counts passes.
+        GpuProfiler* profiler = GpuProfiler::findInstance();
+        for (auto & pass : m_passes)
+        {
+            if (pass.culled)
+            {
+                continue;
+            }
+            if (!pass.imageBarriers.empty() || !pass.bufferBarriers.empty())
+            {
+                vkCmdPipelineBarrier(command_buffer, pass.srcStages, pass.dstStages, 0, 0, nullptr,
+                    static_cast<uint32_t>(pass.bufferBarriers.size()), pass.bufferBarriers.data(),
+                    static_cast<uint32_t>(pass.imageBarriers.size()), pass.imageBarriers.data());
+            }
+            if (profiler)
+            {
+                profiler->beginScope(command_buffer, pass.name);
+                profiler->beginPassCounters(command_buffer, pass.name);
+            }
+            pass.callback(command_buffer, *this);
+            if (profiler)
+            {
+                profiler->endPassCounters(command_buffer);
+                profiler->endScope(command_buffer);
+            }
+        }
+
+        if (!m_finalBarriers.empty())
+        {
+            vkCmdPipelineBarrier(command_buffer, m_finalSrcStages, m_finalDstStages, 0, 0, nullptr, 0, nullptr,
+                static_cast<uint32_t>(m_finalBarriers.size()), m_finalBarriers.data());
+        }
+    } /// execute
+
+    bool RenderGraph::isPassCulled(const std::string& name)
+    {
+        for (const auto & pass : m_passes)
+        {
+            if (pass.name == name)
+            {
+                return pass.culled;
+            }
+        }
+        return false;
+    }
+
+    VkImage RenderGraph::getImage(RenderResource resource) { return m_resources.at(resource).image; }
+    VkImageView RenderGraph::getImageView(RenderResource resource) { return m_resources.at(resource).view; }
+    VkBuffer RenderGraph::getBuffer(RenderResource resource) { return m_resources.at(resource).buffer; }
+    RenderImageDesc RenderGraph::getImageDesc(RenderResource resource) { return m_resources.at(resource).imageDesc; }
+    RenderGraphStats RenderGraph::getStats() { return m_stats; }
+}
@@ -0,0 +1,164 @@
+#include "../include/RenderTargetPool.h"
+#include "../include/LogicalDevice.h"
+#include "../include/Util.h"
+
+#include <vulkan/vulkan.h>
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+namespace KMDM
+{
+    RenderTargetPool* RenderTargetPool::m_renderTargetPool = nullptr;
+
+    /**
+     * @brief Get the Instance object
+     *
+     * @return RenderTargetPool*
+     */
+    RenderTargetPool* RenderTargetPool::getInstance()
+    {
+        if (!m_renderTargetPool)
+        {
+            m_renderTargetPool = new RenderTargetPool();
+        }
+        return m_renderTargetPool;
+    }
+
+    RenderTargetPool::RenderTargetPool() :
+        m_frame(0)
+    {
+        std::cout << "Created render target pool." << std::endl;
+    }
+
+    RenderTargetPool::~RenderTargetPool()
+    {
+        destroyRenderTargetPool();
+    }
+
+    /**
+     * @brief Destroy every target and run every retirement.  The device has to be idle.
+     *
+     */
+    void RenderTargetPool::destroyRenderTargetPool()
+    {
+        std::cout << "- Destroying RenderTargetPool (" << m_stats.hits << " of " << m_stats.requests
+                  << " targets reused)." << std::endl;
+        for (auto & retired : m_retired)
+        {
+            retired.destroy();
+        }
+        m_retired.clear();
+        for (auto & free : m_free)
+        {
+            destroyTarget(free.target);
+        }
+        m_free.clear();
+        m_renderTargetPool = nullptr;
+    }
+
+    /******************************************************************
+        Reuse a free target no frame in flight uses, or create one.
+    *******************************************************************/
+    RenderTarget RenderTargetPool::acquire(const RenderImageDesc& desc)
+    {
+        if (desc.extent.width == 0 || desc.extent.height == 0)
+        {
+            throw std::runtime_error("Render target has no size.");
+        }
+
+        m_stats.requests++;
+        for (auto it = m_free.begin(); it != m_free.end(); ++it)
+        {
+            if (it->frame + MAX_FRAMES_IN_FLIGHT < m_frame && isSameDesc(it->target.desc, desc))
+            {
+                RenderTarget target = it->target;
+                m_free.erase(it);
+                m_stats.hits++;
+                return target;
+            }
+        }
+
+        RenderTarget target;
+        target.desc = desc;
+        createImage(desc.extent.width, desc.extent.height, 1, desc.format, VK_IMAGE_TILING_OPTIMAL,
+            desc.usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, target.image, target.memory, MemoryCategory::RenderTarget);
+        target.view = createImageView(target.image, desc.format, desc.aspect, 1);
+        m_stats.liveTargets++;
+        return target;
+    } /// acquire
+
+    void RenderTargetPool::release(const RenderTarget& target)
+    {
+        if (target.image == VK_NULL_HANDLE)
+        {
+            return;
+        }
+        m_free.push_back({target, m_frame});
+    }
+
+    void RenderTargetPool::retire(std::function<void()> destroy)
+    {
+        m_retired.push_back({destroy, m_frame});
+    }
+
+    /******************************************************************
+        Per frame work.
+    *******************************************************************/
+    void RenderTargetPool::update()
+    {
+        m_frame++;
+
+        while (!m_retired.empty() && m_retired.front().frame + MAX_FRAMES_IN_FLIGHT < m_frame)
+        {
+            m_retired.front().destroy();
+            m_retired.pop_front();
+        }
+
+        // Drop the targets left unused too long, then the oldest beyond the pool size.
+        auto idle = std::remove_if(m_free.begin(), m_free.end(), [this](const FreeTarget& free)
+        {
+            if (free.frame + RENDER_TARGET_IDLE_FRAMES < m_frame)
+            {
+                destroyTarget(free.target);
+                return true;
+            }
+            return false;
+        });
+        m_free.erase(idle, m_free.end());
+
+        while (m_free.size() > RENDER_TARGET_POOL_SIZE)
+        {
+            auto oldest = m_free.begin();
+            if (oldest->frame + MAX_FRAMES_IN_FLIGHT >= m_frame)
+            {
+                break;
+            }
+            destroyTarget(oldest->target);
+            m_free.erase(oldest);
+        }
+    } /// update
+
+    bool RenderTargetPool::isSameDesc(const RenderImageDesc& a, const RenderImageDesc& b)
+    {
+        return a.format == b.format && a.extent.width == b.extent.width && a.extent.height == b.extent.height &&
+               a.usage == b.usage && a.aspect == b.aspect;
+    }
+
+    void RenderTargetPool::destroyTarget(const RenderTarget& target)
+    {
+        VkDevice device = LogicalDevice::getInstance()->getLogicalDevice();
+        vkDestroyImageView(device, target.view, nullptr);
+        vkDestroyImage(device, target.image, nullptr);
+        freeMemory(target.memory);
+        m_stats.liveTargets--;
+    }
+
+    RenderTargetPoolStats RenderTargetPool::getStats()
+    {
+        RenderTargetPoolStats stats = m_stats;
+        stats.freeTargets = static_cast<uint32_t>(m_free.size());
+        stats.pendingRetirements = static_cast<uint32_t>(m_retired.size());
+        return stats;
+    }
+}
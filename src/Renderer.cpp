@@ -11,14 +11,27 @@
 #include "Util.h"
 #include "Allocator.h"
 #include "DescriptorSet.h"
+#include "UploadManager.h"
+#include "TextureResidency.h"
+#include "SamplerCache.h"
+#include "PipelineCache.h"
+#include "PipelineManager.h"
+#include "RenderTargetPool.h"
+#include "GpuProfiler.h"
+#include "CpuProfiler.h"
+#include "MemoryTelemetry.h"
+#include "FrameCapture.h"
+#include "WorkerPool.h"
 
 #include <vulkan/vulkan.h>
+#include <algorithm>
 #include <stdexcept>
 #include <vector>
 #include <array>
 #include <iostream>
 #include <stdexcept>
 #include <chrono>
+#include <cmath>
 
 // #define GLFW_INCLUDE_VULKAN
 // #include <GLFW/glfw3.h>
@@ -39,6 +52,16 @@ namespace KMDM
     Renderer::Renderer()
     {
         m_currentFrame = 0;
+        m_headlessImage = 0;
+        m_depthPrepass = DEPTH_PREPASS;
+        m_renderPath = VISIBILITY_BUFFER ? RenderPath::VisibilityBuffer : RenderPath::Forward;
+        m_dynamicResolutionEnabled = DYNAMIC_RESOLUTION;
+        m_upscaledFrame = false;
+        m_previousModelViewProj = glm::mat4(1.0f);
+        m_hasPreviousFrame = false;
+        m_captureRing = nullptr;
+        m_captureTag = 0;
+        m_frameCapture = nullptr;
         m_window = Window::getInstance();
         m_instance = Instance::getInstance();
         m_surface = Surface::getInstance();
@@ -56,6 +79,8 @@ namespace KMDM
         m_renderPass = new Renderpass();
         m_descriptorSet = new DescriptorSet(m_renderPass);
         m_graphicsPipeline = new Pipeline(m_renderPass, m_descriptorSet);
+        m_renderGraph = new RenderGraph();
+        m_lighting = new ClusteredLighting(m_descriptorSet, static_cast<uint32_t>(m_numFramebuffers));
         
         // Create depth buffer before the framebuffers.
         createDepthResources();
@@ -63,6 +88,21 @@ namespace KMDM
         // Create the framebuffers.
         createFrameBuffers();
 
+        // Depth pre-pass resources, kept even when it is off so it can be turned on any time.
+        createDepthPrepass();
+        m_visibilityBuffer = new VisibilityBuffer(m_descriptorSet, m_graphicsPipeline, m_depthTarget.view,
+            static_cast<uint32_t>(m_numFramebuffers));
+
+        // The upscaled forward pass also writes motion vectors.  Its pipeline compiles in the
+        // background, frames are drawn at full resolution until it is ready.
+        m_dynamicResolution = new DynamicResolution(m_depthTarget.view, static_cast<uint32_t>(m_numFramebuffers));
+        m_upscaledDesc = m_graphicsPipeline->getDescription();
+        m_upscaledDesc.fragmentShader = SHADER_PATH "upscaled_frag.spv";
+        m_upscaledDesc.colorAttachmentCount = 2;
+        m_upscaledDesc.renderPass = m_dynamicResolution->getRenderPass()->getRenderPass();
+        m_upscaledPipeline = PipelineManager::getInstance()->requestPipeline(m_upscaledDesc,
+            m_graphicsPipeline->getDescription());
+
         // Create the camera buffer.
         createCameraBuffers();
 
@@ -74,12 +114,118 @@ namespace KMDM
 
         // Create the command buffers.
         createCommandBuffers();
+
+        // Headless frames have no display to pace to.
+        SDL_DisplayMode displayMode = {};
+        float refreshRate = !Window::isHeadless() && SDL_GetWindowDisplayMode(m_window->getWindow(), &displayMode) == 0 ?
+            static_cast<float>(displayMode.refresh_rate) : 0.0f;
+        m_framePacer = new FramePacer(refreshRate);
+        m_framePacer->setPresentMode(m_swapChain->getPresentMode());
+
+        // Passes, the frame and uploads are timed from the first frame on.
+        GpuProfiler::getInstance();
     }
 
+    /******************************************************************
+        Recreate the swapchain and what is sized to it, without waiting
+        for the device.  Pipelines use dynamic viewport and scissor so
+        they are kept.  The framebuffers and images of the old size are
+        destroyed, or go back to the render target pool, once the
+        frames in flight are done with them.
+    *******************************************************************/
     void Renderer::recreateSwapChain()
     {
+        if (!m_swapChain->recreateSwapChain())
+        {
+            // Minimized, try again after the next frame.
+            m_frameBufferResized = true;
+            return;
+        }
+        // The surface may hand back another number of images, in particular after a present mode switch.
+        if (m_swapChain->getSwapChainImages().size() != m_numFramebuffers)
+        {
+            resizeImageResources();
+        }
 
-    }
+        VkDevice device = m_logicalDevice->getLogicalDevice();
+        std::vector<VkFramebuffer> framebuffers = m_framebuffers;
+        framebuffers.push_back(m_depthFramebuffer);
+        RenderTargetPool::getInstance()->retire([device, framebuffers]()
+        {
+            for (auto & framebuffer : framebuffers)
+            {
+                vkDestroyFramebuffer(device, framebuffer, nullptr);
+            }
+        });
+        cleanupDepthResources();
+
+        createDepthResources();
+        createFrameBuffers();
+        createDepthFramebuffer();
+        m_visibilityBuffer->resize(m_depthTarget.view);
+        m_dynamicResolution->resize(m_depthTarget.view);
+
+        // The fences belonged to images of the old swapchain, and the old projection does not
+        // give motion vectors at the new size.
+        std::fill(m_frameSyncObjects.imagesInFlight.begin(), m_frameSyncObjects.imagesInFlight.end(),
+            static_cast<VkFence>(VK_NULL_HANDLE));
+        m_hasPreviousFrame = false;
+        m_framePacer->setPresentMode(m_swapChain->getPresentMode());
+
+        VkExtent2D extent = m_swapChain->getSwapChainExtent();
+        std::cout << "Recreated swapchain at " << extent.width << "x" << extent.height << "." << std::endl;
+    } /// recreateSwapChain
+
+    /******************************************************************
+        Reallocate what is kept per swapchain image after the image
+        count changed.  The old buffers, command buffers, descriptor
+        pools and query pools are destroyed once the frames in flight
+        are done with them.  The scene descriptor sets come from pools
+        reset every frame, so they follow the count on their own, and
+        the framebuffers are recreated by recreateSwapChain().
+    *******************************************************************/
+    void Renderer::resizeImageResources()
+    {
+        VkDevice device = m_logicalDevice->getLogicalDevice();
+        VkCommandPool commandPool = m_commandPool->getCommandPool();
+        std::vector<VkCommandBuffer> commandBuffers = m_drawCommandBuffers;
+        std::vector<VkBuffer> buffers = m_cameraBuffers;
+        buffers.insert(buffers.end(), m_uniformBuffers.begin(), m_uniformBuffers.end());
+        buffers.insert(buffers.end(), m_gpuSceneData.begin(), m_gpuSceneData.end());
+        std::vector<VkDeviceMemory> memory = m_cameraMemory;
+        memory.insert(memory.end(), m_uniformBufferMemory.begin(), m_uniformBufferMemory.end());
+        memory.insert(memory.end(), m_gpuSceneMemory.begin(), m_gpuSceneMemory.end());
+        RenderTargetPool::getInstance()->retire([device, commandPool, commandBuffers, buffers, memory]()
+        {
+            if (!commandBuffers.empty())
+            {
+                vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(commandBuffers.size()),
+                    commandBuffers.data());
+            }
+            for (size_t i = 0; i < buffers.size(); i++)
+            {
+                vkDestroyBuffer(device, buffers[i], nullptr);
+                freeMemory(memory[i]);
+            }
+        });
+
+        m_numFramebuffers = m_swapChain->getSwapChainImages().size();
+        uint32_t imageCount = static_cast<uint32_t>(m_numFramebuffers);
+        createCameraBuffers();
+        createGPUSceneBuffers();
+        createUniformBuffers();
+
+        // Allocated again at the new count when the next frame is recorded.
+        m_drawCommandBuffers.clear();
+        m_frameSyncObjects.imagesInFlight.assign(m_numFramebuffers, static_cast<VkFence>(VK_NULL_HANDLE));
+        m_headlessImage = 0;
+
+        m_lighting->setImageCount(imageCount);
+        m_visibilityBuffer->setImageCount(imageCount);
+        m_dynamicResolution->setImageCount(imageCount);
+        GpuProfiler::getInstance()->setImageCount(imageCount);
+        std::cout << "Swapchain image count changed to " << imageCount << "." << std::endl;
+    } /// resizeImageResources
 
 
     /**
@@ -88,9 +234,33 @@ namespace KMDM
      */
     void Renderer::destroyRenderer()
     {
-        // vkm_logicalDevice->getLogicalDevice()WaitIdle(m_logicalDevice->getLogicalDevice());
+        vkDeviceWaitIdle(m_logicalDevice->getLogicalDevice());
         std::cout << "- Cleaning up Renderer." << std::endl;
 
+#ifdef KMDM_ENABLE_PROFILER
+        // The streaming threads may still record, so the profiler is left alive.
+        CpuProfiler::getInstance()->writeChromeTrace(CPU_TRACE_PATH);
+#endif // KMDM_ENABLE_PROFILER
+        if (GpuProfiler::getInstance()->isEnabled())
+        {
+            GpuProfiler::getInstance()->writeCsv(GPU_TIMES_PATH);
+            if (!GpuProfiler::getInstance()->getPassCounters().empty())
+            {
+                GpuProfiler::getInstance()->writeCountersCsv(GPU_COUNTERS_PATH);
+            }
+        }
+
+        // Its readback command buffers come from the command pool.
+        if (m_frameCapture)
+        {
+            delete(m_frameCapture);
+            m_frameCapture = nullptr;
+        }
+        delete(m_renderGraph);
+        delete(m_lighting);
+        delete(m_visibilityBuffer);
+        delete(m_dynamicResolution);
+        delete(m_framePacer);
         cleanupDepthResources();
         cleanupCameraBuffers();
 
@@ -98,17 +268,29 @@ namespace KMDM
         {
             vkDestroyFramebuffer(m_logicalDevice->getLogicalDevice(), framebuffer, nullptr);
         }
+        cleanupDepthPrepass();
 
+        UploadManager::getInstance()->destroyUploadManager();
+        TextureResidency::getInstance()->destroyTextureResidency();
         m_commandPool->destroyCommandPool();
+        // Decodes still running after this finish their loops on their own threads.
+        if (WorkerPool::findInstance())
+        {
+            WorkerPool::findInstance()->destroyWorkerPool();
+        }
 
         delete(m_graphicsPipeline);
+        PipelineManager::getInstance()->destroyPipelineManager();
+        PipelineCache::getInstance()->destroyPipelineCache();
         delete(m_renderPass);
         delete(m_descriptorSet);
-
-        
+        SamplerCache::getInstance()->destroySamplerCache();
+        RenderTargetPool::getInstance()->destroyRenderTargetPool();
+        GpuProfiler::getInstance()->destroyGpuProfiler();
 
         m_swapChain->destroySwapChain();
         cleanupSyncObjects();
+        MemoryTelemetry::getInstance()->destroyMemoryTelemetry();
 
         m_logicalDevice->destroyLogicalDevice();
         m_surface->destroySurface();
@@ -159,7 +341,7 @@ namespace KMDM
         {
             VkImageView attachments[2];
             attachments[0] = m_swapChain->getSwapChainImageViews()[i];
-            attachments[1] = m_depthImageView;
+            attachments[1] = m_depthTarget.view;
 
             frameInfo.attachmentCount = 2;
             frameInfo.pAttachments = attachments;
@@ -167,7 +349,7 @@ namespace KMDM
             if (vkCreateFramebuffer(m_logicalDevice->getLogicalDevice(), &frameInfo,
                 nullptr, &m_framebuffers[i]) != VK_SUCCESS)
             {
-                std::runtime_error("Failed to create framebuffer.");
+                throw std::runtime_error("Failed to create framebuffer.");
             }
 
             // Add camera to frameData
@@ -177,45 +359,17 @@ namespace KMDM
 
 
     /**
-     * @brief Create the depth image and image view.
+     * @brief Take the depth image and image view from the render target pool.
      * 
      */
     void Renderer::createDepthResources()
     {
-        // Get the depth format.
-        VkFormat depthFormat = m_renderPass->findDepthFormat();
-
-        // Create the depth image.
-        // m_depthImage = m_allocator->getVMAImage(
-        //     m_swapChain->getSwapChainExtent().width,
-        //     m_swapChain->getSwapChainExtent().height,
-        //     1,
-        //     depthFormat,
-        //     VK_IMAGE_TILING_OPTIMAL,
-        //     VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-        //     VMA_MEMORY_USAGE_GPU_ONLY,
-        //     VK_MEMORY_PROPERTY_m_logicalDevice->getLogicalDevice()_LOCAL_BIT
-        // );
-
-
-        // VkImageCreateInfo imageInfo = {};
-        // imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-        // imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-        // imageInfo.mipLevels = 1;
-
-        
-        createImage( m_swapChain->getSwapChainExtent().width, 
-            m_swapChain->getSwapChainExtent().height,
-            1,
-            depthFormat,
-            VK_IMAGE_TILING_OPTIMAL,
-            VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-            m_depthImage,
-            m_depthMemory
-        );
-
-        m_depthImageView = createImageView(m_depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
+        RenderImageDesc depthDesc = {};
+        depthDesc.format = m_renderPass->findDepthFormat();
+        depthDesc.extent = m_swapChain->getSwapChainExtent();
+        depthDesc.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        depthDesc.aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+        m_depthTarget = RenderTargetPool::getInstance()->acquire(depthDesc);
         std::cout << "Created depth imageview." << std::endl;
     }
 
@@ -223,11 +377,72 @@ namespace KMDM
      * @brief Clean up the depth resources.
      * 
      */
+    /******************************************************************
+        Create the depth pre-pass.  It draws the position stream with
+        no fragment shader into its own depth only render pass, then
+        the main pass loads that depth, tests EQUAL and writes none.
+        Both pipelines derive from the default description, so the
+        vertex transform is the same and the depths match exactly.
+        They compile in the background, and frames are drawn without
+        the pre-pass until both are ready.
+    *******************************************************************/
+    void Renderer::createDepthPrepass()
+    {
+        m_depthPrepassRenderPass = new Renderpass(RenderpassType::DepthPrepass);
+        m_depthTestedRenderPass = new Renderpass(RenderpassType::ForwardDepthTested);
+        createDepthFramebuffer();
+
+        PipelineDesc baseDesc = m_graphicsPipeline->getDescription();
+        m_depthPrepassDesc = baseDesc;
+        m_depthPrepassDesc.vertexShader = SHADER_PATH "depth_vert.spv";
+        m_depthPrepassDesc.fragmentShader.clear();
+        m_depthPrepassDesc.vertexBindings = { Vertex::getPositionBindingDescription() };
+        m_depthPrepassDesc.vertexAttributes = { Vertex::getPositionAttributeDescription() };
+        m_depthPrepassDesc.colorAttachmentCount = 0;
+        m_depthPrepassDesc.renderPass = m_depthPrepassRenderPass->getRenderPass();
+        m_depthPrepassPipeline = PipelineManager::getInstance()->requestPipeline(m_depthPrepassDesc, baseDesc);
+
+        m_depthTestedDesc = baseDesc;
+        m_depthTestedDesc.depthCompareOp = VK_COMPARE_OP_EQUAL;
+        m_depthTestedDesc.depthWrite = VK_FALSE;
+        m_depthTestedDesc.renderPass = m_depthTestedRenderPass->getRenderPass();
+        m_depthTestedPipeline = PipelineManager::getInstance()->requestPipeline(m_depthTestedDesc, baseDesc);
+
+        std::cout << "Created depth pre-pass." << std::endl;
+    } /// createDepthPrepass
+
+    /**
+     * @brief Create the framebuffer of the depth pre-pass for the current depth buffer.
+     * 
+     */
+    void Renderer::createDepthFramebuffer()
+    {
+        VkFramebufferCreateInfo frameInfo = {};
+        frameInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        frameInfo.renderPass = m_depthPrepassRenderPass->getRenderPass();
+        frameInfo.attachmentCount = 1;
+        frameInfo.pAttachments = &m_depthTarget.view;
+        frameInfo.width = m_swapChain->getSwapChainExtent().width;
+        frameInfo.height = m_swapChain->getSwapChainExtent().height;
+        frameInfo.layers = 1;
+
+        if (vkCreateFramebuffer(m_logicalDevice->getLogicalDevice(), &frameInfo,
+            nullptr, &m_depthFramebuffer) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create depth pre-pass framebuffer.");
+        }
+    }
+
+    void Renderer::cleanupDepthPrepass()
+    {
+        vkDestroyFramebuffer(m_logicalDevice->getLogicalDevice(), m_depthFramebuffer, nullptr);
+        delete(m_depthPrepassRenderPass);
+        delete(m_depthTestedRenderPass);
+    }
+
     void Renderer::cleanupDepthResources()
     {
-        vkDestroyImageView(m_logicalDevice->getLogicalDevice(), m_depthImageView, nullptr);
-        vkDestroyImage(m_logicalDevice->getLogicalDevice(), m_depthImage, nullptr);
-        vkFreeMemory(m_logicalDevice->getLogicalDevice(), m_depthMemory, nullptr);
+        RenderTargetPool::getInstance()->release(m_depthTarget);
     }
 
     /**
@@ -244,7 +459,7 @@ namespace KMDM
         {
             createBuffer(sizeof(UniformBufferObject), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, 
                 VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-                m_cameraBuffers[i], m_cameraMemory[i] );
+                m_cameraBuffers[i], m_cameraMemory[i], MemoryCategory::Uniform);
         }
         std::cout << "Created camera buffers." << std::endl;
     }
@@ -259,7 +474,7 @@ namespace KMDM
         for (size_t i = 0; i < m_cameraBuffers.size(); i++)
         {
             vkDestroyBuffer(m_logicalDevice->getLogicalDevice(), m_cameraBuffers[i], nullptr);
-            vkFreeMemory(m_logicalDevice->getLogicalDevice(), m_cameraMemory[i], nullptr);
+            freeMemory(m_cameraMemory[i]);
             std::cout << "- Cleaning up camera buffers." << std::endl;
         }
     }
@@ -271,26 +486,44 @@ namespace KMDM
      */
     void Renderer::drawFrame()
     {
+        KMDM_PROFILE_ZONE("drawFrame");
+
         // Wait for the fence.
-        vkWaitForFences(m_logicalDevice->getLogicalDevice(),
-            1,
-            &m_frameSyncObjects.inflightFences[m_currentFrame],
-            VK_TRUE,
-            UINT64_MAX);
+        {
+            KMDM_PROFILE_ZONE("waitForFrameFence");
+            vkWaitForFences(m_logicalDevice->getLogicalDevice(),
+                1,
+                &m_frameSyncObjects.inflightFences[m_currentFrame],
+                VK_TRUE,
+                UINT64_MAX);
+        }
 
-        // Acquire an image from the swapchain.
+        // Acquire an image from the swapchain.  Headless frames take the offscreen images in turn.
+        bool headless = Window::isHeadless();
         uint32_t imageIndex;
-        VkResult result = vkAcquireNextImageKHR(
-            m_logicalDevice->getLogicalDevice(),
-            m_swapChain->getSwapChain(),
-            UINT64_MAX,
-            m_frameSyncObjects.imageAvailableSemaphores[m_currentFrame],
-            VK_NULL_HANDLE,
-            &imageIndex);
+        VkResult result = VK_SUCCESS;
+        if (headless)
+        {
+            imageIndex = m_headlessImage;
+            m_headlessImage = (m_headlessImage + 1) % static_cast<uint32_t>(m_drawCommandBuffers.size());
+        }
+        else
+        {
+            KMDM_PROFILE_ZONE("acquireImage");
+            result = vkAcquireNextImageKHR(
+                m_logicalDevice->getLogicalDevice(),
+                m_swapChain->getSwapChain(),
+                UINT64_MAX,
+                m_frameSyncObjects.imageAvailableSemaphores[m_currentFrame],
+                VK_NULL_HANDLE,
+                &imageIndex);
+        }
 
         if (result == VK_ERROR_OUT_OF_DATE_KHR)
         {
-            recreateSwapChain(); // gotta bite the bullet on this one.
+            // Only this frame is dropped, the next one is recorded for the new swapchain.
+            m_descriptorSet->resetDescriptorPools();
+            recreateSwapChain();
             return;
         }
         else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR)
@@ -301,6 +534,7 @@ namespace KMDM
         // Wait for the image in flight fence.
         if (m_frameSyncObjects.imagesInFlight[imageIndex] != VK_NULL_HANDLE)
         {
+            KMDM_PROFILE_ZONE("waitForImageFence");
             vkWaitForFences(m_logicalDevice->getLogicalDevice(),
                 1,
                 &m_frameSyncObjects.imagesInFlight[imageIndex],
@@ -309,33 +543,72 @@ namespace KMDM
         }
         m_frameSyncObjects.imagesInFlight[imageIndex] =  m_frameSyncObjects.inflightFences[m_currentFrame];
 
-        // Update the uniform buffer associaged with the image.
-        updateUniformBuffer(imageIndex);
-
         // Submit the command buffer.
         VkSubmitInfo submitInfo = {};
         submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-        VkSemaphore waitSemaphores[] = {m_frameSyncObjects.imageAvailableSemaphores[m_currentFrame]};
-        VkPipelineStageFlags waitstages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-        submitInfo.waitSemaphoreCount = 1;
-        submitInfo.pWaitSemaphores = waitSemaphores;
-        submitInfo.pWaitDstStageMask = waitstages;
+        std::vector<VkSemaphore> waitSemaphores;
+        std::vector<VkPipelineStageFlags> waitstages;
+        std::vector<uint64_t> waitValues;
+        if (!headless)
+        {
+            waitSemaphores.push_back(m_frameSyncObjects.imageAvailableSemaphores[m_currentFrame]);
+            waitstages.push_back(VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+            waitValues.push_back(0);
+        }
+
+        // Geometry the visibility resolve reads may still be copying on the upload queue.
+        uint64_t geometryTicket = m_visibilityBuffer->getGeometryTicket();
+        if (geometryTicket != 0 && !UploadManager::getInstance()->isComplete(geometryTicket))
+        {
+            waitSemaphores.push_back(UploadManager::getInstance()->getGraphicsTimeline());
+            waitstages.push_back(VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+            waitValues.push_back(geometryTicket);
+        }
+
+        VkTimelineSemaphoreSubmitInfo timelineInfo = {};
+        timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfo.waitSemaphoreValueCount = static_cast<uint32_t>(waitValues.size());
+        timelineInfo.pWaitSemaphoreValues = waitValues.data();
+
+        submitInfo.pNext = &timelineInfo;
+        submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+        submitInfo.pWaitSemaphores = waitSemaphores.data();
+        submitInfo.pWaitDstStageMask = waitstages.data();
 
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = &m_drawCommandBuffers[imageIndex]; // Need to incorporate command buffers.
 
+        // A captured frame is presented once it has been copied out, so the copy signals instead.
+        bool capture = m_captureRing && m_captureRing->hasFreeSlot();
         VkSemaphore signalSemaphores[] = {m_frameSyncObjects.renderFinishedSemaphores[m_currentFrame]};
-        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.signalSemaphoreCount = headless || capture ? 0 : 1;
         submitInfo.pSignalSemaphores = signalSemaphores;
 
         vkResetFences(m_logicalDevice->getLogicalDevice(), 1, &m_frameSyncObjects.inflightFences[m_currentFrame]);
 
+        // Latch the camera as late as possible, the command buffer only reads it when it runs.
+        m_framePacer->latch();
+        updateUniformBuffer(imageIndex);
+
         // Submit to the graphics queue.
-        if (vkQueueSubmit(m_logicalDevice->getGraphicsQueue(), 1, &submitInfo,
-            m_frameSyncObjects.inflightFences[m_currentFrame]) != VK_SUCCESS)
         {
-            throw std::runtime_error("Failed to submit draw command buffer.");
+            KMDM_PROFILE_ZONE("submit");
+            if (vkQueueSubmit(m_logicalDevice->getGraphicsQueue(), 1, &submitInfo,
+                m_frameSyncObjects.inflightFences[m_currentFrame]) != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to submit draw command buffer.");
+            }
+        }
+        GpuProfiler::getInstance()->frameSubmitted(imageIndex);
+
+        if (capture)
+        {
+            KMDM_PROFILE_ZONE("captureFrame");
+            m_captureRing->capture(m_swapChain->getSwapChainImages()[imageIndex], m_swapChain->getSwapChainImageFormat(),
+                m_swapChain->getSwapChainExtent(), m_swapChain->getPresentLayout(),
+                headless ? VK_NULL_HANDLE : signalSemaphores[0], m_captureTag);
+            m_captureRing = nullptr;
         }
 
         VkPresentInfoKHR presentInfo = {};
@@ -348,18 +621,35 @@ namespace KMDM
         presentInfo.pSwapchains = swapChains;
         presentInfo.pImageIndices = &imageIndex;
 
-        result = vkQueuePresentKHR(m_logicalDevice->getPresentationQueue(), &presentInfo);
-        if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || m_frameBufferResized)
+        // Headless frames stay in their offscreen image, and are only waited for.
+        if (!headless)
         {
-            m_frameBufferResized = false;
-            recreateSwapChain();
+            KMDM_PROFILE_ZONE("present");
+            result = vkQueuePresentKHR(m_logicalDevice->getPresentationQueue(), &presentInfo);
         }
-        else if (result != VK_SUCCESS)
+        bool recreate = result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR ||
+            (m_frameBufferResized && !headless);
+        if (!recreate && result != VK_SUCCESS)
         {
             throw std::runtime_error("Failed to present swapchain image.");
         }
 
-        vkQueueWaitIdle(m_logicalDevice->getPresentationQueue());
+        {
+            KMDM_PROFILE_ZONE("waitForPresent");
+            vkQueueWaitIdle(m_logicalDevice->getPresentationQueue());
+        }
+        m_framePacer->framePresented();
+        if (m_upscaledFrame)
+        {
+            m_dynamicResolution->endFrame(imageIndex);
+        }
+
+        // This frame was presented, the next one is recorded for the new swapchain.
+        if (recreate)
+        {
+            m_frameBufferResized = false;
+            recreateSwapChain();
+        }
             m_descriptorSet->resetDescriptorPools();
             m_currentFrame = (m_currentFrame += 1) % MAX_FRAMES_IN_FLIGHT;
     } /// drawFrame
@@ -420,9 +710,6 @@ namespace KMDM
             vkDestroySemaphore(m_logicalDevice->getLogicalDevice(), 
                 m_frameSyncObjects.renderFinishedSemaphores[i], nullptr);
 
-            vkDestroyFence(m_logicalDevice->getLogicalDevice(),
-                m_frameSyncObjects.imagesInFlight[i], nullptr);
-
             vkDestroyFence(m_logicalDevice->getLogicalDevice(),
                 m_frameSyncObjects.inflightFences[i], nullptr);
         }
@@ -435,17 +722,22 @@ namespace KMDM
      */
     void Renderer::createCommandBuffers()
     {
-        m_drawCommandBuffers.resize(m_framebuffers.size());
-        // Allocate the command buffers.
-        VkCommandBufferAllocateInfo allocInfo = {};
-        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        allocInfo.commandPool = m_commandPool->getCommandPool();
-        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        allocInfo.commandBufferCount = (uint32_t) m_drawCommandBuffers.size();
+        KMDM_PROFILE_ZONE_VALUE("createCommandBuffers", m_framebuffers.size());
 
-        if (vkAllocateCommandBuffers(m_logicalDevice->getLogicalDevice(), &allocInfo, m_drawCommandBuffers.data()) != VK_SUCCESS)
+        // Allocate the command buffers once, beginning one resets it.
+        if (m_drawCommandBuffers.size() != m_framebuffers.size())
         {
-            throw std::runtime_error("Failed to allocate command buffers.");
+            m_drawCommandBuffers.resize(m_framebuffers.size());
+            VkCommandBufferAllocateInfo allocInfo = {};
+            allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocInfo.commandPool = m_commandPool->getCommandPool();
+            allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocInfo.commandBufferCount = (uint32_t) m_drawCommandBuffers.size();
+
+            if (vkAllocateCommandBuffers(m_logicalDevice->getLogicalDevice(), &allocInfo, m_drawCommandBuffers.data()) != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to allocate command buffers.");
+            }
         }
 
         // Update the descriptor sets for the scene.
@@ -456,65 +748,241 @@ namespace KMDM
         std::vector<Model> models = Scene::getInstance()->getMeshes();
         std::vector<VkDescriptorSet> modelSets = m_descriptorSet->getModelDescriptorSets(models);
 
-        // Begin recording command buffers.
-        for (size_t i = 0; i < m_drawCommandBuffers.size(); i++)
+        // Without models there is nothing for the resolve to shade, so the forward path clears the frame.
+        bool visibility = m_renderPath == RenderPath::VisibilityBuffer && !models.empty();
+        if (visibility)
         {
-            VkCommandBufferBeginInfo beginInfo = {};
-            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-            beginInfo.flags = 0;
-            beginInfo.pInheritanceInfo = nullptr;
-
-            if (vkBeginCommandBuffer(m_drawCommandBuffers[i], &beginInfo) != VK_SUCCESS)
-            {
-                throw std::runtime_error("Failed to begin recording command buffer.");
-            }
-
-            // Start render passes.
-            VkRenderPassBeginInfo renderPassInfo = {};
-            renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-            renderPassInfo.renderPass = m_renderPass->getRenderPass();
-            renderPassInfo.framebuffer = m_framebuffers[i];
-            renderPassInfo.renderArea.offset = {0, 0};
-            renderPassInfo.renderArea.extent = m_swapChain->getSwapChainExtent();
-
-            // Clear the color and depth stencil at the beginning of our renderpass.
-            std::array<VkClearValue, 2> clearValues = {};
-            clearValues[0].color = {0.0f, 0.0f, 0.0f, 1.0f};
-            clearValues[1].depthStencil = {1.0f, 0};
-            renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
-            renderPassInfo.pClearValues = clearValues.data();
+            m_visibilityBuffer->updateGeometry(models);
+        }
 
-            vkCmdBeginRenderPass(m_drawCommandBuffers[i], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+        // Variants still compiling in the background are left out of the frame, which is drawn
+        // with the base pipeline instead.
+        PipelineDesc baseDesc = m_graphicsPipeline->getDescription();
+        VkPipeline basePipeline = *m_graphicsPipeline->getPipeline();
+        auto variantReady = [&](const PipelineDesc& desc, VkPipeline& pipeline)
+        {
+            pipeline = PipelineManager::getInstance()->requestPipeline(desc, baseDesc);
+            return pipeline != basePipeline;
+        };
+        bool depthPrepass = m_depthPrepass && !visibility &&
+            variantReady(m_depthPrepassDesc, m_depthPrepassPipeline) &&
+            variantReady(m_depthTestedDesc, m_depthTestedPipeline);
+
+        // The render scale is picked once, every image of the frame is drawn at it.
+        m_upscaledFrame = m_dynamicResolutionEnabled && !visibility &&
+            variantReady(m_upscaledDesc, m_upscaledPipeline);
+        VkExtent2D renderExtent = m_swapChain->getSwapChainExtent();
+        if (m_upscaledFrame)
+        {
+            m_dynamicResolution->beginFrame();
+            renderExtent = m_dynamicResolution->getRenderExtent();
+        }
 
-            // Bind the graphics pipeline.
-            vkCmdBindPipeline(m_drawCommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, *m_graphicsPipeline->getPipeline());
-            vkCmdBindVertexBuffers(m_drawCommandBuffers[i], 0, 1, &m_uniformBuffers[i], 0);
+        // Draw every model with the forward shading sets, in whichever pass is bound.
+        auto drawModels = [&](VkCommandBuffer commandBuffer, size_t i)
+        {
+            setViewportAndScissor(commandBuffer, renderExtent);
 
-            // vkCmdPushConstants(m_drawCommandBuffers[i], *m_graphicsPipeline->getPipelineLayout(),
+            // vkCmdPushConstants(commandBuffer, *m_graphicsPipeline->getPipelineLayout(),
             //     VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(CameraData), &m_cameraBuffers[i]);
-            vkCmdBindDescriptorSets(m_drawCommandBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, 
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, 
                 *m_graphicsPipeline->getPipelineLayout(), 0, 1, &sceneDescriptorSets[i], 0, nullptr);
+            VkDescriptorSet lightingSet = m_lighting->getDescriptorSet(static_cast<uint32_t>(i));
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                *m_graphicsPipeline->getPipelineLayout(), 2, 1, &lightingSet, 0, nullptr);
             
             for (size_t j = 0; j < models.size(); j++)
             {
                 // Bind the vertex & index buffers.
-                // vertexBuffers.push_back(mesh.getVertexBuffer());
-                // indexBuffers.
                 VkBuffer buffers[] =  { *models[j].getVertexBuffer() };
-                vkCmdBindVertexBuffers(m_drawCommandBuffers[j], 0, 1, buffers, 0);
-                vkCmdBindIndexBuffer(m_drawCommandBuffers[j], *models[i].getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+                VkDeviceSize offsets[] = { 0 };
+                vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+                vkCmdBindIndexBuffer(commandBuffer, *models[j].getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
                 
-                // Bind the UBO descriptor sets.
-                vkCmdBindDescriptorSets(m_drawCommandBuffers[j], VK_PIPELINE_BIND_POINT_GRAPHICS, 
-                    *m_graphicsPipeline->getPipelineLayout(), 0, 1, &modelSets[j],
+                // Bind the model descriptor set.
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, 
+                    *m_graphicsPipeline->getPipelineLayout(), 1, 1, &modelSets[j],
                     0, nullptr);
 
                 // Draw.
-                // vkCmdDraw(m_drawCommandBuffers[i], 3, 1, 0, 0);
+                GpuProfiler::getInstance()->beginDrawCounters(commandBuffer, static_cast<uint32_t>(j));
+                vkCmdDrawIndexed(commandBuffer, models[j].getIndexCount(), 1, 0, 0, 0);
+                GpuProfiler::getInstance()->endDrawCounters(commandBuffer);
+            }
+        };
+
+        // Begin recording command buffers.
+        for (size_t i = 0; i < m_drawCommandBuffers.size(); i++)
+        {
+            KMDM_PROFILE_ZONE_VALUE("recordCommandBuffer", i);
+            VkCommandBufferBeginInfo beginInfo = {};
+            beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags = 0;
+            beginInfo.pInheritanceInfo = nullptr;
+
+            if (vkBeginCommandBuffer(m_drawCommandBuffers[i], &beginInfo) != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to begin recording command buffer.");
+            }
+            GpuProfiler::getInstance()->beginCommandBuffer(m_drawCommandBuffers[i], static_cast<uint32_t>(i));
+            GpuProfiler::getInstance()->beginScope(m_drawCommandBuffers[i], "frame");
+            if (m_upscaledFrame)
+            {
+                m_dynamicResolution->recordFrameStart(m_drawCommandBuffers[i], static_cast<uint32_t>(i));
+            }
+
+            // The graph transitions the attachments, so the renderpass keeps them in attachment layouts.
+            m_renderGraph->reset();
+
+            RenderImageDesc colorDesc = {};
+            colorDesc.format = m_swapChain->getSwapChainImageFormat();
+            colorDesc.extent = m_swapChain->getSwapChainExtent();
+            colorDesc.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+            colorDesc.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+            RenderResource color = m_renderGraph->importImage("swapchain", m_swapChain->getSwapChainImages()[i],
+                m_swapChain->getSwapChainImageViews()[i], colorDesc, VK_IMAGE_LAYOUT_UNDEFINED,
+                m_swapChain->getPresentLayout(), VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+
+            RenderImageDesc depthDesc = {};
+            depthDesc.format = m_renderPass->findDepthFormat();
+            depthDesc.extent = m_swapChain->getSwapChainExtent();
+            depthDesc.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+            depthDesc.aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+            RenderResource depth = m_renderGraph->importImage("depth", m_depthTarget.image, m_depthTarget.view, depthDesc,
+                VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_UNDEFINED,
+                VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT);
+
+            // Fill the light lists of the clusters before anything is shaded.
+            LightCullingResources lightLists = m_lighting->addCullingPass(*m_renderGraph, static_cast<uint32_t>(i));
+
+            if (visibility)
+            {
+                m_visibilityBuffer->updateDescriptorSet(static_cast<uint32_t>(i), m_uniformBuffers[i], models);
+                m_visibilityBuffer->addPasses(*m_renderGraph, static_cast<uint32_t>(i), color, depth, lightLists,
+                    sceneDescriptorSets[i], m_lighting->getDescriptorSet(static_cast<uint32_t>(i)), models);
+            }
+            else if (m_upscaledFrame)
+            {
+                // Shade at the render scale into the upscaler's targets, then upscale into the swap chain.
+                UpscaleResources targets = m_dynamicResolution->importTargets(*m_renderGraph);
+                m_renderGraph->addPass("forward_upscaled", [&, i](VkCommandBuffer commandBuffer, RenderGraph&)
+                {
+                    VkRenderPassBeginInfo renderPassInfo = {};
+                    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+                    renderPassInfo.renderPass = m_dynamicResolution->getRenderPass()->getRenderPass();
+                    renderPassInfo.framebuffer = m_dynamicResolution->getFramebuffer();
+                    renderPassInfo.renderArea.offset = {0, 0};
+                    renderPassInfo.renderArea.extent = renderExtent;
+
+                    std::array<VkClearValue, 3> clearValues = {};
+                    clearValues[0].color = {0.0f, 0.0f, 0.0f, 1.0f};
+                    clearValues[1].color = {0.0f, 0.0f, 0.0f, 0.0f};
+                    clearValues[2].depthStencil = {1.0f, 0};
+                    renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+                    renderPassInfo.pClearValues = clearValues.data();
+
+                    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+                    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_upscaledPipeline);
+                    drawModels(commandBuffer, i);
+                    vkCmdEndRenderPass(commandBuffer);
+                })
+                    .write(targets.sceneColor, RenderAccess::ColorAttachment)
+                    .write(targets.motionVectors, RenderAccess::ColorAttachment)
+                    .write(depth, RenderAccess::DepthAttachment)
+                    .read(lightLists.lightGrid, RenderAccess::StorageRead)
+                    .read(lightLists.lightIndices, RenderAccess::StorageRead);
+
+                m_dynamicResolution->addUpscalePasses(*m_renderGraph, targets, color);
+            }
+            else
+            {
+                if (depthPrepass)
+                {
+                    m_renderGraph->addPass("depth_prepass", [&, i](VkCommandBuffer commandBuffer, RenderGraph&)
+                    {
+                        VkRenderPassBeginInfo renderPassInfo = {};
+                        renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+                        renderPassInfo.renderPass = m_depthPrepassRenderPass->getRenderPass();
+                        renderPassInfo.framebuffer = m_depthFramebuffer;
+                        renderPassInfo.renderArea.offset = {0, 0};
+                        renderPassInfo.renderArea.extent = m_swapChain->getSwapChainExtent();
+
+                        VkClearValue clearValue = {};
+                        clearValue.depthStencil = {1.0f, 0};
+                        renderPassInfo.clearValueCount = 1;
+                        renderPassInfo.pClearValues = &clearValue;
+
+                        vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+                        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_depthPrepassPipeline);
+                        setViewportAndScissor(commandBuffer, renderExtent);
+                        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                            *m_graphicsPipeline->getPipelineLayout(), 0, 1, &sceneDescriptorSets[i], 0, nullptr);
+
+                        // Only the positions are fetched, the shader needs nothing from the model set.
+                        for (size_t j = 0; j < models.size(); j++)
+                        {
+                            VkBuffer buffers[] = { *models[j].getPositionBuffer() };
+                            VkDeviceSize offsets[] = { 0 };
+                            vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+                            vkCmdBindIndexBuffer(commandBuffer, *models[j].getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+                            GpuProfiler::getInstance()->beginDrawCounters(commandBuffer, static_cast<uint32_t>(j));
+                            vkCmdDrawIndexed(commandBuffer, models[j].getIndexCount(), 1, 0, 0, 0);
+                            GpuProfiler::getInstance()->endDrawCounters(commandBuffer);
+                        }
+                        vkCmdEndRenderPass(commandBuffer);
+                    })
+                        .write(depth, RenderAccess::DepthAttachment);
+                }
+
+                // After a pre-pass the main pass only tests depth, so it reads it.
+                bool depthTested = depthPrepass;
+                RenderGraph::PassBuilder forward = m_renderGraph->addPass("forward",
+                    [&, i, depthTested](VkCommandBuffer commandBuffer, RenderGraph&)
+                {
+                    // Start render passes.
+                    VkRenderPassBeginInfo renderPassInfo = {};
+                    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+                    renderPassInfo.renderPass = depthTested ? m_depthTestedRenderPass->getRenderPass() :
+                        m_renderPass->getRenderPass();
+                    renderPassInfo.framebuffer = m_framebuffers[i];
+                    renderPassInfo.renderArea.offset = {0, 0};
+                    renderPassInfo.renderArea.extent = m_swapChain->getSwapChainExtent();
+
+                    // Clear the color and depth stencil at the beginning of our renderpass.
+                    std::array<VkClearValue, 2> clearValues = {};
+                    clearValues[0].color = {0.0f, 0.0f, 0.0f, 1.0f};
+                    clearValues[1].depthStencil = {1.0f, 0};
+                    renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+                    renderPassInfo.pClearValues = clearValues.data();
+
+                    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+                    // Bind the graphics pipeline.
+                    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS,
+                        depthTested ? m_depthTestedPipeline : *m_graphicsPipeline->getPipeline());
+                    drawModels(commandBuffer, i);
+                    vkCmdEndRenderPass(commandBuffer);
+                });
+                forward.write(color, RenderAccess::ColorAttachment);
+                forward.read(lightLists.lightGrid, RenderAccess::StorageRead);
+                forward.read(lightLists.lightIndices, RenderAccess::StorageRead);
+                if (depthTested)
+                {
+                    forward.read(depth, RenderAccess::DepthRead);
+                }
+                else
+                {
+                    forward.write(depth, RenderAccess::DepthAttachment);
+                }
+            }
 
-                vkCmdDrawIndexed(m_drawCommandBuffers[j], models[j].getIndexCount(), 1, 0, 0, 0);
+            m_renderGraph->compile();
+            m_renderGraph->execute(m_drawCommandBuffers[i]);
+            if (m_upscaledFrame)
+            {
+                m_dynamicResolution->recordFrameEnd(m_drawCommandBuffers[i], static_cast<uint32_t>(i));
             }
-            vkCmdEndRenderPass(m_drawCommandBuffers[i]);
+            GpuProfiler::getInstance()->endScope(m_drawCommandBuffers[i]);
 
             if (vkEndCommandBuffer(m_drawCommandBuffers[i]) != VK_SUCCESS)
             {
@@ -536,10 +1004,84 @@ namespace KMDM
                     destroyRenderer();
                     // m_window->destoryWindow();
                 }
+                else if (event.type == SDL_WINDOWEVENT && event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED)
+                {
+                    m_frameBufferResized = true;
+                }
+                else if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F11 && !event.key.repeat)
+                {
+                    cycleCounterLevel();
+                }
+                else if (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_F12 && !event.key.repeat)
+                {
+                    FrameCapture* capture = getFrameCapture();
+                    if (capture->isRecording())
+                    {
+                        capture->stop();
+                    }
+                    else
+                    {
+                        capture->start();
+                    }
+                }
             }
-            createCommandBuffers();
-            drawFrame();
+            renderFrame();
+        }
+    }
+
+    /**
+     * @brief Step the GPU counters from off to passes to draws and back to off.
+     *
+     */
+    void Renderer::cycleCounterLevel()
+    {
+        GpuProfiler* profiler = GpuProfiler::getInstance();
+        switch (profiler->getCounterLevel())
+        {
+            case GpuCounterLevel::Off:
+                profiler->setCounterLevel(GpuCounterLevel::Passes);
+                std::cout << "GPU counters per pass." << std::endl;
+                break;
+            case GpuCounterLevel::Passes:
+                profiler->setCounterLevel(GpuCounterLevel::Draws);
+                std::cout << "GPU counters per draw." << std::endl;
+                break;
+            case GpuCounterLevel::Draws:
+                profiler->setCounterLevel(GpuCounterLevel::Off);
+                std::cout << "GPU counters off." << std::endl;
+                break;
+        }
+    }
+
+    void Renderer::renderFrame()
+    {
+        KMDM_PROFILE_ZONE("renderFrame");
+
+        // Sleep here rather than in the acquire, so the frame starts with fresh input.
+        {
+            KMDM_PROFILE_ZONE("waitForFrame");
+            m_framePacer->waitForFrame();
         }
+
+        // Read the GPU times of the last frame that used this slot, without waiting for it.
+        GpuProfiler::getInstance()->beginFrame(static_cast<uint32_t>(m_currentFrame),
+            m_frameSyncObjects.inflightFences[m_currentFrame]);
+
+        // Swap in any models that finished streaming before recording.
+        Scene::getInstance()->processStreamedModels();
+        {
+            KMDM_PROFILE_ZONE("residency");
+            TextureResidency::getInstance()->update();
+            RenderTargetPool::getInstance()->update();
+            PipelineCache::getInstance()->update();
+            MemoryTelemetry::getInstance()->update();
+        }
+        if (m_frameCapture)
+        {
+            m_frameCapture->update();
+        }
+        createCommandBuffers();
+        drawFrame();
     }
 
     /**
@@ -555,7 +1097,7 @@ namespace KMDM
         for (size_t i = 0; i < m_swapChain->getSwapChainImages().size(); i++)
         {
             createBuffer(size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, m_uniformBuffers[i], m_uniformBufferMemory[i]);
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, m_uniformBuffers[i], m_uniformBufferMemory[i], MemoryCategory::Uniform);
         }
     }
 
@@ -572,7 +1114,7 @@ namespace KMDM
         for (size_t i = 0; i < m_swapChain->getSwapChainImages().size(); i++)
         {
             createBuffer(size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_COHERENT_BIT |
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, m_gpuSceneData[i], m_gpuSceneMemory[i]);
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, m_gpuSceneData[i], m_gpuSceneMemory[i], MemoryCategory::Uniform);
         }
     }
 
@@ -584,7 +1126,7 @@ namespace KMDM
         }
         for (size_t i = 0; i < m_gpuSceneMemory.size(); i++)
         {
-            vkFreeMemory(m_logicalDevice->getLogicalDevice(), m_gpuSceneMemory[i], nullptr);
+            freeMemory(m_gpuSceneMemory[i]);
         }
     }
 
@@ -600,16 +1142,123 @@ namespace KMDM
         auto currentTime = std::chrono::high_resolution_clock::now();
         float time = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - startTime).count();
 
+        // Headless frames are rendered to be compared or written out, so the model holds still.
+        if (Window::isHeadless())
+        {
+            time = 0.0f;
+        }
+
+        float nearPlane = 0.1f;
+        float farPlane = 10.0f;
+
         UniformBufferObject ubo = {};
         ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-        ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+        if (m_cameraLatch)
+        {
+            if (!Window::isHeadless())
+            {
+                SDL_PumpEvents();
+            }
+            ubo.view = m_cameraLatch();
+        }
+        else
+        {
+            ubo.view = glm::lookAt(glm::vec3(2.0f, 2.0f, 2.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
+        }
         ubo.proj = glm::perspective(glm::radians(45.0f), m_swapChain->getSwapChainExtent().width / 
-            (float) m_swapChain->getSwapChainExtent().height, 0.1f, 10.0f);
+            (float) m_swapChain->getSwapChainExtent().height, nearPlane, farPlane);
         ubo.proj[1][1] *= -1;
 
+        // Motion is measured without the jitter, against where the surface was last frame.
+        glm::mat4 modelViewProj = ubo.proj * ubo.view * ubo.model;
+        ubo.unjitteredProj = ubo.proj;
+        ubo.previousModelViewProj = m_hasPreviousFrame ? m_previousModelViewProj : modelViewProj;
+        m_previousModelViewProj = modelViewProj;
+        m_hasPreviousFrame = true;
+
+        VkExtent2D renderExtent = m_swapChain->getSwapChainExtent();
+        if (m_upscaledFrame)
+        {
+            ubo.proj = m_dynamicResolution->jitterProjection(ubo.proj);
+            renderExtent = m_dynamicResolution->getRenderExtent();
+        }
+
+        // Lights are culled with the same camera the frame is drawn with.
+        Scene* scene = Scene::getInstance();
+        m_lighting->update(currentImage, scene->getLights(), scene->getAmbientLight(), ubo.view, ubo.proj,
+            renderExtent, nearPlane, farPlane);
+
+        // Ask for the texture detail the models need at their current size on screen.
+        scene->requestTextureMips(ubo.view * ubo.model, std::fabs(ubo.proj[1][1]),
+            static_cast<float>(renderExtent.height));
+
         void* data;
         vkMapMemory(m_logicalDevice->getLogicalDevice(), m_uniformBufferMemory[currentImage], 0, sizeof(ubo), 0, &data);
             memcpy(data, &ubo, sizeof(ubo));
         vkUnmapMemory(m_logicalDevice->getLogicalDevice(), m_uniformBufferMemory[currentImage]);
     }
+
+    /**
+     * @brief Switch the present mode through a swapchain recreation after the next frame.  The new
+     * mode may come with a different image count, which recreateSwapChain() follows.
+     *
+     * @param mode
+     */
+    void Renderer::setPresentMode(VkPresentModeKHR mode)
+    {
+        m_swapChain->setPresentMode(mode);
+        m_frameBufferResized = true;
+    }
+
+    /**
+     * @brief Copy the next frame that finds a free slot into the ring.  A null ring cancels the
+     * request.
+     *
+     * @param ring
+     * @param tag
+     */
+    void Renderer::captureNextFrame(ReadbackRing* ring, uint64_t tag)
+    {
+        if (ring && !m_swapChain->isReadable())
+        {
+            throw std::runtime_error("Swapchain images cannot be read back.");
+        }
+        m_captureRing = ring;
+        m_captureTag = tag;
+    }
+
+    /**
+     * @brief Resize the offscreen images.  Frames are waited for as they are presented, so the
+     * images can be recreated right away.
+     *
+     * @param width
+     * @param height
+     */
+    void Renderer::resizeHeadless(uint32_t width, uint32_t height)
+    {
+        VkExtent2D extent = m_swapChain->getSwapChainExtent();
+        if (!Window::isHeadless() || (extent.width == width && extent.height == height))
+        {
+            return;
+        }
+        Window::setHeadless(true, static_cast<int>(width), static_cast<int>(height));
+        recreateSwapChain();
+    }
+
+    void Renderer::setDepthPrepass(bool enabled) { m_depthPrepass = enabled; }
+    void Renderer::setRenderPath(RenderPath path) { m_renderPath = path; }
+    void Renderer::setDynamicResolution(bool enabled) { m_dynamicResolutionEnabled = enabled; }
+    DynamicResolution* Renderer::getDynamicResolution() { return m_dynamicResolution; }
+    void Renderer::setFrameRateLimit(float frames_per_second) { m_framePacer->setFrameRateLimit(frames_per_second); }
+    void Renderer::setCameraLatch(std::function<glm::mat4()> latch) { m_cameraLatch = latch; }
+    FramePacer* Renderer::getFramePacer() { return m_framePacer; }
+
+    FrameCapture* Renderer::getFrameCapture()
+    {
+        if (!m_frameCapture)
+        {
+            m_frameCapture = new FrameCapture();
+        }
+        return m_frameCapture;
+    }
 }
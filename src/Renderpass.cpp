@@ -3,10 +3,12 @@
 #include "LogicalDevice.h"
 #include "PhysicalDevice.h"
 #include "types.h"
+#include "Common.h"
 
 #include <vulkan/vulkan.h>
 #include <stdexcept>
 #include <iostream>
+#include <vector>
 
 namespace KMDM
 {
@@ -14,43 +16,69 @@ namespace KMDM
      * @brief Construct a new Renderpass:: Renderpass object
      * 
      */
-    Renderpass::Renderpass()
+    Renderpass::Renderpass(RenderpassType type)
     {
         // Renderpass color attachment
         VkAttachmentDescription colorAttachment = {};
-        colorAttachment.format = SwapChain::getInstance()->getSwapChainImageFormat();
+        colorAttachment.format = type == RenderpassType::Visibility ? VISIBILITY_FORMAT :
+            SwapChain::getInstance()->getSwapChainImageFormat();
         colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
         colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
         colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
         colorAttachment.stencilLoadOp =  VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+        // The render graph moves the attachments in and out of their attachment layouts.
+        colorAttachment.initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+        colorAttachment.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
         colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
 
         VkAttachmentReference colorAttachmentRef = {};
         colorAttachmentRef.attachment = 0;
         colorAttachmentRef.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
+        // The upscaler's input also has the motion vectors next to the color.
+        std::vector<VkAttachmentDescription> colorAttachments;
+        std::vector<VkAttachmentReference> colorAttachmentRefs;
+        if (type == RenderpassType::Upscaled)
+        {
+            VkAttachmentDescription motionAttachment = colorAttachment;
+            colorAttachment.format = SCENE_COLOR_FORMAT;
+            motionAttachment.format = MOTION_VECTOR_FORMAT;
+            colorAttachments = { colorAttachment, motionAttachment };
+            colorAttachmentRefs = { colorAttachmentRef, colorAttachmentRef };
+            colorAttachmentRefs[1].attachment = 1;
+        }
+        else if (type != RenderpassType::DepthPrepass)
+        {
+            colorAttachments = { colorAttachment };
+            colorAttachmentRefs = { colorAttachmentRef };
+        }
+
+        // A pass over pre-pass depth only tests against it, so it stays read only.
+        VkImageLayout depthLayout = type == RenderpassType::ForwardDepthTested ?
+            VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
         VkAttachmentDescription depthAttachment = {};
         depthAttachment.format = findDepthFormat();
         depthAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
-        depthAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-        depthAttachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+        depthAttachment.loadOp = type == RenderpassType::ForwardDepthTested ?
+            VK_ATTACHMENT_LOAD_OP_LOAD : VK_ATTACHMENT_LOAD_OP_CLEAR;
+        depthAttachment.storeOp = type == RenderpassType::DepthPrepass ?
+            VK_ATTACHMENT_STORE_OP_STORE : VK_ATTACHMENT_STORE_OP_DONT_CARE;
         depthAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
         depthAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        depthAttachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_STENCIL_ATTACHMENT_OPTIMAL;
+        depthAttachment.finalLayout = depthLayout;
 
-        depthAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        depthAttachment.initialLayout = depthLayout;
 
         VkAttachmentReference depthAttachmentRef = {};
-        depthAttachmentRef.attachment = 1;
-        depthAttachmentRef.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+        depthAttachmentRef.attachment = static_cast<uint32_t>(colorAttachments.size());
+        depthAttachmentRef.layout = depthLayout;
 
         VkSubpassDescription subpass = {};
         subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-        subpass.colorAttachmentCount = 1;
-        subpass.pColorAttachments = &colorAttachmentRef; // This is referenced in fragment shader layout at layout(location = 0)
+        subpass.colorAttachmentCount = static_cast<uint32_t>(colorAttachmentRefs.size());
+        subpass.pColorAttachments = colorAttachmentRefs.data(); // This is referenced in fragment shader layout at layout(location = 0)
         subpass.pDepthStencilAttachment = &depthAttachmentRef;
         subpass.pResolveAttachments = nullptr;
 
@@ -67,7 +95,8 @@ namespace KMDM
         dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
             VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
 
-        std::array<VkAttachmentDescription, 2> attachments = { colorAttachment, depthAttachment };
+        std::vector<VkAttachmentDescription> attachments = colorAttachments;
+        attachments.push_back(depthAttachment);
         VkRenderPassCreateInfo createInfo = {};
         createInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
         createInfo.attachmentCount = static_cast<uint32_t>(attachments.size());
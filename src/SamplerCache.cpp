@@ -0,0 +1,141 @@
+#include "../include/SamplerCache.h"
+#include "../include/LogicalDevice.h"
+
+#include <vulkan/vulkan.h>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <stdexcept>
+
+namespace KMDM
+{
+    SamplerCache* SamplerCache::m_samplerCache = nullptr;
+
+    namespace
+    {
+        void hashCombine(size_t& seed, uint32_t value)
+        {
+            seed ^= std::hash<uint32_t>()(value) + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+        }
+
+        // Floats are compared and hashed by their bits, so -0.0 and 0.0 are distinct samplers.
+        uint32_t floatBits(float value)
+        {
+            uint32_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            return bits;
+        }
+    }
+
+    /**
+     * @brief Get the Instance object
+     *
+     * @return SamplerCache*
+     */
+    SamplerCache* SamplerCache::getInstance()
+    {
+        if (!m_samplerCache)
+        {
+            m_samplerCache = new SamplerCache();
+        }
+        return m_samplerCache;
+    }
+
+    SamplerCache::SamplerCache()
+    {
+        std::cout << "Created sampler cache." << std::endl;
+    }
+
+    SamplerCache::~SamplerCache()
+    {
+        destroySamplerCache();
+    }
+
+    /**
+     * @brief Destroy every cached sampler.
+     *
+     */
+    void SamplerCache::destroySamplerCache()
+    {
+        std::cout << "- Destroying SamplerCache (" << m_stats.uniqueSamplers << " unique samplers for "
+                  << m_stats.requests << " requests)." << std::endl;
+        for (auto & bucket : m_samplers)
+        {
+            for (auto & cached : bucket.second)
+            {
+                vkDestroySampler(LogicalDevice::getInstance()->getLogicalDevice(), cached.sampler, nullptr);
+            }
+        }
+        m_samplers.clear();
+        m_samplerCache = nullptr;
+    }
+
+    /******************************************************************
+        Look the create info up and create the sampler on a miss.
+    *******************************************************************/
+    VkSampler SamplerCache::getSampler(const VkSamplerCreateInfo& info)
+    {
+        if (info.pNext)
+        {
+            throw std::runtime_error("Sampler create info extensions are not supported by the sampler cache.");
+        }
+
+        m_stats.requests++;
+        std::vector<CachedSampler>& bucket = m_samplers[hashSamplerInfo(info)];
+        for (auto & cached : bucket)
+        {
+            if (isSameSampler(cached.info, info))
+            {
+                m_stats.hits++;
+                return cached.sampler;
+            }
+        }
+
+        CachedSampler cached = {};
+        cached.info = info;
+        if (vkCreateSampler(LogicalDevice::getInstance()->getLogicalDevice(), &info, nullptr, &cached.sampler)
+            != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create texture sampler.");
+        }
+        bucket.push_back(cached);
+        m_stats.uniqueSamplers++;
+        return cached.sampler;
+    } /// getSampler
+
+    size_t SamplerCache::hashSamplerInfo(const VkSamplerCreateInfo& info)
+    {
+        size_t seed = 0;
+        hashCombine(seed, info.flags);
+        hashCombine(seed, info.magFilter);
+        hashCombine(seed, info.minFilter);
+        hashCombine(seed, info.mipmapMode);
+        hashCombine(seed, info.addressModeU);
+        hashCombine(seed, info.addressModeV);
+        hashCombine(seed, info.addressModeW);
+        hashCombine(seed, floatBits(info.mipLodBias));
+        hashCombine(seed, info.anisotropyEnable);
+        hashCombine(seed, floatBits(info.maxAnisotropy));
+        hashCombine(seed, info.compareEnable);
+        hashCombine(seed, info.compareOp);
+        hashCombine(seed, floatBits(info.minLod));
+        hashCombine(seed, floatBits(info.maxLod));
+        hashCombine(seed, info.borderColor);
+        hashCombine(seed, info.unnormalizedCoordinates);
+        return seed;
+    }
+
+    bool SamplerCache::isSameSampler(const VkSamplerCreateInfo& a, const VkSamplerCreateInfo& b)
+    {
+        return a.flags == b.flags && a.magFilter == b.magFilter && a.minFilter == b.minFilter &&
+               a.mipmapMode == b.mipmapMode && a.addressModeU == b.addressModeU &&
+               a.addressModeV == b.addressModeV && a.addressModeW == b.addressModeW &&
+               floatBits(a.mipLodBias) == floatBits(b.mipLodBias) && a.anisotropyEnable == b.anisotropyEnable &&
+               floatBits(a.maxAnisotropy) == floatBits(b.maxAnisotropy) && a.compareEnable == b.compareEnable &&
+               a.compareOp == b.compareOp && floatBits(a.minLod) == floatBits(b.minLod) &&
+               floatBits(a.maxLod) == floatBits(b.maxLod) && a.borderColor == b.borderColor &&
+               a.unnormalizedCoordinates == b.unnormalizedCoordinates;
+    }
+
+    SamplerCacheStats SamplerCache::getStats() { return m_stats; }
+}
@@ -1,7 +1,11 @@
 #include "../include/Scene.h"
 #include "../include/Model.h"
+#include "../include/UploadManager.h"
+#include "../include/TextureResidency.h"
+#include "../include/CpuProfiler.h"
 
 
+#include <algorithm>
 #include <vector>
 #include <string>
 #include <iostream>
@@ -24,8 +28,17 @@ namespace KMDM
 
     Scene::Scene()
     {
-        Model m = Model(std::string("models/viking_room.obj"), std::string("models/viking_room.png"));
-        m_meshes.push_back(m);
+        // Without dynamic lights the models show their textures unlit.
+        m_sceneData = {};
+        m_sceneData.ambientColor = glm::vec4(1.0f);
+
+        m_streamer = new AssetStreamer();
+        m_placeholder.emplace(Model::createPlaceholderData());
+
+        // The placeholder is drawn straight away, so it has to be resident first.
+        UploadManager::getInstance()->wait(m_placeholder->getUploadTicket());
+
+        addModelAsync(std::string("models/viking_room.obj"), std::string("models/viking_room.png"));
     }
 
     Scene::~Scene()
@@ -39,17 +52,78 @@ namespace KMDM
      */
     void Scene::destoryScene()
     {
+        if (m_streamer)
+        {
+            delete(m_streamer);
+            m_streamer = nullptr;
+        }
+
         for (auto & mesh : m_meshes)
         {
             mesh.destroyModel();
-        }    
+        }
+        for (auto & uploading : m_uploadingModels)
+        {
+            UploadManager::getInstance()->wait(uploading.second.getUploadTicket());
+            uploading.second.destroyModel();
+        }
+        m_uploadingModels.clear();
+        if (m_placeholder)
+        {
+            m_placeholder->destroyModel();
+            m_placeholder.reset();
+        }
         m_scene = nullptr;    
     }
 
 
+    /**
+     * @brief Get the models to draw.  Each model that is still loading is represented
+     * by the placeholder.
+     * 
+     * @return std::vector<Model> 
+     */
     std::vector<Model> Scene::getMeshes()
     {
-        return m_meshes;
+        std::vector<Model> meshes = m_meshes;
+        if (m_placeholder)
+        {
+            meshes.insert(meshes.end(), m_pendingModels.size(), *m_placeholder);
+        }
+        return meshes;
+    }
+
+    /******************************************************************
+        Project each model's bounding sphere and request the level
+        whose texels match the pixels it covers.
+    *******************************************************************/
+    void Scene::requestTextureMips(const glm::mat4& model_view, float projection_scale, float viewport_height)
+    {
+        TextureResidency* residency = TextureResidency::getInstance();
+        for (auto & mesh : getMeshes())
+        {
+            glm::vec4 center = model_view * glm::vec4(mesh.getBoundsCenter(), 1.0f);
+            float distance = std::max(-center.z, 0.01f);
+            float pixels = 2.0f * mesh.getBoundsRadius() / distance * projection_scale * 0.5f * viewport_height;
+
+            uint32_t texture = mesh.getTexture();
+            residency->requestMip(texture, residency->computeRequiredMip(texture, pixels));
+        }
+    } /// requestTextureMips
+
+    /**
+     * @brief Add a light to the scene.  Lights past MAX_LIGHTS are ignored when culling.
+     * 
+     * @param light 
+     */
+    void Scene::addLight(const Light& light)
+    {
+        m_lights.push_back(light);
+    }
+
+    void Scene::clearLights()
+    {
+        m_lights.clear();
     }
 
     /**
@@ -61,4 +135,109 @@ namespace KMDM
     {
         m_meshes.push_back(mesh);
     }
+
+    /**
+     * @brief Destroy the meshes added with addMesh().  The device has to be idle.
+     * 
+     */
+    void Scene::clearMeshes()
+    {
+        for (auto & mesh : m_meshes)
+        {
+            mesh.destroyModel();
+        }
+        m_meshes.clear();
+    }
+
+    /**
+     * @brief Queue a model on the streaming threads.
+     * 
+     * @param model_path 
+     * @param texture_path 
+     * @return ModelHandle 
+     */
+    ModelHandle Scene::addModelAsync(std::string model_path, std::string texture_path)
+    {
+        uint32_t id = m_nextModelId++;
+        ModelHandle handle = {};
+        handle.id = id;
+        handle.ready = m_pendingModels[id].get_future().share();
+
+        m_streamer->requestModel(id, model_path, texture_path);
+        return handle;
+    }
+
+    /**
+     * @brief Start uploading the decoded models, and swap the models whose uploads have
+     * completed in for their placeholders.
+     * 
+     */
+    void Scene::processStreamedModels()
+    {
+        KMDM_PROFILE_ZONE("processStreamedModels");
+        UploadManager* uploads = UploadManager::getInstance();
+        uploads->update();
+
+        // Models whose uploads are done.
+        for (auto it = m_uploadingModels.begin(); it != m_uploadingModels.end();)
+        {
+            if (!uploads->isComplete(it->second.getUploadTicket()))
+            {
+                ++it;
+                continue;
+            }
+
+            m_meshes.push_back(it->second);
+            auto pending = m_pendingModels.find(it->first);
+            if (pending != m_pendingModels.end())
+            {
+                pending->second.set_value();
+                m_pendingModels.erase(pending);
+            }
+            it = m_uploadingModels.erase(it);
+        }
+
+        // Models that finished decoding.
+        for (auto & streamed : m_streamer->takeCompleted())
+        {
+            auto pending = m_pendingModels.find(streamed.id);
+            if (pending == m_pendingModels.end())
+            {
+                continue;
+            }
+
+            if (!streamed.error)
+            {
+                try
+                {
+                    // Queues the uploads, the model is swapped in once they complete.
+                    m_uploadingModels.emplace_back(streamed.id, Model(streamed.data));
+                    continue;
+                }
+                catch (...)
+                {
+                    streamed.error = std::current_exception();
+                }
+            }
+
+            try
+            {
+                std::rethrow_exception(streamed.error);
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << "Failed to stream model " << streamed.id << ": " << e.what() << std::endl;
+            }
+            catch (...)
+            {
+                std::cerr << "Failed to stream model " << streamed.id << "." << std::endl;
+            }
+            pending->second.set_exception(streamed.error);
+            m_pendingModels.erase(pending);
+        }
+    }
+
+    const std::vector<Light>& Scene::getLights() { return m_lights; }
+    void Scene::setAmbientLight(glm::vec3 color) { m_sceneData.ambientColor = glm::vec4(color, 1.0f); }
+    glm::vec3 Scene::getAmbientLight() { return glm::vec3(m_sceneData.ambientColor); }
 }
@@ -0,0 +1,109 @@
+#include "../include/StagingRing.h"
+#include "../include/LogicalDevice.h"
+#include "../include/Util.h"
+
+#include <vulkan/vulkan.h>
+#include <stdexcept>
+#include <iostream>
+
+namespace KMDM
+{
+    /**
+     * @brief Construct a new Staging Ring:: Staging Ring object
+     *
+     * @param size
+     */
+    StagingRing::StagingRing(VkDeviceSize size)
+    {
+        m_size = size;
+        createBuffer(m_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                     VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                     m_buffer, m_memory, MemoryCategory::Staging);
+
+        // Mapped for the lifetime of the ring.
+        void *mapped;
+        if (vkMapMemory(LogicalDevice::getInstance()->getLogicalDevice(), m_memory, 0, m_size, 0, &mapped)
+            != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to map staging ring.");
+        }
+        m_mapped = static_cast<unsigned char*>(mapped);
+        std::cout << "Created " << (m_size >> 20) << " MiB staging ring." << std::endl;
+    }
+
+    /**
+     * @brief Destroy the Staging Ring:: Staging Ring object
+     *
+     */
+    StagingRing::~StagingRing()
+    {
+        destroyStagingRing();
+    }
+
+    /**
+     * @brief Unmap and free the ring memory.
+     *
+     */
+    void StagingRing::destroyStagingRing()
+    {
+        if (m_buffer == VK_NULL_HANDLE)
+        {
+            return;
+        }
+        std::cout << "- Destroying StagingRing." << std::endl;
+        VkDevice device = LogicalDevice::getInstance()->getLogicalDevice();
+        vkUnmapMemory(device, m_memory);
+        vkDestroyBuffer(device, m_buffer, nullptr);
+        freeMemory(m_memory);
+        m_buffer = VK_NULL_HANDLE;
+        m_memory = VK_NULL_HANDLE;
+        m_mapped = nullptr;
+    }
+
+    /******************************************************************
+        Sub-allocate a contiguous range.  An allocation that does not
+        fit before the end of the buffer skips the remainder and starts
+        again at offset 0.
+    *******************************************************************/
+    bool StagingRing::allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset)
+    {
+        VkDeviceSize head_offset = m_head % m_size;
+        VkDeviceSize aligned = (head_offset + alignment - 1) & ~(alignment - 1);
+        VkDeviceSize padding = aligned - head_offset;
+
+        if (aligned + size > m_size)
+        {
+            // Wrap around.
+            padding = m_size - head_offset;
+            aligned = 0;
+        }
+
+        if (m_head + padding + size - m_tail > m_size)
+        {
+            return false;
+        }
+
+        offset = aligned;
+        m_head += padding + size;
+        return true;
+    } /// allocate
+
+    uint64_t StagingRing::getHead() { return m_head; }
+
+    /**
+     * @brief Free every allocation made before position.
+     *
+     * @param position
+     */
+    void StagingRing::release(uint64_t position)
+    {
+        if (position > m_tail)
+        {
+            m_tail = position;
+        }
+    }
+
+    void* StagingRing::getMappedPointer(VkDeviceSize offset) { return m_mapped + offset; }
+    VkBuffer StagingRing::getBuffer() { return m_buffer; }
+    VkDeviceSize StagingRing::getSize() { return m_size; }
+}
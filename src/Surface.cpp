@@ -29,6 +29,11 @@ namespace KMDM
 
     Surface::Surface()
     {
+        m_VKsurface = VK_NULL_HANDLE;
+        if (Window::isHeadless())
+        {
+            return;
+        }
         if (SDL_Vulkan_CreateSurface(Window::getInstance()->getWindow(),
             Instance::getInstance()->getVulkanInstance(), &m_VKsurface) != SDL_TRUE)
         {
@@ -44,7 +49,10 @@ namespace KMDM
 
     void Surface::destroySurface()
     {
-        vkDestroySurfaceKHR(Instance::getInstance()->getVulkanInstance(), m_VKsurface, nullptr);
+        if (m_VKsurface != VK_NULL_HANDLE)
+        {
+            vkDestroySurfaceKHR(Instance::getInstance()->getVulkanInstance(), m_VKsurface, nullptr);
+        }
         m_surface = nullptr;
         std::cout << "- Cleaning up surface." << std::endl;
     }
@@ -1,11 +1,14 @@
 #include "../include/SwapChain.h"
 #include <vulkan/vulkan.h>
+#include <algorithm>
 #include <stdexcept>
 #include <iostream>
 
 #include "../include/LogicalDevice.h"
 #include "../include/PhysicalDevice.h"
 #include "../include/Surface.h"
+#include "../include/Window.h"
+#include "../include/RenderTargetPool.h"
 #include "../include/types.h"
 #include "Util.h"
 
@@ -38,11 +41,29 @@ namespace KMDM
         m_physicalDevice = PhysicalDevice::getInstance();
         m_logicalDevice = LogicalDevice::getInstance();
         m_surface = Surface::getInstance();
+        m_preferredPresentMode = PRESENT_MODE;
 
+        if (Window::isHeadless())
+        {
+            createOffscreenImages();
+            return;
+        }
         m_swapChainDetails = m_physicalDevice->getSwapChainSupportDetails();
+        createSwapChain(VK_NULL_HANDLE);
+    }
+
+    /******************************************************************
+        Create the swapchain and its image views for the current surface
+        details, handing the old swapchain to the driver so it can reuse
+        its resources and keep presenting the images it already owns.
+    *******************************************************************/
+    void SwapChain::createSwapChain(VkSwapchainKHR old_swapchain)
+    {
         VkSurfaceFormatKHR swformat = chooseSwapSurfaceFormat(m_swapChainDetails.formats);
         VkPresentModeKHR present_mode = chooseSwapPresentationMode(m_swapChainDetails.presentModes);
+        m_presentMode = present_mode;
         m_swapChainExtent = chooseSwapExtent(m_swapChainDetails.capabilities);
+        m_swapChainImageFormat = swformat.format;
 
         // It is better to use 1 more than the minimum image count in the swapchain. If possible.
         uint32_t image_count = m_swapChainDetails.capabilities.minImageCount + 1;
@@ -61,18 +82,25 @@ namespace KMDM
         create_info.imageColorSpace = swformat.colorSpace;
         create_info.imageExtent = m_swapChainExtent;
         create_info.imageArrayLayers = 1; // always 1 unless stereoscopic
-        create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        // The visibility buffer path blits its shaded image into the swap chain, and frames are
+        // read back from it when the surface allows.
+        create_info.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        if (m_swapChainDetails.capabilities.supportedUsageFlags & VK_IMAGE_USAGE_TRANSFER_SRC_BIT)
+        {
+            create_info.imageUsage |= VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        }
+        m_readable = (create_info.imageUsage & VK_IMAGE_USAGE_TRANSFER_SRC_BIT) != 0;
 
         // Handle the queue family indices for the case where graphics and presentation
         // are different, and then when they are the same.
         QueueFamilyInfo queueFamily = m_logicalDevice->getQueueFamilyInfo();
+        uint32_t family_indices[] =
+        {
+            queueFamily.graphicsFamilyIndex.value(),
+            queueFamily.presentationFamilyIndex.value()
+        };
         if (queueFamily.graphicsFamilyIndex.value() != queueFamily.presentationFamilyIndex.value())
         {
-            uint32_t family_indices[] =
-            {
-                queueFamily.graphicsFamilyIndex.value(),
-                queueFamily.presentationFamilyIndex.value()
-            };
             create_info.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
             create_info.queueFamilyIndexCount = 2;
             create_info.pQueueFamilyIndices = family_indices;
@@ -87,7 +115,7 @@ namespace KMDM
         create_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
         create_info.presentMode = present_mode;
         create_info.clipped = VK_TRUE;
-        create_info.oldSwapchain = VK_NULL_HANDLE;
+        create_info.oldSwapchain = old_swapchain;
         if (vkCreateSwapchainKHR(m_logicalDevice->getLogicalDevice(), &create_info, nullptr, &m_VKswapChain) != VK_SUCCESS)
         {
             throw std::runtime_error("Failed to create swapchain.");
@@ -113,7 +141,109 @@ namespace KMDM
                 VK_IMAGE_ASPECT_COLOR_BIT, 1);
             std::cout << "Created swapchain imageview: " << i << std::endl;
         }        
-    }
+    } /// createSwapChain
+
+    /******************************************************************
+        Create the images headless frames are drawn to in place of the
+        swapchain's.  They are used round robin, one more than there are
+        frames in flight, and never change size.
+    *******************************************************************/
+    void SwapChain::createOffscreenImages()
+    {
+        VkFormatFeatureFlags features = VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT |
+            VK_FORMAT_FEATURE_TRANSFER_SRC_BIT;
+        m_swapChainImageFormat = VK_FORMAT_B8G8R8A8_SRGB;
+        if (!m_physicalDevice->isFormatSupported(m_swapChainImageFormat, VK_IMAGE_TILING_OPTIMAL, features))
+        {
+            m_swapChainImageFormat = VK_FORMAT_R8G8B8A8_SRGB;
+        }
+        ExtentSize size = Window::getInstance()->getWindowSize();
+        m_swapChainExtent = { static_cast<uint32_t>(size.width), static_cast<uint32_t>(size.height) };
+        m_presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+        m_readable = true;
+
+        uint32_t image_count = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT) + 1;
+        m_swapChainImages.resize(image_count);
+        m_swapChainImageViews.resize(image_count);
+        m_offscreenMemory.resize(image_count);
+        for (uint32_t i = 0; i < image_count; i++)
+        {
+            createImage(m_swapChainExtent.width, m_swapChainExtent.height, 1, m_swapChainImageFormat,
+                VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT |
+                VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_swapChainImages[i],
+                m_offscreenMemory[i], MemoryCategory::RenderTarget);
+            m_swapChainImageViews[i] = createImageView(m_swapChainImages[i], m_swapChainImageFormat,
+                VK_IMAGE_ASPECT_COLOR_BIT, 1);
+        }
+        std::cout << "Created " << image_count << " offscreen images." << std::endl;
+    } /// createOffscreenImages
+
+    /******************************************************************
+        Recreate the offscreen images at the headless size, when it has
+        changed.  The old ones are destroyed once the frames in flight
+        are done with them.
+    *******************************************************************/
+    bool SwapChain::recreateOffscreenImages()
+    {
+        ExtentSize size = Window::getInstance()->getWindowSize();
+        if (size.width <= 0 || size.height <= 0 ||
+            (static_cast<uint32_t>(size.width) == m_swapChainExtent.width &&
+             static_cast<uint32_t>(size.height) == m_swapChainExtent.height))
+        {
+            return false;
+        }
+
+        VkDevice device = m_logicalDevice->getLogicalDevice();
+        std::vector<VkImage> old_images = m_swapChainImages;
+        std::vector<VkImageView> old_views = m_swapChainImageViews;
+        std::vector<VkDeviceMemory> old_memory = m_offscreenMemory;
+        RenderTargetPool::getInstance()->retire([device, old_images, old_views, old_memory]()
+        {
+            for (size_t i = 0; i < old_images.size(); i++)
+            {
+                vkDestroyImageView(device, old_views[i], nullptr);
+                vkDestroyImage(device, old_images[i], nullptr);
+                freeMemory(old_memory[i]);
+            }
+        });
+        createOffscreenImages();
+        return true;
+    } /// recreateOffscreenImages
+
+    /******************************************************************
+        Recreate the swapchain for the current window size.  The old
+        swapchain and its views are destroyed once the frames in flight
+        are done with them, so nothing waits for the device.
+    *******************************************************************/
+    bool SwapChain::recreateSwapChain()
+    {
+        if (Window::isHeadless())
+        {
+            return recreateOffscreenImages();
+        }
+        m_swapChainDetails = querySwapChainSupport();
+        VkExtent2D extent = chooseSwapExtent(m_swapChainDetails.capabilities);
+        if (extent.width == 0 || extent.height == 0)
+        {
+            // Minimized, there is nothing to present to.
+            return false;
+        }
+
+        VkSwapchainKHR old_swapchain = m_VKswapChain;
+        std::vector<VkImageView> old_views = m_swapChainImageViews;
+        createSwapChain(old_swapchain);
+
+        VkDevice device = m_logicalDevice->getLogicalDevice();
+        RenderTargetPool::getInstance()->retire([device, old_swapchain, old_views]()
+        {
+            for (auto & view : old_views)
+            {
+                vkDestroyImageView(device, view, nullptr);
+            }
+            vkDestroySwapchainKHR(device, old_swapchain, nullptr);
+        });
+        return true;
+    } /// recreateSwapChain
 
     /**
      * @brief Destory the SwapChain.
@@ -127,6 +257,12 @@ namespace KMDM
             {
                 vkDestroyImageView(m_logicalDevice->getLogicalDevice(), m_swapChainImageViews[i], nullptr);
             }
+            for (size_t i = 0; i < m_offscreenMemory.size(); i++)
+            {
+                vkDestroyImage(m_logicalDevice->getLogicalDevice(), m_swapChainImages[i], nullptr);
+                freeMemory(m_offscreenMemory[i]);
+            }
+            m_offscreenMemory.clear();
             vkDestroySwapchainKHR(m_logicalDevice->getLogicalDevice(), m_VKswapChain, nullptr);
         }
         std::cout << "- Cleaning up SwapChain." << std::endl;
@@ -198,14 +334,14 @@ namespace KMDM
 /******************************************************************************/
     /******************************************************************
         Choose the presentation mode.
-            - VK_PRESENT_MODE_MAILBOX_KHR if available.
-            - VK_PRESENT_MODE_FIFO_KHR otherwise.
+            - The preferred mode if available.
+            - VK_PRESENT_MODE_FIFO_KHR otherwise, it always is.
     *******************************************************************/
     VkPresentModeKHR SwapChain::chooseSwapPresentationMode(const std::vector<VkPresentModeKHR>& available_modes)
     {
         for (auto & pres_mode : available_modes)
         {
-            if (pres_mode == VK_PRESENT_MODE_MAILBOX_KHR)
+            if (pres_mode == m_preferredPresentMode)
             {
                 return pres_mode;
             }
@@ -234,11 +370,11 @@ namespace KMDM
                 static_cast<uint32_t>(eSize.height)
             };
 
-            actual_extent.width = std::max(capabilities.maxImageExtent.width,
-                std::min(capabilities.maxImageExtent.width, actual_extent.width));
+            actual_extent.width = std::clamp(actual_extent.width, capabilities.minImageExtent.width,
+                capabilities.maxImageExtent.width);
 
-            actual_extent.height = std::max(capabilities.maxImageExtent.height,
-                std::min(capabilities.maxImageExtent.height, capabilities.maxImageExtent.height));
+            actual_extent.height = std::clamp(actual_extent.height, capabilities.minImageExtent.height,
+                capabilities.maxImageExtent.height);
 
             return actual_extent;
         }
@@ -259,5 +395,27 @@ namespace KMDM
     {
         return m_swapChainExtent;
     }
+/******************************************************************************/
+    void SwapChain::setPresentMode(VkPresentModeKHR mode)
+    {
+        m_preferredPresentMode = mode;
+    }
+/******************************************************************************/
+    VkPresentModeKHR SwapChain::getPresentMode()
+    {
+        return m_presentMode;
+    }
+
+/******************************************************************************/
+    VkImageLayout SwapChain::getPresentLayout()
+    {
+        return Window::isHeadless() ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+    }
+
+/******************************************************************************/
+    bool SwapChain::isReadable()
+    {
+        return m_readable;
+    }
 
 }
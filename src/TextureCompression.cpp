@@ -0,0 +1,727 @@
+#include "../include/TextureCompression.h"
+#include "../include/WorkerPool.h"
+
+#include <vulkan/vulkan.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <vector>
+
+namespace KMDM
+{
+    namespace
+    {
+        // Interpolation weights of the BC7 4 bit indices.
+        const int BC7_WEIGHTS[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+        typedef void (*BlockCodec)(const unsigned char*, unsigned char*);
+
+        bool isSrgb(VkFormat format)
+        {
+            return format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_BC1_RGB_SRGB_BLOCK ||
+                   format == VK_FORMAT_BC1_RGBA_SRGB_BLOCK || format == VK_FORMAT_BC3_SRGB_BLOCK ||
+                   format == VK_FORMAT_BC7_SRGB_BLOCK;
+        }
+
+        /******************************************************************
+            Texel block size of the formats the texture pipeline handles.
+        *******************************************************************/
+        bool lookupBlockInfo(VkFormat format, uint32_t& block_width, uint32_t& block_height, uint32_t& block_bytes)
+        {
+            switch (format)
+            {
+                case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+                case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+                case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+                case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+                    block_width = 4;
+                    block_height = 4;
+                    block_bytes = 8;
+                    return true;
+                case VK_FORMAT_BC3_UNORM_BLOCK:
+                case VK_FORMAT_BC3_SRGB_BLOCK:
+                case VK_FORMAT_BC5_UNORM_BLOCK:
+                case VK_FORMAT_BC7_UNORM_BLOCK:
+                case VK_FORMAT_BC7_SRGB_BLOCK:
+                    block_width = 4;
+                    block_height = 4;
+                    block_bytes = 16;
+                    return true;
+                case VK_FORMAT_R8G8B8A8_UNORM:
+                case VK_FORMAT_R8G8B8A8_SRGB:
+                    block_width = 1;
+                    block_height = 1;
+                    block_bytes = 4;
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        /******************************************************************
+            Copy a 4x4 block out of an RGBA8 image.  Blocks that hang over
+            the edge repeat the last row / column.
+        *******************************************************************/
+        void fetchBlock(const unsigned char* rgba, uint32_t width, uint32_t height,
+            uint32_t block_x, uint32_t block_y, unsigned char* block)
+        {
+            for (uint32_t y = 0; y < 4; y++)
+            {
+                uint32_t src_y = std::min(block_y * 4 + y, height - 1);
+                for (uint32_t x = 0; x < 4; x++)
+                {
+                    uint32_t src_x = std::min(block_x * 4 + x, width - 1);
+                    memcpy(block + (y * 4 + x) * 4, rgba + (static_cast<size_t>(src_y) * width + src_x) * 4, 4);
+                }
+            }
+        }
+
+        /******************************************************************
+            Write the texels of a decoded block that are inside the image.
+        *******************************************************************/
+        void storeBlock(const unsigned char* block, uint32_t width, uint32_t height,
+            uint32_t block_x, uint32_t block_y, unsigned char* rgba)
+        {
+            for (uint32_t y = 0; y < 4 && block_y * 4 + y < height; y++)
+            {
+                for (uint32_t x = 0; x < 4 && block_x * 4 + x < width; x++)
+                {
+                    size_t dst = (static_cast<size_t>(block_y * 4 + y) * width + block_x * 4 + x) * 4;
+                    memcpy(rgba + dst, block + (y * 4 + x) * 4, 4);
+                }
+            }
+        }
+
+        /******************************************************************
+            Pick two endpoints along the principal axis of the block's
+            colours, spanning every texel.
+        *******************************************************************/
+        void findEndpoints(const unsigned char* rgba, int channels, float* low, float* high)
+        {
+            float mean[4] = {};
+            for (int i = 0; i < 16; i++)
+            {
+                for (int c = 0; c < channels; c++)
+                {
+                    mean[c] += rgba[i * 4 + c];
+                }
+            }
+            for (int c = 0; c < channels; c++)
+            {
+                mean[c] /= 16.0f;
+            }
+
+            float covariance[4][4] = {};
+            for (int i = 0; i < 16; i++)
+            {
+                float d[4];
+                for (int c = 0; c < channels; c++)
+                {
+                    d[c] = rgba[i * 4 + c] - mean[c];
+                }
+                for (int a = 0; a < channels; a++)
+                {
+                    for (int b = 0; b < channels; b++)
+                    {
+                        covariance[a][b] += d[a] * d[b];
+                    }
+                }
+            }
+
+            // Power iteration, starting from the channel with the most variance.
+            float axis[4] = {};
+            int start = 0;
+            for (int c = 1; c < channels; c++)
+            {
+                if (covariance[c][c] > covariance[start][start])
+                {
+                    start = c;
+                }
+            }
+            axis[start] = 1.0f;
+            for (int iteration = 0; iteration < 8; iteration++)
+            {
+                float next[4] = {};
+                float length = 0.0f;
+                for (int a = 0; a < channels; a++)
+                {
+                    for (int b = 0; b < channels; b++)
+                    {
+                        next[a] += covariance[a][b] * axis[b];
+                    }
+                    length += next[a] * next[a];
+                }
+                length = std::sqrt(length);
+                if (length < 1e-6f)
+                {
+                    break;
+                }
+                for (int c = 0; c < channels; c++)
+                {
+                    axis[c] = next[c] / length;
+                }
+            }
+
+            float min_t = 0.0f;
+            float max_t = 0.0f;
+            for (int i = 0; i < 16; i++)
+            {
+                float t = 0.0f;
+                for (int c = 0; c < channels; c++)
+                {
+                    t += (rgba[i * 4 + c] - mean[c]) * axis[c];
+                }
+                min_t = std::min(min_t, t);
+                max_t = std::max(max_t, t);
+            }
+
+            for (int c = 0; c < channels; c++)
+            {
+                low[c] = std::clamp(mean[c] + min_t * axis[c], 0.0f, 255.0f);
+                high[c] = std::clamp(mean[c] + max_t * axis[c], 0.0f, 255.0f);
+            }
+        }
+
+        uint16_t packRGB565(const float* color)
+        {
+            int r = std::clamp(static_cast<int>(std::lround(color[0] * 31.0f / 255.0f)), 0, 31);
+            int g = std::clamp(static_cast<int>(std::lround(color[1] * 63.0f / 255.0f)), 0, 63);
+            int b = std::clamp(static_cast<int>(std::lround(color[2] * 31.0f / 255.0f)), 0, 31);
+            return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+        }
+
+        void unpackRGB565(uint16_t packed, int* color)
+        {
+            int r = (packed >> 11) & 31;
+            int g = (packed >> 5) & 63;
+            int b = packed & 31;
+            color[0] = (r << 3) | (r >> 2);
+            color[1] = (g << 2) | (g >> 4);
+            color[2] = (b << 3) | (b >> 2);
+        }
+
+        /******************************************************************
+            BC1 style colour block, always in 4 colour mode.
+        *******************************************************************/
+        void encodeColor(const unsigned char* rgba, unsigned char* block)
+        {
+            float low[4];
+            float high[4];
+            findEndpoints(rgba, 3, low, high);
+
+            uint16_t c0 = packRGB565(high);
+            uint16_t c1 = packRGB565(low);
+            if (c0 < c1)
+            {
+                std::swap(c0, c1);
+            }
+
+            uint32_t indices = 0;
+            if (c0 != c1)
+            {
+                int p0[3];
+                int p1[3];
+                unpackRGB565(c0, p0);
+                unpackRGB565(c1, p1);
+
+                int palette[4][3];
+                for (int c = 0; c < 3; c++)
+                {
+                    palette[0][c] = p0[c];
+                    palette[1][c] = p1[c];
+                    palette[2][c] = (2 * p0[c] + p1[c]) / 3;
+                    palette[3][c] = (p0[c] + 2 * p1[c]) / 3;
+                }
+
+                for (int i = 0; i < 16; i++)
+                {
+                    int best = 0;
+                    int best_error = std::numeric_limits<int>::max();
+                    for (int p = 0; p < 4; p++)
+                    {
+                        int error = 0;
+                        for (int c = 0; c < 3; c++)
+                        {
+                            int d = rgba[i * 4 + c] - palette[p][c];
+                            error += d * d;
+                        }
+                        if (error < best_error)
+                        {
+                            best_error = error;
+                            best = p;
+                        }
+                    }
+                    indices |= static_cast<uint32_t>(best) << (2 * i);
+                }
+            }
+
+            block[0] = static_cast<unsigned char>(c0 & 0xFF);
+            block[1] = static_cast<unsigned char>(c0 >> 8);
+            block[2] = static_cast<unsigned char>(c1 & 0xFF);
+            block[3] = static_cast<unsigned char>(c1 >> 8);
+            for (int k = 0; k < 4; k++)
+            {
+                block[4 + k] = static_cast<unsigned char>((indices >> (8 * k)) & 0xFF);
+            }
+        }
+
+        /******************************************************************
+            BC4 style single channel block, always in 8 value mode.
+        *******************************************************************/
+        void encodeChannel(const unsigned char* rgba, int channel, unsigned char* block)
+        {
+            int low = 255;
+            int high = 0;
+            for (int i = 0; i < 16; i++)
+            {
+                low = std::min(low, static_cast<int>(rgba[i * 4 + channel]));
+                high = std::max(high, static_cast<int>(rgba[i * 4 + channel]));
+            }
+            block[0] = static_cast<unsigned char>(high);
+            block[1] = static_cast<unsigned char>(low);
+
+            uint64_t indices = 0;
+            if (high != low)
+            {
+                int palette[8];
+                palette[0] = high;
+                palette[1] = low;
+                for (int j = 2; j < 8; j++)
+                {
+                    palette[j] = ((8 - j) * high + (j - 1) * low) / 7;
+                }
+
+                for (int i = 0; i < 16; i++)
+                {
+                    int value = rgba[i * 4 + channel];
+                    int best = 0;
+                    for (int p = 1; p < 8; p++)
+                    {
+                        if (std::abs(value - palette[p]) < std::abs(value - palette[best]))
+                        {
+                            best = p;
+                        }
+                    }
+                    indices |= static_cast<uint64_t>(best) << (3 * i);
+                }
+            }
+            for (int k = 0; k < 6; k++)
+            {
+                block[2 + k] = static_cast<unsigned char>((indices >> (8 * k)) & 0xFF);
+            }
+        }
+
+        void decodeColor(const unsigned char* block, unsigned char* rgba, bool four_color)
+        {
+            uint16_t c0 = static_cast<uint16_t>(block[0] | (block[1] << 8));
+            uint16_t c1 = static_cast<uint16_t>(block[2] | (block[3] << 8));
+            int p0[3];
+            int p1[3];
+            unpackRGB565(c0, p0);
+            unpackRGB565(c1, p1);
+
+            int palette[4][4];
+            for (int c = 0; c < 3; c++)
+            {
+                palette[0][c] = p0[c];
+                palette[1][c] = p1[c];
+                if (four_color || c0 > c1)
+                {
+                    palette[2][c] = (2 * p0[c] + p1[c]) / 3;
+                    palette[3][c] = (p0[c] + 2 * p1[c]) / 3;
+                }
+                else
+                {
+                    palette[2][c] = (p0[c] + p1[c]) / 2;
+                    palette[3][c] = 0;
+                }
+            }
+            palette[0][3] = 255;
+            palette[1][3] = 255;
+            palette[2][3] = 255;
+            palette[3][3] = (four_color || c0 > c1) ? 255 : 0;
+
+            uint32_t indices = block[4] | (block[5] << 8) | (block[6] << 16) | (static_cast<uint32_t>(block[7]) << 24);
+            for (int i = 0; i < 16; i++)
+            {
+                int index = (indices >> (2 * i)) & 3;
+                for (int c = 0; c < 4; c++)
+                {
+                    rgba[i * 4 + c] = static_cast<unsigned char>(palette[index][c]);
+                }
+            }
+        }
+
+        void decodeChannel(const unsigned char* block, unsigned char* rgba, int channel)
+        {
+            int a0 = block[0];
+            int a1 = block[1];
+            int palette[8];
+            palette[0] = a0;
+            palette[1] = a1;
+            if (a0 > a1)
+            {
+                for (int j = 2; j < 8; j++)
+                {
+                    palette[j] = ((8 - j) * a0 + (j - 1) * a1) / 7;
+                }
+            }
+            else
+            {
+                for (int j = 2; j < 6; j++)
+                {
+                    palette[j] = ((6 - j) * a0 + (j - 1) * a1) / 5;
+                }
+                palette[6] = 0;
+                palette[7] = 255;
+            }
+
+            uint64_t indices = 0;
+            for (int k = 0; k < 6; k++)
+            {
+                indices |= static_cast<uint64_t>(block[2 + k]) << (8 * k);
+            }
+            for (int i = 0; i < 16; i++)
+            {
+                rgba[i * 4 + channel] = static_cast<unsigned char>(palette[(indices >> (3 * i)) & 7]);
+            }
+        }
+
+        void writeBits(unsigned char* block, size_t& bit, uint32_t value, int count)
+        {
+            for (int k = 0; k < count; k++, bit++)
+            {
+                if ((value >> k) & 1)
+                {
+                    block[bit / 8] |= static_cast<unsigned char>(1 << (bit % 8));
+                }
+            }
+        }
+
+        /******************************************************************
+            Run a block codec over every block of every mip level, with
+            rows of blocks spread over the shared worker pool.
+        *******************************************************************/
+        void transcode(const TextureData& src, TextureData& dst, BlockCodec codec, bool encode)
+        {
+            uint32_t src_bw, src_bh, src_bytes;
+            uint32_t dst_bw, dst_bh, dst_bytes;
+            getFormatBlockInfo(src.format, src_bw, src_bh, src_bytes);
+            getFormatBlockInfo(dst.format, dst_bw, dst_bh, dst_bytes);
+            uint32_t block_bytes = encode ? dst_bytes : src_bytes;
+
+            dst.width = src.width;
+            dst.height = src.height;
+            dst.mips.clear();
+            for (auto & mip : src.mips)
+            {
+                TextureMip out = {};
+                out.offset = dst.data.size();
+                out.size = getMipSize(dst.format, mip.width, mip.height);
+                out.width = mip.width;
+                out.height = mip.height;
+                dst.mips.push_back(out);
+                dst.data.resize(out.offset + out.size);
+            }
+
+            struct Row
+            {
+                size_t mip;
+                uint32_t blockY;
+            };
+            std::vector<Row> rows;
+            for (size_t m = 0; m < src.mips.size(); m++)
+            {
+                for (uint32_t y = 0; y < (src.mips[m].height + 3) / 4; y++)
+                {
+                    rows.push_back({ m, y });
+                }
+            }
+
+            WorkerPool::getInstance()->parallelFor(static_cast<uint32_t>(rows.size()), [&](uint32_t r)
+            {
+                unsigned char texels[64];
+                const TextureMip& src_mip = src.mips[rows[r].mip];
+                const TextureMip& dst_mip = dst.mips[rows[r].mip];
+                uint32_t blocks_x = (src_mip.width + 3) / 4;
+                uint32_t block_y = rows[r].blockY;
+                for (uint32_t block_x = 0; block_x < blocks_x; block_x++)
+                {
+                    size_t block_offset = (static_cast<size_t>(block_y) * blocks_x + block_x) * block_bytes;
+                    if (encode)
+                    {
+                        fetchBlock(src.data.data() + src_mip.offset, src_mip.width, src_mip.height, block_x, block_y, texels);
+                        codec(texels, dst.data.data() + dst_mip.offset + block_offset);
+                    }
+                    else
+                    {
+                        codec(src.data.data() + src_mip.offset + block_offset, texels);
+                        storeBlock(texels, dst_mip.width, dst_mip.height, block_x, block_y, dst.data.data() + dst_mip.offset);
+                    }
+                }
+            });
+        }
+    }
+
+    bool isBlockCompressed(VkFormat format)
+    {
+        uint32_t block_width, block_height, block_bytes;
+        return lookupBlockInfo(format, block_width, block_height, block_bytes) && block_width > 1;
+    }
+
+    bool isTextureFormatHandled(VkFormat format)
+    {
+        uint32_t block_width, block_height, block_bytes;
+        return lookupBlockInfo(format, block_width, block_height, block_bytes);
+    }
+
+    void getFormatBlockInfo(VkFormat format, uint32_t& block_width, uint32_t& block_height, uint32_t& block_bytes)
+    {
+        if (!lookupBlockInfo(format, block_width, block_height, block_bytes))
+        {
+            throw std::runtime_error("Unsupported texture format.");
+        }
+    }
+
+    size_t getMipSize(VkFormat format, uint32_t width, uint32_t height)
+    {
+        uint32_t block_width, block_height, block_bytes;
+        getFormatBlockInfo(format, block_width, block_height, block_bytes);
+        size_t blocks_x = (width + block_width - 1) / block_width;
+        size_t blocks_y = (height + block_height - 1) / block_height;
+        return blocks_x * blocks_y * block_bytes;
+    }
+
+    /******************************************************************
+        Compress an RGBA8 texture.
+    *******************************************************************/
+    TextureData compressTexture(const TextureData& texture, VkFormat format)
+    {
+        if (texture.format != VK_FORMAT_R8G8B8A8_UNORM && texture.format != VK_FORMAT_R8G8B8A8_SRGB)
+        {
+            throw std::runtime_error("Only RGBA8 textures can be compressed.");
+        }
+
+        BlockCodec codec = nullptr;
+        switch (format)
+        {
+            case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+            case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+                codec = encodeBC1Block;
+                break;
+            case VK_FORMAT_BC3_UNORM_BLOCK:
+            case VK_FORMAT_BC3_SRGB_BLOCK:
+                codec = encodeBC3Block;
+                break;
+            case VK_FORMAT_BC5_UNORM_BLOCK:
+                codec = encodeBC5Block;
+                break;
+            case VK_FORMAT_BC7_UNORM_BLOCK:
+            case VK_FORMAT_BC7_SRGB_BLOCK:
+                codec = encodeBC7Block;
+                break;
+            default:
+                throw std::runtime_error("Unsupported compressed texture format.");
+        }
+
+        TextureData compressed;
+        compressed.format = format;
+        transcode(texture, compressed, codec, true);
+        return compressed;
+    } /// compressTexture
+
+    bool canDecompressTexture(VkFormat format)
+    {
+        switch (format)
+        {
+            case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+            case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+            case VK_FORMAT_BC3_UNORM_BLOCK:
+            case VK_FORMAT_BC3_SRGB_BLOCK:
+            case VK_FORMAT_BC5_UNORM_BLOCK:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    /******************************************************************
+        Decode a BC1/BC3/BC5 texture to RGBA8.
+    *******************************************************************/
+    TextureData decompressTexture(const TextureData& texture)
+    {
+        BlockCodec codec = nullptr;
+        switch (texture.format)
+        {
+            case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+            case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+                codec = decodeBC1Block;
+                break;
+            case VK_FORMAT_BC3_UNORM_BLOCK:
+            case VK_FORMAT_BC3_SRGB_BLOCK:
+                codec = decodeBC3Block;
+                break;
+            case VK_FORMAT_BC5_UNORM_BLOCK:
+                codec = decodeBC5Block;
+                break;
+            default:
+                throw std::runtime_error("No CPU decoder for texture format.");
+        }
+
+        TextureData decoded;
+        decoded.format = isSrgb(texture.format) ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+        transcode(texture, decoded, codec, false);
+        return decoded;
+    } /// decompressTexture
+
+    void encodeBC1Block(const unsigned char* rgba, unsigned char* block)
+    {
+        encodeColor(rgba, block);
+    }
+
+    void encodeBC3Block(const unsigned char* rgba, unsigned char* block)
+    {
+        encodeChannel(rgba, 3, block);
+        encodeColor(rgba, block + 8);
+    }
+
+    void encodeBC5Block(const unsigned char* rgba, unsigned char* block)
+    {
+        encodeChannel(rgba, 0, block);
+        encodeChannel(rgba, 1, block + 8);
+    }
+
+    /******************************************************************
+        BC7 mode 6: one subset, 7 bit RGBA endpoints with a shared
+        p-bit each and 4 bit indices.  Every p-bit combination is tried
+        and the one with the lowest error kept.
+    *******************************************************************/
+    void encodeBC7Block(const unsigned char* rgba, unsigned char* block)
+    {
+        float low[4];
+        float high[4];
+        findEndpoints(rgba, 4, low, high);
+
+        int best_q[2][4] = {};
+        int best_p[2] = {};
+        int best_indices[16] = {};
+        long best_error = std::numeric_limits<long>::max();
+
+        for (int p0 = 0; p0 < 2; p0++)
+        {
+            for (int p1 = 0; p1 < 2; p1++)
+            {
+                int q[2][4];
+                int endpoint[2][4];
+                for (int c = 0; c < 4; c++)
+                {
+                    q[0][c] = std::clamp(static_cast<int>(std::lround((low[c] - p0) / 2.0f)), 0, 127);
+                    q[1][c] = std::clamp(static_cast<int>(std::lround((high[c] - p1) / 2.0f)), 0, 127);
+                    endpoint[0][c] = (q[0][c] << 1) | p0;
+                    endpoint[1][c] = (q[1][c] << 1) | p1;
+                }
+
+                int palette[16][4];
+                for (int w = 0; w < 16; w++)
+                {
+                    for (int c = 0; c < 4; c++)
+                    {
+                        palette[w][c] = ((64 - BC7_WEIGHTS[w]) * endpoint[0][c] + BC7_WEIGHTS[w] * endpoint[1][c] + 32) >> 6;
+                    }
+                }
+
+                long error = 0;
+                int indices[16];
+                for (int i = 0; i < 16; i++)
+                {
+                    int best = 0;
+                    int best_texel_error = std::numeric_limits<int>::max();
+                    for (int w = 0; w < 16; w++)
+                    {
+                        int texel_error = 0;
+                        for (int c = 0; c < 4; c++)
+                        {
+                            int d = rgba[i * 4 + c] - palette[w][c];
+                            texel_error += d * d;
+                        }
+                        if (texel_error < best_texel_error)
+                        {
+                            best_texel_error = texel_error;
+                            best = w;
+                        }
+                    }
+                    indices[i] = best;
+                    error += best_texel_error;
+                }
+
+                if (error < best_error)
+                {
+                    best_error = error;
+                    memcpy(best_q, q, sizeof(q));
+                    best_p[0] = p0;
+                    best_p[1] = p1;
+                    memcpy(best_indices, indices, sizeof(indices));
+                }
+            }
+        }
+
+        // The anchor index is stored without its top bit, so it has to be below 8.
+        if (best_indices[0] & 8)
+        {
+            for (int c = 0; c < 4; c++)
+            {
+                std::swap(best_q[0][c], best_q[1][c]);
+            }
+            std::swap(best_p[0], best_p[1]);
+            for (int i = 0; i < 16; i++)
+            {
+                best_indices[i] = 15 - best_indices[i];
+            }
+        }
+
+        memset(block, 0, 16);
+        size_t bit = 0;
+        writeBits(block, bit, 1u << 6, 7);
+        for (int c = 0; c < 4; c++)
+        {
+            writeBits(block, bit, best_q[0][c], 7);
+            writeBits(block, bit, best_q[1][c], 7);
+        }
+        writeBits(block, bit, best_p[0], 1);
+        writeBits(block, bit, best_p[1], 1);
+        for (int i = 0; i < 16; i++)
+        {
+            writeBits(block, bit, best_indices[i], i == 0 ? 3 : 4);
+        }
+    } /// encodeBC7Block
+
+    void decodeBC1Block(const unsigned char* block, unsigned char* rgba)
+    {
+        decodeColor(block, rgba, false);
+    }
+
+    void decodeBC3Block(const unsigned char* block, unsigned char* rgba)
+    {
+        decodeColor(block + 8, rgba, true);
+        decodeChannel(block, rgba, 3);
+    }
+
+    void decodeBC5Block(const unsigned char* block, unsigned char* rgba)
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            rgba[i * 4 + 2] = 0;
+            rgba[i * 4 + 3] = 255;
+        }
+        decodeChannel(block, rgba, 0);
+        decodeChannel(block + 8, rgba, 1);
+    }
+}
@@ -0,0 +1,379 @@
+#include "../include/TextureResidency.h"
+#include "../include/LogicalDevice.h"
+#include "../include/UploadManager.h"
+#include "../include/Util.h"
+
+#include <vulkan/vulkan.h>
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+
+namespace KMDM
+{
+    TextureResidency* TextureResidency::m_textureResidency = nullptr;
+
+    /**
+     * @brief Get the Instance object
+     *
+     * @return TextureResidency*
+     */
+    TextureResidency* TextureResidency::getInstance()
+    {
+        if (!m_textureResidency)
+        {
+            m_textureResidency = new TextureResidency();
+        }
+        return m_textureResidency;
+    }
+
+    TextureResidency::TextureResidency()
+    {
+        std::cout << "Created texture residency with a budget of " << (m_budget >> 20) << " MB." << std::endl;
+    }
+
+    TextureResidency::~TextureResidency()
+    {
+        destroyTextureResidency();
+    }
+
+    /**
+     * @brief Wait for the device and destroy every texture image.
+     *
+     */
+    void TextureResidency::destroyTextureResidency()
+    {
+        std::cout << "- Destroying TextureResidency." << std::endl;
+        vkDeviceWaitIdle(LogicalDevice::getInstance()->getLogicalDevice());
+
+        for (auto & retired : m_retired)
+        {
+            destroyImage(retired.image);
+        }
+        m_retired.clear();
+
+        for (auto & entry : m_textures)
+        {
+            destroyImage(entry.second.resident);
+            if (entry.second.streaming)
+            {
+                destroyImage(entry.second.incoming);
+            }
+        }
+        m_textures.clear();
+        m_committedBytes = 0;
+        m_textureResidency = nullptr;
+    }
+
+    /******************************************************************
+        Register a texture.  Only the levels no larger than
+        TEXTURE_TAIL_SIZE are uploaded, the rest are streamed in once
+        something asks for them.
+    *******************************************************************/
+    uint32_t TextureResidency::registerTexture(const TextureData& data)
+    {
+        Texture texture = {};
+        texture.data = std::make_shared<const TextureData>(data);
+
+        uint32_t last = static_cast<uint32_t>(data.mips.size()) - 1;
+        texture.tailMip = last;
+        for (uint32_t mip = 0; mip < last; mip++)
+        {
+            if (std::max(data.mips[mip].width, data.mips[mip].height) <= TEXTURE_TAIL_SIZE)
+            {
+                texture.tailMip = mip;
+                break;
+            }
+        }
+        texture.requestedMip = texture.tailMip;
+        texture.lastUsedFrame = m_frame;
+
+        texture.resident = createResidentImage(*texture.data, texture.tailMip);
+        m_committedBytes += texture.resident.bytes;
+
+        uint32_t id = m_nextId++;
+        m_textures.emplace(id, std::move(texture));
+        return id;
+    } /// registerTexture
+
+    /**
+     * @brief Destroy a texture once the GPU is done with it.
+     *
+     * @param id
+     */
+    void TextureResidency::releaseTexture(uint32_t id)
+    {
+        auto it = m_textures.find(id);
+        if (it == m_textures.end())
+        {
+            return;
+        }
+
+        Texture& texture = it->second;
+        m_committedBytes -= texture.streaming ? texture.incoming.bytes : texture.resident.bytes;
+        retireImage(texture.resident);
+        if (texture.streaming)
+        {
+            retireImage(texture.incoming);
+        }
+        m_textures.erase(it);
+    }
+
+    void TextureResidency::requestMip(uint32_t id, uint32_t mip)
+    {
+        Texture& texture = m_textures.at(id);
+        texture.requestedMip = std::min(texture.requestedMip, mip);
+        texture.lastUsedFrame = m_frame;
+    }
+
+    /******************************************************************
+        One texel per pixel: every halving of the on screen size drops
+        one level.
+    *******************************************************************/
+    uint32_t TextureResidency::computeRequiredMip(uint32_t id, float projected_pixels)
+    {
+        const Texture& texture = m_textures.at(id);
+        float size = static_cast<float>(std::max(texture.data->width, texture.data->height));
+        float mip = std::floor(std::log2(size / std::max(projected_pixels, 1.0f)));
+        return static_cast<uint32_t>(std::clamp(mip, 0.0f, static_cast<float>(texture.tailMip)));
+    } /// computeRequiredMip
+
+    /******************************************************************
+        Per frame residency work.
+    *******************************************************************/
+    void TextureResidency::update()
+    {
+        UploadManager* uploads = UploadManager::getInstance();
+
+        // Swap in the streams whose uploads are done.
+        for (auto & entry : m_textures)
+        {
+            Texture& texture = entry.second;
+            if (texture.streaming && uploads->isComplete(texture.incoming.ticket))
+            {
+                retireImage(texture.resident);
+                texture.resident = texture.incoming;
+                texture.incoming = {};
+                texture.streaming = false;
+            }
+        }
+
+        // Destroy the images that no frame in flight can still read.
+        while (!m_retired.empty() && m_retired.front().frame + MAX_FRAMES_IN_FLIGHT < m_frame &&
+               uploads->isComplete(m_retired.front().image.ticket))
+        {
+            destroyImage(m_retired.front().image);
+            m_retired.pop_front();
+        }
+
+        // Textures that need finer levels, the most recently used and most detailed first.
+        std::vector<uint32_t> wanted;
+        for (auto & entry : m_textures)
+        {
+            if (!entry.second.streaming && entry.second.requestedMip < entry.second.resident.mip)
+            {
+                wanted.push_back(entry.first);
+            }
+        }
+        std::sort(wanted.begin(), wanted.end(), [this](uint32_t a, uint32_t b)
+        {
+            const Texture& ta = m_textures.at(a);
+            const Texture& tb = m_textures.at(b);
+            if (ta.lastUsedFrame != tb.lastUsedFrame)
+            {
+                return ta.lastUsedFrame > tb.lastUsedFrame;
+            }
+            return ta.requestedMip < tb.requestedMip;
+        });
+
+        uint32_t started = 0;
+        for (uint32_t id : wanted)
+        {
+            if (started == TEXTURE_STREAMS_PER_FRAME)
+            {
+                break;
+            }
+
+            // Settle for a coarser level when the requested one does not fit in the budget.  Growth is
+            // measured in allocation sizes, the same unit as the committed bytes.
+            Texture& texture = m_textures.at(id);
+            for (uint32_t mip = texture.requestedMip; mip < texture.resident.mip; mip++)
+            {
+                VkDeviceSize growth = getImageBytes(texture, mip) - texture.resident.bytes;
+                while (m_committedBytes + growth > m_budget && evictLeastRecentlyUsed(id))
+                {
+                }
+                if (m_committedBytes + growth <= m_budget)
+                {
+                    startStream(texture, mip);
+                    started++;
+                    break;
+                }
+            }
+        }
+
+        // Everything started this frame, evictions included, goes out in one batch.
+        bool pending = false;
+        for (auto & entry : m_textures)
+        {
+            pending |= entry.second.streaming && entry.second.incoming.ticket == 0;
+        }
+        if (pending)
+        {
+            uint64_t ticket = uploads->flush();
+            for (auto & entry : m_textures)
+            {
+                if (entry.second.streaming && entry.second.incoming.ticket == 0)
+                {
+                    entry.second.incoming.ticket = ticket;
+                }
+            }
+        }
+
+        // Requests are made again every frame.
+        for (auto & entry : m_textures)
+        {
+            entry.second.requestedMip = entry.second.tailMip;
+        }
+        m_frame++;
+    } /// update
+
+    /******************************************************************
+        Drop the least recently used texture that holds finer levels
+        than it asked for back to the level it asked for.  Returns
+        false when there is nothing left to evict.
+    *******************************************************************/
+    bool TextureResidency::evictLeastRecentlyUsed(uint32_t keep_id)
+    {
+        Texture* victim = nullptr;
+        for (auto & entry : m_textures)
+        {
+            Texture& texture = entry.second;
+            if (entry.first == keep_id || texture.streaming || texture.requestedMip <= texture.resident.mip)
+            {
+                continue;
+            }
+            if (!victim || texture.lastUsedFrame < victim->lastUsedFrame)
+            {
+                victim = &texture;
+            }
+        }
+
+        if (!victim)
+        {
+            return false;
+        }
+
+        // The coarser levels are uploaded again from the system memory copy.
+        startStream(*victim, victim->requestedMip);
+        return true;
+    } /// evictLeastRecentlyUsed
+
+    /******************************************************************
+        Create an image holding the levels [mip, mip count) and queue
+        its upload.
+    *******************************************************************/
+    TextureResidency::ResidentImage TextureResidency::createResidentImage(const TextureData& data, uint32_t mip)
+    {
+        ResidentImage resident = {};
+        resident.mip = mip;
+        uint32_t levels = static_cast<uint32_t>(data.mips.size()) - mip;
+
+        createImage(data.mips[mip].width, data.mips[mip].height, levels, data.format, VK_IMAGE_TILING_OPTIMAL,
+                    VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, resident.image, resident.memory, MemoryCategory::Texture);
+
+        VkMemoryRequirements requirements = {};
+        vkGetImageMemoryRequirements(LogicalDevice::getInstance()->getLogicalDevice(), resident.image, &requirements);
+        resident.bytes = requirements.size;
+        m_residentBytes += resident.bytes;
+
+        UploadManager::getInstance()->uploadImage(resident.image, data, mip);
+        resident.view = createImageView(resident.image, data.format, VK_IMAGE_ASPECT_COLOR_BIT, levels);
+        return resident;
+    } /// createResidentImage
+
+    /******************************************************************
+        Device memory an image holding the levels [mip, mip count)
+        takes, alignment and padding included, from the requirements
+        of an image that is created only to be asked.  Cached per
+        level.
+    *******************************************************************/
+    VkDeviceSize TextureResidency::getImageBytes(Texture& texture, uint32_t mip)
+    {
+        const TextureData& data = *texture.data;
+        texture.imageBytes.resize(data.mips.size(), 0);
+        if (texture.imageBytes[mip] != 0)
+        {
+            return texture.imageBytes[mip];
+        }
+
+        VkImageCreateInfo image_info = {};
+        image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+        image_info.imageType = VK_IMAGE_TYPE_2D;
+        image_info.extent.width = data.mips[mip].width;
+        image_info.extent.height = data.mips[mip].height;
+        image_info.extent.depth = 1;
+        image_info.mipLevels = static_cast<uint32_t>(data.mips.size()) - mip;
+        image_info.arrayLayers = 1;
+        image_info.format = data.format;
+        image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+        image_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+        image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+
+        VkDevice device = LogicalDevice::getInstance()->getLogicalDevice();
+        VkImage image;
+        if (vkCreateImage(device, &image_info, nullptr, &image) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create texture image.");
+        }
+        VkMemoryRequirements requirements = {};
+        vkGetImageMemoryRequirements(device, image, &requirements);
+        vkDestroyImage(device, image, nullptr);
+
+        texture.imageBytes[mip] = requirements.size;
+        return requirements.size;
+    } /// getImageBytes
+
+    /**
+     * @brief Start replacing the resident image with one holding the levels from mip down.
+     *
+     * @param texture
+     * @param mip
+     */
+    void TextureResidency::startStream(Texture& texture, uint32_t mip)
+    {
+        texture.incoming = createResidentImage(*texture.data, mip);
+        texture.streaming = true;
+        m_committedBytes = m_committedBytes + texture.incoming.bytes - texture.resident.bytes;
+    }
+
+    void TextureResidency::retireImage(const ResidentImage& image)
+    {
+        m_retired.push_back({ image, m_frame });
+    }
+
+    void TextureResidency::destroyImage(const ResidentImage& image)
+    {
+        VkDevice device = LogicalDevice::getInstance()->getLogicalDevice();
+        vkDestroyImageView(device, image.view, nullptr);
+        vkDestroyImage(device, image.image, nullptr);
+        freeMemory(image.memory);
+        m_residentBytes -= image.bytes;
+    }
+
+    VkImageView TextureResidency::getImageView(uint32_t id) { return m_textures.at(id).resident.view; }
+    uint32_t TextureResidency::getResidentMip(uint32_t id) { return m_textures.at(id).resident.mip; }
+    void TextureResidency::setBudget(VkDeviceSize budget) { m_budget = budget; }
+    VkDeviceSize TextureResidency::getBudget() { return m_budget; }
+    VkDeviceSize TextureResidency::getResidentBytes() { return m_residentBytes; }
+
+    uint32_t TextureResidency::getMipLevels(uint32_t id)
+    {
+        const Texture& texture = m_textures.at(id);
+        return static_cast<uint32_t>(texture.data->mips.size()) - texture.resident.mip;
+    }
+}
@@ -0,0 +1,755 @@
+#include "../include/UploadManager.h"
+#include "../include/LogicalDevice.h"
+#include "../include/PhysicalDevice.h"
+#include "../include/Util.h"
+#include "../include/TextureCompression.h"
+#include "../include/GpuProfiler.h"
+#include "../include/CpuProfiler.h"
+#include "../include/types.h"
+
+#include <vulkan/vulkan.h>
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <iostream>
+
+namespace KMDM
+{
+    // Staging offsets satisfy the copy offset alignment of every format that is uploaded.
+    const VkDeviceSize STAGING_ALIGNMENT = 16;
+
+    UploadManager* UploadManager::m_uploadManager = nullptr;
+
+    /**
+     * @brief Get the Instance object
+     *
+     * @return UploadManager*
+     */
+    UploadManager* UploadManager::getInstance()
+    {
+        if (!m_uploadManager)
+        {
+            m_uploadManager = new UploadManager();
+        }
+        return m_uploadManager;
+    }
+
+    /**
+     * @brief Construct a new Upload Manager:: Upload Manager object
+     *
+     */
+    UploadManager::UploadManager()
+    {
+        LogicalDevice* device = LogicalDevice::getInstance();
+        QueueFamilyInfo families = device->getQueueFamilyInfo();
+
+        m_graphicsFamily = families.graphicsFamilyIndex.value();
+        m_graphicsQueue = device->getGraphicsQueue();
+
+        // Fall back to the graphics queue when there is no separate transfer family.
+        m_dedicatedTransfer = families.hasTransfer() && families.transferFamilyIndex.value() != m_graphicsFamily;
+        m_transferFamily = m_dedicatedTransfer ? families.transferFamilyIndex.value() : m_graphicsFamily;
+        m_transferQueue = m_dedicatedTransfer ? device->getTransferQueue() : m_graphicsQueue;
+
+        VkCommandPoolCreateInfo pool_info = {};
+        pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+
+        pool_info.queueFamilyIndex = m_graphicsFamily;
+        if (vkCreateCommandPool(device->getLogicalDevice(), &pool_info, nullptr, &m_graphicsPool) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create upload command pool.");
+        }
+
+        m_transferPool = m_graphicsPool;
+        if (m_dedicatedTransfer)
+        {
+            pool_info.queueFamilyIndex = m_transferFamily;
+            if (vkCreateCommandPool(device->getLogicalDevice(), &pool_info, nullptr, &m_transferPool) != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to create transfer command pool.");
+            }
+        }
+
+        // Copies on a transfer only queue may be restricted to multiples of its granularity.
+        uint32_t family_count = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(PhysicalDevice::getInstance()->getPhysicalDevice(), &family_count, nullptr);
+        std::vector<VkQueueFamilyProperties> family_properties(family_count);
+        vkGetPhysicalDeviceQueueFamilyProperties(PhysicalDevice::getInstance()->getPhysicalDevice(), &family_count,
+                                                 family_properties.data());
+        m_copyRowGranularity = family_properties[m_transferFamily].minImageTransferGranularity.height;
+
+        m_stagingRing = new StagingRing();
+        m_transferTimeline = createTimelineSemaphore();
+        m_graphicsTimeline = createTimelineSemaphore();
+
+        if (m_dedicatedTransfer)
+        {
+            std::cout << "Created upload manager on transfer queue family " << m_transferFamily << "." << std::endl;
+        }
+        else
+        {
+            std::cout << "Created upload manager on the graphics queue." << std::endl;
+        }
+    }
+
+    /**
+     * @brief Destroy the Upload Manager:: Upload Manager object
+     *
+     */
+    UploadManager::~UploadManager()
+    {
+        destroyUploadManager();
+    }
+
+    /**
+     * @brief Wait for the outstanding uploads and destroy the upload resources.
+     *
+     */
+    void UploadManager::destroyUploadManager()
+    {
+        VkDevice device = LogicalDevice::getInstance()->getLogicalDevice();
+        std::cout << "- Destroying UploadManager." << std::endl;
+
+        wait(m_graphicsValue);
+
+        // Uploads that were never flushed are dropped.
+        m_bufferUploads.clear();
+        m_imageUploads.clear();
+        delete(m_stagingRing);
+        m_stagingRing = nullptr;
+
+        vkDestroySemaphore(device, m_transferTimeline, nullptr);
+        vkDestroySemaphore(device, m_graphicsTimeline, nullptr);
+        if (m_dedicatedTransfer)
+        {
+            vkDestroyCommandPool(device, m_transferPool, nullptr);
+        }
+        vkDestroyCommandPool(device, m_graphicsPool, nullptr);
+        m_uploadManager = nullptr;
+    }
+
+    /******************************************************************
+        Queue a buffer upload.  Uploads larger than half the staging
+        ring are split into chunks.
+    *******************************************************************/
+    void UploadManager::uploadBuffer(VkBuffer dst, const void* data, VkDeviceSize size,
+        VkAccessFlags dst_access, VkPipelineStageFlags dst_stage)
+    {
+        KMDM_PROFILE_ZONE_VALUE("uploadBuffer", size);
+        const unsigned char* src = static_cast<const unsigned char*>(data);
+        VkDeviceSize max_chunk = m_stagingRing->getSize() / 2;
+
+        VkDeviceSize copied = 0;
+        while (copied < size)
+        {
+            VkDeviceSize chunk = std::min(size - copied, max_chunk);
+            VkDeviceSize offset = allocateStaging(chunk);
+            memcpy(m_stagingRing->getMappedPointer(offset), src + copied, static_cast<size_t>(chunk));
+
+            BufferUpload upload = {};
+            upload.dst = dst;
+            upload.dstOffset = copied;
+            upload.stagingOffset = offset;
+            upload.size = chunk;
+            upload.dstAccess = dst_access;
+            upload.dstStage = dst_stage;
+            upload.last = copied + chunk == size;
+            m_bufferUploads.push_back(upload);
+
+            copied += chunk;
+        }
+    } /// uploadBuffer
+
+    /******************************************************************
+        Queue an image upload.  Images larger than half the staging
+        ring are split into bands of rows.
+    *******************************************************************/
+    void UploadManager::uploadImage(VkImage image, const TextureData& texture, uint32_t base_mip)
+    {
+        KMDM_PROFILE_ZONE("uploadImage");
+        uint32_t block_width, block_height, block_bytes;
+        getFormatBlockInfo(texture.format, block_width, block_height, block_bytes);
+        VkDeviceSize max_chunk = m_stagingRing->getSize() / 2;
+
+        ImageUpload upload = {};
+        upload.image = image;
+        upload.mipLevels = static_cast<uint32_t>(texture.mips.size()) - base_mip;
+        upload.first = true;
+        upload.last = false;
+        m_imageUploads.push_back(upload);
+
+        // Copy each level in bands of whole block rows.
+        for (uint32_t level = base_mip; level < texture.mips.size(); level++)
+        {
+            const TextureMip& mip = texture.mips[level];
+            uint32_t block_rows = (mip.height + block_height - 1) / block_height;
+            VkDeviceSize row_pitch = mip.size / block_rows;
+            uint32_t band_rows = static_cast<uint32_t>(std::min<VkDeviceSize>(block_rows, max_chunk / row_pitch));
+            if (band_rows < block_rows)
+            {
+                if (m_copyRowGranularity == 0)
+                {
+                    throw std::runtime_error("Image is too large for the staging ring.");
+                }
+                band_rows -= band_rows % m_copyRowGranularity;
+                if (band_rows == 0)
+                {
+                    throw std::runtime_error("Image rows are too large for the staging ring.");
+                }
+            }
+
+            const unsigned char* src = texture.data.data() + mip.offset;
+            for (uint32_t row = 0; row < block_rows; row += band_rows)
+            {
+                uint32_t rows = std::min(band_rows, block_rows - row);
+                VkDeviceSize band_size = rows * row_pitch;
+                VkDeviceSize offset = allocateStaging(band_size);
+                if (m_imageUploads.empty())
+                {
+                    // Running out of staging space flushed the earlier bands, carry on in the next batch.
+                    upload.first = false;
+                    m_imageUploads.push_back(upload);
+                }
+                memcpy(m_stagingRing->getMappedPointer(offset), src + row * row_pitch, static_cast<size_t>(band_size));
+
+                uint32_t y = row * block_height;
+                VkBufferImageCopy region = {};
+                region.bufferOffset = offset;
+                region.bufferRowLength = 0;
+                region.bufferImageHeight = 0;
+                region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                region.imageSubresource.mipLevel = level - base_mip;
+                region.imageSubresource.baseArrayLayer = 0;
+                region.imageSubresource.layerCount = 1;
+                region.imageOffset = {0, static_cast<int32_t>(y), 0};
+                region.imageExtent = {mip.width, std::min(rows * block_height, mip.height - y), 1};
+                m_imageUploads.back().regions.push_back(region);
+            }
+        }
+        m_imageUploads.back().last = true;
+    } /// uploadImage
+
+    /******************************************************************
+        Record and submit the queued uploads.
+    *******************************************************************/
+    uint64_t UploadManager::flush()
+    {
+        if (m_bufferUploads.empty() && m_imageUploads.empty())
+        {
+            return m_graphicsValue;
+        }
+        KMDM_PROFILE_ZONE_VALUE("uploadFlush", m_bufferUploads.size() + m_imageUploads.size());
+
+        Batch batch = {};
+        batch.stagingEnd = m_stagingRing->getHead();
+
+        batch.graphicsCommands = beginCommandBuffer(m_graphicsPool);
+
+        // Batches that are one graphics submission are timed with the frame they are flushed in.
+        GpuProfiler* profiler = m_dedicatedTransfer ? nullptr : GpuProfiler::findInstance();
+        if (profiler)
+        {
+            profiler->beginUploadCommandBuffer(batch.graphicsCommands);
+            profiler->beginScope(batch.graphicsCommands, "upload");
+        }
+        if (m_dedicatedTransfer)
+        {
+            // Copies and the release barriers go to the transfer queue, the acquire barriers are
+            // submitted on the graphics queue once the copies are done.
+            batch.transferCommands = beginCommandBuffer(m_transferPool);
+            recordTransfer(batch);
+            vkEndCommandBuffer(batch.transferCommands);
+        }
+        else
+        {
+            // Everything goes into a single graphics queue submission.
+            batch.transferCommands = batch.graphicsCommands;
+            recordTransfer(batch);
+        }
+        recordAcquire(batch);
+        if (profiler)
+        {
+            profiler->endScope(batch.graphicsCommands);
+        }
+        vkEndCommandBuffer(batch.graphicsCommands);
+
+        m_bufferUploads.clear();
+        m_imageUploads.clear();
+
+        batch.graphicsValue = ++m_graphicsValue;
+        if (m_dedicatedTransfer)
+        {
+            batch.transferValue = ++m_transferValue;
+
+            VkTimelineSemaphoreSubmitInfo timeline_info = {};
+            timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+            timeline_info.signalSemaphoreValueCount = 1;
+            timeline_info.pSignalSemaphoreValues = &batch.transferValue;
+
+            VkSubmitInfo submit_info = {};
+            submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            submit_info.pNext = &timeline_info;
+            submit_info.commandBufferCount = 1;
+            submit_info.pCommandBuffers = &batch.transferCommands;
+            submit_info.signalSemaphoreCount = 1;
+            submit_info.pSignalSemaphores = &m_transferTimeline;
+
+            if (vkQueueSubmit(m_transferQueue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS)
+            {
+                throw std::runtime_error("Failed to submit upload batch.");
+            }
+            m_inFlight.push_back(std::move(batch));
+        }
+        else
+        {
+            m_inFlight.push_back(std::move(batch));
+            submitGraphics(m_inFlight.back());
+        }
+        return m_graphicsValue;
+    } /// flush
+
+    /******************************************************************
+        Advance the batches that are in flight.
+    *******************************************************************/
+    void UploadManager::update()
+    {
+        if (m_dedicatedTransfer)
+        {
+            // Only hand a batch to the graphics queue once its copies are done, so the graphics
+            // queue never stalls on the semaphore.  Submit in order to keep the timeline monotonic.
+            uint64_t transfer_done = getTimelineValue(m_transferTimeline);
+            for (auto & batch : m_inFlight)
+            {
+                if (batch.graphicsSubmitted)
+                {
+                    continue;
+                }
+                if (batch.transferValue > transfer_done)
+                {
+                    break;
+                }
+                // The staging memory is only read by the copies.
+                m_stagingRing->release(batch.stagingEnd);
+                submitGraphics(batch);
+            }
+        }
+
+        uint64_t graphics_done = getTimelineValue(m_graphicsTimeline);
+        while (!m_inFlight.empty() && m_inFlight.front().graphicsSubmitted &&
+               m_inFlight.front().graphicsValue <= graphics_done)
+        {
+            retireBatch(m_inFlight.front());
+            m_inFlight.pop_front();
+        }
+    } /// update
+
+    /**
+     * @brief Check if a flush has completed.
+     *
+     * @param ticket
+     * @return true
+     * @return false
+     */
+    bool UploadManager::isComplete(uint64_t ticket)
+    {
+        return getTimelineValue(m_graphicsTimeline) >= ticket;
+    }
+
+    /******************************************************************
+        Block until a flush has completed.
+    *******************************************************************/
+    void UploadManager::wait(uint64_t ticket)
+    {
+        while (!m_inFlight.empty() && !isComplete(ticket))
+        {
+            advanceOldest();
+        }
+        update();
+    } /// wait
+
+    /******************************************************************
+        Wait for the next step of the oldest batch in flight.
+    *******************************************************************/
+    void UploadManager::advanceOldest()
+    {
+        Batch& oldest = m_inFlight.front();
+        if (!oldest.graphicsSubmitted)
+        {
+            waitTimelineValue(m_transferTimeline, oldest.transferValue);
+        }
+        else
+        {
+            waitTimelineValue(m_graphicsTimeline, oldest.graphicsValue);
+        }
+        update();
+    } /// advanceOldest
+
+    /******************************************************************
+        Hand batches to the graphics queue without waiting for their
+        copies on the CPU.  Their staging memory is released when they
+        retire instead of when the copies are seen to be done.
+    *******************************************************************/
+    void UploadManager::submitToGraphics(uint64_t ticket)
+    {
+        for (auto & batch : m_inFlight)
+        {
+            if (batch.graphicsValue > ticket)
+            {
+                break;
+            }
+            if (!batch.graphicsSubmitted)
+            {
+                submitGraphics(batch);
+            }
+        }
+    } /// submitToGraphics
+
+    VkSemaphore UploadManager::getGraphicsTimeline() { return m_graphicsTimeline; }
+    bool UploadManager::hasDedicatedTransferQueue() { return m_dedicatedTransfer; }
+
+    /******************************************************************
+        Allocate staging space.  When the ring is full, flush what has
+        been queued and wait for older batches to give space back.
+    *******************************************************************/
+    VkDeviceSize UploadManager::allocateStaging(VkDeviceSize size)
+    {
+        VkDeviceSize offset = 0;
+        while (!m_stagingRing->allocate(size, STAGING_ALIGNMENT, offset))
+        {
+            if (!m_bufferUploads.empty() || !m_imageUploads.empty())
+            {
+                flush();
+            }
+            else if (!m_inFlight.empty())
+            {
+                advanceOldest();
+            }
+            else
+            {
+                throw std::runtime_error("Upload is larger than the staging ring.");
+            }
+        }
+        return offset;
+    } /// allocateStaging
+
+    /******************************************************************
+        Allocate and begin a one time submit command buffer.
+    *******************************************************************/
+    VkCommandBuffer UploadManager::beginCommandBuffer(VkCommandPool pool)
+    {
+        VkCommandBufferAllocateInfo alloc_info = {};
+        alloc_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        alloc_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        alloc_info.commandPool = pool;
+        alloc_info.commandBufferCount = 1;
+
+        VkCommandBuffer command_buffer;
+        if (vkAllocateCommandBuffers(LogicalDevice::getInstance()->getLogicalDevice(), &alloc_info, &command_buffer)
+            != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to allocate upload command buffer.");
+        }
+
+        VkCommandBufferBeginInfo begin_info = {};
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkBeginCommandBuffer(command_buffer, &begin_info);
+        return command_buffer;
+    } /// beginCommandBuffer
+
+    /******************************************************************
+        Create a timeline semaphore starting at 0.
+    *******************************************************************/
+    VkSemaphore UploadManager::createTimelineSemaphore()
+    {
+        VkSemaphoreTypeCreateInfo type_info = {};
+        type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        type_info.initialValue = 0;
+
+        VkSemaphoreCreateInfo semaphore_info = {};
+        semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphore_info.pNext = &type_info;
+
+        VkSemaphore semaphore;
+        if (vkCreateSemaphore(LogicalDevice::getInstance()->getLogicalDevice(), &semaphore_info, nullptr, &semaphore)
+            != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create timeline semaphore.");
+        }
+        return semaphore;
+    } /// createTimelineSemaphore
+
+    uint64_t UploadManager::getTimelineValue(VkSemaphore semaphore)
+    {
+        uint64_t value = 0;
+        vkGetSemaphoreCounterValue(LogicalDevice::getInstance()->getLogicalDevice(), semaphore, &value);
+        return value;
+    }
+
+    void UploadManager::waitTimelineValue(VkSemaphore semaphore, uint64_t value)
+    {
+        VkSemaphoreWaitInfo wait_info = {};
+        wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        wait_info.semaphoreCount = 1;
+        wait_info.pSemaphores = &semaphore;
+        wait_info.pValues = &value;
+        vkWaitSemaphores(LogicalDevice::getInstance()->getLogicalDevice(), &wait_info, UINT64_MAX);
+    }
+
+    /******************************************************************
+        Record the copies into the transfer command buffer.  With a
+        dedicated transfer queue this also releases ownership of the
+        destinations to the graphics queue family.
+    *******************************************************************/
+    void UploadManager::recordTransfer(Batch& batch)
+    {
+        VkCommandBuffer command_buffer = batch.transferCommands;
+
+        // Move every new destination image into TRANSFER_DST with a single barrier.
+        std::vector<VkImageMemoryBarrier> image_barriers;
+        for (auto & upload : m_imageUploads)
+        {
+            if (!upload.first)
+            {
+                continue;
+            }
+
+            VkImageMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.image = upload.image;
+            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            barrier.subresourceRange.baseMipLevel = 0;
+            barrier.subresourceRange.levelCount = upload.mipLevels;
+            barrier.subresourceRange.baseArrayLayer = 0;
+            barrier.subresourceRange.layerCount = 1;
+            image_barriers.push_back(barrier);
+        }
+        if (!image_barriers.empty())
+        {
+            vkCmdPipelineBarrier(command_buffer,
+                                 VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                                 0, nullptr,
+                                 0, nullptr,
+                                 static_cast<uint32_t>(image_barriers.size()), image_barriers.data());
+        }
+
+        // Copies, all sourced from the staging ring.
+        VkBuffer staging = m_stagingRing->getBuffer();
+        for (auto & upload : m_bufferUploads)
+        {
+            VkBufferCopy region = {};
+            region.srcOffset = upload.stagingOffset;
+            region.dstOffset = upload.dstOffset;
+            region.size = upload.size;
+            vkCmdCopyBuffer(command_buffer, staging, upload.dst, 1, &region);
+        }
+        for (auto & upload : m_imageUploads)
+        {
+            if (upload.regions.empty())
+            {
+                continue;
+            }
+            vkCmdCopyBufferToImage(command_buffer, staging, upload.image,
+                                   VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                                   static_cast<uint32_t>(upload.regions.size()), upload.regions.data());
+        }
+
+        if (!m_dedicatedTransfer)
+        {
+            return;
+        }
+
+        // Release ownership to the graphics family.  This has to match the acquire barrier
+        // recorded in recordAcquire exactly, including the layout transition.  Resources that
+        // are only partially uploaded stay on the transfer queue until their last part.
+        std::vector<VkBufferMemoryBarrier> buffer_releases;
+        for (auto & upload : m_bufferUploads)
+        {
+            if (!upload.last)
+            {
+                continue;
+            }
+
+            VkBufferMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = 0;
+            barrier.srcQueueFamilyIndex = m_transferFamily;
+            barrier.dstQueueFamilyIndex = m_graphicsFamily;
+            barrier.buffer = upload.dst;
+            barrier.offset = 0;
+            barrier.size = VK_WHOLE_SIZE;
+            buffer_releases.push_back(barrier);
+        }
+
+        std::vector<VkImageMemoryBarrier> image_releases;
+        for (auto & upload : m_imageUploads)
+        {
+            if (!upload.last)
+            {
+                continue;
+            }
+
+            VkImageMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = 0;
+            barrier.srcQueueFamilyIndex = m_transferFamily;
+            barrier.dstQueueFamilyIndex = m_graphicsFamily;
+            barrier.image = upload.image;
+            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            barrier.subresourceRange.baseMipLevel = 0;
+            barrier.subresourceRange.levelCount = upload.mipLevels;
+            barrier.subresourceRange.baseArrayLayer = 0;
+            barrier.subresourceRange.layerCount = 1;
+            image_releases.push_back(barrier);
+        }
+
+        if (buffer_releases.empty() && image_releases.empty())
+        {
+            return;
+        }
+        vkCmdPipelineBarrier(command_buffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                             0, nullptr,
+                             static_cast<uint32_t>(buffer_releases.size()), buffer_releases.data(),
+                             static_cast<uint32_t>(image_releases.size()), image_releases.data());
+    } /// recordTransfer
+
+    /******************************************************************
+        Record the graphics side of the batch: make the uploads visible
+        to their consumers, acquiring ownership when a transfer queue was
+        used.
+    *******************************************************************/
+    void UploadManager::recordAcquire(Batch& batch)
+    {
+        VkCommandBuffer command_buffer = batch.graphicsCommands;
+
+        uint32_t src_family = m_dedicatedTransfer ? m_transferFamily : VK_QUEUE_FAMILY_IGNORED;
+        uint32_t dst_family = m_dedicatedTransfer ? m_graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+        VkAccessFlags src_access = m_dedicatedTransfer ? 0 : VK_ACCESS_TRANSFER_WRITE_BIT;
+        VkPipelineStageFlags src_stage = m_dedicatedTransfer ? VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT
+                                                             : VK_PIPELINE_STAGE_TRANSFER_BIT;
+        VkPipelineStageFlags dst_stage = 0;
+
+        std::vector<VkBufferMemoryBarrier> buffer_barriers;
+        for (auto & upload : m_bufferUploads)
+        {
+            if (!upload.last)
+            {
+                continue;
+            }
+
+            VkBufferMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barrier.srcAccessMask = src_access;
+            barrier.dstAccessMask = upload.dstAccess;
+            barrier.srcQueueFamilyIndex = src_family;
+            barrier.dstQueueFamilyIndex = dst_family;
+            barrier.buffer = upload.dst;
+            barrier.offset = 0;
+            barrier.size = VK_WHOLE_SIZE;
+            buffer_barriers.push_back(barrier);
+            dst_stage |= upload.dstStage;
+        }
+
+        std::vector<VkImageMemoryBarrier> image_barriers;
+        for (auto & upload : m_imageUploads)
+        {
+            if (!upload.last)
+            {
+                continue;
+            }
+
+            VkImageMemoryBarrier barrier = {};
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+            barrier.srcAccessMask = src_access;
+            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+            barrier.srcQueueFamilyIndex = src_family;
+            barrier.dstQueueFamilyIndex = dst_family;
+            barrier.image = upload.image;
+            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            barrier.subresourceRange.baseMipLevel = 0;
+            barrier.subresourceRange.levelCount = upload.mipLevels;
+            barrier.subresourceRange.baseArrayLayer = 0;
+            barrier.subresourceRange.layerCount = 1;
+            image_barriers.push_back(barrier);
+            dst_stage |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        }
+
+        if (buffer_barriers.empty() && image_barriers.empty())
+        {
+            return;
+        }
+        vkCmdPipelineBarrier(command_buffer,
+                             src_stage, dst_stage, 0,
+                             0, nullptr,
+                             static_cast<uint32_t>(buffer_barriers.size()), buffer_barriers.data(),
+                             static_cast<uint32_t>(image_barriers.size()), image_barriers.data());
+    } /// recordAcquire
+
+    /******************************************************************
+        Submit the graphics side of a batch.
+    *******************************************************************/
+    void UploadManager::submitGraphics(Batch& batch)
+    {
+        VkTimelineSemaphoreSubmitInfo timeline_info = {};
+        timeline_info.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timeline_info.signalSemaphoreValueCount = 1;
+        timeline_info.pSignalSemaphoreValues = &batch.graphicsValue;
+
+        VkSubmitInfo submit_info = {};
+        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submit_info.pNext = &timeline_info;
+        submit_info.commandBufferCount = 1;
+        submit_info.pCommandBuffers = &batch.graphicsCommands;
+        submit_info.signalSemaphoreCount = 1;
+        submit_info.pSignalSemaphores = &m_graphicsTimeline;
+
+        // The copies have usually finished by the time this is submitted, the wait orders the
+        // acquire after the release either way.
+        VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        if (m_dedicatedTransfer)
+        {
+            timeline_info.waitSemaphoreValueCount = 1;
+            timeline_info.pWaitSemaphoreValues = &batch.transferValue;
+            submit_info.waitSemaphoreCount = 1;
+            submit_info.pWaitSemaphores = &m_transferTimeline;
+            submit_info.pWaitDstStageMask = &wait_stage;
+        }
+
+        if (vkQueueSubmit(m_graphicsQueue, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to submit upload batch.");
+        }
+        batch.graphicsSubmitted = true;
+    } /// submitGraphics
+
+    /******************************************************************
+        Give back the staging space and command buffers of a finished
+        batch.
+    *******************************************************************/
+    void UploadManager::retireBatch(Batch& batch)
+    {
+        VkDevice device = LogicalDevice::getInstance()->getLogicalDevice();
+        m_stagingRing->release(batch.stagingEnd);
+
+        if (m_dedicatedTransfer)
+        {
+            vkFreeCommandBuffers(device, m_transferPool, 1, &batch.transferCommands);
+        }
+        vkFreeCommandBuffers(device, m_graphicsPool, 1, &batch.graphicsCommands);
+    } /// retireBatch
+}
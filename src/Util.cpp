@@ -1,8 +1,9 @@
 #include "../include/Util.h"
 #include "../include/Renderer.h"
-#include "../include/CommandPool.h"
 #include "../include/LogicalDevice.h"
 #include "../include/PhysicalDevice.h"
+#include "../include/UploadManager.h"
+#include "../include/MemoryTelemetry.h"
 
 #include <stdexcept>
 #include <vulkan/vulkan.h>
@@ -13,7 +14,7 @@ namespace KMDM
         Create the host-visible vertex staging buffer.
     *******************************************************************/
     void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
-        VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& buffer_memory)
+        VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& buffer_memory, MemoryCategory category)
     {
         // Buffer create info struct.
         VkBufferCreateInfo bufferInfo = {};
@@ -44,37 +45,20 @@ namespace KMDM
         {
             throw std::runtime_error("Failed to allocate buffer memory.");
         }
+        MemoryTelemetry::getInstance()->trackAllocation(buffer_memory, allocate_info.allocationSize,
+            allocate_info.memoryTypeIndex, category);
 
         // Associate the buffer with the memory.
         vkBindBufferMemory(LogicalDevice::getInstance()->getLogicalDevice(), buffer, buffer_memory, 0);
     } /// createBuffer
 
 
-    /******************************************************************
-        Copy buffer contents.
-    *******************************************************************/
-    void copyBuffer(VkBuffer src, VkBuffer dst, VkDeviceSize size)
-    {
-        // Get a single use command buffer.
-        VkCommandBuffer buffer = CommandPool::getInstance()->beginSingleTimeCommands();
-
-        // Copy buffer from src to dst.
-        VkBufferCopy copyRegion = {};
-        copyRegion.dstOffset = 0;
-        copyRegion.srcOffset = 0;
-        copyRegion.size = size;
-        vkCmdCopyBuffer(buffer, src, dst, 1, &copyRegion);
-
-        // Clean up the single use command buffer.
-        CommandPool::getInstance()->endSingleTimeCommands(buffer);
-    } /// copyBuffer
-
     /******************************************************************
         Create an image.
     *******************************************************************/
      void createImage(uint32_t width, uint32_t height, uint32_t mip_level,
         VkFormat format, VkImageTiling tiling, VkImageUsageFlags usage, VkMemoryPropertyFlags properties,
-        VkImage &image, VkDeviceMemory &memory)
+        VkImage &image, VkDeviceMemory &memory, MemoryCategory category)
     {
 
         // Create image info.
@@ -112,12 +96,26 @@ namespace KMDM
         {
             throw std::runtime_error("Failed to allocate image memory.");
         }
+        MemoryTelemetry::getInstance()->trackAllocation(memory, alloc_info.allocationSize, alloc_info.memoryTypeIndex,
+            category);
         vkBindImageMemory(LogicalDevice::getInstance()->getLogicalDevice(), image, memory, 0);
     }
 
     /******************************************************************
         Find an appropriate vertex buffer memory type.
     *******************************************************************/
+    /******************************************************************
+        Free memory, and stop tracking it.
+    *******************************************************************/
+    void freeMemory(VkDeviceMemory memory)
+    {
+        if (MemoryTelemetry* telemetry = MemoryTelemetry::findInstance())
+        {
+            telemetry->trackFree(memory);
+        }
+        vkFreeMemory(LogicalDevice::getInstance()->getLogicalDevice(), memory, nullptr);
+    } /// freeMemory
+
     uint32_t findMemoryType(uint32_t type_filter, VkMemoryPropertyFlags properties)
     {
         // Query available types of memory.
@@ -136,40 +134,6 @@ namespace KMDM
         throw std::runtime_error("Failed to find a suitable memory type.");
     } /// findMemoryType
 
-    /******************************************************************
-        Copy buffer to image.
-    *******************************************************************/
-    void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height)
-    {
-        // Get a command buffer.
-        VkCommandBuffer cmd_buffer = CommandPool::getInstance()->beginSingleTimeCommands();
-
-        // Specify which part of the buffer is copied to which part of the image.
-        VkBufferImageCopy region = {};
-        region.bufferOffset = 0;
-        region.bufferRowLength = 0;
-        region.bufferImageHeight = 0;
-        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        region.imageSubresource.mipLevel = 0;
-        region.imageSubresource.baseArrayLayer = 0;
-        region.imageSubresource.layerCount = 1;
-        region.imageOffset = {0, 0, 0};
-        region.imageExtent = {width, height, 1};
-
-        // Enqueue the copy command.
-        vkCmdCopyBufferToImage(
-            cmd_buffer,
-            buffer,
-            image,
-            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-            1,
-            &region
-        );
-
-        // End command buffer.
-        CommandPool::getInstance()->endSingleTimeCommands(cmd_buffer);
-    } /// copyBufferToImage
-
     /******************************************************************
         Create the image view.
     ******************************************************************/
@@ -197,7 +161,7 @@ namespace KMDM
     } /// createImageVkew
 
     /**
-     * @brief 
+     * @brief Create a device local buffer and queue an upload of data into it.
      * 
      * @param data 
      * @param size 
@@ -205,44 +169,25 @@ namespace KMDM
      * @param buffer_usage 
      * @param dest_buffer 
      * @param dest_memory 
+     * @return uint64_t UploadManager ticket of the upload.
      */
-    void loadGpuBuffer(void *data, VkDeviceSize size, VkMemoryPropertyFlags memory_properties, VkBufferUsageFlags buffer_usage,
-        VkBuffer dest_buffer, VkDeviceMemory dest_memory)
+    uint64_t loadGpuBuffer(void *data, VkDeviceSize size, VkMemoryPropertyFlags memory_properties, VkBufferUsageFlags buffer_usage,
+        VkBuffer& dest_buffer, VkDeviceMemory& dest_memory, MemoryCategory category)
     {
-        VkBuffer stagingBuffer;
-        VkDeviceMemory stagingMemory;
-
-        // Create the staging buffer
-        createBuffer(
-            size, 
-            VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-            VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-            stagingBuffer, 
-            stagingMemory
-        );
-        
-        // Load the data.
-        void* mem;
-        vkMapMemory(LogicalDevice::getInstance()->getLogicalDevice(), stagingMemory, 0, size, 0, &mem);
-        memcpy(mem, data, size);
-        vkUnmapMemory(LogicalDevice::getInstance()->getLogicalDevice(), stagingMemory);
-
         // Create the GPU buffer.
-        AllocatedBuffer GPUBuffer = {};
         createBuffer(
             size,
             VK_BUFFER_USAGE_TRANSFER_DST_BIT | buffer_usage,
             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | memory_properties,
             dest_buffer,
-            dest_memory
+            dest_memory,
+            category
         );
 
-        // Copy the contents of the staging buffer.
-        copyBuffer(stagingBuffer, GPUBuffer.buffer, size);
-
-        // Nuke the staging buffer.
-        vkDestroyBuffer(LogicalDevice::getInstance()->getLogicalDevice(), stagingBuffer, nullptr);
-        vkFreeMemory(LogicalDevice::getInstance()->getLogicalDevice(), stagingMemory, nullptr);
+        // Copy the data through the staging ring.
+        UploadManager* uploads = UploadManager::getInstance();
+        uploads->uploadBuffer(dest_buffer, data, size, VK_ACCESS_MEMORY_READ_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+        return uploads->flush();
     }
 
     /**
@@ -255,4 +200,27 @@ namespace KMDM
     //     vkDestroyBuffer(LogicalDevice::getInstance()->getLogicalDevice(), buffer.buffer, nullptr);
     //     vkFreeMemory(LogicalDevice::getInstance()->getLogicalDevice(), buffer.bufferMemory, nullptr);
     // }
+
+    /**
+     * @brief Set the dynamic viewport and scissor to the top left extent of the attachments.
+     * 
+     * @param command_buffer 
+     * @param extent 
+     */
+    void setViewportAndScissor(VkCommandBuffer command_buffer, VkExtent2D extent)
+    {
+        VkViewport viewport = {};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = static_cast<float>(extent.width);
+        viewport.height = static_cast<float>(extent.height);
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+        vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+
+        VkRect2D scissor = {};
+        scissor.offset = { 0, 0 };
+        scissor.extent = extent;
+        vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+    }
 }
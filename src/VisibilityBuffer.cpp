@@ -0,0 +1,571 @@
+#include "../include/VisibilityBuffer.h"
+#include "../include/SwapChain.h"
+#include "../include/PipelineCache.h"
+#include "../include/PipelineManager.h"
+#include "../include/RenderTargetPool.h"
+#include "../include/UploadManager.h"
+#include "../include/GpuProfiler.h"
+#include "../include/Util.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <iostream>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace KMDM
+{
+    namespace
+    {
+        // Must match local_size_x and local_size_y of visibility.comp.
+        const uint32_t RESOLVE_GROUP_SIZE = 8;
+
+        // Format of the shaded image, blitted into the swap chain.
+        const VkFormat SHADED_FORMAT = VK_FORMAT_R16G16B16A16_SFLOAT;
+    }
+
+    /**
+     * @brief Construct a new VisibilityBuffer object
+     *
+     * @param descriptor_set
+     * @param pipeline
+     * @param depth_view
+     * @param image_count
+     */
+    VisibilityBuffer::VisibilityBuffer(DescriptorSet* descriptor_set, Pipeline* pipeline, VkImageView depth_view,
+        uint32_t image_count)
+    {
+        m_logicalDevice = LogicalDevice::getInstance();
+        m_descriptorSet = descriptor_set;
+        m_imageCount = image_count;
+        m_extent = SwapChain::getInstance()->getSwapChainExtent();
+        m_pipelineLayout = *pipeline->getPipelineLayout();
+
+        m_renderPass = new Renderpass(RenderpassType::Visibility);
+        createImages(depth_view);
+        createDescriptorSets();
+        createPipelines(pipeline);
+        std::cout << "Created visibility buffer." << std::endl;
+    }
+
+    /**
+     * @brief Destroy the VisibilityBuffer object
+     *
+     */
+    VisibilityBuffer::~VisibilityBuffer()
+    {
+        destroyVisibilityBuffer();
+    }
+
+    /**
+     * @brief Destroy the pipelines, images and geometry.  The visibility pipeline belongs to the
+     * PipelineManager.
+     *
+     */
+    void VisibilityBuffer::destroyVisibilityBuffer()
+    {
+        std::cout << "- Destroying visibility buffer." << std::endl;
+        VkDevice device = m_logicalDevice->getLogicalDevice();
+        destroyGeometry();
+
+        vkDestroyPipeline(device, m_resolvePipeline, nullptr);
+        vkDestroyPipelineLayout(device, m_resolvePipelineLayout, nullptr);
+        vkDestroyDescriptorPool(device, m_descriptorPool, nullptr);
+        vkDestroyDescriptorSetLayout(device, m_resolveLayout, nullptr);
+        m_descriptorSets.clear();
+
+        vkDestroyFramebuffer(device, m_framebuffer, nullptr);
+        delete(m_renderPass);
+
+        RenderTargetPool::getInstance()->release(m_visibilityTarget);
+        RenderTargetPool::getInstance()->release(m_shadedTarget);
+    }
+
+    /**
+     * @brief Follow a swap chain resize.  The old images go back to the pool and the old framebuffer
+     * is destroyed once the frames in flight are done with it.
+     *
+     * @param depth_view
+     */
+    void VisibilityBuffer::resize(VkImageView depth_view)
+    {
+        RenderTargetPool* pool = RenderTargetPool::getInstance();
+        pool->release(m_visibilityTarget);
+        pool->release(m_shadedTarget);
+        VkDevice device = m_logicalDevice->getLogicalDevice();
+        VkFramebuffer framebuffer = m_framebuffer;
+        pool->retire([device, framebuffer]()
+        {
+            vkDestroyFramebuffer(device, framebuffer, nullptr);
+        });
+
+        m_extent = SwapChain::getInstance()->getSwapChainExtent();
+        createImages(depth_view);
+    }
+
+    /**
+     * @brief Follow a change of the swap chain image count.  The resolve sets of the old count are
+     * destroyed once the frames in flight are done with them, and the new ones are written when
+     * their images are next recorded.
+     *
+     * @param image_count
+     */
+    void VisibilityBuffer::setImageCount(uint32_t image_count)
+    {
+        if (image_count == m_imageCount)
+        {
+            return;
+        }
+        VkDevice device = m_logicalDevice->getLogicalDevice();
+        VkDescriptorPool descriptorPool = m_descriptorPool;
+        RenderTargetPool::getInstance()->retire([device, descriptorPool]()
+        {
+            vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+        });
+
+        m_imageCount = image_count;
+        createDescriptorPool();
+    }
+
+    /**
+     * @brief Take the visibility and shaded images from the render target pool, and create the
+     * framebuffer of the visibility pass.
+     *
+     * @param depth_view
+     */
+    void VisibilityBuffer::createImages(VkImageView depth_view)
+    {
+        RenderImageDesc visibilityDesc = {};
+        visibilityDesc.format = VISIBILITY_FORMAT;
+        visibilityDesc.extent = m_extent;
+        visibilityDesc.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+        visibilityDesc.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+        m_visibilityTarget = RenderTargetPool::getInstance()->acquire(visibilityDesc);
+
+        RenderImageDesc shadedDesc = {};
+        shadedDesc.format = SHADED_FORMAT;
+        shadedDesc.extent = m_extent;
+        shadedDesc.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        shadedDesc.aspect = VK_IMAGE_ASPECT_COLOR_BIT;
+        m_shadedTarget = RenderTargetPool::getInstance()->acquire(shadedDesc);
+
+        VkImageView attachments[] = { m_visibilityTarget.view, depth_view };
+        VkFramebufferCreateInfo frameInfo = {};
+        frameInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+        frameInfo.renderPass = m_renderPass->getRenderPass();
+        frameInfo.attachmentCount = 2;
+        frameInfo.pAttachments = attachments;
+        frameInfo.width = m_extent.width;
+        frameInfo.height = m_extent.height;
+        frameInfo.layers = 1;
+
+        if (vkCreateFramebuffer(m_logicalDevice->getLogicalDevice(), &frameInfo, nullptr, &m_framebuffer)
+            != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create visibility framebuffer.");
+        }
+    }
+
+    /**
+     * @brief Create the resolve set layout and allocate a set for every swap chain image.
+     *
+     */
+    void VisibilityBuffer::createDescriptorSets()
+    {
+        VkDevice device = m_logicalDevice->getLogicalDevice();
+
+        VkDescriptorSetLayoutBinding bindings[] = {
+            { 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },          // Camera.
+            { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },          // Vertices.
+            { 2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },          // Indices.
+            { 3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },          // Draws.
+            { 4, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },           // Visibility.
+            { 5, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, nullptr },           // Shaded.
+            { 6, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MAX_VISIBILITY_TEXTURES,
+                VK_SHADER_STAGE_COMPUTE_BIT, nullptr }                                                  // Textures.
+        };
+
+        VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        layoutInfo.bindingCount = 7;
+        layoutInfo.pBindings = bindings;
+
+        if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &m_resolveLayout) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create visibility resolve descriptor set layout.");
+        }
+        createDescriptorPool();
+    } /// createDescriptorSets
+
+    /**
+     * @brief Create the resolve descriptor pool and allocate a set from it for every swap chain image.
+     *
+     */
+    void VisibilityBuffer::createDescriptorPool()
+    {
+        VkDevice device = m_logicalDevice->getLogicalDevice();
+
+        std::array<VkDescriptorPoolSize, 4> sizes = {};
+        sizes[0] = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, m_imageCount };
+        sizes[1] = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 3 * m_imageCount };
+        sizes[2] = { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 2 * m_imageCount };
+        sizes[3] = { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, MAX_VISIBILITY_TEXTURES * m_imageCount };
+
+        VkDescriptorPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.maxSets = m_imageCount;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(sizes.size());
+        poolInfo.pPoolSizes = sizes.data();
+
+        if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &m_descriptorPool) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create visibility resolve descriptor pool.");
+        }
+
+        m_descriptorSets.resize(m_imageCount);
+        std::vector<VkDescriptorSetLayout> layouts(m_imageCount, m_resolveLayout);
+        VkDescriptorSetAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = m_descriptorPool;
+        allocInfo.descriptorSetCount = m_imageCount;
+        allocInfo.pSetLayouts = layouts.data();
+
+        if (vkAllocateDescriptorSets(device, &allocInfo, m_descriptorSets.data()) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to allocate visibility resolve descriptor sets.");
+        }
+    }
+
+    /******************************************************************
+        The visibility pipeline is the default pipeline with only the
+        position stream and the id shaders.  The resolve pipeline
+        reads the lighting set after its own, and is specialized with
+        the id split and the vertex layout it decodes.
+    *******************************************************************/
+    void VisibilityBuffer::createPipelines(Pipeline* pipeline)
+    {
+        VkDevice device = m_logicalDevice->getLogicalDevice();
+
+        PipelineDesc visibilityDesc = pipeline->getDescription();
+        visibilityDesc.vertexShader = SHADER_PATH "visibility_vert.spv";
+        visibilityDesc.fragmentShader = SHADER_PATH "visibility_frag.spv";
+        visibilityDesc.specialization = { { 0, VISIBILITY_TRIANGLE_BITS } };
+        visibilityDesc.vertexBindings = { Vertex::getPositionBindingDescription() };
+        visibilityDesc.vertexAttributes = { Vertex::getPositionAttributeDescription() };
+        visibilityDesc.renderPass = m_renderPass->getRenderPass();
+        m_visibilityPipeline = PipelineManager::getInstance()->getPipeline(visibilityDesc);
+
+        VkDescriptorSetLayout layouts[] = { m_resolveLayout, m_descriptorSet->getLightingLayout() };
+        VkPipelineLayoutCreateInfo layoutInfo = {};
+        layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        layoutInfo.setLayoutCount = 2;
+        layoutInfo.pSetLayouts = layouts;
+
+        if (vkCreatePipelineLayout(device, &layoutInfo, nullptr, &m_resolvePipelineLayout) != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create visibility resolve pipeline layout.");
+        }
+
+        uint32_t constants[] = {
+            VISIBILITY_TRIANGLE_BITS,
+            MAX_VISIBILITY_TEXTURES,
+            static_cast<uint32_t>(sizeof(Vertex) / sizeof(float)),
+            static_cast<uint32_t>(offsetof(Vertex, position) / sizeof(float)),
+            static_cast<uint32_t>(offsetof(Vertex, normal) / sizeof(float)),
+            static_cast<uint32_t>(offsetof(Vertex, texCoord) / sizeof(float))
+        };
+        VkSpecializationMapEntry entries[6];
+        for (uint32_t i = 0; i < 6; i++)
+        {
+            entries[i] = { i, static_cast<uint32_t>(i * sizeof(uint32_t)), sizeof(uint32_t) };
+        }
+        VkSpecializationInfo specialization = {};
+        specialization.mapEntryCount = 6;
+        specialization.pMapEntries = entries;
+        specialization.dataSize = sizeof(constants);
+        specialization.pData = constants;
+
+        VkShaderModule module = m_logicalDevice->createShaderModule(readFile(SHADER_PATH "visibility_comp.spv"));
+
+        VkComputePipelineCreateInfo pipelineInfo = {};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = module;
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.stage.pSpecializationInfo = &specialization;
+        pipelineInfo.layout = m_resolvePipelineLayout;
+
+        VkResult result = vkCreateComputePipelines(device, PipelineCache::getInstance()->getPipelineCache(), 1,
+            &pipelineInfo, nullptr, &m_resolvePipeline);
+        vkDestroyShaderModule(device, module, nullptr);
+        if (result != VK_SUCCESS)
+        {
+            throw std::runtime_error("Failed to create visibility resolve pipeline.");
+        }
+    } /// createPipelines
+
+    /******************************************************************
+        Pack every model into one vertex and one index buffer.  Each
+        draw records where its indices start, the offset of its
+        vertices and the texture slot of its model.  Models that share
+        a texture share a slot; past MAX_VISIBILITY_TEXTURES textures
+        the first slot is reused.
+    *******************************************************************/
+    void VisibilityBuffer::updateGeometry(std::vector<Model>& models)
+    {
+        std::vector<VkBuffer> geometryModels;
+        for (auto & model : models)
+        {
+            geometryModels.push_back(*model.getVertexBuffer());
+        }
+        if (geometryModels == m_geometryModels && m_vertexBuffer != VK_NULL_HANDLE)
+        {
+            return;
+        }
+        if (models.size() > MAX_VISIBILITY_DRAWS)
+        {
+            throw std::runtime_error("Too many draws for the visibility buffer.");
+        }
+
+        std::vector<Vertex> vertices;
+        std::vector<uint32_t> indices;
+        std::vector<DrawInfo> draws;
+        std::unordered_map<uint32_t, uint32_t> textureSlots;
+        m_textureModels.clear();
+        for (uint32_t i = 0; i < models.size(); i++)
+        {
+            auto slot = textureSlots.find(models[i].getTexture());
+            if (slot == textureSlots.end())
+            {
+                uint32_t next = std::min<uint32_t>(static_cast<uint32_t>(m_textureModels.size()),
+                    MAX_VISIBILITY_TEXTURES);
+                if (next < MAX_VISIBILITY_TEXTURES)
+                {
+                    m_textureModels.push_back(i);
+                }
+                slot = textureSlots.emplace(models[i].getTexture(), next % MAX_VISIBILITY_TEXTURES).first;
+            }
+
+            DrawInfo draw = {};
+            draw.firstIndex = static_cast<uint32_t>(indices.size());
+            draw.vertexOffset = static_cast<int32_t>(vertices.size());
+            draw.texture = slot->second;
+            draws.push_back(draw);
+
+            const std::vector<Vertex>& modelVertices = models[i].getVertices();
+            const std::vector<uint32_t>& modelIndices = models[i].getIndices();
+            if (modelIndices.size() / 3 > (1u << VISIBILITY_TRIANGLE_BITS))
+            {
+                throw std::runtime_error("Too many triangles in a model for the visibility buffer.");
+            }
+            vertices.insert(vertices.end(), modelVertices.begin(), modelVertices.end());
+            indices.insert(indices.end(), modelIndices.begin(), modelIndices.end());
+        }
+
+        // The old buffers go once the frames in flight are done with them.
+        VkDevice device = m_logicalDevice->getLogicalDevice();
+        std::array<VkBuffer, 3> buffers = { m_vertexBuffer, m_indexBuffer, m_drawBuffer };
+        std::array<VkDeviceMemory, 3> memory = { m_vertexMemory, m_indexMemory, m_drawMemory };
+        RenderTargetPool::getInstance()->retire([device, buffers, memory]()
+        {
+            for (size_t i = 0; i < buffers.size(); i++)
+            {
+                vkDestroyBuffer(device, buffers[i], nullptr);
+                freeMemory(memory[i]);
+            }
+        });
+
+        // Storage buffers can not be empty.
+        vertices.resize(std::max<size_t>(vertices.size(), 1));
+        indices.resize(std::max<size_t>(indices.size(), 1));
+        draws.resize(std::max<size_t>(draws.size(), 1));
+
+        loadGpuBuffer(vertices.data(), sizeof(Vertex) * vertices.size(), 0, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            m_vertexBuffer, m_vertexMemory, MemoryCategory::Geometry);
+        loadGpuBuffer(indices.data(), sizeof(uint32_t) * indices.size(), 0, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            m_indexBuffer, m_indexMemory, MemoryCategory::Geometry);
+        m_geometryTicket = loadGpuBuffer(draws.data(), sizeof(DrawInfo) * draws.size(), 0,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, m_drawBuffer, m_drawMemory, MemoryCategory::Geometry);
+
+        // The frame waits for the copies on the GPU, see getGeometryTicket().
+        UploadManager::getInstance()->submitToGraphics(m_geometryTicket);
+
+        m_geometryModels = geometryModels;
+        std::cout << "Built visibility buffer geometry for " << models.size() << " draws." << std::endl;
+    } /// updateGeometry
+
+    /**
+     * @brief Destroy the shared geometry buffers.
+     *
+     */
+    void VisibilityBuffer::destroyGeometry()
+    {
+        VkDevice device = m_logicalDevice->getLogicalDevice();
+        vkDestroyBuffer(device, m_vertexBuffer, nullptr);
+        freeMemory(m_vertexMemory);
+        vkDestroyBuffer(device, m_indexBuffer, nullptr);
+        freeMemory(m_indexMemory);
+        vkDestroyBuffer(device, m_drawBuffer, nullptr);
+        freeMemory(m_drawMemory);
+        m_vertexBuffer = VK_NULL_HANDLE;
+        m_vertexMemory = VK_NULL_HANDLE;
+        m_indexBuffer = VK_NULL_HANDLE;
+        m_indexMemory = VK_NULL_HANDLE;
+        m_drawBuffer = VK_NULL_HANDLE;
+        m_drawMemory = VK_NULL_HANDLE;
+        m_geometryModels.clear();
+    }
+
+    /******************************************************************
+        Every slot of the texture array has to hold a valid view, so
+        the slots past the last texture repeat the first one.
+    *******************************************************************/
+    void VisibilityBuffer::updateDescriptorSet(uint32_t image, VkBuffer uniform_buffer, std::vector<Model>& models)
+    {
+        if (m_textureModels.empty())
+        {
+            throw std::runtime_error("The visibility buffer needs at least one model to shade.");
+        }
+
+        std::array<VkDescriptorBufferInfo, 4> bufferInfos = {};
+        bufferInfos[0] = { uniform_buffer, 0, sizeof(UniformBufferObject) };
+        bufferInfos[1] = { m_vertexBuffer, 0, VK_WHOLE_SIZE };
+        bufferInfos[2] = { m_indexBuffer, 0, VK_WHOLE_SIZE };
+        bufferInfos[3] = { m_drawBuffer, 0, VK_WHOLE_SIZE };
+
+        std::array<VkDescriptorImageInfo, 2> storageInfos = {};
+        storageInfos[0] = { VK_NULL_HANDLE, m_visibilityTarget.view, VK_IMAGE_LAYOUT_GENERAL };
+        storageInfos[1] = { VK_NULL_HANDLE, m_shadedTarget.view, VK_IMAGE_LAYOUT_GENERAL };
+
+        std::vector<VkDescriptorImageInfo> textureInfos(MAX_VISIBILITY_TEXTURES);
+        for (uint32_t i = 0; i < MAX_VISIBILITY_TEXTURES; i++)
+        {
+            Model& model = models[m_textureModels[i < m_textureModels.size() ? i : 0]];
+            textureInfos[i] = { model.getTextureSampler(), model.getTextureImageView(),
+                VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL };
+        }
+
+        std::array<VkWriteDescriptorSet, 7> writes = {};
+        for (uint32_t i = 0; i < writes.size(); i++)
+        {
+            writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            writes[i].dstSet = m_descriptorSets[image];
+            writes[i].dstBinding = i;
+            writes[i].descriptorCount = 1;
+        }
+        writes[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        writes[0].pBufferInfo = &bufferInfos[0];
+        for (uint32_t i = 1; i < 4; i++)
+        {
+            writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            writes[i].pBufferInfo = &bufferInfos[i];
+        }
+        writes[4].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        writes[4].pImageInfo = &storageInfos[0];
+        writes[5].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        writes[5].pImageInfo = &storageInfos[1];
+        writes[6].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writes[6].descriptorCount = MAX_VISIBILITY_TEXTURES;
+        writes[6].pImageInfo = textureInfos.data();
+
+        vkUpdateDescriptorSets(m_logicalDevice->getLogicalDevice(), static_cast<uint32_t>(writes.size()),
+            writes.data(), 0, nullptr);
+    } /// updateDescriptorSet
+
+    /******************************************************************
+        1) visibility: draw the ids and depth.  The draw index goes in
+           as the first instance, so no per draw state is bound.
+        2) visibility_resolve: shade every pixel from its id.
+        3) visibility_present: blit the shaded image to the swap chain.
+    *******************************************************************/
+    void VisibilityBuffer::addPasses(RenderGraph& graph, uint32_t image, RenderResource color, RenderResource depth,
+        const LightCullingResources& lights, VkDescriptorSet scene_set, VkDescriptorSet lighting_set,
+        std::vector<Model>& models)
+    {
+        RenderResource visibility = graph.importImage("visibility", m_visibilityTarget.image,
+            m_visibilityTarget.view, m_visibilityTarget.desc, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT);
+        RenderResource shaded = graph.importImage("visibility_shaded", m_shadedTarget.image, m_shadedTarget.view,
+            m_shadedTarget.desc, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_UNDEFINED, VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+        graph.addPass("visibility", [&models, scene_set, this](VkCommandBuffer commandBuffer, RenderGraph&)
+        {
+            VkRenderPassBeginInfo renderPassInfo = {};
+            renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+            renderPassInfo.renderPass = m_renderPass->getRenderPass();
+            renderPassInfo.framebuffer = m_framebuffer;
+            renderPassInfo.renderArea.offset = {0, 0};
+            renderPassInfo.renderArea.extent = m_extent;
+
+            // All ones marks a pixel no triangle covers.
+            std::array<VkClearValue, 2> clearValues = {};
+            clearValues[0].color.uint32[0] = 0xFFFFFFFF;
+            clearValues[1].depthStencil = {1.0f, 0};
+            renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
+            renderPassInfo.pClearValues = clearValues.data();
+
+            vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_visibilityPipeline);
+            setViewportAndScissor(commandBuffer, m_extent);
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_pipelineLayout, 0, 1,
+                &scene_set, 0, nullptr);
+
+            GpuProfiler* profiler = GpuProfiler::findInstance();
+            for (uint32_t j = 0; j < models.size(); j++)
+            {
+                VkBuffer buffers[] = { *models[j].getPositionBuffer() };
+                VkDeviceSize offsets[] = { 0 };
+                vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+                vkCmdBindIndexBuffer(commandBuffer, *models[j].getIndexBuffer(), 0, VK_INDEX_TYPE_UINT32);
+                if (profiler)
+                {
+                    profiler->beginDrawCounters(commandBuffer, j);
+                }
+                vkCmdDrawIndexed(commandBuffer, models[j].getIndexCount(), 1, 0, 0, j);
+                if (profiler)
+                {
+                    profiler->endDrawCounters(commandBuffer);
+                }
+            }
+            vkCmdEndRenderPass(commandBuffer);
+        })
+            .write(visibility, RenderAccess::ColorAttachment)
+            .write(depth, RenderAccess::DepthAttachment);
+
+        VkDescriptorSet resolveSet = m_descriptorSets[image];
+        graph.addPass("visibility_resolve", [resolveSet, lighting_set, this](VkCommandBuffer commandBuffer,
+            RenderGraph&)
+        {
+            VkDescriptorSet sets[] = { resolveSet, lighting_set };
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_resolvePipeline);
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, m_resolvePipelineLayout, 0, 2,
+                sets, 0, nullptr);
+            vkCmdDispatch(commandBuffer, (m_extent.width + RESOLVE_GROUP_SIZE - 1) / RESOLVE_GROUP_SIZE,
+                (m_extent.height + RESOLVE_GROUP_SIZE - 1) / RESOLVE_GROUP_SIZE, 1);
+        })
+            .read(visibility, RenderAccess::StorageRead)
+            .read(lights.lightGrid, RenderAccess::StorageRead)
+            .read(lights.lightIndices, RenderAccess::StorageRead)
+            .write(shaded, RenderAccess::StorageWrite);
+
+        graph.addPass("visibility_present", [shaded, color, this](VkCommandBuffer commandBuffer,
+            RenderGraph& pass_graph)
+        {
+            VkImageBlit blit = {};
+            blit.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+            blit.srcOffsets[1] = { static_cast<int32_t>(m_extent.width), static_cast<int32_t>(m_extent.height), 1 };
+            blit.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+            blit.dstOffsets[1] = blit.srcOffsets[1];
+            vkCmdBlitImage(commandBuffer, pass_graph.getImage(shaded), VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                pass_graph.getImage(color), VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_NEAREST);
+        })
+            .read(shaded, RenderAccess::TransferSrc)
+            .write(color, RenderAccess::TransferDst);
+    } /// addPasses
+
+    VkImage VisibilityBuffer::getVisibilityImage() { return m_visibilityTarget.image; }
+    VkImage VisibilityBuffer::getShadedImage() { return m_shadedTarget.image; }
+    uint64_t VisibilityBuffer::getGeometryTicket() { return m_geometryTicket; }
+}
@@ -8,11 +8,14 @@
 #include <SDL_video.h>
 
 #include <iostream>
+#include <stdexcept>
 
 namespace KMDM
 {
     Window* Window::m_window = nullptr;
     SDL_Window* Window::m_SDLwindow = nullptr;
+    bool Window::m_headless = false;
+    ExtentSize Window::m_headlessSize = {WIDTH, HEIGHT};
 
     Window* Window::getInstance()
     {
@@ -30,6 +33,10 @@ namespace KMDM
 
     ExtentSize Window::getWindowSize()
     {
+        if (m_headless)
+        {
+            return m_headlessSize;
+        }
         ExtentSize e;
         SDL_Vulkan_GetDrawableSize(m_SDLwindow, &e.width, &e.height);
         return e;
@@ -46,11 +53,33 @@ namespace KMDM
         }
     }
 
+    void Window::setHeadless(bool headless, int width, int height)
+    {
+        if (m_window && headless != m_headless)
+        {
+            throw std::runtime_error("Headless mode has to be set before the window is created.");
+        }
+        m_headless = headless;
+        m_headlessSize = {width, height};
+    }
+
+    bool Window::isHeadless()
+    {
+        return m_headless;
+    }
+
     Window::Window()
     {
+        if (m_headless)
+        {
+            std::cout << "Running headless at " << m_headlessSize.width << "x" << m_headlessSize.height
+                << "." << std::endl;
+            return;
+        }
+
         // Initialize the SDL window.
         SDL_Init(SDL_INIT_VIDEO);
-        SDL_WindowFlags windowFlags = (SDL_WindowFlags)(SDL_WINDOW_VULKAN);
+        SDL_WindowFlags windowFlags = (SDL_WindowFlags)(SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE);
 
         // Create a blank SDL window.
         m_SDLwindow = SDL_CreateWindow(
@@ -0,0 +1,161 @@
+#include "../include/WorkerPool.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace KMDM
+{
+    WorkerPool* WorkerPool::m_workerPool = nullptr;
+
+    WorkerPool* WorkerPool::getInstance()
+    {
+        // Decode threads may ask for the first time at once.
+        static std::mutex instanceMutex;
+        std::lock_guard<std::mutex> lock(instanceMutex);
+        if (!m_workerPool)
+        {
+            m_workerPool = new WorkerPool();
+        }
+        return m_workerPool;
+    }
+
+    WorkerPool* WorkerPool::findInstance()
+    {
+        return m_workerPool;
+    }
+
+    /**
+     * @brief Construct a new Worker Pool:: Worker Pool object with a thread per core but the
+     * caller's.
+     *
+     */
+    WorkerPool::WorkerPool() :
+        m_stop(false)
+    {
+        uint32_t thread_count = std::max(1u, std::thread::hardware_concurrency()) - 1;
+        for (uint32_t i = 0; i < thread_count; i++)
+        {
+            m_threads.emplace_back(&WorkerPool::worker, this);
+        }
+        std::cout << "Created worker pool with " << thread_count << " threads." << std::endl;
+    }
+
+    WorkerPool::~WorkerPool()
+    {
+        destroyWorkerPool();
+    }
+
+    void WorkerPool::destroyWorkerPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_stop)
+            {
+                return;
+            }
+            m_stop = true;
+        }
+        std::cout << "- Destroying WorkerPool." << std::endl;
+        m_wake.notify_all();
+        for (auto & thread : m_threads)
+        {
+            thread.join();
+        }
+        m_threads.clear();
+    }
+
+    /******************************************************************
+        The loop is queued for the pool threads and the caller works
+        on it as well.  Whoever finishes the last iteration wakes the
+        caller, which then takes the loop off the queue if no pool
+        thread has yet.
+    *******************************************************************/
+    void WorkerPool::parallelFor(uint32_t count, const std::function<void(uint32_t)>& body, uint32_t grain)
+    {
+        std::shared_ptr<Loop> loop;
+        if (count >= 2 * std::max(1u, grain))
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_stop && !m_threads.empty())
+            {
+                loop = std::make_shared<Loop>();
+                loop->count = count;
+                loop->body = &body;
+                m_loops.push_back(loop);
+            }
+        }
+        if (!loop)
+        {
+            for (uint32_t i = 0; i < count; i++)
+            {
+                body(i);
+            }
+            return;
+        }
+
+        m_wake.notify_all();
+        run(*loop);
+        {
+            std::unique_lock<std::mutex> lock(loop->mutex);
+            loop->finished.wait(lock, [&loop]()
+            {
+                return loop->done == loop->count;
+            });
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = std::find(m_loops.begin(), m_loops.end(), loop);
+        if (it != m_loops.end())
+        {
+            m_loops.erase(it);
+        }
+    } /// parallelFor
+
+    /**
+     * @brief Help with the oldest loop that still has iterations left, until stopped.
+     *
+     */
+    void WorkerPool::worker()
+    {
+        while (true)
+        {
+            std::shared_ptr<Loop> loop;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_wake.wait(lock, [this]()
+                {
+                    return m_stop || !m_loops.empty();
+                });
+                if (m_stop)
+                {
+                    return;
+                }
+                loop = m_loops.front();
+                if (loop->next >= loop->count)
+                {
+                    m_loops.pop_front();
+                    continue;
+                }
+            }
+            run(*loop);
+        }
+    }
+
+    /**
+     * @brief Take iterations of a loop until none are left.
+     *
+     * @param loop
+     */
+    void WorkerPool::run(Loop& loop)
+    {
+        for (uint32_t i = loop.next++; i < loop.count; i = loop.next++)
+        {
+            (*loop.body)(i);
+            if (++loop.done == loop.count)
+            {
+                std::lock_guard<std::mutex> lock(loop.mutex);
+                loop.finished.notify_all();
+            }
+        }
+    }
+}
@@ -0,0 +1,101 @@
+#include "../include/TextureCompression.h"
+#include "../include/Ktx2.h"
+#include "../include/MipGenerator.h"
+#include "../include/types.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+/******************************************************************
+    TextureCook: import an image and write it as a KTX2 file with a
+    full mip chain, block compressed unless rgba is asked for.
+
+    TextureCook <input> <output.ktx2> [bc1|bc3|bc5|bc7|rgba] [--linear] [--box]
+*******************************************************************/
+
+namespace
+{
+    VkFormat parseFormat(const std::string& name, bool linear)
+    {
+        if (name == "bc1") return linear ? VK_FORMAT_BC1_RGBA_UNORM_BLOCK : VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+        if (name == "bc3") return linear ? VK_FORMAT_BC3_UNORM_BLOCK : VK_FORMAT_BC3_SRGB_BLOCK;
+        if (name == "bc5") return VK_FORMAT_BC5_UNORM_BLOCK;
+        if (name == "bc7") return linear ? VK_FORMAT_BC7_UNORM_BLOCK : VK_FORMAT_BC7_SRGB_BLOCK;
+        if (name == "rgba") return linear ? VK_FORMAT_R8G8B8A8_UNORM : VK_FORMAT_R8G8B8A8_SRGB;
+        throw std::runtime_error("Unknown format " + name + ".");
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage: TextureCook <input> <output.ktx2> [bc1|bc3|bc5|bc7|rgba] [--linear] [--box]" << std::endl;
+        return 1;
+    }
+
+    try
+    {
+        std::string format_name = "bc7";
+        bool linear = false;
+        KMDM::MipFilter filter = KMDM::MipFilter::Kaiser;
+        for (int i = 3; i < argc; i++)
+        {
+            std::string arg = argv[i];
+            if (arg == "--linear")
+            {
+                linear = true;
+            }
+            else if (arg == "--box")
+            {
+                filter = KMDM::MipFilter::Box;
+            }
+            else
+            {
+                format_name = arg;
+            }
+        }
+        VkFormat format = parseFormat(format_name, linear);
+
+        int width, height, channels;
+        stbi_uc* pixels = stbi_load(argv[1], &width, &height, &channels, STBI_rgb_alpha);
+        if (!pixels)
+        {
+            throw std::runtime_error("Failed to load " + std::string(argv[1]) + ".");
+        }
+
+        KMDM::TextureData texture;
+        texture.format = linear ? VK_FORMAT_R8G8B8A8_UNORM : VK_FORMAT_R8G8B8A8_SRGB;
+        texture.width = static_cast<uint32_t>(width);
+        texture.height = static_cast<uint32_t>(height);
+        texture.data.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+        texture.mips = { { 0, texture.data.size(), texture.width, texture.height } };
+        stbi_image_free(pixels);
+
+        KMDM::generateMipChain(texture, filter);
+        if (KMDM::isBlockCompressed(format))
+        {
+            texture = KMDM::compressTexture(texture, format);
+        }
+
+        std::vector<unsigned char> bytes = KMDM::writeKtx2(texture);
+        std::ofstream file(argv[2], std::ios::binary);
+        if (!file.write(reinterpret_cast<const char*>(bytes.data()), bytes.size()))
+        {
+            throw std::runtime_error("Failed to write " + std::string(argv[2]) + ".");
+        }
+        std::cout << "Cooked " << argv[1] << " to " << argv[2] << " (" << format_name << ", "
+                  << texture.mips.size() << " mips)." << std::endl;
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}